@@ -5057,6 +5057,26 @@ event_add_failed:
 	return ret;
 }
 
+/**
+ * pevent_add_event - add an event built without parsing its format
+ * @pevent: the handle to the pevent
+ * @event: the event, allocated as pevent_parse_format() does
+ *
+ * This adds an event whose fields were filled in by the caller, as
+ * pevent_parse_event() does with the one it parses, binding the handler
+ * registered for it, if any. On success, @event belongs to @pevent.
+ */
+enum pevent_errno pevent_add_event(struct pevent *pevent,
+				   struct event_format *event)
+{
+	if (add_event(pevent, event))
+		return PEVENT_ERRNO__MEM_ALLOC_FAILED;
+
+	find_event_handle(pevent, event);
+
+	return 0;
+}
+
 #undef _PE
 #define _PE(code, str) str
 static const char * const pevent_error_str[] = {
@@ -549,6 +549,8 @@ enum pevent_errno pevent_parse_event(struct pevent *pevent, const char *buf,
 				     unsigned long size, const char *sys);
 enum pevent_errno pevent_parse_format(struct event_format **eventp, const char *buf,
 				      unsigned long size, const char *sys);
+enum pevent_errno pevent_add_event(struct pevent *pevent,
+				   struct event_format *event);
 void pevent_free_format(struct event_format *event);
 
 void *pevent_get_field_raw(struct trace_seq *s, struct event_format *event,
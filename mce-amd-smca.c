@@ -12,6 +12,7 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "ras-mce-handler.h"
@@ -391,6 +392,22 @@ static struct smca_hwid smca_hwid_mcatypes[] = {
 	{ SMCA_PCIE,     0x00000046 },
 };
 
+/*
+ * IPIDs are fixed per (cpu, bank), so the bank type only needs to be looked
+ * up in smca_hwid_mcatypes[] the first time a bank reports an error. Rows
+ * are allocated per CPU on first use.
+ */
+#define SMCA_MAX_BANKS	64
+
+/*
+ * The hwid in the upper 32 bits, and the bank type + 1 in the lower ones
+ * (0 if the entry isn't valid), so that handler threads can read and
+ * update it at once
+ */
+struct smca_bank_cache {
+	uint64_t	entry;
+};
+
 struct smca_bank_name {
 	const char *name;
 };
@@ -434,43 +451,116 @@ static void amd_decode_errcode(struct mce_event *e)
 /*
  * To find the UMC channel represented by this bank we need to match on its
  * instance_id. The instance_id of a bank is held in the lower 32 bits of its
- * IPID.
+ * IPID. UMC instances are laid out as 0x50f00, 0x150f00, 0x250f00, ...,
+ * so the channel number is held in bits [31:20]. This covers parts with
+ * more than two channels per socket, like Zen 3/4 with 8 to 12 channels.
  */
 static int find_umc_channel(struct mce_event *e)
 {
-	uint32_t umc_instance_id[] = {0x50f00, 0x150f00};
-	uint32_t instance_id = EXTRACT(e->ipid, 0, 31);
-	int i, channel = -1;
+	return EXTRACT(e->ipid, 0, 31) >> 20;
+}
+
+static int smca_lookup_bank_type(uint32_t mcatype_hwid)
+{
+	unsigned int i;
+
+	for (i = 0; i < ARRAY_SIZE(smca_hwid_mcatypes); i++) {
+		if (mcatype_hwid == smca_hwid_mcatypes[i].mcatype_hwid)
+			return smca_hwid_mcatypes[i].bank_type;
+	}
+
+	return -1;
+}
+
+static struct smca_bank_cache *smca_cache_entry(struct mce_priv *mce,
+						struct mce_event *e)
+{
+	struct smca_bank_cache *row;
+
+	if (!mce || e->cpu >= mce->ncpus || e->bank >= SMCA_MAX_BANKS)
+		return NULL;
+
+	if (!mce->smca_cache)
+		return NULL;
+
+	/* Rows are allocated by the first thread that needs them */
+	row = __atomic_load_n(&mce->smca_cache[e->cpu], __ATOMIC_ACQUIRE);
+	if (!row) {
+		struct smca_bank_cache *new, *cur = NULL;
+
+		new = calloc(SMCA_MAX_BANKS, sizeof(*new));
+		if (!new)
+			return NULL;
+		if (__atomic_compare_exchange_n(&mce->smca_cache[e->cpu], &cur,
+						new, 0, __ATOMIC_ACQ_REL,
+						__ATOMIC_ACQUIRE)) {
+			row = new;
+		} else {
+			free(new);
+			row = cur;
+		}
+	}
+
+	return &row[e->bank];
+}
+
+static int smca_get_bank_type(struct mce_priv *mce, struct mce_event *e)
+{
+	uint32_t mcatype_hwid = EXTRACT(e->ipid, 32, 63);
+	struct smca_bank_cache *c = smca_cache_entry(mce, e);
+	uint64_t entry;
+	int bank_type;
+
+	if (c) {
+		entry = __atomic_load_n(&c->entry, __ATOMIC_RELAXED);
+		if ((uint32_t)entry && entry >> 32 == mcatype_hwid)
+			return (int)(uint32_t)entry - 1;
+	}
+
+	bank_type = smca_lookup_bank_type(mcatype_hwid);
+	if (c) {
+		entry = (uint64_t)mcatype_hwid << 32 | (uint32_t)(bank_type + 1);
+		__atomic_store_n(&c->entry, entry, __ATOMIC_RELAXED);
+	}
+
+	return bank_type;
+}
+
+int amd_smca_alloc_cache(struct mce_priv *mce)
+{
+	mce->smca_cache = calloc(mce->ncpus, sizeof(*mce->smca_cache));
+
+	return mce->smca_cache ? 0 : -1;
+}
+
+void amd_smca_free_cache(struct mce_priv *mce)
+{
+	unsigned int cpu;
 
-	for (i = 0; i < ARRAY_SIZE(umc_instance_id); i++)
-		if (umc_instance_id[i] == instance_id)
-			channel = i;
+	if (!mce->smca_cache)
+		return;
 
-	return channel;
+	for (cpu = 0; cpu < mce->ncpus; cpu++)
+		free(mce->smca_cache[cpu]);
+	free(mce->smca_cache);
+	mce->smca_cache = NULL;
 }
+
 /* Decode extended errors according to Scalable MCA specification */
-static void decode_smca_error(struct mce_event *e)
+static void decode_smca_error(struct mce_priv *mce, struct mce_event *e)
 {
 	enum smca_bank_types bank_type;
 	const char *ip_name;
 	unsigned short xec = (e->status >> 16) & 0x3f;
-	const struct smca_hwid *s_hwid;
-	uint32_t mcatype_hwid = EXTRACT(e->ipid, 32, 63);
 	unsigned int csrow = -1, channel = -1;
-	unsigned int i;
-
-	for (i = 0; i < ARRAY_SIZE(smca_hwid_mcatypes); i++) {
-		s_hwid = &smca_hwid_mcatypes[i];
-		if (mcatype_hwid == s_hwid->mcatype_hwid) {
-			bank_type = s_hwid->bank_type;
-			break;
-		}
-	}
+	int type;
 
-	if (i >= ARRAY_SIZE(smca_hwid_mcatypes)) {
+	type = smca_get_bank_type(mce, e);
+	if (type < 0) {
 		strcpy(e->mcastatus_msg, "Couldn't find bank type with IPID");
 		return;
 	}
+	bank_type = type;
 
 	if (bank_type >= N_SMCA_BANK_TYPES) {
 		strcpy(e->mcastatus_msg, "Don't know how to decode this bank");
@@ -513,7 +603,7 @@ int parse_amd_smca_event(struct ras_events *ras, struct mce_event *e)
 	if (mcgstatus & MCG_STATUS_MCIP)
 		mce_snprintf(e->mcgstatus_msg, "MCIP");
 
-	decode_smca_error(e);
+	decode_smca_error(ras->mce_priv, e);
 	amd_decode_errcode(e);
 	return 0;
 }
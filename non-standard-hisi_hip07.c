@@ -15,6 +15,8 @@
 #include "ras-logger.h"
 #include "ras-report.h"
 #include "ras-non-standard-handler.h"
+#include "ras-ns-layout.h"
+#include "ras-plugin.h"
 
 /* common definitions */
 
@@ -87,41 +89,49 @@ static char *sas_axi_err_type(int etype)
 	return "unknown error";
 }
 
-static int decode_hip07_sas_error(struct ras_events *ras,
-				  struct ras_ns_dec_tab *dec_tab,
-				  struct trace_seq *s,
-				  struct ras_non_standard_event *event)
+static const char *sas_mb_err_str(const uint8_t *sec, uint64_t val)
 {
-	char buf[1024];
-	char *p = buf;
-	const struct hisi_sas_err_sec *err =
-			(struct hisi_sas_err_sec *)event->error;
-
-	if (err->val_bits == 0) {
-		trace_seq_printf(s, "%s: no valid error data\n",
-				 __func__);
-		return -1;
-	}
-	p += sprintf(p, "[");
-	if (err->val_bits & HISI_SAS_VALID_PA)
-		p += sprintf(p, "phy addr = 0x%p: ",
-			     (void *)err->physical_addr);
+	return err_bit_type(val);
+}
 
-	if (err->val_bits & HISI_SAS_VALID_MB_ERR)
-		p += sprintf(p, "%s: ", err_bit_type(err->mb));
+static const char *sas_err_type_str(const uint8_t *sec, uint64_t val)
+{
+	return sas_err_type(val);
+}
 
-	if (err->val_bits & HISI_SAS_VALID_ERR_TYPE)
-		p += sprintf(p, "error type = %s: ",
-			     sas_err_type(err->type));
+static const char *sas_axi_err_type_str(const uint8_t *sec, uint64_t val)
+{
+	return sas_axi_err_type(val);
+}
 
-	if (err->val_bits & HISI_SAS_VALID_AXI_ERR_INFO)
-		p += sprintf(p, "axi error type = %s",
-			     sas_axi_err_type(err->axi_err_info));
+static const struct ns_field hip07_sas_hdr[] = {
+	NS_FIELD("phy addr = 0x%llx: ", struct hisi_sas_err_sec,
+		 physical_addr, HISI_SAS_VALID_PA, 0),
+	NS_FIELD_STR("%s: ", struct hisi_sas_err_sec, mb,
+		     HISI_SAS_VALID_MB_ERR, 0, sas_mb_err_str),
+	NS_FIELD_STR("error type = %s: ", struct hisi_sas_err_sec, type,
+		     HISI_SAS_VALID_ERR_TYPE, 0, sas_err_type_str),
+	NS_FIELD_STR("axi error type = %s", struct hisi_sas_err_sec,
+		     axi_err_info, HISI_SAS_VALID_AXI_ERR_INFO, 0,
+		     sas_axi_err_type_str),
+	{ /* sentinel */ }
+};
 
-	p += sprintf(p, "]");
+static const struct ns_layout hip07_sas_layout = {
+	.name = "hip07_sas",
+	.title = "\nHISI HIP07: SAS error: ",
+	.hdr_open = "[",
+	.hdr_close = "]",
+	.valid_width = 8,
+	.hdr = hip07_sas_hdr,
+};
 
-	trace_seq_printf(s, "\nHISI HIP07: SAS error: %s\n", buf);
-	return 0;
+static int decode_hip07_sas_error(struct ras_events *ras,
+				  struct ras_ns_dec_tab *dec_tab,
+				  struct trace_seq *s,
+				  struct ras_non_standard_event *event)
+{
+	return ns_layout_decode(ras, dec_tab, &hip07_sas_layout, s, event);
 }
 
 static int decode_hip07_hns_error(struct ras_events *ras,
@@ -144,8 +154,9 @@ struct ras_ns_dec_tab hisi_ns_dec_tab[] = {
 	{ /* sentinel */ }
 };
 
-__attribute__((constructor))
-static void hip07_init(void)
+static int hip07_init(void)
 {
-	register_ns_dec_tab(hisi_ns_dec_tab);
+	return register_ns_dec_tab(hisi_ns_dec_tab);
 }
+
+RAS_PLUGIN_INIT("hisi_hip07", hip07_init);
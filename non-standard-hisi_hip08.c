@@ -15,6 +15,8 @@
 #include "ras-logger.h"
 #include "ras-report.h"
 #include "ras-non-standard-handler.h"
+#include "ras-ns-layout.h"
+#include "ras-plugin.h"
 
 /* HISI OEM error definitions */
 /* HISI OEM format1 error definitions */
@@ -81,7 +83,6 @@
 #define HISI_PCIE_LOCAL_VALID_ERR_MISC		9
 
 #define HISI_PCIE_LOCAL_ERR_MISC_MAX	33
-#define HISI_BUF_LEN	1024
 
 #define HISI_ERR_SEVERITY_NFE	0
 #define HISI_ERR_SEVERITY_FE	1
@@ -145,12 +146,6 @@ struct hisi_pcie_local_err_sec {
 	uint32_t   err_misc[HISI_PCIE_LOCAL_ERR_MISC_MAX];
 };
 
-enum hisi_oem_data_type {
-	HISI_OEM_DATA_TYPE_INT,
-	HISI_OEM_DATA_TYPE_INT64,
-	HISI_OEM_DATA_TYPE_TEXT,
-};
-
 enum {
 	HIP08_OEM_TYPE1_FIELD_ID,
 	HIP08_OEM_TYPE1_FIELD_TIMESTAMP,
@@ -563,186 +558,215 @@ static const struct db_table_descriptor hip08_pcie_local_event_tab = {
 	.num_fields = ARRAY_SIZE(hip08_pcie_local_event_fields),
 };
 
-static void record_vendor_data(struct ras_ns_dec_tab *dec_tab,
-			       enum hisi_oem_data_type data_type,
-			       int id, int64_t data, const char *text)
+#endif
+
+static const char *err_severity_str(const uint8_t *sec, uint64_t val)
 {
-	switch (data_type) {
-	case HISI_OEM_DATA_TYPE_INT:
-		sqlite3_bind_int(dec_tab->stmt_dec_record, id, data);
-		break;
-	case HISI_OEM_DATA_TYPE_INT64:
-		sqlite3_bind_int64(dec_tab->stmt_dec_record, id, data);
-		break;
-	case HISI_OEM_DATA_TYPE_TEXT:
-		sqlite3_bind_text(dec_tab->stmt_dec_record, id, text, -1, NULL);
-		break;
-	default:
-		break;
-	}
+	return err_severity(val);
 }
 
-static int step_vendor_data_tab(struct ras_ns_dec_tab *dec_tab,
-				const char *name)
+static const char *oem_type1_module_str(const uint8_t *sec, uint64_t val)
 {
-	int rc;
-
-	rc = sqlite3_step(dec_tab->stmt_dec_record);
-	if (rc != SQLITE_OK && rc != SQLITE_DONE)
-		log(TERM, LOG_ERR,
-		    "Failed to do %s step on sqlite: error = %d\n", name, rc);
-
-	rc = sqlite3_reset(dec_tab->stmt_dec_record);
-	if (rc != SQLITE_OK && rc != SQLITE_DONE)
-		log(TERM, LOG_ERR,
-		    "Failed to reset %s on sqlite: error = %d\n", name, rc);
+	return oem_module_name(hisi_oem_type1_module, val);
+}
 
-	rc = sqlite3_clear_bindings(dec_tab->stmt_dec_record);
-	if (rc != SQLITE_OK && rc != SQLITE_DONE)
-		log(TERM, LOG_ERR,
-		    "Failed to clear bindings %s on sqlite: error = %d\n",
-		    name, rc);
+static const char *oem_type1_submodule_str(const uint8_t *sec, uint64_t val)
+{
+	const struct hisi_oem_type1_err_sec *err = (const void *)sec;
 
-	return rc;
+	return oem_submodule_name(hisi_oem_type1_module, err->module_id, val);
 }
-#else
-static void record_vendor_data(struct ras_ns_dec_tab *dec_tab,
-			       enum hisi_oem_data_type data_type,
-			       int id, int64_t data, const char *text)
-{ }
 
-static int step_vendor_data_tab(struct ras_ns_dec_tab *dec_tab, char *name)
+static const char *oem_type2_module_str(const uint8_t *sec, uint64_t val)
 {
-	return 0;
+	return oem_module_name(hisi_oem_type2_module, val);
 }
-#endif
 
-#define IN_RANGE(p, start, end) ((p) >= (start) && (p) < (end))
-static void decode_oem_type1_err_hdr(struct ras_ns_dec_tab *dec_tab,
-				     struct trace_seq *s,
-				     const struct hisi_oem_type1_err_sec *err)
+static const char *oem_type2_submodule_str(const uint8_t *sec, uint64_t val)
 {
-	char buf[HISI_BUF_LEN];
-	char *p = buf;
-	char *end = buf + HISI_BUF_LEN;
-
-	p += snprintf(p, end - p, "[ table_version=%d ", err->version);
-	record_vendor_data(dec_tab, HISI_OEM_DATA_TYPE_INT,
-			   HIP08_OEM_TYPE1_FIELD_VERSION, err->version, NULL);
-
-	if (err->val_bits & HISI_OEM_VALID_SOC_ID && IN_RANGE(p, buf, end)) {
-		p += snprintf(p, end - p, "SOC_ID=%d ", err->soc_id);
-		record_vendor_data(dec_tab, HISI_OEM_DATA_TYPE_INT,
-				   HIP08_OEM_TYPE1_FIELD_SOC_ID,
-				   err->soc_id, NULL);
-	}
-
-	if (err->val_bits & HISI_OEM_VALID_SOCKET_ID && IN_RANGE(p, buf, end)) {
-		p += snprintf(p, end - p, "socket_ID=%d ", err->socket_id);
-		record_vendor_data(dec_tab, HISI_OEM_DATA_TYPE_INT,
-				   HIP08_OEM_TYPE1_FIELD_SOCKET_ID,
-				   err->socket_id, NULL);
-	}
+	const struct hisi_oem_type2_err_sec *err = (const void *)sec;
 
-	if (err->val_bits & HISI_OEM_VALID_NIMBUS_ID && IN_RANGE(p, buf, end)) {
-		p += snprintf(p, end - p, "nimbus_ID=%d ", err->nimbus_id);
-		record_vendor_data(dec_tab, HISI_OEM_DATA_TYPE_INT,
-				   HIP08_OEM_TYPE1_FIELD_NIMBUS_ID,
-				   err->nimbus_id, NULL);
-	}
-
-	if (err->val_bits & HISI_OEM_VALID_MODULE_ID && IN_RANGE(p, buf, end)) {
-		const char *str = oem_module_name(hisi_oem_type1_module,
-						  err->module_id);
-
-		p += snprintf(p, end - p, "module=%s ", str);
-		record_vendor_data(dec_tab, HISI_OEM_DATA_TYPE_TEXT,
-				   HIP08_OEM_TYPE1_FIELD_MODULE_ID,
-				   0, str);
-	}
-
-	if (err->val_bits & HISI_OEM_VALID_SUB_MODULE_ID &&
-	    IN_RANGE(p, buf, end)) {
-		const char *str = oem_submodule_name(hisi_oem_type1_module,
-						     err->module_id,
-						     err->sub_module_id);
-
-		p += snprintf(p, end - p, "submodule=%s ", str);
-		record_vendor_data(dec_tab, HISI_OEM_DATA_TYPE_TEXT,
-				   HIP08_OEM_TYPE1_FIELD_SUB_MODULE_ID,
-				   0, str);
-	}
-
-	if (err->val_bits & HISI_OEM_VALID_ERR_SEVERITY &&
-	    IN_RANGE(p, buf, end)) {
-		p += snprintf(p, end - p, "error_severity=%s ",
-			     err_severity(err->err_severity));
-		record_vendor_data(dec_tab, HISI_OEM_DATA_TYPE_TEXT,
-				   HIP08_OEM_TYPE1_FIELD_ERR_SEV,
-				   0, err_severity(err->err_severity));
-	}
-
-	if (IN_RANGE(p, buf, end))
-		p += snprintf(p, end - p, "]");
-
-	trace_seq_printf(s, "%s\n", buf);
+	return oem_submodule_name(hisi_oem_type2_module, err->module_id, val);
 }
 
-static void decode_oem_type1_err_regs(struct ras_ns_dec_tab *dec_tab,
-				      struct trace_seq *s,
-				      const struct hisi_oem_type1_err_sec *err)
+static const char *pcie_local_sub_module_str(const uint8_t *sec, uint64_t val)
 {
-	char buf[HISI_BUF_LEN];
-	char *p = buf;
-	char *end = buf + HISI_BUF_LEN;
-
-	trace_seq_printf(s, "Reg Dump:\n");
-	if (err->val_bits & HISI_OEM_TYPE1_VALID_ERR_MISC_0) {
-		trace_seq_printf(s, "ERR_MISC0=0x%x\n", err->err_misc_0);
-		p += snprintf(p, end - p, "ERR_MISC0=0x%x ", err->err_misc_0);
-	}
-
-	if (err->val_bits & HISI_OEM_TYPE1_VALID_ERR_MISC_1 &&
-	    IN_RANGE(p, buf, end)) {
-		trace_seq_printf(s, "ERR_MISC1=0x%x\n", err->err_misc_1);
-		p += snprintf(p, end - p, "ERR_MISC1=0x%x ", err->err_misc_1);
-	}
+	return pcie_local_sub_module_name(val);
+}
 
-	if (err->val_bits & HISI_OEM_TYPE1_VALID_ERR_MISC_2 &&
-	    IN_RANGE(p, buf, end)) {
-		trace_seq_printf(s, "ERR_MISC2=0x%x\n", err->err_misc_2);
-		p += snprintf(p, end - p, "ERR_MISC2=0x%x ", err->err_misc_2);
-	}
+/* error data decoding tables */
+#define T1 struct hisi_oem_type1_err_sec
+static const struct ns_field hip08_oem_type1_hdr[] = {
+	NS_FIELD("table_version=%llu ", T1, version, NS_ALWAYS_VALID,
+		 HIP08_OEM_TYPE1_FIELD_VERSION),
+	NS_FIELD("SOC_ID=%llu ", T1, soc_id, HISI_OEM_VALID_SOC_ID,
+		 HIP08_OEM_TYPE1_FIELD_SOC_ID),
+	NS_FIELD("socket_ID=%llu ", T1, socket_id, HISI_OEM_VALID_SOCKET_ID,
+		 HIP08_OEM_TYPE1_FIELD_SOCKET_ID),
+	NS_FIELD("nimbus_ID=%llu ", T1, nimbus_id, HISI_OEM_VALID_NIMBUS_ID,
+		 HIP08_OEM_TYPE1_FIELD_NIMBUS_ID),
+	NS_FIELD_STR("module=%s ", T1, module_id, HISI_OEM_VALID_MODULE_ID,
+		     HIP08_OEM_TYPE1_FIELD_MODULE_ID, oem_type1_module_str),
+	NS_FIELD_STR("submodule=%s ", T1, sub_module_id,
+		     HISI_OEM_VALID_SUB_MODULE_ID,
+		     HIP08_OEM_TYPE1_FIELD_SUB_MODULE_ID,
+		     oem_type1_submodule_str),
+	NS_FIELD_STR("error_severity=%s ", T1, err_severity,
+		     HISI_OEM_VALID_ERR_SEVERITY,
+		     HIP08_OEM_TYPE1_FIELD_ERR_SEV, err_severity_str),
+	{ /* sentinel */ }
+};
 
-	if (err->val_bits & HISI_OEM_TYPE1_VALID_ERR_MISC_3 &&
-	    IN_RANGE(p, buf, end)) {
-		trace_seq_printf(s, "ERR_MISC3=0x%x\n", err->err_misc_3);
-		p += snprintf(p, end - p, "ERR_MISC3=0x%x ", err->err_misc_3);
-	}
+static const struct ns_field hip08_oem_type1_regs[] = {
+	NS_FIELD("ERR_MISC0=0x%llx", T1, err_misc_0,
+		 HISI_OEM_TYPE1_VALID_ERR_MISC_0, 0),
+	NS_FIELD("ERR_MISC1=0x%llx", T1, err_misc_1,
+		 HISI_OEM_TYPE1_VALID_ERR_MISC_1, 0),
+	NS_FIELD("ERR_MISC2=0x%llx", T1, err_misc_2,
+		 HISI_OEM_TYPE1_VALID_ERR_MISC_2, 0),
+	NS_FIELD("ERR_MISC3=0x%llx", T1, err_misc_3,
+		 HISI_OEM_TYPE1_VALID_ERR_MISC_3, 0),
+	NS_FIELD("ERR_MISC4=0x%llx", T1, err_misc_4,
+		 HISI_OEM_TYPE1_VALID_ERR_MISC_4, 0),
+	NS_FIELD("ERR_ADDR=0x%llx", T1, err_addr,
+		 HISI_OEM_TYPE1_VALID_ERR_ADDR, 0),
+	{ /* sentinel */ }
+};
+#undef T1
+
+static const struct ns_layout hip08_oem_type1_layout = {
+	.name = "hip08_oem_type1",
+	.title = "\nHISI HIP08: OEM Type-1 Error\n",
+	.hdr_open = "[ ",
+	.hdr_close = "]",
+	.valid_width = 4,
+	.hdr = hip08_oem_type1_hdr,
+	.regs = hip08_oem_type1_regs,
+#ifdef HAVE_SQLITE3
+	.tab = &hip08_oem_type1_event_tab,
+#endif
+	.ts_column = HIP08_OEM_TYPE1_FIELD_TIMESTAMP,
+	.regs_column = HIP08_OEM_TYPE1_FIELD_REGS_DUMP,
+};
 
-	if (err->val_bits & HISI_OEM_TYPE1_VALID_ERR_MISC_4 &&
-	    IN_RANGE(p, buf, end)) {
-		trace_seq_printf(s, "ERR_MISC4=0x%x\n", err->err_misc_4);
-		p += snprintf(p, end - p, "ERR_MISC4=0x%x ", err->err_misc_4);
-	}
+#define T2 struct hisi_oem_type2_err_sec
+static const struct ns_field hip08_oem_type2_hdr[] = {
+	NS_FIELD("table_version=%llu ", T2, version, NS_ALWAYS_VALID,
+		 HIP08_OEM_TYPE2_FIELD_VERSION),
+	NS_FIELD("SOC_ID=%llu ", T2, soc_id, HISI_OEM_VALID_SOC_ID,
+		 HIP08_OEM_TYPE2_FIELD_SOC_ID),
+	NS_FIELD("socket_ID=%llu ", T2, socket_id, HISI_OEM_VALID_SOCKET_ID,
+		 HIP08_OEM_TYPE2_FIELD_SOCKET_ID),
+	NS_FIELD("nimbus_ID=%llu ", T2, nimbus_id, HISI_OEM_VALID_NIMBUS_ID,
+		 HIP08_OEM_TYPE2_FIELD_NIMBUS_ID),
+	NS_FIELD_STR("module=%s ", T2, module_id, HISI_OEM_VALID_MODULE_ID,
+		     HIP08_OEM_TYPE2_FIELD_MODULE_ID, oem_type2_module_str),
+	NS_FIELD_STR("submodule=%s ", T2, sub_module_id,
+		     HISI_OEM_VALID_SUB_MODULE_ID,
+		     HIP08_OEM_TYPE2_FIELD_SUB_MODULE_ID,
+		     oem_type2_submodule_str),
+	NS_FIELD_STR("error_severity=%s ", T2, err_severity,
+		     HISI_OEM_VALID_ERR_SEVERITY,
+		     HIP08_OEM_TYPE2_FIELD_ERR_SEV, err_severity_str),
+	{ /* sentinel */ }
+};
 
-	if (err->val_bits & HISI_OEM_TYPE1_VALID_ERR_ADDR &&
-	    IN_RANGE(p, buf, end)) {
-		trace_seq_printf(s, "ERR_ADDR=0x%llx\n",
-				 (unsigned long long)err->err_addr);
-		p += snprintf(p, end - p, "ERR_ADDR=0x%llx ",
-			     (unsigned long long)err->err_addr);
-	}
+static const struct ns_field hip08_oem_type2_regs[] = {
+	NS_FIELD("ERR_FR_0=0x%llx", T2, err_fr_0,
+		 HISI_OEM_TYPE2_VALID_ERR_FR, 0),
+	NS_FIELD("ERR_FR_1=0x%llx", T2, err_fr_1,
+		 HISI_OEM_TYPE2_VALID_ERR_FR, 0),
+	NS_FIELD("ERR_CTRL_0=0x%llx", T2, err_ctrl_0,
+		 HISI_OEM_TYPE2_VALID_ERR_CTRL, 0),
+	NS_FIELD("ERR_CTRL_1=0x%llx", T2, err_ctrl_1,
+		 HISI_OEM_TYPE2_VALID_ERR_CTRL, 0),
+	NS_FIELD("ERR_STATUS_0=0x%llx", T2, err_status_0,
+		 HISI_OEM_TYPE2_VALID_ERR_STATUS, 0),
+	NS_FIELD("ERR_STATUS_1=0x%llx", T2, err_status_1,
+		 HISI_OEM_TYPE2_VALID_ERR_STATUS, 0),
+	NS_FIELD("ERR_ADDR_0=0x%llx", T2, err_addr_0,
+		 HISI_OEM_TYPE2_VALID_ERR_ADDR, 0),
+	NS_FIELD("ERR_ADDR_1=0x%llx", T2, err_addr_1,
+		 HISI_OEM_TYPE2_VALID_ERR_ADDR, 0),
+	NS_FIELD("ERR_MISC0_0=0x%llx", T2, err_misc0_0,
+		 HISI_OEM_TYPE2_VALID_ERR_MISC_0, 0),
+	NS_FIELD("ERR_MISC0_1=0x%llx", T2, err_misc0_1,
+		 HISI_OEM_TYPE2_VALID_ERR_MISC_0, 0),
+	NS_FIELD("ERR_MISC1_0=0x%llx", T2, err_misc1_0,
+		 HISI_OEM_TYPE2_VALID_ERR_MISC_1, 0),
+	NS_FIELD("ERR_MISC1_1=0x%llx", T2, err_misc1_1,
+		 HISI_OEM_TYPE2_VALID_ERR_MISC_1, 0),
+	{ /* sentinel */ }
+};
+#undef T2
+
+static const struct ns_layout hip08_oem_type2_layout = {
+	.name = "hip08_oem_type2",
+	.title = "\nHISI HIP08: OEM Type-2 Error\n",
+	.hdr_open = "[ ",
+	.hdr_close = "]",
+	.valid_width = 4,
+	.hdr = hip08_oem_type2_hdr,
+	.regs = hip08_oem_type2_regs,
+#ifdef HAVE_SQLITE3
+	.tab = &hip08_oem_type2_event_tab,
+#endif
+	.ts_column = HIP08_OEM_TYPE2_FIELD_TIMESTAMP,
+	.regs_column = HIP08_OEM_TYPE2_FIELD_REGS_DUMP,
+};
 
-	if (p > buf && p < end) {
-		p--;
-		*p = '\0';
-	}
+#define PL struct hisi_pcie_local_err_sec
+static const struct ns_field hip08_pcie_local_hdr[] = {
+	NS_FIELD("table_version=%llu ", PL, version, NS_ALWAYS_VALID,
+		 HIP08_PCIE_LOCAL_FIELD_VERSION),
+	NS_FIELD("SOC_ID=%llu ", PL, soc_id, HISI_PCIE_LOCAL_VALID_SOC_ID,
+		 HIP08_PCIE_LOCAL_FIELD_SOC_ID),
+	NS_FIELD("socket_ID=%llu ", PL, socket_id,
+		 HISI_PCIE_LOCAL_VALID_SOCKET_ID,
+		 HIP08_PCIE_LOCAL_FIELD_SOCKET_ID),
+	NS_FIELD("nimbus_ID=%llu ", PL, nimbus_id,
+		 HISI_PCIE_LOCAL_VALID_NIMBUS_ID,
+		 HIP08_PCIE_LOCAL_FIELD_NIMBUS_ID),
+	NS_FIELD_STR("submodule=%s ", PL, sub_module_id,
+		     HISI_PCIE_LOCAL_VALID_SUB_MODULE_ID,
+		     HIP08_PCIE_LOCAL_FIELD_SUB_MODULE_ID,
+		     pcie_local_sub_module_str),
+	NS_FIELD("core_ID=core%llu ", PL, core_id,
+		 HISI_PCIE_LOCAL_VALID_CORE_ID,
+		 HIP08_PCIE_LOCAL_FIELD_CORE_ID),
+	NS_FIELD("port_ID=port%llu ", PL, port_id,
+		 HISI_PCIE_LOCAL_VALID_PORT_ID,
+		 HIP08_PCIE_LOCAL_FIELD_PORT_ID),
+	NS_FIELD_STR("error_severity=%s ", PL, err_severity,
+		     HISI_PCIE_LOCAL_VALID_ERR_SEVERITY,
+		     HIP08_PCIE_LOCAL_FIELD_ERR_SEV, err_severity_str),
+	NS_FIELD("error_type=0x%llx ", PL, err_type,
+		 HISI_PCIE_LOCAL_VALID_ERR_TYPE,
+		 HIP08_PCIE_LOCAL_FIELD_ERR_TYPE),
+	{ /* sentinel */ }
+};
 
-	record_vendor_data(dec_tab, HISI_OEM_DATA_TYPE_TEXT,
-			   HIP08_OEM_TYPE1_FIELD_REGS_DUMP, 0, buf);
-	step_vendor_data_tab(dec_tab, "hip08_oem_type1_event_tab");
-}
+static const struct ns_field hip08_pcie_local_regs[] = {
+	NS_FIELD_ARRAY("ERR_MISC_%u=0x%llx", PL, err_misc,
+		       BIT(HISI_PCIE_LOCAL_VALID_ERR_MISC)),
+	{ /* sentinel */ }
+};
+#undef PL
+
+static const struct ns_layout hip08_pcie_local_layout = {
+	.name = "hip08_pcie_local",
+	.title = "\nHISI HIP08: PCIe local error\n",
+	.hdr_open = "[ ",
+	.hdr_close = "]",
+	.valid_width = 8,
+	.hdr = hip08_pcie_local_hdr,
+	.regs = hip08_pcie_local_regs,
+#ifdef HAVE_SQLITE3
+	.tab = &hip08_pcie_local_event_tab,
+#endif
+	.ts_column = HIP08_PCIE_LOCAL_FIELD_TIMESTAMP,
+	.regs_column = HIP08_PCIE_LOCAL_FIELD_REGS_DUMP,
+};
 
 /* error data decoding functions */
 static int decode_hip08_oem_type1_error(struct ras_events *ras,
@@ -750,171 +774,8 @@ static int decode_hip08_oem_type1_error(struct ras_events *ras,
 					struct trace_seq *s,
 					struct ras_non_standard_event *event)
 {
-	const struct hisi_oem_type1_err_sec *err =
-			(struct hisi_oem_type1_err_sec*)event->error;
-
-	if (err->val_bits == 0) {
-		trace_seq_printf(s, "%s: no valid error information\n",
-				 __func__);
-		return -1;
-	}
-
-#ifdef HAVE_SQLITE3
-	if (!dec_tab->stmt_dec_record) {
-		if (ras_mc_add_vendor_table(ras, &dec_tab->stmt_dec_record,
-					    &hip08_oem_type1_event_tab)
-			!= SQLITE_OK) {
-			trace_seq_printf(s,
-					"create sql hip08_oem_type1_event_tab fail\n");
-			return -1;
-		}
-	}
-#endif
-	record_vendor_data(dec_tab, HISI_OEM_DATA_TYPE_TEXT,
-			   HIP08_OEM_TYPE1_FIELD_TIMESTAMP,
-			   0, event->timestamp);
-
-	trace_seq_printf(s, "\nHISI HIP08: OEM Type-1 Error\n");
-	decode_oem_type1_err_hdr(dec_tab, s, err);
-	decode_oem_type1_err_regs(dec_tab, s, err);
-
-	return 0;
-}
-
-static void decode_oem_type2_err_hdr(struct ras_ns_dec_tab *dec_tab,
-				     struct trace_seq *s,
-				     const struct hisi_oem_type2_err_sec *err)
-{
-	char buf[HISI_BUF_LEN];
-	char *p = buf;
-	char *end = buf + HISI_BUF_LEN;
-
-	p += snprintf(p, end - p, "[ table_version=%d ", err->version);
-	record_vendor_data(dec_tab, HISI_OEM_DATA_TYPE_INT,
-			   HIP08_OEM_TYPE2_FIELD_VERSION, err->version, NULL);
-
-	if (err->val_bits & HISI_OEM_VALID_SOC_ID && IN_RANGE(p, buf, end)) {
-		p += snprintf(p, end - p, "SOC_ID=%d ", err->soc_id);
-		record_vendor_data(dec_tab, HISI_OEM_DATA_TYPE_INT,
-				   HIP08_OEM_TYPE2_FIELD_SOC_ID,
-				   err->soc_id, NULL);
-	}
-
-	if (err->val_bits & HISI_OEM_VALID_SOCKET_ID && IN_RANGE(p, buf, end)) {
-		p += snprintf(p, end - p, "socket_ID=%d ", err->socket_id);
-		record_vendor_data(dec_tab, HISI_OEM_DATA_TYPE_INT,
-				   HIP08_OEM_TYPE2_FIELD_SOCKET_ID,
-				   err->socket_id, NULL);
-	}
-
-	if (err->val_bits & HISI_OEM_VALID_NIMBUS_ID && IN_RANGE(p, buf, end)) {
-		p += snprintf(p, end - p, "nimbus_ID=%d ", err->nimbus_id);
-		record_vendor_data(dec_tab, HISI_OEM_DATA_TYPE_INT,
-				   HIP08_OEM_TYPE2_FIELD_NIMBUS_ID,
-				   err->nimbus_id, NULL);
-	}
-
-	if (err->val_bits & HISI_OEM_VALID_MODULE_ID && IN_RANGE(p, buf, end)) {
-		const char *str = oem_module_name(hisi_oem_type2_module,
-						  err->module_id);
-
-		p += snprintf(p, end - p, "module=%s ", str);
-		record_vendor_data(dec_tab, HISI_OEM_DATA_TYPE_TEXT,
-				   HIP08_OEM_TYPE2_FIELD_MODULE_ID,
-				   0, str);
-	}
-
-	if (err->val_bits & HISI_OEM_VALID_SUB_MODULE_ID &&
-	    IN_RANGE(p, buf, end)) {
-		const char *str = oem_submodule_name(hisi_oem_type2_module,
-						     err->module_id,
-						     err->sub_module_id);
-
-		p += snprintf(p, end - p, "submodule=%s ", str);
-		record_vendor_data(dec_tab, HISI_OEM_DATA_TYPE_TEXT,
-				   HIP08_OEM_TYPE2_FIELD_SUB_MODULE_ID,
-				   0, str);
-	}
-
-	if (err->val_bits & HISI_OEM_VALID_ERR_SEVERITY &&
-	    IN_RANGE(p, buf, end)) {
-		p += snprintf(p, end - p, "error_severity=%s ",
-			     err_severity(err->err_severity));
-		record_vendor_data(dec_tab, HISI_OEM_DATA_TYPE_TEXT,
-				   HIP08_OEM_TYPE2_FIELD_ERR_SEV,
-				   0, err_severity(err->err_severity));
-	}
-
-	if (IN_RANGE(p, buf, end))
-		p += snprintf(p, end - p, "]");
-
-	trace_seq_printf(s, "%s\n", buf);
-}
-
-static void decode_oem_type2_err_regs(struct ras_ns_dec_tab *dec_tab,
-				      struct trace_seq *s,
-				      const struct hisi_oem_type2_err_sec *err)
-{
-	char buf[HISI_BUF_LEN];
-	char *p = buf;
-	char *end = buf + HISI_BUF_LEN;
-
-	trace_seq_printf(s, "Reg Dump:\n");
-	if (err->val_bits & HISI_OEM_TYPE2_VALID_ERR_FR) {
-		trace_seq_printf(s, "ERR_FR_0=0x%x\n", err->err_fr_0);
-		trace_seq_printf(s, "ERR_FR_1=0x%x\n", err->err_fr_1);
-		p += snprintf(p, end - p, "ERR_FR_0=0x%x ERR_FR_1=0x%x ",
-			     err->err_fr_0, err->err_fr_1);
-	}
-
-	if (err->val_bits & HISI_OEM_TYPE2_VALID_ERR_CTRL &&
-	    IN_RANGE(p, buf, end)) {
-		trace_seq_printf(s, "ERR_CTRL_0=0x%x\n", err->err_ctrl_0);
-		trace_seq_printf(s, "ERR_CTRL_1=0x%x\n", err->err_ctrl_1);
-		p += snprintf(p, end - p, "ERR_CTRL_0=0x%x ERR_CTRL_1=0x%x ",
-			      err->err_ctrl_0, err->err_ctrl_1);
-	}
-
-	if (err->val_bits & HISI_OEM_TYPE2_VALID_ERR_STATUS &&
-	    IN_RANGE(p, buf, end)) {
-		trace_seq_printf(s, "ERR_STATUS_0=0x%x\n", err->err_status_0);
-		trace_seq_printf(s, "ERR_STATUS_1=0x%x\n", err->err_status_1);
-		p += snprintf(p, end - p, "ERR_STATUS_0=0x%x ERR_STATUS_1=0x%x ",
-			      err->err_status_0, err->err_status_1);
-	}
-
-	if (err->val_bits & HISI_OEM_TYPE2_VALID_ERR_ADDR &&
-	    IN_RANGE(p, buf, end)) {
-		trace_seq_printf(s, "ERR_ADDR_0=0x%x\n", err->err_addr_0);
-		trace_seq_printf(s, "ERR_ADDR_1=0x%x\n", err->err_addr_1);
-		p += snprintf(p, end - p, "ERR_ADDR_0=0x%x ERR_ADDR_1=0x%x ",
-			      err->err_addr_0, err->err_addr_1);
-	}
-
-	if (err->val_bits & HISI_OEM_TYPE2_VALID_ERR_MISC_0 &&
-	    IN_RANGE(p, buf, end)) {
-		trace_seq_printf(s, "ERR_MISC0_0=0x%x\n", err->err_misc0_0);
-		trace_seq_printf(s, "ERR_MISC0_1=0x%x\n", err->err_misc0_1);
-		p += snprintf(p, end - p, "ERR_MISC0_0=0x%x ERR_MISC0_1=0x%x ",
-			      err->err_misc0_0, err->err_misc0_1);
-	}
-
-	if (err->val_bits & HISI_OEM_TYPE2_VALID_ERR_MISC_1 &&
-	    IN_RANGE(p, buf, end)) {
-		trace_seq_printf(s, "ERR_MISC1_0=0x%x\n", err->err_misc1_0);
-		trace_seq_printf(s, "ERR_MISC1_1=0x%x\n", err->err_misc1_1);
-		p += snprintf(p, end - p, "ERR_MISC1_0=0x%x ERR_MISC1_1=0x%x ",
-			      err->err_misc1_0, err->err_misc1_1);
-	}
-
-	if (p > buf && p < end) {
-		p--;
-		*p = '\0';
-	}
-
-	record_vendor_data(dec_tab, HISI_OEM_DATA_TYPE_TEXT,
-			   HIP08_OEM_TYPE2_FIELD_REGS_DUMP, 0, buf);
-	step_vendor_data_tab(dec_tab, "hip08_oem_type2_event_tab");
+	return ns_layout_decode(ras, dec_tab, &hip08_oem_type1_layout, s,
+				event);
 }
 
 static int decode_hip08_oem_type2_error(struct ras_events *ras,
@@ -922,149 +783,8 @@ static int decode_hip08_oem_type2_error(struct ras_events *ras,
 					struct trace_seq *s,
 					struct ras_non_standard_event *event)
 {
-	const struct hisi_oem_type2_err_sec *err =
-			(struct hisi_oem_type2_err_sec *)event->error;
-
-	if (err->val_bits == 0) {
-		trace_seq_printf(s, "%s: no valid error information\n",
-				 __func__);
-		return -1;
-	}
-
-#ifdef HAVE_SQLITE3
-	if (!dec_tab->stmt_dec_record) {
-		if (ras_mc_add_vendor_table(ras, &dec_tab->stmt_dec_record,
-			&hip08_oem_type2_event_tab) != SQLITE_OK) {
-			trace_seq_printf(s,
-				"create sql hip08_oem_type2_event_tab fail\n");
-			return -1;
-		}
-	}
-#endif
-	record_vendor_data(dec_tab, HISI_OEM_DATA_TYPE_TEXT,
-			   HIP08_OEM_TYPE2_FIELD_TIMESTAMP,
-			   0, event->timestamp);
-
-	trace_seq_printf(s, "\nHISI HIP08: OEM Type-2 Error\n");
-	decode_oem_type2_err_hdr(dec_tab, s, err);
-	decode_oem_type2_err_regs(dec_tab, s, err);
-
-	return 0;
-}
-
-static void decode_pcie_local_err_hdr(struct ras_ns_dec_tab *dec_tab,
-				      struct trace_seq *s,
-				      const struct hisi_pcie_local_err_sec *err)
-{
-	char buf[HISI_BUF_LEN];
-	char *p = buf;
-	char *end = buf + HISI_BUF_LEN;
-
-	p += snprintf(p, end - p, "[ table_version=%d ", err->version);
-	record_vendor_data(dec_tab, HISI_OEM_DATA_TYPE_INT,
-			   HIP08_PCIE_LOCAL_FIELD_VERSION,
-			   err->version, NULL);
-
-	if (err->val_bits & HISI_PCIE_LOCAL_VALID_SOC_ID &&
-	    IN_RANGE(p, buf, end)) {
-		p += snprintf(p, end - p, "SOC_ID=%d ", err->soc_id);
-		record_vendor_data(dec_tab, HISI_OEM_DATA_TYPE_INT,
-				   HIP08_PCIE_LOCAL_FIELD_SOC_ID,
-				   err->soc_id, NULL);
-	}
-
-	if (err->val_bits & HISI_PCIE_LOCAL_VALID_SOCKET_ID &&
-	    IN_RANGE(p, buf, end)) {
-		p += snprintf(p, end - p, "socket_ID=%d ", err->socket_id);
-		record_vendor_data(dec_tab, HISI_OEM_DATA_TYPE_INT,
-				   HIP08_PCIE_LOCAL_FIELD_SOCKET_ID,
-				   err->socket_id, NULL);
-	}
-
-	if (err->val_bits & HISI_PCIE_LOCAL_VALID_NIMBUS_ID &&
-	    IN_RANGE(p, buf, end)) {
-		p += snprintf(p, end - p, "nimbus_ID=%d ", err->nimbus_id);
-		record_vendor_data(dec_tab, HISI_OEM_DATA_TYPE_INT,
-				   HIP08_PCIE_LOCAL_FIELD_NIMBUS_ID,
-				   err->nimbus_id, NULL);
-	}
-
-	if (err->val_bits & HISI_PCIE_LOCAL_VALID_SUB_MODULE_ID &&
-	    IN_RANGE(p, buf, end)) {
-		p += snprintf(p, end - p, "submodule=%s ",
-			      pcie_local_sub_module_name(err->sub_module_id));
-		record_vendor_data(dec_tab, HISI_OEM_DATA_TYPE_TEXT,
-				   HIP08_PCIE_LOCAL_FIELD_SUB_MODULE_ID,
-				   0, pcie_local_sub_module_name(err->sub_module_id));
-	}
-
-	if (err->val_bits & HISI_PCIE_LOCAL_VALID_CORE_ID &&
-	    IN_RANGE(p, buf, end)) {
-		p += snprintf(p, end - p, "core_ID=core%d ", err->core_id);
-		record_vendor_data(dec_tab, HISI_OEM_DATA_TYPE_INT,
-				   HIP08_PCIE_LOCAL_FIELD_CORE_ID,
-				   err->core_id, NULL);
-	}
-
-	if (err->val_bits & HISI_PCIE_LOCAL_VALID_PORT_ID &&
-	    IN_RANGE(p, buf, end)) {
-		p += snprintf(p, end - p, "port_ID=port%d ", err->port_id);
-		record_vendor_data(dec_tab, HISI_OEM_DATA_TYPE_INT,
-				   HIP08_PCIE_LOCAL_FIELD_PORT_ID,
-				   err->port_id, NULL);
-	}
-
-	if (err->val_bits & HISI_PCIE_LOCAL_VALID_ERR_SEVERITY &&
-	    IN_RANGE(p, buf, end)) {
-		p += snprintf(p, end - p, "error_severity=%s ",
-			      err_severity(err->err_severity));
-		record_vendor_data(dec_tab, HISI_OEM_DATA_TYPE_TEXT,
-				   HIP08_PCIE_LOCAL_FIELD_ERR_SEV,
-				   0, err_severity(err->err_severity));
-	}
-
-	if (err->val_bits & HISI_PCIE_LOCAL_VALID_ERR_TYPE &&
-	    IN_RANGE(p, buf, end)) {
-		p += snprintf(p, end - p, "error_type=0x%x ", err->err_type);
-		record_vendor_data(dec_tab, HISI_OEM_DATA_TYPE_INT,
-				   HIP08_PCIE_LOCAL_FIELD_ERR_TYPE,
-				   err->err_type, NULL);
-	}
-
-	if (IN_RANGE(p, buf, end))
-		p += snprintf(p, end - p, "]");
-
-	trace_seq_printf(s, "%s\n", buf);
-}
-
-static void decode_pcie_local_err_regs(struct ras_ns_dec_tab *dec_tab,
-				       struct trace_seq *s,
-				       const struct hisi_pcie_local_err_sec *err)
-{
-	char buf[HISI_BUF_LEN];
-	char *p = buf;
-	char *end = buf + HISI_BUF_LEN;
-	uint32_t i;
-
-	trace_seq_printf(s, "Reg Dump:\n");
-	for (i = 0; i < HISI_PCIE_LOCAL_ERR_MISC_MAX; i++) {
-		if (err->val_bits & BIT(HISI_PCIE_LOCAL_VALID_ERR_MISC + i) &&
-		    IN_RANGE(p, buf, end)) {
-			trace_seq_printf(s, "ERR_MISC_%d=0x%x\n", i,
-					 err->err_misc[i]);
-			p += snprintf(p, end - p, "ERR_MISC_%d=0x%x ",
-				      i, err->err_misc[i]);
-		}
-	}
-
-	if (p > buf && p < end) {
-		p--;
-		*p = '\0';
-	}
-
-	record_vendor_data(dec_tab, HISI_OEM_DATA_TYPE_TEXT,
-			   HIP08_PCIE_LOCAL_FIELD_REGS_DUMP, 0, buf);
-	step_vendor_data_tab(dec_tab, "hip08_pcie_local_event_tab");
+	return ns_layout_decode(ras, dec_tab, &hip08_oem_type2_layout, s,
+				event);
 }
 
 static int decode_hip08_pcie_local_error(struct ras_events *ras,
@@ -1072,34 +792,8 @@ static int decode_hip08_pcie_local_error(struct ras_events *ras,
 					 struct trace_seq *s,
 					 struct ras_non_standard_event *event)
 {
-	const struct hisi_pcie_local_err_sec *err =
-			(struct hisi_pcie_local_err_sec *)event->error;
-
-	if (err->val_bits == 0) {
-		trace_seq_printf(s, "%s: no valid error information\n",
-				 __func__);
-		return -1;
-	}
-
-#ifdef HAVE_SQLITE3
-	if (!dec_tab->stmt_dec_record) {
-		if (ras_mc_add_vendor_table(ras, &dec_tab->stmt_dec_record,
-				&hip08_pcie_local_event_tab) != SQLITE_OK) {
-			trace_seq_printf(s,
-				"create sql hip08_pcie_local_event_tab fail\n");
-			return -1;
-		}
-	}
-#endif
-	record_vendor_data(dec_tab, HISI_OEM_DATA_TYPE_TEXT,
-			   HIP08_PCIE_LOCAL_FIELD_TIMESTAMP,
-			   0, event->timestamp);
-
-	trace_seq_printf(s, "\nHISI HIP08: PCIe local error\n");
-	decode_pcie_local_err_hdr(dec_tab, s, err);
-	decode_pcie_local_err_regs(dec_tab, s, err);
-
-	return 0;
+	return ns_layout_decode(ras, dec_tab, &hip08_pcie_local_layout, s,
+				event);
 }
 
 struct ras_ns_dec_tab hip08_ns_oem_tab[] = {
@@ -1118,7 +812,9 @@ struct ras_ns_dec_tab hip08_ns_oem_tab[] = {
 	{ /* sentinel */ }
 };
 
-static void __attribute__((constructor)) hip08_init(void)
+static int hip08_init(void)
 {
-	register_ns_dec_tab(hip08_ns_oem_tab);
+	return register_ns_dec_tab(hip08_ns_oem_tab);
 }
+
+RAS_PLUGIN_INIT("hisi_hip08", hip08_init);
@@ -21,10 +21,12 @@
 #include <unistd.h>
 #include "libtrace/kbuffer.h"
 #include "ras-aer-handler.h"
+#include "ras-aer-rate.h"
 #include "ras-record.h"
 #include "ras-logger.h"
 #include "bitfield.h"
 #include "ras-report.h"
+#include "ras-stream.h"
 
 /* bit field meaning for correctable error */
 static const char *aer_cor_errors[32] = {
@@ -54,6 +56,93 @@ static const char *aer_uncor_errors[32] = {
 
 #define BUF_LEN	1024
 
+/*
+ * TLP header decoding, as per PCIe Base Specification, "Transaction Layer
+ * Protocol". The kernel reports the header as 4 dwords, with DW0 holding
+ * Fmt[31:29] and Type[28:24].
+ */
+#define TLP_FMT(dw0)		(((dw0) >> 29) & 0x7)
+#define TLP_TYPE(dw0)		(((dw0) >> 24) & 0x1f)
+#define TLP_FMT_4DW		0x1	/* 64-bit address */
+#define TLP_FMT_DATA		0x2
+#define TLP_FMT_PREFIX		0x4
+#define TLP_TYPE_IS_MSG(type)	(((type) & 0x18) == 0x10)
+
+static const char *tlp_types[32][2] = {
+	/* without data, with data */
+	[0x00] = { "MRd",	"MWr" },
+	[0x01] = { "MRdLk",	NULL },
+	[0x02] = { "IORd",	"IOWr" },
+	[0x04] = { "CfgRd0",	"CfgWr0" },
+	[0x05] = { "CfgRd1",	"CfgWr1" },
+	[0x0a] = { "Cpl",	"CplD" },
+	[0x0b] = { "CplLk",	"CplDLk" },
+	[0x0c] = { NULL,	"FetchAdd" },
+	[0x0d] = { NULL,	"Swap" },
+	[0x0e] = { NULL,	"CAS" },
+};
+
+static void aer_decode_tlp(const uint32_t *dw, struct ras_aer_tlp *tlp)
+{
+	unsigned int fmt = TLP_FMT(dw[0]), type = TLP_TYPE(dw[0]);
+
+	memset(tlp, 0, sizeof(*tlp));
+	tlp->fmt_type = dw[0] >> 24;
+
+	if (fmt & TLP_FMT_PREFIX) {
+		tlp->type = "Prefix";
+		return;
+	}
+
+	if (TLP_TYPE_IS_MSG(type))
+		tlp->type = fmt & TLP_FMT_DATA ? "MsgD" : "Msg";
+	else
+		tlp->type = tlp_types[type][!!(fmt & TLP_FMT_DATA)];
+	if (!tlp->type) {
+		tlp->type = "Unknown";
+		return;
+	}
+
+	switch (type) {
+	case 0x0a:
+	case 0x0b:
+		/* Completions: DW1 is the completer, DW2 the requester */
+		tlp->completer_id = dw[1] >> 16;
+		tlp->has_completer = 1;
+		tlp->requester_id = dw[2] >> 16;
+		tlp->tag = (dw[2] >> 8) & 0xff;
+		return;
+	}
+
+	/* Requests */
+	tlp->requester_id = dw[1] >> 16;
+	tlp->tag = (dw[1] >> 8) & 0xff;
+
+	switch (type) {
+	case 0x04:
+	case 0x05:
+		/* the target function */
+		tlp->completer_id = dw[2] >> 16;
+		tlp->has_completer = 1;
+		break;
+	case 0x00:
+	case 0x01:
+	case 0x02:
+	case 0x0c:
+	case 0x0d:
+	case 0x0e:
+		if (fmt & TLP_FMT_4DW)
+			tlp->address = (unsigned long long)dw[2] << 32 |
+				       (dw[3] & ~0x3u);
+		else
+			tlp->address = dw[2] & ~0x3u;
+		tlp->has_address = 1;
+		break;
+	}
+}
+
+#define PCI_ID_ARGS(id)		(id) >> 8, ((id) >> 3) & 0x1f, (id) & 0x7
+
 int ras_aer_event_handler(struct trace_seq *s,
 			 struct pevent_record *record,
 			 struct event_format *event, void *context)
@@ -67,6 +156,7 @@ int ras_aer_event_handler(struct trace_seq *s,
 	struct tm *tm;
 	struct ras_aer_event ev;
 	char buf[BUF_LEN];
+	void *tlp;
 
 	/*
 	 * Newer kernels (3.10-rc1 or upper) provide an uptime clock.
@@ -96,6 +186,7 @@ int ras_aer_event_handler(struct trace_seq *s,
 
 	if (pevent_get_field_val(s,  event, "status", record, &status_val, 1) < 0)
 		return -1;
+	ev.status = status_val;
 
 	if (pevent_get_field_val(s, event, "severity", record, &severity_val, 1) < 0)
 		return -1;
@@ -115,8 +206,13 @@ int ras_aer_event_handler(struct trace_seq *s,
 
 	ev.tlp_header_valid = val;
 	if (ev.tlp_header_valid) {
-		ev.tlp_header = pevent_get_field_raw(s, event, "tlp_header",
-						     record, &len, 1);
+		tlp = pevent_get_field_raw(s, event, "tlp_header",
+					   record, &len, 1);
+		if (!tlp || len < sizeof(ev.tlp_header))
+			return -1;
+		memcpy(ev.tlp_header, tlp, sizeof(ev.tlp_header));
+		aer_decode_tlp(ev.tlp_header, &ev.tlp);
+
 		snprintf((buf + strlen(ev.msg)), BUF_LEN - strlen(ev.msg),
 			 " TLP Header: %08x %08x %08x %08x",
 			 ev.tlp_header[0], ev.tlp_header[1],
@@ -125,6 +221,18 @@ int ras_aer_event_handler(struct trace_seq *s,
 
 	trace_seq_printf(s, "%s ", ev.msg);
 
+	if (ev.tlp_header_valid && ras->text_output) {
+		trace_seq_printf(s, "(%s requester %02x:%02x.%x tag 0x%02x",
+				 ev.tlp.type, PCI_ID_ARGS(ev.tlp.requester_id),
+				 ev.tlp.tag);
+		if (ev.tlp.has_completer)
+			trace_seq_printf(s, " completer %02x:%02x.%x",
+					 PCI_ID_ARGS(ev.tlp.completer_id));
+		if (ev.tlp.has_address)
+			trace_seq_printf(s, " address 0x%llx", ev.tlp.address);
+		trace_seq_puts(s, ") ");
+	}
+
 	/* Use hw_event_aer_err_type switch between different severity_val */
 	switch (severity_val) {
 	case HW_EVENT_AER_UNCORRECTED_NON_FATAL:
@@ -141,6 +249,15 @@ int ras_aer_event_handler(struct trace_seq *s,
 	}
 	trace_seq_puts(s, ev.error_type);
 
+	/* Errors of a burst are only accounted for the burst summary */
+	if (aer_rate_check(ras->aer_rate, &ev, severity_val, status_val,
+			   severity_val == HW_EVENT_AER_CORRECTED ?
+			   aer_cor_errors : aer_uncor_errors,
+			   now) == AER_RATE_COALESCE) {
+		trace_seq_puts(s, " (coalesced)");
+		return 0;
+	}
+
 	/* Insert data into the SGBD */
 #ifdef HAVE_SQLITE3
 	ras_store_aer_event(ras, &ev);
@@ -151,5 +268,7 @@ int ras_aer_event_handler(struct trace_seq *s,
 	ras_report_aer_event(ras, &ev);
 #endif
 
+	ras_stream_aer_event(ras, &ev);
+
 	return 0;
 }
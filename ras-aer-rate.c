@@ -0,0 +1,533 @@
+/*
+ * Copyright (c) Huawei Technologies Co., Ltd. 2026. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+/*
+ * PCIe AER error rate tracking.
+ *
+ * A flapping link may report thousands of corrected errors per minute.
+ * Errors are counted per (device, severity, status bit) on a sliding
+ * window of AER_RATE_WINDOW seconds. When a count reaches its threshold
+ * (AER_CE_THRESHOLD or AER_UE_THRESHOLD), the AER_RATE_ACTION actions are
+ * taken:
+ *
+ *	log	log a warning about the error rate
+ *	summary	coalesce the following corrected errors, emitting a summary
+ *		(count, first and last seen) every window instead
+ *	hook	run AER_RATE_HOOK <device> <severity> <error> <count> <window>
+ *
+ * Once the rate goes below the threshold, events are handled as usual
+ * again. Uncorrected errors are accounted, but never coalesced.
+ */
+
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "ras-aer-rate.h"
+#include "ras-events.h"
+#include "ras-record.h"
+#include "ras-logger.h"
+#include "ras-env.h"
+
+#define AER_RATE_TABLE_SIZE	256	/* must be a power of 2 */
+#define AER_RATE_SLOTS		12	/* sliding window granularity */
+#define AER_DEV_NAME_LEN	32
+
+enum {
+	AER_ACTION_LOG		= 1 << 0,
+	AER_ACTION_SUMMARY	= 1 << 1,
+	AER_ACTION_HOOK		= 1 << 2,
+};
+
+static const struct {
+	const char	*name;
+	unsigned int	action;
+} aer_actions[] = {
+	{ "off",	0 },
+	{ "log",	AER_ACTION_LOG },
+	{ "summary",	AER_ACTION_SUMMARY },
+	{ "hook",	AER_ACTION_HOOK },
+};
+
+struct aer_rate_entry {
+	unsigned		used:1;
+	unsigned		over:1;		/* actions taken for this burst */
+	unsigned		corrected:1;
+	uint8_t			bit;
+	uint32_t		hash;
+	char			dev_name[AER_DEV_NAME_LEN];
+	const char		*name;
+
+	/* errors per slot, slot being the current one */
+	uint32_t		slots[AER_RATE_SLOTS];
+	long			slot;
+
+	/* pending summary */
+	unsigned long long	count;
+	double			due;
+	time_t			first_seen, last_seen;
+};
+
+/* What a hook is run with, copied so that it runs unlocked */
+struct aer_rate_hook {
+	char			dev_name[AER_DEV_NAME_LEN];
+	const char		*name;
+	unsigned		corrected:1;
+	unsigned long		count;
+};
+
+struct aer_rate {
+	pthread_mutex_t		lock;
+	unsigned long		ce_threshold, ue_threshold, window;
+	unsigned int		actions;
+	char			*hook;
+	double			slot_len;
+	unsigned int		used, pending;
+	double			next_due;
+	struct aer_rate_entry	tab[AER_RATE_TABLE_SIZE];
+};
+
+static double aer_rate_clock(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static unsigned int aer_rate_parse_actions(const char *env)
+{
+	char *list, *tok, *save;
+	unsigned int actions = 0, i;
+
+	list = strdup(env);
+	if (!list)
+		return AER_ACTION_LOG | AER_ACTION_SUMMARY;
+
+	for (tok = strtok_r(list, ", ", &save); tok;
+	     tok = strtok_r(NULL, ", ", &save)) {
+		for (i = 0; i < ARRAY_SIZE(aer_actions); i++) {
+			if (!strcasecmp(tok, aer_actions[i].name))
+				break;
+		}
+		if (i == ARRAY_SIZE(aer_actions)) {
+			log(TERM, LOG_INFO, "Ignoring unknown AER_RATE_ACTION %s\n",
+			    tok);
+			continue;
+		}
+		actions |= aer_actions[i].action;
+	}
+	free(list);
+
+	return actions;
+}
+
+struct aer_rate *aer_rate_init(void)
+{
+	struct aer_rate *rate;
+	unsigned long ce_threshold, ue_threshold, window;
+	unsigned int actions = AER_ACTION_LOG | AER_ACTION_SUMMARY;
+	char *env, *hook = NULL;
+
+	ce_threshold = ras_parse_env_ulong("AER_CE_THRESHOLD", 0, ULONG_MAX, 100);
+	ue_threshold = ras_parse_env_ulong("AER_UE_THRESHOLD", 0, ULONG_MAX, 10);
+	window = ras_parse_env_ulong("AER_RATE_WINDOW", 0, ULONG_MAX, 60);
+	env = getenv("AER_RATE_ACTION");
+	if (env)
+		actions = aer_rate_parse_actions(env);
+
+	if (actions & AER_ACTION_HOOK) {
+		env = getenv("AER_RATE_HOOK");
+		if (env && !access(env, X_OK)) {
+			hook = strdup(env);
+		} else {
+			log(TERM, LOG_INFO,
+			    "AER_RATE_HOOK is not executable, not running it\n");
+		}
+		if (!hook)
+			actions &= ~AER_ACTION_HOOK;
+	}
+
+	if (!actions || (!ce_threshold && !ue_threshold)) {
+		log(TERM, LOG_INFO, "PCIe AER rate tracking is disabled\n");
+		return NULL;
+	}
+	if (!window)
+		window = 1;
+
+	rate = calloc(1, sizeof(*rate));
+	if (!rate) {
+		log(TERM, LOG_ERR, "Can't allocate memory for AER rate data\n");
+		free(hook);
+		return NULL;
+	}
+	pthread_mutex_init(&rate->lock, NULL);
+	rate->ce_threshold = ce_threshold;
+	rate->ue_threshold = ue_threshold;
+	rate->window = window;
+	rate->slot_len = (double)window / AER_RATE_SLOTS;
+	rate->actions = actions;
+	rate->hook = hook;
+
+	log(TERM, LOG_INFO,
+	    "PCIe AER rate thresholds: %lu corrected, %lu uncorrected errors per %lus\n",
+	    ce_threshold, ue_threshold, window);
+
+	return rate;
+}
+
+void aer_rate_free(struct aer_rate *rate)
+{
+	if (!rate)
+		return;
+
+	pthread_mutex_destroy(&rate->lock);
+	free(rate->hook);
+	free(rate);
+}
+
+static uint32_t aer_rate_hash(const char *dev_name, int corrected, int bit)
+{
+	uint32_t h = 2166136261u;
+
+	/* FNV-1a */
+	while (*dev_name) {
+		h ^= (uint8_t)*dev_name++;
+		h *= 16777619u;
+	}
+	h ^= (corrected << 8) | bit;
+	h *= 16777619u;
+
+	return h;
+}
+
+/* Drops the slots that went out of the window since the last update */
+static unsigned long aer_rate_advance(struct aer_rate *rate,
+				      struct aer_rate_entry *ent, double now)
+{
+	long slot = now / rate->slot_len, n;
+	unsigned long sum = 0;
+	int i;
+
+	n = slot - ent->slot;
+	if (n >= AER_RATE_SLOTS)
+		memset(ent->slots, 0, sizeof(ent->slots));
+	else
+		while (n-- > 0)
+			ent->slots[(slot - n) % AER_RATE_SLOTS] = 0;
+	ent->slot = slot;
+
+	for (i = 0; i < AER_RATE_SLOTS; i++)
+		sum += ent->slots[i];
+
+	return sum;
+}
+
+static int aer_rate_idle(struct aer_rate *rate, struct aer_rate_entry *ent,
+			 double now)
+{
+	return !ent->count && !aer_rate_advance(rate, ent, now);
+}
+
+/* Linear probing removal, without tombstones */
+static void aer_rate_remove(struct aer_rate *rate, unsigned int i)
+{
+	unsigned int j = i, home;
+
+	rate->used--;
+	for (;;) {
+		rate->tab[i].used = 0;
+		for (;;) {
+			j = (j + 1) & (AER_RATE_TABLE_SIZE - 1);
+			if (!rate->tab[j].used)
+				return;
+			home = rate->tab[j].hash & (AER_RATE_TABLE_SIZE - 1);
+			/* Can the entry at j be moved back to i? */
+			if (i <= j ? (home <= i || home > j) :
+				     (home <= i && home > j))
+				break;
+		}
+		rate->tab[i] = rate->tab[j];
+		i = j;
+	}
+}
+
+static void aer_rate_gc(struct aer_rate *rate, double now)
+{
+	unsigned int i;
+
+	for (i = 0; i < AER_RATE_TABLE_SIZE; i++) {
+		if (rate->tab[i].used && aer_rate_idle(rate, &rate->tab[i], now)) {
+			aer_rate_remove(rate, i);
+			/* An entry may have been moved back into this slot */
+			i--;
+		}
+	}
+}
+
+static struct aer_rate_entry *aer_rate_lookup(struct aer_rate *rate,
+					      const char *dev_name,
+					      int corrected, int bit,
+					      double now)
+{
+	uint32_t hash = aer_rate_hash(dev_name, corrected, bit);
+	struct aer_rate_entry *ent;
+	unsigned int i, n;
+
+	i = hash & (AER_RATE_TABLE_SIZE - 1);
+	for (n = 0; n < AER_RATE_TABLE_SIZE; n++) {
+		ent = &rate->tab[i];
+		if (!ent->used) {
+			memset(ent, 0, sizeof(*ent));
+			ent->used = 1;
+			ent->corrected = corrected;
+			ent->bit = bit;
+			ent->hash = hash;
+			snprintf(ent->dev_name, sizeof(ent->dev_name), "%s",
+				 dev_name);
+			ent->slot = now / rate->slot_len;
+			rate->used++;
+			return ent;
+		}
+		if (ent->hash == hash && ent->corrected == corrected &&
+		    ent->bit == bit && !strcmp(ent->dev_name, dev_name))
+			return ent;
+		i = (i + 1) & (AER_RATE_TABLE_SIZE - 1);
+	}
+
+	/* Table full of tracked errors: don't rate limit new ones */
+	return NULL;
+}
+
+static void aer_rate_run_hook(struct aer_rate *rate, struct aer_rate_hook *h)
+{
+	char count_str[32], window_str[32];
+	char *argv[] = {
+		rate->hook, h->dev_name,
+		h->corrected ? "corrected" : "uncorrected",
+		(char *)h->name, count_str, window_str, NULL
+	};
+	sigset_t mask;
+	pid_t pid;
+
+	snprintf(count_str, sizeof(count_str), "%lu", h->count);
+	snprintf(window_str, sizeof(window_str), "%lu", rate->window);
+
+	pid = fork();
+	if (pid < 0) {
+		log(ALL, LOG_ERR, "Can't fork to run %s: %s\n", rate->hook,
+		    strerror(errno));
+		return;
+	}
+	if (!pid) {
+		/* The hook runs on a grandchild, so that nobody has to reap it */
+		if (!fork()) {
+			sigemptyset(&mask);
+			sigprocmask(SIG_SETMASK, &mask, NULL);
+			execv(rate->hook, argv);
+		}
+		_exit(0);
+	}
+	waitpid(pid, NULL, 0);
+}
+
+/* Returns 1 if the hook at @h has to be run, once rate->lock is released */
+static int aer_rate_over(struct aer_rate *rate, struct aer_rate_entry *ent,
+			 unsigned long count, struct aer_rate_hook *h)
+{
+	ent->over = 1;
+
+	if (rate->actions & AER_ACTION_LOG)
+		log(ALL, ent->corrected ? LOG_WARNING : LOG_CRIT,
+		    "PCIe AER: %s: %lu %s %s errors in the last %lus\n",
+		    ent->dev_name, count,
+		    ent->corrected ? "corrected" : "uncorrected",
+		    ent->name, rate->window);
+
+	if (!(rate->actions & AER_ACTION_HOOK))
+		return 0;
+
+	memcpy(h->dev_name, ent->dev_name, sizeof(h->dev_name));
+	h->name = ent->name;
+	h->corrected = ent->corrected;
+	h->count = count;
+
+	return 1;
+}
+
+enum aer_rate_verdict aer_rate_check(struct aer_rate *rate,
+				     struct ras_aer_event *ev, int severity,
+				     uint32_t status, const char **names,
+				     time_t when)
+{
+	struct aer_rate_entry *ents[32];
+	struct aer_rate_hook hooks[32];
+	unsigned long threshold, count;
+	int corrected = severity == HW_EVENT_AER_CORRECTED;
+	int coalesce, bit, n = 0, nhooks = 0, i;
+	double now;
+
+	if (!rate || !status)
+		return AER_RATE_PASS;
+
+	threshold = corrected ? rate->ce_threshold : rate->ue_threshold;
+	if (!threshold)
+		return AER_RATE_PASS;
+
+	coalesce = corrected && (rate->actions & AER_ACTION_SUMMARY);
+	now = aer_rate_clock();
+
+	pthread_mutex_lock(&rate->lock);
+
+	/* Forgets about idle errors before the table gets full */
+	if (rate->used > AER_RATE_TABLE_SIZE * 3 / 4)
+		aer_rate_gc(rate, now);
+
+	for (bit = 0; bit < 32; bit++) {
+		struct aer_rate_entry *ent;
+
+		if (!(status & (1u << bit)))
+			continue;
+
+		ent = aer_rate_lookup(rate, ev->dev_name, corrected, bit, now);
+		if (!ent) {
+			coalesce = 0;
+			continue;
+		}
+		if (!ent->name)
+			ent->name = names[bit] ? names[bit] : "Unknown";
+
+		count = aer_rate_advance(rate, ent, now) + 1;
+		ent->slots[ent->slot % AER_RATE_SLOTS]++;
+
+		if (count < threshold) {
+			ent->over = 0;
+			coalesce = 0;
+		} else if (!ent->over) {
+			/* Reports the event crossing the threshold */
+			if (aer_rate_over(rate, ent, count, &hooks[nhooks]))
+				nhooks++;
+			coalesce = 0;
+		}
+		ents[n++] = ent;
+	}
+
+	/* Only coalesced if all its errors are above the threshold */
+	if (coalesce) {
+		for (i = 0; i < n; i++) {
+			struct aer_rate_entry *ent = ents[i];
+
+			if (!ent->count) {
+				ent->first_seen = when;
+				ent->due = now + rate->window;
+				if (!rate->pending++ || ent->due < rate->next_due)
+					rate->next_due = ent->due;
+			}
+			ent->count++;
+			ent->last_seen = when;
+		}
+	}
+
+	pthread_mutex_unlock(&rate->lock);
+
+	/* A slow fork or hook would otherwise stall the other AER handlers */
+	for (i = 0; i < nhooks; i++)
+		aer_rate_run_hook(rate, &hooks[i]);
+
+	return coalesce ? AER_RATE_COALESCE : AER_RATE_PASS;
+}
+
+static void aer_rate_emit(struct ras_events *ras, struct aer_rate_entry *ent)
+{
+	struct ras_aer_summary_event ev;
+	struct tm tm;
+
+	memset(&ev, 0, sizeof(ev));
+	ev.count = ent->count;
+	ev.dev_name = ent->dev_name;
+	ev.error_type = ent->corrected ? "Corrected" : "Uncorrected";
+	ev.msg = ent->name;
+	if (localtime_r(&ent->first_seen, &tm))
+		strftime(ev.first_seen, sizeof(ev.first_seen),
+			 "%Y-%m-%d %H:%M:%S %z", &tm);
+	if (localtime_r(&ent->last_seen, &tm))
+		strftime(ev.last_seen, sizeof(ev.last_seen),
+			 "%Y-%m-%d %H:%M:%S %z", &tm);
+
+	log(ALL, LOG_WARNING,
+	    "PCIe AER: %s: %llu %s errors coalesced from %s to %s\n",
+	    ev.dev_name, ev.count, ev.msg, ev.first_seen, ev.last_seen);
+
+#ifdef HAVE_SQLITE3
+	ras_store_aer_summary(ras, &ev);
+#endif
+}
+
+int aer_rate_flush(struct ras_events *ras, int force)
+{
+	struct aer_rate *rate = ras->aer_rate;
+	struct aer_rate_entry *ent;
+	double now, next = 0;
+	unsigned int i;
+	int timeout;
+
+	if (!rate)
+		return -1;
+
+	now = aer_rate_clock();
+
+	pthread_mutex_lock(&rate->lock);
+
+	if (!force && (!rate->pending || now < rate->next_due))
+		goto out;
+
+	for (i = 0; i < AER_RATE_TABLE_SIZE; i++) {
+		ent = &rate->tab[i];
+		if (!ent->used || !ent->count)
+			continue;
+
+		if (force || now >= ent->due) {
+			aer_rate_emit(ras, ent);
+			ent->count = 0;
+			rate->pending--;
+			continue;
+		}
+		if (!next || ent->due < next)
+			next = ent->due;
+	}
+	rate->next_due = next;
+
+out:
+	if (rate->pending) {
+		timeout = (rate->next_due - now) * 1000;
+		if (timeout < 0)
+			timeout = 0;
+	} else {
+		timeout = -1;
+	}
+	pthread_mutex_unlock(&rate->lock);
+
+	return timeout;
+}
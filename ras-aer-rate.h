@@ -0,0 +1,54 @@
+/*
+ * Copyright (c) Huawei Technologies Co., Ltd. 2026. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#ifndef __RAS_AER_RATE_H
+#define __RAS_AER_RATE_H
+
+#include <stdint.h>
+#include <time.h>
+
+struct ras_events;
+struct ras_aer_event;
+struct aer_rate;
+
+enum aer_rate_verdict {
+	AER_RATE_PASS,		/* handle the event as usual */
+	AER_RATE_COALESCE,	/* accounted on a rate summary */
+};
+
+struct aer_rate *aer_rate_init(void);
+void aer_rate_free(struct aer_rate *rate);
+
+/*
+ * Accounts the errors set on @status for the device of @ev. @names are
+ * the names of the status bits, for @severity. @when is the wall clock
+ * time of the event.
+ */
+enum aer_rate_verdict aer_rate_check(struct aer_rate *rate,
+				     struct ras_aer_event *ev, int severity,
+				     uint32_t status, const char **names,
+				     time_t when);
+
+/*
+ * Emits the summaries that are due (or all pending ones, if @force).
+ * Returns how many milliseconds until the next one is due, or -1 if
+ * nothing is pending, so that it can be used as a poll() timeout.
+ */
+int aer_rate_flush(struct ras_events *ras, int force);
+
+#endif
@@ -20,6 +20,7 @@
 #include "ras-record.h"
 #include "ras-logger.h"
 #include "ras-report.h"
+#include "ras-stream.h"
 
 int ras_arm_event_handler(struct trace_seq *s,
 			 struct pevent_record *record,
@@ -88,5 +89,7 @@ int ras_arm_event_handler(struct trace_seq *s,
 	ras_report_arm_event(ras, &ev);
 #endif
 
+	ras_stream_arm_event(ras, &ev);
+
 	return 0;
 }
@@ -0,0 +1,1350 @@
+/*
+ * Copyright (c) Huawei Technologies Co., Ltd. 2026. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+/*
+ * ras-bench: feeds synthetic trace events through the rasdaemon handlers
+ * and storage, without the need of a kernel producing them.
+ *
+ * The events are built from the tracepoint formats under bench/formats,
+ * packed on ring buffer sub-buffers just like the kernel does, and read
+ * back with kbuffer, as read_ras_event() does with trace_pipe_raw. The
+ * handlers are the ones rasdaemon registers, storing on a scratch database.
+ */
+
+#include <argp.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/sysmacros.h>
+#include "libtrace/kbuffer.h"
+#include "libtrace/event-parse.h"
+#include "ras-mc-handler.h"
+#include "ras-aer-handler.h"
+#include "ras-aer-rate.h"
+#include "ras-non-standard-handler.h"
+#include "ras-arm-handler.h"
+#include "ras-mce-handler.h"
+#include "ras-extlog-handler.h"
+#include "ras-devlink-handler.h"
+#include "ras-diskerror-handler.h"
+#include "ras-disk-regions.h"
+#include "ras-blkdev.h"
+#include "ras-record.h"
+#include "ras-logger.h"
+#include "ras-page-isolation.h"
+#include "ras-mce-storm.h"
+#include "ras-stream.h"
+#include "ras-metrics.h"
+
+#define TOOL_DESCRIPTION "Benchmarks the rasdaemon handlers with synthetic events."
+
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+	#define ENDIAN KBUFFER_ENDIAN_LITTLE
+#else
+	#define ENDIAN KBUFFER_ENDIAN_BIG
+#endif
+
+#define BENCH_REC_MAX		512	/* the largest event we build */
+#define BENCH_DELTA		1000	/* ns between two events */
+#define RB_MAX_SMALL_DATA	(28 * 4)
+#define FEED_TICK		1000000	/* ns between two feed rounds */
+#define FEED_BATCH		256	/* events per round, at full speed */
+
+/* The addresses, devices... events are about are picked from small pools */
+#define BENCH_PAGES		4096
+#define BENCH_DEVS		32
+
+const char *argp_program_version = "ras-bench " VERSION;
+
+long user_hz;
+
+struct bench_rec {
+	struct event_format	*event;
+	unsigned char		data[BENCH_REC_MAX];
+	unsigned int		len;
+};
+
+struct bench_type {
+	char			*group, *event;
+	pevent_event_handler_func handler;
+	void			(*gen)(struct bench_rec *r, unsigned long long seq);
+	int			id;
+
+	struct ras_events	*ras;
+	struct event_format	*format;
+	unsigned int		weight;
+	unsigned long		count;
+	unsigned long		lat_size;
+	uint64_t		*lat;		/* of each event, in ns */
+	uint64_t		busy;
+};
+
+static uint64_t rnd_state = 0x2545f4914f6cdd1dULL;
+static unsigned int bench_cpus;
+
+static uint64_t rnd(void)
+{
+	/* xorshift64*, good enough to vary the events */
+	rnd_state ^= rnd_state >> 12;
+	rnd_state ^= rnd_state << 25;
+	rnd_state ^= rnd_state >> 27;
+
+	return rnd_state * 0x2545f4914f6cdd1dULL;
+}
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*
+ * Record building, driven by the format: fields missing on it are skipped,
+ * as kernels differ on which ones they have.
+ */
+static void rec_init(struct bench_rec *r, struct event_format *event)
+{
+	struct format_field *f;
+	unsigned short type = event->id;
+
+	memset(r->data, 0, sizeof(r->data));
+	r->event = event;
+	r->len = 0;
+	for (f = event->format.common_fields; f; f = f->next)
+		if (f->offset + f->size > r->len)
+			r->len = f->offset + f->size;
+	for (f = event->format.fields; f; f = f->next)
+		if (f->offset + f->size > r->len)
+			r->len = f->offset + f->size;
+
+	memcpy(r->data, &type, sizeof(type));
+}
+
+static void rec_num(struct bench_rec *r, const char *name,
+		    unsigned long long val)
+{
+	struct format_field *f = pevent_find_field(r->event, name);
+	uint8_t v8 = val;
+	uint16_t v16 = val;
+	uint32_t v32 = val;
+	uint64_t v64 = val;
+
+	if (!f)
+		return;
+
+	switch (f->size) {
+	case 1:
+		memcpy(r->data + f->offset, &v8, sizeof(v8));
+		break;
+	case 2:
+		memcpy(r->data + f->offset, &v16, sizeof(v16));
+		break;
+	case 4:
+		memcpy(r->data + f->offset, &v32, sizeof(v32));
+		break;
+	case 8:
+		memcpy(r->data + f->offset, &v64, sizeof(v64));
+		break;
+	}
+}
+
+static void rec_raw(struct bench_rec *r, const char *name,
+		    const void *p, unsigned int len)
+{
+	struct format_field *f = pevent_find_field(r->event, name);
+	uint32_t loc;
+
+	if (!f)
+		return;
+
+	if (!(f->flags & FIELD_IS_DYNAMIC)) {
+		memcpy(r->data + f->offset, p, len < f->size ? len : f->size);
+		return;
+	}
+
+	/* __data_loc: the data goes at the end, its offset and length here */
+	if (r->len + len > sizeof(r->data))
+		len = sizeof(r->data) - r->len;
+	loc = len << 16 | r->len;
+	memcpy(r->data + f->offset, &loc, sizeof(loc));
+	memcpy(r->data + r->len, p, len);
+	r->len += len;
+}
+
+static void rec_str(struct bench_rec *r, const char *name, const char *str)
+{
+	rec_raw(r, name, str, strlen(str) + 1);
+}
+
+/* Event generators, roughly what a machine with a failing part reports */
+
+static void gen_mc(struct bench_rec *r, unsigned long long seq)
+{
+	char label[64];
+	uint64_t v = rnd();
+
+	snprintf(label, sizeof(label), "CPU_SrcID#%u_MC#%u_Chan#%u_DIMM#%u",
+		 (unsigned)(v & 1), (unsigned)(v >> 1 & 1),
+		 (unsigned)(v >> 2 & 3), (unsigned)(v >> 4 & 1));
+
+	rec_num(r, "error_count", 1);
+	rec_num(r, "error_type", v % 20 ? HW_EVENT_ERR_CORRECTED :
+					   HW_EVENT_ERR_UNCORRECTED);
+	rec_str(r, "msg", "memory read error");
+	rec_str(r, "label", label);
+	rec_num(r, "mc_index", v >> 8 & 3);
+	rec_num(r, "top_layer", v >> 10 & 1);
+	rec_num(r, "middle_layer", v >> 11 & 3);
+	rec_num(r, "lower_layer", v >> 13 & 1);
+	rec_num(r, "address", (v >> 16) % BENCH_PAGES << 12 | (v & 0xfc0));
+	rec_num(r, "grain_bits", 6);
+	rec_num(r, "syndrome", v >> 32);
+	rec_str(r, "driver_detail", "err_code:0x0090:0x0001 ProcessorSocketId:0x0");
+}
+
+#ifdef HAVE_MCE
+static void gen_mce(struct bench_rec *r, unsigned long long seq)
+{
+	uint64_t v = rnd();
+
+	rec_num(r, "mcgcap", 0x1000c14);
+	rec_num(r, "mcgstatus", 0);
+	/* VAL, EN, MISCV, ADDRV, a corrected memory read error; or UCNA */
+	rec_num(r, "status", (v % 50 ? 0x9c00004000010090ULL :
+				       0xbc00000000010090ULL));
+	rec_num(r, "addr", (v >> 8) % BENCH_PAGES << 12 | (v & 0xfc0));
+	rec_num(r, "misc", 0x140000086ULL);
+	rec_num(r, "ip", 0);
+	rec_num(r, "tsc", seq * 2000);
+	rec_num(r, "walltime", time(NULL));
+	rec_num(r, "cpu", (v >> 32) % bench_cpus);
+	rec_num(r, "cpuid", 0x50657);
+	rec_num(r, "apicid", (v >> 32) % bench_cpus);
+	rec_num(r, "socketid", 0);
+	rec_num(r, "cs", 0);
+	rec_num(r, "bank", 7 + (v >> 40) % 6);
+	rec_num(r, "cpuvendor", 0);
+}
+#endif
+
+#ifdef HAVE_AER
+static void gen_aer(struct bench_rec *r, unsigned long long seq)
+{
+	char dev[32];
+	uint32_t tlp[4] = { 0x4a000001, 0x01000004, 0x00000000, 0x00000000 };
+	uint64_t v = rnd();
+
+	snprintf(dev, sizeof(dev), "0000:%02x:00.0",
+		 (unsigned)(v % BENCH_DEVS));
+	rec_str(r, "dev_name", dev);
+	if (v >> 8 & 15) {
+		rec_num(r, "severity", HW_EVENT_AER_CORRECTED);
+		rec_num(r, "status", v >> 12 & 1 ? 0x1 : 0x40);
+	} else {
+		rec_num(r, "severity", HW_EVENT_AER_UNCORRECTED_NON_FATAL);
+		rec_num(r, "status", 0x1000);
+		rec_num(r, "tlp_header_valid", 1);
+		rec_raw(r, "tlp_header", tlp, sizeof(tlp));
+	}
+}
+#endif
+
+#ifdef HAVE_NON_STANDARD
+static void gen_non_standard(struct bench_rec *r, unsigned long long seq)
+{
+	static const uint8_t sec_type[16] = {
+		0x3b, 0x9d, 0x6c, 0x1b, 0x8a, 0x54, 0x4d, 0x3e,
+		0x9f, 0x2a, 0x17, 0x0e, 0x60, 0xc2, 0x4b, 0x85,
+	};
+	static const uint8_t fru_id[16];
+	uint32_t buf[16];
+	uint64_t v = rnd();
+	unsigned int i;
+
+	for (i = 0; i < 16; i++)
+		buf[i] = v >> (i & 31);
+	buf[0] = 0x1f;		/* validation bits */
+
+	rec_raw(r, "sec_type", sec_type, sizeof(sec_type));
+	rec_raw(r, "fru_id", fru_id, sizeof(fru_id));
+	rec_str(r, "fru_text", "");
+	rec_num(r, "sev", v % 10 ? GHES_SEV_CORRECTED : GHES_SEV_RECOVERABLE);
+	rec_num(r, "len", sizeof(buf));
+	rec_raw(r, "buf", buf, sizeof(buf));
+}
+#endif
+
+#ifdef HAVE_ARM
+static void gen_arm(struct bench_rec *r, unsigned long long seq)
+{
+	uint64_t v = rnd();
+
+	rec_num(r, "affinity", 0);
+	rec_num(r, "mpidr", 0x81000000ULL | (v % bench_cpus));
+	rec_num(r, "midr", 0x481fd010);
+	rec_num(r, "running_state", 1);
+	rec_num(r, "psci_state", 0);
+}
+#endif
+
+#ifdef HAVE_EXTLOG
+static void gen_extlog(struct bench_rec *r, unsigned long long seq)
+{
+	/* struct cper_mem_err_compact, as the kernel packs it */
+	uint8_t data[54] = { 0 };
+	uint64_t valid = 0x3ff;
+	uint16_t card = 1, module = 2, bank = 3, row = 0x1234, column = 0x56;
+	static const uint8_t fru_id[16];
+	uint64_t v = rnd();
+
+	memcpy(data, &valid, sizeof(valid));
+	memcpy(data + 10, &card, sizeof(card));
+	memcpy(data + 12, &module, sizeof(module));
+	memcpy(data + 14, &bank, sizeof(bank));
+	memcpy(data + 18, &row, sizeof(row));
+	memcpy(data + 20, &column, sizeof(column));
+
+	rec_num(r, "err_seq", seq);
+	rec_num(r, "etype", 2);			/* single-bit ECC */
+	rec_num(r, "sev", v % 20 ? 2 : 0);	/* corrected, recoverable */
+	rec_num(r, "pa", v % BENCH_PAGES << 12);
+	rec_num(r, "pa_mask_lsb", 12);
+	rec_raw(r, "fru_id", fru_id, sizeof(fru_id));
+	rec_str(r, "fru_text", "Card01, ChnB, DIMM0");
+	rec_raw(r, "data", data, sizeof(data));
+}
+#endif
+
+#ifdef HAVE_DEVLINK
+static void gen_devlink(struct bench_rec *r, unsigned long long seq)
+{
+	char dev[32], msg[64];
+	uint64_t v = rnd();
+
+	snprintf(dev, sizeof(dev), "0000:%02x:00.0",
+		 (unsigned)(v % BENCH_DEVS));
+	snprintf(msg, sizeof(msg), "TX timeout on queue: %u, SQ: 0x%x",
+		 (unsigned)(v >> 8 & 63), (unsigned)(v >> 16 & 0xfff));
+	rec_str(r, "bus_name", "pci");
+	rec_str(r, "dev_name", dev);
+	rec_str(r, "driver_name", "mlx5_core");
+	rec_str(r, "reporter_name", "tx");
+	rec_str(r, "msg", msg);
+}
+#endif
+
+#ifdef HAVE_DISKERROR
+static void gen_diskerror(struct bench_rec *r, unsigned long long seq)
+{
+	uint64_t v = rnd();
+
+	rec_num(r, "dev", makedev(8, (v & 3) * 16));
+	rec_num(r, "sector", (v >> 8) % (BENCH_PAGES * 8) * 8);
+	rec_num(r, "nr_sector", 8);
+	rec_num(r, "error", v >> 4 & 3 ? -EIO : -ENODATA);
+	rec_raw(r, "rwbs", v >> 6 & 1 ? "W" : "R", 2);
+	rec_str(r, "cmd", "");
+}
+#endif
+
+static struct bench_type types[] = {
+	{ "ras", "mc_event", ras_mc_event_handler, gen_mc, MC_EVENT },
+#ifdef HAVE_MCE
+	{ "mce", "mce_record", ras_mce_event_handler, gen_mce, MCE_EVENT },
+#endif
+#ifdef HAVE_AER
+	{ "ras", "aer_event", ras_aer_event_handler, gen_aer, AER_EVENT },
+#endif
+#ifdef HAVE_NON_STANDARD
+	{ "ras", "non_standard_event", ras_non_standard_event_handler,
+	  gen_non_standard, NON_STANDARD_EVENT },
+#endif
+#ifdef HAVE_ARM
+	{ "ras", "arm_event", ras_arm_event_handler, gen_arm, ARM_EVENT },
+#endif
+#ifdef HAVE_EXTLOG
+	{ "ras", "extlog_mem_event", ras_extlog_mem_event_handler, gen_extlog,
+	  EXTLOG_EVENT },
+#endif
+#ifdef HAVE_DEVLINK
+	{ "devlink", "devlink_health_report", ras_devlink_event_handler,
+	  gen_devlink, DEVLINK_EVENT },
+#endif
+#ifdef HAVE_DISKERROR
+	{ "block", "block_rq_complete", ras_diskerror_event_handler,
+	  gen_diskerror, DISKERROR_EVENT },
+#endif
+};
+
+#define NR_TYPES (sizeof(types) / sizeof(types[0]))
+
+struct arguments {
+	unsigned long	events;
+	unsigned long	rate;
+	const char	*mix;
+	const char	*formats;
+	const char	*db;
+	const char	*tracefs;
+	unsigned int	cpus;
+	int		legacy;
+};
+
+static char *read_file(const char *dir, const char *name, int *size)
+{
+	char fname[PATH_MAX], *buf;
+	struct stat st;
+	int fd;
+
+	snprintf(fname, sizeof(fname), "%s/%s", dir, name);
+	fd = open(fname, O_RDONLY);
+	if (fd < 0 || fstat(fd, &st) < 0) {
+		fprintf(stderr, "Can't open %s: %s\n", fname, strerror(errno));
+		if (fd >= 0)
+			close(fd);
+		return NULL;
+	}
+
+	buf = malloc(st.st_size + 1);
+	if (buf)
+		*size = read(fd, buf, st.st_size);
+	close(fd);
+	if (buf && *size < 0) {
+		free(buf);
+		return NULL;
+	}
+
+	return buf;
+}
+
+/* As the trampoline from add_event_handler(), minus the probes */
+static int bench_handler(struct trace_seq *s, struct pevent_record *record,
+			 struct event_format *event, void *context)
+{
+	struct bench_type *t = context;
+	uint64_t start = ras_metrics_now();
+	int rc;
+
+	rc = t->handler(s, record, event, t->ras);
+	ras_metrics_event(t->id, record->cpu, rc, start);
+
+	return rc;
+}
+
+/* Parses the format of @t, registering its handler if @handle */
+static int bench_register(struct ras_events *ras, const char *dir,
+			  struct bench_type *t, int handle)
+{
+	char name[PATH_MAX], *buf;
+	int size, rc;
+
+	snprintf(name, sizeof(name), "%s/%s/format", t->group, t->event);
+	buf = read_file(dir, name, &size);
+	if (!buf)
+		return -1;
+
+	t->ras = ras;
+	rc = 0;
+	if (handle)
+		rc = pevent_register_event_handler(ras->pevent, -1, t->group,
+						   t->event, bench_handler, t);
+	if (rc != PEVENT_ERRNO__MEM_ALLOC_FAILED)
+		rc = pevent_parse_event(ras->pevent, buf, size, t->group);
+	free(buf);
+	if (rc) {
+		fprintf(stderr, "Can't parse %s:%s\n", t->group, t->event);
+		return -1;
+	}
+
+	t->format = pevent_find_event_by_name(ras->pevent, t->group, t->event);
+	if (handle)
+		ras_lane_init(ras, t->id, t->format);
+
+	return t->format ? 0 : -1;
+}
+
+/* Parses "type[:weight],...", all the types being run if there's none */
+static int parse_mix(const char *mix)
+{
+	char *str, *tok, *save, *w;
+	unsigned int i, total = 0;
+
+	if (!mix) {
+		for (i = 0; i < NR_TYPES; i++)
+			types[i].weight = 1;
+		return 0;
+	}
+
+	str = strdup(mix);
+	if (!str)
+		return -1;
+
+	for (tok = strtok_r(str, ",", &save); tok;
+	     tok = strtok_r(NULL, ",", &save)) {
+		w = strchr(tok, ':');
+		if (w)
+			*w++ = '\0';
+		for (i = 0; i < NR_TYPES; i++)
+			if (!strcmp(tok, ras_event_names[types[i].id]))
+				break;
+		if (i == NR_TYPES) {
+			fprintf(stderr, "Unknown or disabled event type %s\n",
+				tok);
+			free(str);
+			return -1;
+		}
+		types[i].weight = w ? strtoul(w, NULL, 0) : 1;
+		total += types[i].weight;
+	}
+	free(str);
+
+	if (!total) {
+		fprintf(stderr, "No events on the mix\n");
+		return -1;
+	}
+
+	return 0;
+}
+
+static struct bench_type *pick_type(unsigned int total)
+{
+	unsigned int i, w = rnd() % total;
+
+	for (i = 0; i < NR_TYPES; i++) {
+		if (w < types[i].weight)
+			break;
+		w -= types[i].weight;
+	}
+
+	return &types[i];
+}
+
+/* Appends a record to a sub-buffer, if it fits, @delta after the previous */
+static int page_add(unsigned char *page, unsigned int *used,
+		    unsigned int data_size, const struct bench_rec *r,
+		    unsigned int delta)
+{
+	unsigned int len = (r->len + 3) & ~3, hdr, n;
+	unsigned char *p = page + 16 + *used;
+
+	n = len <= RB_MAX_SMALL_DATA ? 4 + len : 8 + len;
+	if (*used + n > data_size)
+		return -1;
+
+	if (len <= RB_MAX_SMALL_DATA) {
+		hdr = (*used ? delta : 0) << 5 | len / 4;
+		memcpy(p, &hdr, sizeof(hdr));
+		p += 4;
+	} else {
+		hdr = (*used ? delta : 0) << 5;
+		memcpy(p, &hdr, sizeof(hdr));
+		hdr = len + 4;
+		memcpy(p + 4, &hdr, sizeof(hdr));
+		p += 8;
+	}
+	memset(p, 0, len);
+	memcpy(p, r->data, r->len);
+	*used += n;
+
+	return 0;
+}
+
+static void page_start(unsigned char *page, unsigned long long ts)
+{
+	memcpy(page, &ts, sizeof(ts));
+	memset(page + 8, 0, 8);
+}
+
+/* @lost events were dropped before this sub-buffer, stored after its data */
+static void page_commit(unsigned char *page, unsigned int used,
+			unsigned long long lost)
+{
+	unsigned long long commit = used;
+
+	if (lost) {
+		commit |= 1ULL << 31 | 1ULL << 30;
+		memcpy(page + 16 + used, &lost, sizeof(lost));
+	}
+	memcpy(page + 8, &commit, sizeof(commit));
+}
+
+/* Mirrors ras_periodic() */
+static void bench_periodic(struct ras_events *ras, int force)
+{
+#ifdef HAVE_MCE
+	if (ras->mce_priv)
+		mce_storm_flush(ras, force);
+#endif
+#ifdef HAVE_AER
+	aer_rate_flush(ras, force);
+#endif
+#ifdef HAVE_DISKERROR
+	disk_regions_flush(ras, force);
+#endif
+	ras_db_flush(ras, force);
+}
+
+static void lat_add(struct bench_type *t, uint64_t lat)
+{
+	if (t->count == t->lat_size) {
+		t->lat_size = t->lat_size ? 2 * t->lat_size : 1024;
+		t->lat = realloc(t->lat, t->lat_size * sizeof(*t->lat));
+		if (!t->lat) {
+			fprintf(stderr, "Out of memory\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+	t->lat[t->count++] = lat;
+	t->busy += lat;
+}
+
+/* Urgent events: the time from their page being read to being handled */
+static struct bench_type urgent_lane;
+
+static void record_read(struct ras_events *ras, struct kbuffer *kbuf,
+			void *data, unsigned long long time_stamp)
+{
+	struct pevent_record record;
+	struct trace_seq s;
+	struct bench_type *t;
+	uint64_t start, lat;
+	int id;
+
+	record.ts = time_stamp;
+	record.size = kbuffer_event_size(kbuf);
+	record.data = data;
+	record.offset = kbuffer_curr_offset(kbuf);
+	record.cpu = 0;
+	record.missed_events = kbuffer_missed_events(kbuf);
+	record.record_size = kbuffer_curr_size(kbuf);
+
+	start = now_ns();
+	trace_seq_init(&s);
+	pevent_print_event(ras->pevent, &s, &record);
+	trace_seq_destroy(&s);
+	lat = now_ns() - start;
+
+	id = pevent_data_type(ras->pevent, &record);
+	for (t = types; t < types + NR_TYPES; t++) {
+		if (t->format && t->format->id == id) {
+			lat_add(t, lat);
+			break;
+		}
+	}
+}
+
+/* Reads a sub-buffer back by lanes, as parse_ras_page() does */
+static uint64_t page_read(struct ras_events *ras, struct kbuffer *kbuf,
+			  unsigned char *page)
+{
+	unsigned long long time_stamp;
+	struct ras_lane_page lp = { .nr_urgent = 0 };
+	uint64_t start = now_ns();
+	int others = 0;
+	void *data;
+
+	kbuffer_load_subbuffer(kbuf, page);
+	while ((data = kbuffer_read_event(kbuf, &time_stamp))) {
+		if (ras_lane_first(ras, &lp, kbuf, data)) {
+			ras_lane_urgent = 1;
+			record_read(ras, kbuf, data, time_stamp);
+			ras_lane_urgent = 0;
+			ras_db_commit(ras);
+			lat_add(&urgent_lane, now_ns() - start);
+		} else {
+			others++;
+		}
+		kbuffer_next_event(kbuf, NULL);
+	}
+
+	if (others) {
+		kbuffer_load_subbuffer(kbuf, page);
+		while ((data = kbuffer_read_event(kbuf, &time_stamp))) {
+			if (!ras_lane_handled(ras, &lp, kbuf, data)) {
+				ras_db_batch(ras);
+				record_read(ras, kbuf, data, time_stamp);
+			}
+			kbuffer_next_event(kbuf, NULL);
+		}
+	}
+
+	bench_periodic(ras, 0);
+
+	return now_ns() - start;
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static double percentile_us(struct bench_type *t, unsigned int pct)
+{
+	if (!t->count)
+		return 0;
+
+	return t->lat[(t->count - 1) * pct / 100] / 1000.0;
+}
+
+#ifdef HAVE_SQLITE3
+static long long db_size(const char *db)
+{
+	static const char *suffix[] = { "", "-wal", "-journal" };
+	char name[PATH_MAX];
+	struct stat st;
+	long long size = 0;
+	unsigned int i;
+
+	for (i = 0; i < sizeof(suffix) / sizeof(suffix[0]); i++) {
+		snprintf(name, sizeof(name), "%s%s", db, suffix[i]);
+		if (!stat(name, &st))
+			size += st.st_size;
+	}
+
+	return size;
+}
+
+static void db_remove(const char *db)
+{
+	static const char *suffix[] = { "", "-wal", "-shm", "-journal" };
+	char name[PATH_MAX];
+	unsigned int i;
+
+	for (i = 0; i < sizeof(suffix) / sizeof(suffix[0]); i++) {
+		snprintf(name, sizeof(name), "%s%s", db, suffix[i]);
+		unlink(name);
+	}
+}
+#endif
+
+static void report(uint64_t busy, unsigned long events, long long db_bytes)
+{
+	struct rusage ru;
+	struct bench_type *t;
+
+	printf("\n%-24s %10s %12s %10s %10s\n",
+	       "event", "count", "events/s", "p50 us", "p99 us");
+	for (t = types; t < types + NR_TYPES; t++) {
+		if (!t->count)
+			continue;
+		qsort(t->lat, t->count, sizeof(*t->lat), cmp_u64);
+		printf("%-24s %10lu %12.0f %10.2f %10.2f\n", t->event, t->count,
+		       t->count * 1e9 / t->busy, percentile_us(t, 50),
+		       percentile_us(t, 99));
+	}
+	printf("%-24s %10lu %12.0f\n", "total", events,
+	       busy ? events * 1e9 / busy : 0);
+	if (urgent_lane.count) {
+		qsort(urgent_lane.lat, urgent_lane.count,
+		      sizeof(*urgent_lane.lat), cmp_u64);
+		printf("%-24s %10lu %12s %10.2f %10.2f\n", "urgent lane",
+		       urgent_lane.count, "", percentile_us(&urgent_lane, 50),
+		       percentile_us(&urgent_lane, 99));
+	}
+
+	if (!getrusage(RUSAGE_SELF, &ru))
+		printf("max RSS: %ld KiB\n", ru.ru_maxrss);
+	if (db_bytes >= 0)
+		printf("database: %lld bytes, %.1f bytes/event\n", db_bytes,
+		       events ? (double)db_bytes / events : 0);
+}
+
+/*
+ * Stand-in tracing instance, for rasdaemon --tracefs-root: the formats,
+ * the files rasdaemon writes to, and per_cpu/cpuN/trace_pipe_raw FIFOs,
+ * or regular files as a kernel without poll() on them.
+ */
+static int make_dir(const char *dir, const char *name)
+{
+	char fname[PATH_MAX];
+
+	snprintf(fname, sizeof(fname), "%s/%s", dir, name);
+	if (mkdir(fname, 0755) < 0 && errno != EEXIST) {
+		fprintf(stderr, "Can't create %s: %s\n", fname, strerror(errno));
+		return -1;
+	}
+
+	return 0;
+}
+
+static int write_file(const char *dir, const char *name, const char *buf,
+		      int size)
+{
+	char fname[PATH_MAX];
+	int fd, rc = -1;
+
+	snprintf(fname, sizeof(fname), "%s/%s", dir, name);
+	fd = open(fname, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd >= 0) {
+		rc = write(fd, buf, size) == size ? 0 : -1;
+		close(fd);
+	}
+	if (rc)
+		fprintf(stderr, "Can't write %s: %s\n", fname, strerror(errno));
+
+	return rc;
+}
+
+static int copy_file(const char *from, const char *dir, const char *name,
+		     const char *to)
+{
+	char *buf;
+	int size, rc;
+
+	buf = read_file(from, name, &size);
+	if (!buf)
+		return -1;
+	rc = write_file(dir, to, buf, size);
+	free(buf);
+
+	return rc;
+}
+
+/* As on a kernel with the uptime clock, which rasdaemon then selects */
+#define FEED_TRACE_CLOCK "[local] global counter uptime perf mono mono_raw boot\n"
+
+static int make_instance(const char *dir, const char *formats,
+			 unsigned int cpus, int legacy)
+{
+	char name[256], path[PATH_MAX];
+	struct bench_type *t;
+	unsigned int i;
+
+	if (make_dir(dir, "") || make_dir(dir, "events") ||
+	    make_dir(dir, "per_cpu"))
+		return -1;
+
+	if (copy_file(formats, dir, "header_page", "events/header_page") ||
+	    write_file(dir, "trace_clock", FEED_TRACE_CLOCK,
+		       strlen(FEED_TRACE_CLOCK)) ||
+	    write_file(dir, "set_event", "", 0))
+		return -1;
+
+	for (t = types; t < types + NR_TYPES; t++) {
+		snprintf(name, sizeof(name), "events/%s", t->group);
+		if (make_dir(dir, name))
+			return -1;
+		snprintf(name, sizeof(name), "events/%s/%s", t->group, t->event);
+		if (make_dir(dir, name))
+			return -1;
+
+		snprintf(name, sizeof(name), "%s/%s/format", t->group, t->event);
+		snprintf(path, sizeof(path), "events/%s", name);
+		if (copy_file(formats, dir, name, path))
+			return -1;
+		snprintf(name, sizeof(name), "events/%s/%s/filter", t->group,
+			 t->event);
+		if (write_file(dir, name, "none\n", 5))
+			return -1;
+	}
+
+	for (i = 0; ; i++) {
+		snprintf(name, sizeof(name), "per_cpu/cpu%u", i);
+		snprintf(path, sizeof(path), "%s/%s/trace_pipe_raw", dir, name);
+		unlink(path);
+
+		/* Drops the cpus of a previous, larger, instance */
+		if (i >= cpus) {
+			snprintf(path, sizeof(path), "%s/%s", dir, name);
+			if (rmdir(path) < 0)
+				break;
+			continue;
+		}
+
+		if (make_dir(dir, name))
+			return -1;
+
+		/* Always readable, but empty until fed, as a legacy kernel */
+		if (legacy) {
+			snprintf(name, sizeof(name),
+				 "per_cpu/cpu%u/trace_pipe_raw", i);
+			if (write_file(dir, name, "", 0))
+				return -1;
+			continue;
+		}
+		if (mkfifo(path, 0600) < 0) {
+			fprintf(stderr, "Can't create %s: %s\n", path,
+				strerror(errno));
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+struct feed_cpu {
+	int			fd;
+	unsigned char		*page;
+	unsigned int		used, events;
+	unsigned long long	lost;	/* since the last sub-buffer written */
+};
+
+static volatile sig_atomic_t feed_stop;
+
+static void feed_signal(int sig)
+{
+	feed_stop = 1;
+}
+
+/* The uptime clock, in the units rasdaemon expects it */
+static unsigned long long feed_ts(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_BOOTTIME, &ts);
+
+	return ts.tv_sec * user_hz + ts.tv_nsec / (1000000000L / user_hz);
+}
+
+/*
+ * rasdaemon first tries to poll() the trace_pipe_raw files of a legacy
+ * instance, and falls back to a thread per cpu once it closes them, as
+ * they never block. Waits for that, so that the events are all read by
+ * the threads.
+ */
+static int feed_wait_legacy(struct arguments *args, int ifd)
+{
+	struct inotify_event ev;
+	unsigned int closed = 0;
+
+	fprintf(stderr, "Waiting for rasdaemon --tracefs-root=%s\n",
+		args->tracefs);
+	while (closed < args->cpus && !feed_stop) {
+		if (read(ifd, &ev, sizeof(ev)) != sizeof(ev)) {
+			if (errno == EINTR)
+				continue;
+			fprintf(stderr, "Can't watch the instance: %s\n",
+				strerror(errno));
+			return -1;
+		}
+		closed++;
+	}
+	close(ifd);
+
+	return feed_stop ? -1 : 0;
+}
+
+/*
+ * Writes the sub-buffer of @c, if any. As the kernel does, the events
+ * rasdaemon has no room for are dropped, and reported as missed on the
+ * next sub-buffer it gets. Returns how many were dropped.
+ */
+static unsigned int feed_flush(struct feed_cpu *c, unsigned int page_size)
+{
+	unsigned int dropped = 0;
+
+	if (!c->events)
+		return 0;
+
+	page_commit(c->page, c->used, c->lost);
+	if (write(c->fd, c->page, page_size) == page_size) {
+		c->lost = 0;
+	} else {
+		if (errno == EPIPE)
+			feed_stop = 1;
+		c->lost += c->events;
+		dropped = c->events;
+	}
+	c->used = 0;
+	c->events = 0;
+
+	return dropped;
+}
+
+/*
+ * Feeds the events to the rasdaemon running on the stand-in instance at
+ * the given rate, spread over the cpus, all at once without a rate. Once
+ * done, the FIFOs are kept open, as rasdaemon would take their closing for
+ * a legacy kernel, until interrupted.
+ */
+static int bench_feed(struct ras_events *ras, struct arguments *args,
+		      unsigned int total)
+{
+	struct sigaction sa;
+	struct feed_cpu *cpus, *c;
+	struct bench_type *t;
+	struct bench_rec r;
+	struct timespec tick = { 0, FEED_TICK };
+	char fifo[PATH_MAX];
+	unsigned long sent = 0, due, dropped = 0;
+	unsigned int i, data_size;
+	uint64_t start, elapsed;
+	int ifd = -1;
+
+	/* Room for the count of missed events */
+	data_size = ras->pevent->header_page_data_size - 8;
+
+	if (make_instance(args->tracefs, args->formats, args->cpus,
+			  args->legacy))
+		return -1;
+
+	/* Set before rasdaemon is told to start, not to miss its closes */
+	if (args->legacy) {
+		ifd = inotify_init();
+		for (i = 0; ifd >= 0 && i < args->cpus; i++) {
+			snprintf(fifo, sizeof(fifo),
+				 "%s/per_cpu/cpu%u/trace_pipe_raw",
+				 args->tracefs, i);
+			if (inotify_add_watch(ifd, fifo, IN_CLOSE_NOWRITE) < 0) {
+				close(ifd);
+				ifd = -1;
+			}
+		}
+		if (ifd < 0) {
+			fprintf(stderr, "Can't watch the instance: %s\n",
+				strerror(errno));
+			return -1;
+		}
+	}
+
+	cpus = calloc(args->cpus, sizeof(*cpus));
+	if (!cpus)
+		return -1;
+
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = feed_signal;
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
+	signal(SIGPIPE, SIG_IGN);
+
+	if (args->legacy) {
+		if (feed_wait_legacy(args, ifd))
+			return -1;
+	} else {
+		fprintf(stderr, "Waiting for rasdaemon --tracefs-root=%s\n",
+			args->tracefs);
+	}
+	for (i = 0; i < args->cpus; i++) {
+		c = &cpus[i];
+		c->page = calloc(1, ras->page_size);
+		if (!c->page)
+			return -1;
+
+		/* Blocks until rasdaemon opens it, if a FIFO */
+		snprintf(fifo, sizeof(fifo), "%s/per_cpu/cpu%u/trace_pipe_raw",
+			 args->tracefs, i);
+		c->fd = open(fifo, args->legacy ? O_WRONLY | O_APPEND : O_WRONLY);
+		if (c->fd < 0) {
+			if (!feed_stop)
+				fprintf(stderr, "Can't open %s: %s\n", fifo,
+					strerror(errno));
+			return -1;
+		}
+		fcntl(c->fd, F_SETFL, O_NONBLOCK);
+	}
+
+	start = now_ns();
+	while (sent < args->events && !feed_stop) {
+		if (args->rate)
+			due = (now_ns() - start) * args->rate / 1000000000ULL;
+		else
+			due = sent + FEED_BATCH;
+		if (due > args->events)
+			due = args->events;
+
+		for (; sent < due; sent++) {
+			c = &cpus[rnd() % args->cpus];
+			t = pick_type(total);
+			rec_init(&r, t->format);
+			t->gen(&r, sent);
+
+			if (!c->used)
+				page_start(c->page, feed_ts());
+			if (page_add(c->page, &c->used, data_size, &r, 0)) {
+				dropped += feed_flush(c, ras->page_size);
+				page_start(c->page, feed_ts());
+				page_add(c->page, &c->used, data_size, &r, 0);
+			}
+			c->events++;
+		}
+
+		/* Paced events are read as soon as they come */
+		if (args->rate || sent == args->events)
+			for (i = 0; i < args->cpus; i++)
+				dropped += feed_flush(&cpus[i], ras->page_size);
+
+		if (args->rate)
+			nanosleep(&tick, NULL);
+	}
+	elapsed = now_ns() - start;
+
+	printf("fed %lu events to %u cpus in %.3f s, %.0f events/s, %lu dropped\n",
+	       sent, args->cpus, elapsed / 1e9,
+	       elapsed ? sent * 1e9 / elapsed : 0, dropped);
+	fflush(stdout);
+
+	while (!feed_stop)
+		pause();
+
+	for (i = 0; i < args->cpus; i++) {
+		close(cpus[i].fd);
+		free(cpus[i].page);
+	}
+	free(cpus);
+
+	return 0;
+}
+
+static error_t parse_opt(int k, char *arg, struct argp_state *state)
+{
+	struct arguments *args = state->input;
+
+	switch (k) {
+	case 'n':
+		args->events = strtoul(arg, NULL, 0);
+		break;
+	case 'r':
+		args->rate = strtoul(arg, NULL, 0);
+		break;
+	case 'm':
+		args->mix = arg;
+		break;
+	case 'F':
+		args->formats = arg;
+		break;
+	case 'D':
+		args->db = arg;
+		break;
+	case 's':
+		rnd_state = strtoull(arg, NULL, 0) | 1;
+		break;
+	case 'T':
+		args->tracefs = arg;
+		break;
+	case 'c':
+		args->cpus = strtoul(arg, NULL, 0);
+		break;
+	case 'L':
+		args->legacy = 1;
+		break;
+	default:
+		return ARGP_ERR_UNKNOWN;
+	}
+	return 0;
+}
+
+/* Runs the events through the handlers, on this process */
+static int bench_run(struct ras_events *ras, struct arguments *args)
+{
+	struct kbuffer *kbuf;
+	struct bench_type *t;
+	struct bench_rec r;
+	struct timespec next;
+	unsigned char *page;
+	unsigned long long ts;
+	unsigned long i;
+	unsigned int used, total = 0, data_size;
+	uint64_t busy = 0, tick;
+	long long db_bytes = -1;
+#ifdef HAVE_SQLITE3
+	long long db_base;
+#endif
+
+	kbuf = kbuffer_alloc(KBUFFER_LSIZE_8, ENDIAN);
+	page = calloc(1, ras->page_size);
+	if (!kbuf || !page)
+		return -1;
+	data_size = ras->pevent->header_page_data_size;
+
+	ras_metrics_init(bench_cpus);
+	ras_stream_init(ras);
+#ifdef HAVE_MEMORY_CE_PFA
+	ras_page_account_init();
+#endif
+#ifdef HAVE_AER
+	ras->aer_rate = aer_rate_init();
+#endif
+#ifdef HAVE_MCE
+	if (register_mce_handler(ras, bench_cpus))
+		fprintf(stderr, "Can't register the mce handler, skipping mce_record\n");
+#endif
+#ifdef HAVE_DISKERROR
+	ras->disk_regions = disk_regions_init();
+	ras->blkdev = blkdev_cache_init();
+#endif
+
+	for (t = types; t < types + NR_TYPES; t++) {
+		if (!t->weight)
+			continue;
+#ifdef HAVE_MCE
+		if (t->id == MCE_EVENT && !ras->mce_priv) {
+			t->weight = 0;
+			continue;
+		}
+#endif
+		if (bench_register(ras, args->formats, t, 1))
+			return -1;
+		total += t->weight;
+	}
+	if (!total)
+		return -1;
+
+#ifdef HAVE_SQLITE3
+	db_remove(args->db);
+	ras->record_events = 1;
+	if (ras_mc_event_opendb(0, ras))
+		return -1;
+	db_base = db_size(args->db);
+#endif
+
+	clock_gettime(CLOCK_MONOTONIC, &next);
+	ts = next.tv_sec * 1000000000ULL + next.tv_nsec;
+	for (i = 0; i < args->events; ) {
+		page_start(page, ts);
+		used = 0;
+		do {
+			t = pick_type(total);
+			rec_init(&r, t->format);
+			t->gen(&r, i);
+			if (page_add(page, &used, data_size, &r, BENCH_DELTA))
+				break;
+			ts += BENCH_DELTA;
+			i++;
+		} while (!args->rate && i < args->events);
+		page_commit(page, used, 0);
+
+		/* At a given rate, events come alone: the reader keeps up */
+		if (args->rate) {
+			tick = 1000000000ULL / args->rate;
+			next.tv_nsec += tick % 1000000000ULL;
+			next.tv_sec += tick / 1000000000ULL +
+				       next.tv_nsec / 1000000000L;
+			next.tv_nsec %= 1000000000L;
+			clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next,
+					NULL);
+		}
+
+		busy += page_read(ras, kbuf, page);
+	}
+
+	tick = now_ns();
+	bench_periodic(ras, 1);
+	busy += now_ns() - tick;
+
+#ifdef HAVE_SQLITE3
+	ras_mc_event_closedb(0, ras);
+	db_bytes = db_size(args->db) - db_base;
+#endif
+
+	report(busy, args->events, db_bytes);
+
+#ifdef HAVE_MCE
+	unregister_mce_handler(ras);
+#endif
+	ras_stream_exit(ras);
+	ras_metrics_exit();
+	kbuffer_free(kbuf);
+	free(page);
+
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	struct arguments args = {
+		.events = 100000,
+		.formats = "bench/formats",
+		.db = "ras-bench.db",
+	};
+	const struct argp_option options[] = {
+		{"events",  'n', "N", 0, "number of events to run (100000)", 0},
+		{"rate",    'r', "RATE", 0, "events per second, 0 for as fast as possible", 0},
+		{"mix",     'm', "TYPE[:WEIGHT],...", 0, "event types to run, all by default", 0},
+		{"formats", 'F', "DIR", 0, "directory with the tracepoint formats", 0},
+		{"db",      'D', "FILE", 0, "scratch database, overwritten", 0},
+		{"seed",    's', "SEED", 0, "seed of the event generators", 0},
+		{"tracefs", 'T', "DIR", 0, "make a tracing instance at DIR, and feed the events to a rasdaemon --tracefs-root=DIR", 1},
+		{"cpus",    'c', "N", 0, "cpus of the tracing instance, as many as this host's by default", 1},
+		{"legacy",  'L', 0, 0, "make the instance of a kernel without poll() on trace_pipe_raw", 1},
+		{ 0, 0, 0, 0, 0, 0 }
+	};
+	const struct argp argp = {
+		.options = options,
+		.parser = parse_opt,
+		.doc = TOOL_DESCRIPTION,
+	};
+	struct ras_events *ras;
+	struct bench_type *t;
+	unsigned int total = 0;
+	char *buf;
+	int size;
+
+	argp_parse(&argp, argc, argv, 0, NULL, &args);
+
+	/* Never act on the host, nor tell ABRT about made up errors */
+	setenv("PAGE_CE_ACTION", "account", 1);
+	setenv("ABRT_QUEUE_SIZE", "0", 1);
+	setenv("RAS_DB_FILE", args.db, 1);
+	setenv("RAS_LOG_LEVEL", "warning", 0);
+
+	user_hz = sysconf(_SC_CLK_TCK);
+	bench_cpus = sysconf(_SC_NPROCESSORS_CONF);
+	if (!args.cpus)
+		args.cpus = bench_cpus;
+	ras_log_set_level();
+	ras_log_init();
+
+	if (parse_mix(args.mix))
+		return EXIT_FAILURE;
+
+	ras = calloc(1, sizeof(*ras));
+	if (!ras)
+		return EXIT_FAILURE;
+	ras->pevent = pevent_alloc();
+	if (!ras->pevent)
+		return EXIT_FAILURE;
+
+	buf = read_file(args.formats, "header_page", &size);
+	if (!buf || pevent_parse_header_page(ras->pevent, buf, size,
+					     sizeof(long))) {
+		fprintf(stderr, "Can't parse the header page\n");
+		return EXIT_FAILURE;
+	}
+	free(buf);
+	ras->page_size = ras->pevent->header_page_data_offset +
+			 ras->pevent->header_page_data_size;
+
+	if (!args.tracefs)
+		return bench_run(ras, &args) ? EXIT_FAILURE : 0;
+
+	/* The events are handled by rasdaemon: only their formats are needed */
+	bench_cpus = args.cpus;
+	for (t = types; t < types + NR_TYPES; t++) {
+		if (!t->weight)
+			continue;
+		if (bench_register(ras, args.formats, t, 0))
+			return EXIT_FAILURE;
+		total += t->weight;
+	}
+
+	return bench_feed(ras, &args, total) ? EXIT_FAILURE : 0;
+}
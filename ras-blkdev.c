@@ -0,0 +1,309 @@
+/*
+ * Copyright (c) Huawei Technologies Co., Ltd. 2026. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+/*
+ * Block device name resolution.
+ *
+ * The block events only carry the device number. It is translated into
+ * the device name, WWID, model and serial number from sysfs, through
+ * /sys/dev/block/<major>:<minor>. Partitions get the identity of their
+ * disk.
+ *
+ * The results are cached on a fixed size hash table, so resolving a known
+ * device takes no allocation nor sysfs access. As device numbers get
+ * reused after a device is removed, block uevents invalidate the entries
+ * of the devices they are about. They are read from a non-blocking
+ * NETLINK_KOBJECT_UEVENT socket before each lookup. If the socket can't
+ * be opened, nothing is cached.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+#include <linux/netlink.h>
+
+#include "ras-blkdev.h"
+#include "ras-logger.h"
+
+#define BLKDEV_CACHE_SIZE	256	/* must be a power of 2 */
+#define BLKDEV_UEVENT_LEN	4096
+
+struct blkdev_entry {
+	unsigned		used:1;
+	unsigned		found:1;
+	dev_t			dev;
+	struct blkdev_info	info;
+};
+
+struct blkdev_cache {
+	pthread_mutex_t		lock;
+	int			uevent_fd;
+	unsigned int		used;
+	struct blkdev_entry	tab[BLKDEV_CACHE_SIZE];
+};
+
+static unsigned int blkdev_hash(dev_t dev)
+{
+	uint64_t h = (uint64_t)dev * 0x9e3779b97f4a7c15ULL;
+
+	return (h >> 32) & (BLKDEV_CACHE_SIZE - 1);
+}
+
+static int blkdev_uevent_open(void)
+{
+	struct sockaddr_nl addr;
+	int fd;
+
+	fd = socket(AF_NETLINK, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC,
+		    NETLINK_KOBJECT_UEVENT);
+	if (fd < 0)
+		return -1;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.nl_family = AF_NETLINK;
+	addr.nl_groups = 1;	/* kernel uevents */
+	if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+struct blkdev_cache *blkdev_cache_init(void)
+{
+	struct blkdev_cache *cache;
+
+	cache = calloc(1, sizeof(*cache));
+	if (!cache) {
+		log(TERM, LOG_ERR, "Can't allocate memory for the block device cache\n");
+		return NULL;
+	}
+	pthread_mutex_init(&cache->lock, NULL);
+
+	cache->uevent_fd = blkdev_uevent_open();
+	if (cache->uevent_fd < 0)
+		log(TERM, LOG_INFO,
+		    "Can't listen to uevents: %s, not caching block device names\n",
+		    strerror(errno));
+
+	return cache;
+}
+
+void blkdev_cache_free(struct blkdev_cache *cache)
+{
+	if (!cache)
+		return;
+
+	if (cache->uevent_fd >= 0)
+		close(cache->uevent_fd);
+	pthread_mutex_destroy(&cache->lock);
+	free(cache);
+}
+
+static struct blkdev_entry *blkdev_slot(struct blkdev_cache *cache, dev_t dev)
+{
+	unsigned int i = blkdev_hash(dev);
+
+	while (cache->tab[i].used && cache->tab[i].dev != dev)
+		i = (i + 1) & (BLKDEV_CACHE_SIZE - 1);
+
+	return &cache->tab[i];
+}
+
+/* Removes the entry of @dev, shifting back the ones that probed past it */
+static void blkdev_invalidate(struct blkdev_cache *cache, dev_t dev)
+{
+	unsigned int i, j, k;
+
+	i = blkdev_slot(cache, dev) - cache->tab;
+	if (!cache->tab[i].used)
+		return;
+
+	for (j = (i + 1) & (BLKDEV_CACHE_SIZE - 1); cache->tab[j].used;
+	     j = (j + 1) & (BLKDEV_CACHE_SIZE - 1)) {
+		k = blkdev_hash(cache->tab[j].dev);
+		/* Moves it back if its home slot is not in (i, j] */
+		if ((i < j) ? (k <= i || k > j) : (k <= i && k > j)) {
+			cache->tab[i] = cache->tab[j];
+			i = j;
+		}
+	}
+	cache->tab[i].used = 0;
+	cache->used--;
+}
+
+static void blkdev_uevent_parse(struct blkdev_cache *cache, const char *buf,
+				size_t len)
+{
+	const char *p, *end = buf + len;
+	int block = 0, major = -1, minor = -1;
+
+	for (p = buf; p < end; p += strlen(p) + 1) {
+		if (!strcmp(p, "SUBSYSTEM=block"))
+			block = 1;
+		else if (!strncmp(p, "MAJOR=", 6))
+			major = atoi(p + 6);
+		else if (!strncmp(p, "MINOR=", 6))
+			minor = atoi(p + 6);
+	}
+
+	if (block && major >= 0 && minor >= 0)
+		blkdev_invalidate(cache, makedev(major, minor));
+}
+
+static void blkdev_uevent_drain(struct blkdev_cache *cache)
+{
+	char buf[BLKDEV_UEVENT_LEN];
+	struct sockaddr_nl addr;
+	socklen_t addrlen;
+	ssize_t len;
+
+	for (;;) {
+		addrlen = sizeof(addr);
+		len = recvfrom(cache->uevent_fd, buf, sizeof(buf) - 1, 0,
+			       (struct sockaddr *)&addr, &addrlen);
+		if (len < 0) {
+			/* Lost uevents: start over */
+			if (errno == ENOBUFS) {
+				memset(cache->tab, 0, sizeof(cache->tab));
+				cache->used = 0;
+				continue;
+			}
+			return;
+		}
+
+		/* Only trust the kernel */
+		if (addr.nl_pid)
+			continue;
+		buf[len] = '\0';
+		blkdev_uevent_parse(cache, buf, len);
+	}
+}
+
+/* Reads a sysfs attribute of @dirfd, without its trailing blanks */
+static void blkdev_read_attr(int dirfd, const char *attr, char *buf,
+			     size_t size)
+{
+	ssize_t len;
+	int fd;
+
+	buf[0] = '\0';
+	fd = openat(dirfd, attr, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return;
+	len = read(fd, buf, size - 1);
+	close(fd);
+	if (len < 0)
+		len = 0;
+
+	while (len > 0 && (buf[len - 1] == '\n' || buf[len - 1] == ' '))
+		len--;
+	buf[len] = '\0';
+}
+
+static int blkdev_resolve(dev_t dev, struct blkdev_info *info)
+{
+	char path[64], link[256], *name;
+	struct stat st;
+	ssize_t len;
+	int dirfd, parent;
+
+	memset(info, 0, sizeof(*info));
+
+	snprintf(path, sizeof(path), "/sys/dev/block/%u:%u",
+		 major(dev), minor(dev));
+	len = readlink(path, link, sizeof(link) - 1);
+	if (len < 0)
+		return -1;
+	link[len] = '\0';
+	name = strrchr(link, '/');
+	snprintf(info->name, sizeof(info->name), "%.*s",
+		 (int)sizeof(info->name) - 1, name ? name + 1 : link);
+
+	dirfd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (dirfd < 0)
+		return 0;
+
+	/* Partitions are identified by their disk */
+	if (!fstatat(dirfd, "partition", &st, 0)) {
+		parent = openat(dirfd, "..", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+		close(dirfd);
+		if (parent < 0)
+			return 0;
+		dirfd = parent;
+	}
+
+	/* NVMe namespaces have it on the disk, SCSI devices on the device */
+	blkdev_read_attr(dirfd, "wwid", info->wwid, sizeof(info->wwid));
+	if (!info->wwid[0])
+		blkdev_read_attr(dirfd, "device/wwid", info->wwid,
+				 sizeof(info->wwid));
+	blkdev_read_attr(dirfd, "device/model", info->model,
+			 sizeof(info->model));
+	blkdev_read_attr(dirfd, "device/serial", info->serial,
+			 sizeof(info->serial));
+	if (!info->serial[0])
+		blkdev_read_attr(dirfd, "serial", info->serial,
+				 sizeof(info->serial));
+	close(dirfd);
+
+	return 0;
+}
+
+int blkdev_lookup(struct blkdev_cache *cache, dev_t dev,
+		  struct blkdev_info *info)
+{
+	struct blkdev_entry *ent;
+	int rc;
+
+	if (!cache || cache->uevent_fd < 0)
+		return blkdev_resolve(dev, info);
+
+	pthread_mutex_lock(&cache->lock);
+
+	blkdev_uevent_drain(cache);
+
+	ent = blkdev_slot(cache, dev);
+	if (!ent->used) {
+		/* Keep the load factor under 3/4 */
+		if (4 * (cache->used + 1) > 3 * BLKDEV_CACHE_SIZE) {
+			memset(cache->tab, 0, sizeof(cache->tab));
+			cache->used = 0;
+			ent = blkdev_slot(cache, dev);
+		}
+		ent->used = 1;
+		ent->dev = dev;
+		ent->found = !blkdev_resolve(dev, &ent->info);
+		cache->used++;
+	}
+	*info = ent->info;
+	rc = ent->found ? 0 : -1;
+
+	pthread_mutex_unlock(&cache->lock);
+
+	return rc;
+}
@@ -0,0 +1,43 @@
+/*
+ * Copyright (c) Huawei Technologies Co., Ltd. 2026. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#ifndef __RAS_BLKDEV_H
+#define __RAS_BLKDEV_H
+
+#include <sys/types.h>
+
+struct blkdev_cache;
+
+struct blkdev_info {
+	char	name[32];	/* sdX, nvmeXnY... empty if unknown */
+	char	wwid[128];
+	char	model[64];
+	char	serial[64];
+};
+
+struct blkdev_cache *blkdev_cache_init(void);
+void blkdev_cache_free(struct blkdev_cache *cache);
+
+/*
+ * Fills @info for the block device @dev. Unknown attributes are left
+ * empty. Returns 0 if the device was found.
+ */
+int blkdev_lookup(struct blkdev_cache *cache, dev_t dev,
+		  struct blkdev_info *info);
+
+#endif
@@ -25,6 +25,7 @@
 #include "ras-record.h"
 #include "ras-logger.h"
 #include "ras-report.h"
+#include "ras-stream.h"
 
 int ras_net_xmit_timeout_handler(struct trace_seq *s,
 				 struct pevent_record *record,
@@ -76,6 +77,8 @@ int ras_net_xmit_timeout_handler(struct trace_seq *s,
 	ras_report_devlink_event(ras, &ev);
 #endif
 
+	ras_stream_devlink_event(ras, &ev);
+
 	free(ev.msg);
 	return 0;
 
@@ -148,5 +151,7 @@ int ras_devlink_event_handler(struct trace_seq *s,
 	ras_report_devlink_event(ras, &ev);
 #endif
 
+	ras_stream_devlink_event(ras, &ev);
+
 	return 0;
 }
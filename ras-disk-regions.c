@@ -0,0 +1,411 @@
+/*
+ * Copyright (c) Huawei Technologies Co., Ltd. 2026. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+/*
+ * Bad region tracking of block devices.
+ *
+ * A dying disk fails the same sectors over and over, as the requests get
+ * retried. Failed (sector, nr_sector) ranges are merged per device with
+ * the overlapping and adjacent ones into bad regions, that keep an error
+ * count and when they were first and last seen. Every
+ * DISKERROR_REGION_INTERVAL seconds, the regions that got new errors are
+ * stored on the disk_error_regions table, along with the error rate of
+ * their device.
+ *
+ * When a device has more than DISKERROR_MAX_REGIONS regions, the updated
+ * region is merged with its closest neighbour, trading precision for a
+ * bounded memory usage.
+ *
+ * Storing the raw events on disk_errors can be disabled with
+ * DISKERROR_RAW_EVENTS=0.
+ */
+
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/sysmacros.h>
+
+#include "ras-disk-regions.h"
+#include "ras-events.h"
+#include "ras-record.h"
+#include "ras-logger.h"
+#include "ras-env.h"
+#include "rbtree.h"
+
+struct disk_region {
+	struct rb_node		node;
+	unsigned long long	start, end;	/* sectors [start, end) */
+	unsigned long long	count;
+	time_t			first_seen, last_seen;
+	const char		*error;		/* the last one */
+	unsigned		dirty:1;	/* updated since the last flush */
+};
+
+struct disk_dev {
+	struct disk_dev		*next;
+	dev_t			dev;
+	struct rb_root		regions;	/* by start sector */
+	unsigned long		nr_regions;
+	unsigned long long	errors;		/* since the last flush */
+};
+
+struct disk_regions {
+	pthread_mutex_t		lock;
+	unsigned long		interval, max_regions;
+	unsigned		raw_events:1;
+	struct disk_dev		*devs;
+	unsigned long		pending;	/* dirty regions */
+	double			last_flush;
+};
+
+static double disk_regions_clock(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+struct disk_regions *disk_regions_init(void)
+{
+	struct disk_regions *regions;
+	unsigned long interval, max_regions, raw_events;
+
+	interval = ras_parse_env_ulong("DISKERROR_REGION_INTERVAL", 0,
+				       ULONG_MAX, 60);
+	max_regions = ras_parse_env_ulong("DISKERROR_MAX_REGIONS", 0,
+					  ULONG_MAX, 1024);
+	raw_events = ras_parse_env_ulong("DISKERROR_RAW_EVENTS", 0, 1, 1);
+	if (!interval)
+		interval = 1;
+	if (!max_regions)
+		max_regions = 1;
+
+	regions = calloc(1, sizeof(*regions));
+	if (!regions) {
+		log(TERM, LOG_ERR, "Can't allocate memory for disk regions\n");
+		return NULL;
+	}
+	pthread_mutex_init(&regions->lock, NULL);
+	regions->interval = interval;
+	regions->max_regions = max_regions;
+	regions->raw_events = !!raw_events;
+	regions->last_flush = disk_regions_clock();
+
+	return regions;
+}
+
+void disk_regions_free(struct disk_regions *regions)
+{
+	struct disk_dev *d, *next;
+	struct rb_node *node;
+
+	if (!regions)
+		return;
+
+	for (d = regions->devs; d; d = next) {
+		next = d->next;
+		while ((node = rb_first(&d->regions))) {
+			rb_erase(node, &d->regions);
+			free(rb_entry(node, struct disk_region, node));
+		}
+		free(d);
+	}
+	pthread_mutex_destroy(&regions->lock);
+	free(regions);
+}
+
+static struct disk_dev *disk_dev_get(struct disk_regions *regions, dev_t dev)
+{
+	struct disk_dev *d;
+
+	for (d = regions->devs; d; d = d->next)
+		if (d->dev == dev)
+			return d;
+
+	d = calloc(1, sizeof(*d));
+	if (!d)
+		return NULL;
+	d->dev = dev;
+	d->regions = RB_ROOT;
+	d->next = regions->devs;
+	regions->devs = d;
+
+	return d;
+}
+
+/* The first region ending at or after @sector, so adjacent ones match */
+static struct disk_region *disk_region_find(struct disk_dev *d,
+					    unsigned long long sector)
+{
+	struct rb_node *node = d->regions.rb_node;
+	struct disk_region *r, *found = NULL;
+
+	while (node) {
+		r = rb_entry(node, struct disk_region, node);
+		if (r->end >= sector) {
+			found = r;
+			node = node->rb_left;
+		} else {
+			node = node->rb_right;
+		}
+	}
+
+	return found;
+}
+
+static void disk_region_insert(struct disk_dev *d, struct disk_region *new)
+{
+	struct rb_node **p = &d->regions.rb_node, *parent = NULL;
+	struct disk_region *r;
+
+	while (*p) {
+		parent = *p;
+		r = rb_entry(parent, struct disk_region, node);
+		if (new->start < r->start)
+			p = &(*p)->rb_left;
+		else
+			p = &(*p)->rb_right;
+	}
+	rb_link_node(&new->node, parent, p);
+	rb_insert_color(&new->node, &d->regions);
+	d->nr_regions++;
+}
+
+/* Merges @src into @dst, @src being the next or the previous region */
+static void disk_region_absorb(struct disk_regions *regions,
+			       struct disk_dev *d, struct disk_region *dst,
+			       struct disk_region *src)
+{
+	if (src->start < dst->start)
+		dst->start = src->start;
+	if (src->end > dst->end)
+		dst->end = src->end;
+	dst->count += src->count;
+	if (src->first_seen < dst->first_seen)
+		dst->first_seen = src->first_seen;
+	if (src->last_seen > dst->last_seen) {
+		dst->last_seen = src->last_seen;
+		dst->error = src->error;
+	}
+	if (src->dirty)
+		regions->pending--;
+
+	rb_erase(&src->node, &d->regions);
+	d->nr_regions--;
+	free(src);
+}
+
+static struct disk_region *disk_region_next(struct disk_region *r)
+{
+	struct rb_node *node = rb_next(&r->node);
+
+	return node ? rb_entry(node, struct disk_region, node) : NULL;
+}
+
+static struct disk_region *disk_region_prev(struct disk_region *r)
+{
+	struct rb_node *node = rb_prev(&r->node);
+
+	return node ? rb_entry(node, struct disk_region, node) : NULL;
+}
+
+/* Keeps the regions of @d under the limit, by coarsening around @r */
+static void disk_region_shrink(struct disk_regions *regions,
+			       struct disk_dev *d, struct disk_region *r)
+{
+	struct disk_region *prev, *next;
+
+	while (d->nr_regions > regions->max_regions) {
+		prev = disk_region_prev(r);
+		next = disk_region_next(r);
+		if (!prev && !next)
+			return;
+
+		if (!next || (prev && r->start - prev->end < next->start - r->end))
+			disk_region_absorb(regions, d, r, prev);
+		else
+			disk_region_absorb(regions, d, r, next);
+	}
+}
+
+enum disk_regions_verdict disk_regions_add(struct disk_regions *regions,
+					   dev_t dev, unsigned long long sector,
+					   unsigned int nr_sector,
+					   const char *error, time_t when)
+{
+	unsigned long long end;
+	struct disk_region *r, *next;
+	struct disk_dev *d;
+
+	if (!regions)
+		return DISK_REGIONS_STORE;
+
+	/* Requests without a sector, like flushes */
+	if (sector == ~0ULL)
+		return DISK_REGIONS_STORE;
+
+	end = sector + (nr_sector ? nr_sector : 1);
+	if (end < sector)
+		end = ~0ULL;
+
+	pthread_mutex_lock(&regions->lock);
+
+	d = disk_dev_get(regions, dev);
+	if (!d) {
+		pthread_mutex_unlock(&regions->lock);
+		return DISK_REGIONS_STORE;
+	}
+	d->errors++;
+
+	r = disk_region_find(d, sector);
+	if (r && r->start <= end) {
+		if (sector < r->start)
+			r->start = sector;
+		if (end > r->end)
+			r->end = end;
+		r->count++;
+		r->last_seen = when;
+		r->error = error;
+
+		/* The region may now reach the next ones */
+		while ((next = disk_region_next(r)) && next->start <= r->end)
+			disk_region_absorb(regions, d, r, next);
+	} else {
+		r = calloc(1, sizeof(*r));
+		if (!r) {
+			pthread_mutex_unlock(&regions->lock);
+			return DISK_REGIONS_STORE;
+		}
+		r->start = sector;
+		r->end = end;
+		r->count = 1;
+		r->first_seen = r->last_seen = when;
+		r->error = error;
+		disk_region_insert(d, r);
+		disk_region_shrink(regions, d, r);
+	}
+
+	if (!r->dirty) {
+		/* Starts a new interval after an idle one */
+		if (!regions->pending &&
+		    disk_regions_clock() - regions->last_flush >= regions->interval)
+			regions->last_flush = disk_regions_clock();
+		r->dirty = 1;
+		regions->pending++;
+	}
+
+	pthread_mutex_unlock(&regions->lock);
+
+	return regions->raw_events ? DISK_REGIONS_STORE : DISK_REGIONS_MERGED;
+}
+
+static void disk_region_emit(struct ras_events *ras, struct disk_region *r,
+			     const char *timestamp, const char *dev,
+			     double rate)
+{
+	struct ras_disk_region_event ev;
+	struct tm tm;
+
+	memset(&ev, 0, sizeof(ev));
+	ev.timestamp = timestamp;
+	ev.dev = dev;
+	ev.sector = r->start;
+	ev.nr_sector = r->end - r->start;
+	ev.count = r->count;
+	ev.error = r->error;
+	ev.rate = rate;
+	if (localtime_r(&r->first_seen, &tm))
+		strftime(ev.first_seen, sizeof(ev.first_seen),
+			 "%Y-%m-%d %H:%M:%S %z", &tm);
+	if (localtime_r(&r->last_seen, &tm))
+		strftime(ev.last_seen, sizeof(ev.last_seen),
+			 "%Y-%m-%d %H:%M:%S %z", &tm);
+
+#ifdef HAVE_SQLITE3
+	ras_store_disk_region(ras, &ev);
+#endif
+}
+
+int disk_regions_flush(struct ras_events *ras, int force)
+{
+	struct disk_regions *regions = ras->disk_regions;
+	char timestamp[64] = "", dev[32];
+	struct disk_region *r;
+	struct rb_node *node;
+	struct disk_dev *d;
+	double now, elapsed, rate;
+	time_t t;
+	struct tm tm;
+	int timeout;
+
+	if (!regions)
+		return -1;
+
+	now = disk_regions_clock();
+
+	pthread_mutex_lock(&regions->lock);
+
+	elapsed = now - regions->last_flush;
+	if (!regions->pending || (!force && elapsed < regions->interval))
+		goto out;
+
+	t = time(NULL);
+	if (localtime_r(&t, &tm))
+		strftime(timestamp, sizeof(timestamp),
+			 "%Y-%m-%d %H:%M:%S %z", &tm);
+	if (elapsed < 1)
+		elapsed = 1;
+
+	for (d = regions->devs; d; d = d->next) {
+		if (!d->errors)
+			continue;
+
+		snprintf(dev, sizeof(dev), "%u:%u", major(d->dev), minor(d->dev));
+		rate = d->errors * 60 / elapsed;
+		log(ALL, LOG_WARNING,
+		    "Disk %s: %llu errors in %.0fs (%.1f/min), %lu bad regions\n",
+		    dev, d->errors, elapsed, rate, d->nr_regions);
+
+		for (node = rb_first(&d->regions); node; node = rb_next(node)) {
+			r = rb_entry(node, struct disk_region, node);
+			if (!r->dirty)
+				continue;
+			disk_region_emit(ras, r, timestamp, dev, rate);
+			r->dirty = 0;
+		}
+		d->errors = 0;
+	}
+	regions->pending = 0;
+	regions->last_flush = now;
+
+out:
+	if (regions->pending) {
+		timeout = (regions->last_flush + regions->interval - now) * 1000;
+		if (timeout < 0)
+			timeout = 0;
+	} else {
+		timeout = -1;
+	}
+	pthread_mutex_unlock(&regions->lock);
+
+	return timeout;
+}
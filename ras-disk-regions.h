@@ -0,0 +1,53 @@
+/*
+ * Copyright (c) Huawei Technologies Co., Ltd. 2026. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#ifndef __RAS_DISK_REGIONS_H
+#define __RAS_DISK_REGIONS_H
+
+#include <time.h>
+#include <sys/types.h>
+
+struct ras_events;
+struct disk_regions;
+
+enum disk_regions_verdict {
+	DISK_REGIONS_STORE,	/* also store the event on disk_errors */
+	DISK_REGIONS_MERGED,	/* only accounted on its bad region */
+};
+
+struct disk_regions *disk_regions_init(void);
+void disk_regions_free(struct disk_regions *regions);
+
+/*
+ * Accounts a failed request of @nr_sector sectors at @sector of @dev.
+ * @error is a static string and @when the wall clock time of the event.
+ */
+enum disk_regions_verdict disk_regions_add(struct disk_regions *regions,
+					   dev_t dev, unsigned long long sector,
+					   unsigned int nr_sector,
+					   const char *error, time_t when);
+
+/*
+ * Stores the bad regions updated since the last flush, if they are due
+ * (or now, if @force). Returns how many milliseconds until the next flush
+ * is due, or -1 if nothing is pending, so that it can be used as a poll()
+ * timeout.
+ */
+int disk_regions_flush(struct ras_events *ras, int force);
+
+#endif
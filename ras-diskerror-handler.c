@@ -26,9 +26,12 @@
 #include <sys/sysmacros.h>
 #include "libtrace/kbuffer.h"
 #include "ras-diskerror-handler.h"
+#include "ras-disk-regions.h"
+#include "ras-blkdev.h"
 #include "ras-record.h"
 #include "ras-logger.h"
 #include "ras-report.h"
+#include "ras-stream.h"
 
 
 static const struct {
@@ -70,7 +73,20 @@ int ras_diskerror_event_handler(struct trace_seq *s,
 	time_t now;
 	struct tm *tm;
 	struct diskerror_event ev;
+	char dev_str[32];
+	struct blkdev_info info;
 	dev_t dev;
+	int error;
+
+	/*
+	 * Successful requests are filtered out by the kernel, unless the
+	 * filter was overridden, or couldn't be installed
+	 */
+	if (pevent_get_field_val(s, event, "error", record, &val, 1) < 0)
+		return -1;
+	error = (int)val;
+	if (!error)
+		return 0;
 
 	/*
 	 * Newer kernels (3.10-rc1 or upper) provide an uptime clock.
@@ -95,8 +111,14 @@ int ras_diskerror_event_handler(struct trace_seq *s,
 	if (pevent_get_field_val(s, event, "dev", record, &val, 1) < 0)
 		return -1;
 	dev = (dev_t)val;
-	if (asprintf(&ev.dev, "%u:%u", major(dev), minor(dev)) < 0)
-		return -1;
+	snprintf(dev_str, sizeof(dev_str), "%u:%u", major(dev), minor(dev));
+	ev.dev = dev_str;
+
+	blkdev_lookup(ras->blkdev, dev, &info);
+	ev.name = info.name;
+	ev.wwid = info.wwid;
+	ev.model = info.model;
+	ev.serial = info.serial;
 
 	if (pevent_get_field_val(s, event, "sector", record, &val, 1) < 0)
 		return -1;
@@ -106,9 +128,7 @@ int ras_diskerror_event_handler(struct trace_seq *s,
 		return -1;
 	ev.nr_sector = (unsigned int)val;
 
-	if (pevent_get_field_val(s, event, "error", record, &val, 1) < 0)
-		return -1;
-	ev.error = get_blk_error((int)val);
+	ev.error = get_blk_error(error);
 
 	ev.rwbs = pevent_get_field_raw(s, event, "rwbs", record, &len, 1);
 	if (!ev.rwbs)
@@ -118,15 +138,29 @@ int ras_diskerror_event_handler(struct trace_seq *s,
 	if (!ev.cmd)
 		return -1;
 
-	/* Insert data into the SGBD */
+	trace_seq_printf(s, "%s", ev.dev);
+	if (*ev.name)
+		trace_seq_printf(s, " (%s)", ev.name);
+	trace_seq_printf(s, " sector %llu (%u sectors): %s",
+			 ev.sector, ev.nr_sector, ev.error);
+
+	/*
+	 * Without raw events, failed requests are only stored on their bad
+	 * region, but still reported
+	 */
+	if (disk_regions_add(ras->disk_regions, dev, ev.sector, ev.nr_sector,
+			     ev.error, now) == DISK_REGIONS_STORE) {
+		/* Insert data into the SGBD */
 #ifdef HAVE_SQLITE3
-	ras_store_diskerror_event(ras, &ev);
+		ras_store_diskerror_event(ras, &ev);
 #endif
+	}
 
 #ifdef HAVE_ABRT_REPORT
 	/* Report event to ABRT */
 	ras_report_diskerror_event(ras, &ev);
 #endif
-	free(ev.dev);
+
+	ras_stream_diskerror_event(ras, &ev);
 	return 0;
 }
@@ -0,0 +1,42 @@
+/*
+ * Copyright (c) Huawei Technologies Co., Ltd. 2026. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#include <errno.h>
+#include <stdlib.h>
+#include "ras-env.h"
+#include "ras-logger.h"
+
+unsigned long ras_parse_env_ulong(const char *name, unsigned long min,
+				  unsigned long max, unsigned long def)
+{
+	char *env = getenv(name), *end;
+	unsigned long v;
+
+	if (!env || !*env)
+		return def;
+
+	errno = 0;
+	v = strtoul(env, &end, 10);
+	if (errno || end == env || *end || v < min || v > max) {
+		log(TERM, LOG_INFO, "Improper %s, set to default %lu.\n",
+		    name, def);
+		return def;
+	}
+
+	return v;
+}
@@ -0,0 +1,30 @@
+/*
+ * Copyright (c) Huawei Technologies Co., Ltd. 2026. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#ifndef __RAS_ENV_H
+#define __RAS_ENV_H
+
+/*
+ * Reads the decimal value of the environment variable @name. If it is unset
+ * or empty, returns @def. If it isn't a number between @min and @max, logs
+ * it and returns @def as well.
+ */
+unsigned long ras_parse_env_ulong(const char *name, unsigned long min,
+				  unsigned long max, unsigned long def);
+
+#endif
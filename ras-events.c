@@ -15,6 +15,7 @@
  * along with this program; if not, write to the Free Software
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
 */
+#include <ctype.h>
 #include <dirent.h>
 #include <errno.h>
 #include <fcntl.h>
@@ -24,6 +25,7 @@
 #include <unistd.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/vfs.h>
 #include <sys/poll.h>
 #include <signal.h>
 #include <sys/signalfd.h>
@@ -31,15 +33,24 @@
 #include "libtrace/event-parse.h"
 #include "ras-mc-handler.h"
 #include "ras-aer-handler.h"
+#include "ras-aer-rate.h"
 #include "ras-non-standard-handler.h"
 #include "ras-arm-handler.h"
 #include "ras-mce-handler.h"
 #include "ras-extlog-handler.h"
 #include "ras-devlink-handler.h"
 #include "ras-diskerror-handler.h"
+#include "ras-disk-regions.h"
+#include "ras-blkdev.h"
 #include "ras-record.h"
 #include "ras-logger.h"
 #include "ras-page-isolation.h"
+#include "ras-report.h"
+#include "ras-mce-storm.h"
+#include "ras-stream.h"
+#include "ras-metrics.h"
+#include "ras-probes.h"
+#include "ras-format-cache.h"
 
 /*
  * Polling time, if read() doesn't block. Currently, trace_pipe_raw never
@@ -55,11 +66,26 @@
 	#define ENDIAN KBUFFER_ENDIAN_BIG
 #endif
 
-static int get_debugfs_dir(char *tracing_dir, size_t len)
+const char *ras_event_names[NR_EVENTS] = {
+	[MC_EVENT]		= "mc",
+	[MCE_EVENT]		= "mce",
+	[AER_EVENT]		= "aer",
+	[NON_STANDARD_EVENT]	= "non_standard",
+	[ARM_EVENT]		= "arm",
+	[EXTLOG_EVENT]		= "extlog",
+	[DEVLINK_EVENT]		= "devlink",
+	[DISKERROR_EVENT]	= "diskerror",
+};
+
+const char *ras_tracefs_root;
+
+/* Last resort, for tracefs or debugfs mounted at unusual places */
+static int get_tracing_mount(char *tracing_dir, size_t len)
 {
 	FILE *fp;
 	char line[MAX_PATH + 1 + 256];
 	char *p, *type, *dir;
+	int rc = ENOENT;
 
 	fp = fopen("/proc/mounts","r");
 	if (!fp) {
@@ -83,17 +109,23 @@ static int get_debugfs_dir(char *tracing_dir, size_t len)
 		if (!type)
 			break;
 
-		if (!strcmp(type, "debugfs")) {
-			fclose(fp);
-			strncpy(tracing_dir, dir, len - 1);
-			tracing_dir[len - 1] = '\0';
-			return 0;
+		if (!strcmp(type, "tracefs")) {
+			snprintf(tracing_dir, len, "%s", dir);
+			rc = 0;
+			break;
+		}
+
+		/* Unless tracefs is also mounted */
+		if (!strcmp(type, "debugfs") && rc) {
+			snprintf(tracing_dir, len, "%s/tracing", dir);
+			rc = 0;
 		}
 	} while(1);
 
 	fclose(fp);
-	log(ALL, LOG_INFO, "Can't find debugfs\n");
-	return ENOENT;
+	if (rc)
+		log(ALL, LOG_INFO, "Can't find tracefs nor debugfs\n");
+	return rc;
 }
 
 static int open_trace(struct ras_events *ras, char *name, int flags)
@@ -107,87 +139,280 @@ static int open_trace(struct ras_events *ras, char *name, int flags)
 	return open(fname, flags);
 }
 
-static int get_tracing_dir(struct ras_events *ras)
+#ifndef TRACEFS_MAGIC
+#define TRACEFS_MAGIC	0x74726163
+#endif
+#ifndef DEBUGFS_MAGIC
+#define DEBUGFS_MAGIC	0x64626720
+#endif
+
+/*
+ * Where tracing usually is: tracefs on its own mount point, then within
+ * debugfs, either as a tracefs automount or as part of debugfs on kernels
+ * older than 4.1. Checking the filesystem type tells apart an empty mount
+ * point, without going through the mount table.
+ */
+static const char *tracing_dirs[] = {
+	"/sys/kernel/tracing",
+	"/sys/kernel/debug/tracing",
+};
+
+static int is_tracing_dir(const char *dir)
 {
-	char		fname[MAX_PATH + 1];
-	int		rc, has_instances = 0;
-	DIR		*dir;
-	struct dirent	*entry;
+	struct statfs st;
 
-	get_debugfs_dir(ras->debugfs, sizeof(ras->debugfs));
+	if (statfs(dir, &st) < 0)
+		return 0;
 
-	strcpy(fname, ras->debugfs);
-	strcat(fname, "/tracing");
-	dir = opendir(fname);
-	if (!dir)
-		return -1;
+	return st.f_type == TRACEFS_MAGIC || st.f_type == DEBUGFS_MAGIC;
+}
 
-	for (entry = readdir(dir); entry; entry = readdir(dir)) {
-		if (strstr(entry->d_name, "instances")) {
-			has_instances = 1;
+static int get_tracing_dir(struct ras_events *ras)
+{
+	char		tracing[MAX_PATH + 1 - sizeof("/instances/" TOOL_NAME)];
+	int		i, rc;
+
+	/* Used as is: it is not ours to create an instance there */
+	if (ras_tracefs_root) {
+		snprintf(ras->tracing, sizeof(ras->tracing), "%s",
+			 ras_tracefs_root);
+		return 0;
+	}
+
+	for (i = 0; i < ARRAY_SIZE(tracing_dirs); i++) {
+		if (is_tracing_dir(tracing_dirs[i])) {
+			snprintf(tracing, sizeof(tracing), "%s",
+				 tracing_dirs[i]);
 			break;
 		}
 	}
-	closedir(dir);
+	if (i == ARRAY_SIZE(tracing_dirs) &&
+	    get_tracing_mount(tracing, sizeof(tracing)))
+		return -1;
 
-	strcpy(ras->tracing, ras->debugfs);
-	strcat(ras->tracing, "/tracing");
-	if (has_instances) {
-		strcat(ras->tracing, "/instances/" TOOL_NAME);
-		rc = mkdir(ras->tracing, S_IRWXU);
-		if (rc < 0 && errno != EEXIST) {
-			log(ALL, LOG_INFO,
-			    "Unable to create " TOOL_NAME " instance at %s\n",
-			    ras->tracing);
-			return -1;
-		}
+	/* Kernels without instances trace on the top level only */
+	snprintf(ras->tracing, sizeof(ras->tracing),
+		 "%s/instances/" TOOL_NAME, tracing);
+	rc = mkdir(ras->tracing, S_IRWXU);
+	if (!rc) {
+		ras->instance = 1;
+	} else if (errno == EEXIST) {
+		ras->instance = 1;
+		ras->old_instance = 1;
+	} else if (errno == ENOENT) {
+		snprintf(ras->tracing, sizeof(ras->tracing), "%s", tracing);
+	} else {
+		log(ALL, LOG_INFO,
+		    "Unable to create " TOOL_NAME " instance at %s\n",
+		    ras->tracing);
+		return -1;
 	}
 	return 0;
 }
 
+/*
+ * The instance left by a previous run may still have events enabled that
+ * this one doesn't handle, and records on its buffers that were either
+ * already handled or, if the trace clock gets changed, would be dropped
+ * by the kernel anyway: start afresh.
+ */
+static void reset_tracing_instance(struct ras_events *ras)
+{
+	int fd;
+
+	/* Truncating set_event disables all the events */
+	fd = open_trace(ras, "set_event", O_WRONLY | O_TRUNC);
+	if (fd < 0)
+		log(ALL, LOG_WARNING, "Can't disable the events left enabled\n");
+	else
+		close(fd);
+
+	/* And truncating trace clears the buffers */
+	fd = open_trace(ras, "trace", O_WRONLY | O_TRUNC);
+	if (fd < 0)
+		log(ALL, LOG_WARNING, "Can't clear the trace buffers\n");
+	else
+		close(fd);
+
+	log(ALL, LOG_INFO, "Reset the instance left at %s\n", ras->tracing);
+}
+
 /*
  * Tracing enable/disable code
  */
-static int __toggle_ras_mc_event(struct ras_events *ras,
-				 char *group, char *event, int enable)
+struct ras_trace_event {
+	const char	*group;
+	const char	*event;
+};
+
+/* Events toggled by --enable and --disable */
+static const struct ras_trace_event ras_trace_events[] = {
+	{ "ras", "mc_event" },
+#ifdef HAVE_AER
+	{ "ras", "aer_event" },
+#endif
+#ifdef HAVE_MCE
+	{ "mce", "mce_record" },
+#endif
+#ifdef HAVE_EXTLOG
+	{ "ras", "extlog_mem_event" },
+#endif
+#ifdef HAVE_NON_STANDARD
+	{ "ras", "non_standard_event" },
+#endif
+#ifdef HAVE_ARM
+	{ "ras", "arm_event" },
+#endif
+#ifdef HAVE_DEVLINK
+	{ "net", "net_dev_xmit_timeout" },
+	{ "devlink", "devlink_health_report" },
+#endif
+#ifdef HAVE_DISKERROR
+	{ "block", "block_rq_complete" },
+#endif
+};
+
+/*
+ * Makes the "group:event" lines for set_event, prefixed by "!" to disable
+ * them. Also used, with a space as @sep, for the log messages.
+ */
+static char *set_event_lines(const struct ras_trace_event *ev, int n,
+			     int enable, char sep, size_t *len)
 {
-	int fd, rc;
-	char fname[MAX_PATH + 1];
+	char *buf, *p;
+	int i;
+
+	*len = 0;
+	for (i = 0; i < n; i++)
+		*len += strlen(ev[i].group) + strlen(ev[i].event) + 3;
+
+	buf = malloc(*len + 1);
+	if (!buf)
+		return NULL;
+
+	p = buf;
+	*p = '\0';
+	for (i = 0; i < n; i++)
+		p += sprintf(p, "%s%s:%s%c", enable ? "" : "!",
+			     ev[i].group, ev[i].event, sep);
+	*len = p - buf;
+
+	return buf;
+}
+
+/*
+ * The kernel applies a single line of set_event per write(), returning how
+ * much of the buffer it consumed: the lines are written at once, and a
+ * failed write tells which one was rejected. If @skip, that line is skipped,
+ * and the remaining ones still written.
+ */
+static int write_set_event(int fd, const char *buf, size_t len,
+			   size_t *done, int skip)
+{
+	const char *eol;
+	ssize_t rc;
+	int err = 0;
+
+	*done = 0;
+	while (*done < len) {
+		rc = write(fd, buf + *done, len - *done);
+		if (rc < 0 && errno == EINTR)
+			continue;
+		if (rc > 0) {
+			*done += rc;
+			continue;
+		}
+
+		err = rc < 0 ? errno : EIO;
+		log(ALL, LOG_WARNING, "Can't write %.*s to set_event\n",
+		    (int)strcspn(buf + *done, "\n"), buf + *done);
+		if (!skip)
+			return err;
+
+		eol = memchr(buf + *done, '\n', len - *done);
+		*done = eol ? eol - buf + 1 : len;
+	}
+
+	return err;
+}
 
-	snprintf(fname, sizeof(fname), "%s%s:%s\n",
-		 enable ? "" : "!",
-		 group, event);
+/*
+ * Enables or disables @n events through a single open of set_event. Either
+ * all of them get enabled, or none: the ones enabled before a failure are
+ * disabled back. Disabling carries on past the events that fail.
+ */
+static int toggle_events(struct ras_events *ras,
+			 const struct ras_trace_event *ev, int n, int enable)
+{
+	size_t len, done, undo_len;
+	char *buf, *undo, *msg;
+	int fd, rc, applied, i;
 
-	/* Enable RAS events */
-	fd = open_trace(ras, "set_event", O_RDWR | O_APPEND);
+	if (!n)
+		return 0;
+
+	buf = set_event_lines(ev, n, enable, '\n', &len);
+	if (!buf)
+		return ENOMEM;
+
+	fd = open_trace(ras, "set_event", O_WRONLY | O_APPEND);
 	if (fd < 0) {
 		log(ALL, LOG_WARNING, "Can't open set_event\n");
-		return errno;
+		rc = errno;
+		free(buf);
+		return rc;
 	}
 
-	rc = write(fd, fname,strlen(fname));
-	if (rc < 0) {
-		log(ALL, LOG_WARNING, "Can't write to set_event\n");
-		close(fd);
-		return rc;
+	rc = write_set_event(fd, buf, len, &done, !enable);
+	if (rc && enable) {
+		for (applied = 0, i = 0; i < done; i++)
+			applied += buf[i] == '\n';
+
+		undo = set_event_lines(ev, applied, 0, '\n', &undo_len);
+		if (undo) {
+			write_set_event(fd, undo, undo_len, &done, 1);
+			free(undo);
+		}
+		log(ALL, LOG_WARNING,
+		    "Can't enable the RAS events, %d disabled back\n", applied);
 	}
 	close(fd);
+	free(buf);
+
 	if (!rc) {
-		log(ALL, LOG_WARNING, "Nothing was written on set_event\n");
-		return EIO;
+		msg = set_event_lines(ev, n, 1, ' ', &len);
+		if (msg) {
+			msg[len - 1] = '\0';
+			log(ALL, LOG_INFO, "%s %s\n",
+			    enable ? "Enabled" : "Disabled", msg);
+			free(msg);
+		}
 	}
 
-	log(ALL, LOG_INFO, "%s:%s event %s\n",
-	    group, event,
-	    enable ? "enabled" : "disabled");
+	return rc;
+}
 
-	return 0;
+static int has_trace_event(struct ras_events *ras,
+			   const struct ras_trace_event *ev)
+{
+	char fname[MAX_PATH + 1];
+	int fd;
+
+	snprintf(fname, sizeof(fname), "events/%s/%s", ev->group, ev->event);
+
+	fd = open_trace(ras, fname, O_RDONLY | O_DIRECTORY);
+	if (fd < 0)
+		return 0;
+	close(fd);
+
+	return 1;
 }
 
 int toggle_ras_mc_event(int enable)
 {
+	struct ras_trace_event ev[ARRAY_SIZE(ras_trace_events)];
 	struct ras_events *ras;
-	int rc = 0;
+	int rc = 0, i, n = 0;
 
 	ras = calloc(1, sizeof(*ras));
 	if (!ras) {
@@ -197,45 +422,27 @@ int toggle_ras_mc_event(int enable)
 
 	rc = get_tracing_dir(ras);
 	if (rc < 0) {
-		log(TERM, LOG_ERR, "Can't locate a mounted debugfs\n");
+		log(TERM, LOG_ERR, "Can't locate a mounted tracefs\n");
 		goto free_ras;
 	}
 
-	rc = __toggle_ras_mc_event(ras, "ras", "mc_event", enable);
-
-#ifdef HAVE_AER
-	rc |= __toggle_ras_mc_event(ras, "ras", "aer_event", enable);
-#endif
-
-#ifdef HAVE_MCE
-	rc |= __toggle_ras_mc_event(ras, "mce", "mce_record", enable);
-#endif
-
-#ifdef HAVE_EXTLOG
-	rc |= __toggle_ras_mc_event(ras, "ras", "extlog_mem_event", enable);
-#endif
-
-#ifdef HAVE_NON_STANDARD
-	rc |= __toggle_ras_mc_event(ras, "ras", "non_standard_event", enable);
-#endif
-
-#ifdef HAVE_ARM
-	rc |= __toggle_ras_mc_event(ras, "ras", "arm_event", enable);
-#endif
-
-#ifdef HAVE_DEVLINK
-	rc |= __toggle_ras_mc_event(ras, "devlink", "devlink_health_report", enable);
-#endif
+	/* Those the kernel doesn't have would fail the whole batch */
+	for (i = 0; i < ARRAY_SIZE(ras_trace_events); i++) {
+		if (has_trace_event(ras, &ras_trace_events[i]))
+			ev[n++] = ras_trace_events[i];
+		else
+			log(ALL, LOG_INFO, "No %s:%s event on this kernel\n",
+			    ras_trace_events[i].group, ras_trace_events[i].event);
+	}
 
-#ifdef HAVE_DISKERROR
-	rc |= __toggle_ras_mc_event(ras, "block", "block_rq_complete", enable);
-#endif
+	rc = toggle_events(ras, ev, n, enable);
 
 free_ras:
 	free(ras);
 	return rc;
 }
 
+#if defined(HAVE_DEVLINK) || defined(HAVE_DISKERROR)
 /*
  * Set kernel filter. libtrace doesn't provide an API for setting filters
  * in kernel, we have to implement it here.
@@ -272,6 +479,84 @@ static int filter_ras_mc_event(struct ras_events *ras, char *group, char *event,
  * Tracing read code
  */
 
+/*
+ * Kernel filters of the events, so that the records rasdaemon would drop
+ * are not even written to the trace buffers. Each one can be overridden
+ * with RAS_FILTER_<EVENT>, e.g. RAS_FILTER_BLOCK_RQ_COMPLETE, in the
+ * kernel filter syntax. An empty value removes the filter.
+ *
+ * If the kernel refuses a filter, the event is still traced, with
+ * ->fallback evaluated by the handler on each record instead, unless
+ * ->required is set: then the event is not traced at all.
+ */
+static const struct ras_event_filter {
+	const char	*group, *event;
+	const char	*filter;	/* records to keep, kernel syntax */
+	char		*fallback;	/* records to drop, libtrace syntax */
+	unsigned	required:1;
+} ras_event_filters[] = {
+	/* TX timeouts are reported through net_dev_xmit_timeout */
+	{ "devlink", "devlink_health_report", "!(msg ~ \"TX timeout*\")",
+	  "devlink/devlink_health_report:msg=~'TX timeout*'" },
+	/* Every block request completes there */
+	{ "block", "block_rq_complete", "error != 0", NULL, 1 },
+};
+
+/*
+ * Installs the kernel filter of @group:@event. Returns the libtrace filter
+ * to use instead on @fallback, if any, or an error if the event shouldn't
+ * be traced.
+ */
+static int set_event_filter(struct ras_events *ras, char *group, char *event,
+			    char **fallback)
+{
+	const struct ras_event_filter *f = NULL;
+	char env[64], *p;
+	const char *filter;
+	int i, rc;
+
+	*fallback = NULL;
+
+	for (i = 0; i < ARRAY_SIZE(ras_event_filters); i++) {
+		if (!strcmp(ras_event_filters[i].group, group) &&
+		    !strcmp(ras_event_filters[i].event, event)) {
+			f = &ras_event_filters[i];
+			break;
+		}
+	}
+	if (!f)
+		return 0;
+
+	snprintf(env, sizeof(env), "RAS_FILTER_%s", event);
+	for (p = env; *p; p++)
+		*p = toupper(*p);
+	filter = getenv(env);
+	if (filter) {
+		log(ALL, LOG_INFO, "Using %s filter for %s:%s: %s\n",
+		    env, group, event, *filter ? filter : "none");
+	} else {
+		filter = f->filter;
+	}
+
+	/* "0" clears the filter left by a previous run */
+	rc = filter_ras_mc_event(ras, group, event, *filter ? filter : "0");
+	if (!rc)
+		return 0;
+
+	if (f->required) {
+		log(ALL, LOG_ERR, "Can't filter %s:%s on the kernel, not tracing it\n",
+		    group, event);
+		return rc;
+	}
+
+	log(ALL, LOG_INFO, "Can't filter %s:%s on the kernel, filtering it on rasdaemon\n",
+	    group, event);
+	*fallback = f->fallback;
+
+	return 0;
+}
+#endif
+
 static int get_pagesize(struct ras_events *ras, struct pevent *pevent)
 {
 	int fd, len, page_size = 4096;
@@ -295,6 +580,107 @@ error:
 
 }
 
+/*
+ * Lanes: what makes an event urgent, by type, from a single field read
+ * before the event is decoded. Types without a rule here, or whose field
+ * the kernel doesn't have, always take the batched lane.
+ */
+static int mc_urgent(unsigned long long val)
+{
+	return val == HW_EVENT_ERR_UNCORRECTED || val == HW_EVENT_ERR_FATAL;
+}
+
+static int mce_urgent(unsigned long long val)
+{
+	return !!(val & MCI_STATUS_UC);
+}
+
+static int aer_urgent(unsigned long long val)
+{
+	return val != HW_EVENT_AER_CORRECTED;
+}
+
+static int ghes_urgent(unsigned long long val)
+{
+	return val >= GHES_SEV_RECOVERABLE;
+}
+
+/* CPER severities: recoverable, fatal, corrected, informational */
+static int cper_urgent(unsigned long long val)
+{
+	return val <= 1;
+}
+
+static const struct {
+	const char	*field;
+	int		(*urgent)(unsigned long long val);
+} lane_rules[NR_EVENTS] = {
+	[MC_EVENT]		= { "error_type", mc_urgent },
+	[MCE_EVENT]		= { "status", mce_urgent },
+	[AER_EVENT]		= { "severity", aer_urgent },
+	[NON_STANDARD_EVENT]	= { "sev", ghes_urgent },
+	[EXTLOG_EVENT]		= { "sev", cper_urgent },
+};
+
+void ras_lane_init(struct ras_events *ras, int type, struct event_format *event)
+{
+	if (!event || !lane_rules[type].field)
+		return;
+
+	ras->lanes[type].id = event->id;
+	ras->lanes[type].field = pevent_find_field(event,
+						   lane_rules[type].field);
+}
+
+int ras_event_urgent(struct ras_events *ras, void *data)
+{
+	struct pevent_record record = { .data = data };
+	unsigned long long val;
+	int id, type;
+
+	id = pevent_data_type(ras->pevent, &record);
+	for (type = 0; type < NR_EVENTS; type++) {
+		if (!ras->lanes[type].field || ras->lanes[type].id != id)
+			continue;
+		if (pevent_read_number_field(ras->lanes[type].field, data,
+					     &val))
+			return 0;
+		return lane_rules[type].urgent(val);
+	}
+
+	return 0;
+}
+
+__thread int ras_lane_urgent;
+
+int ras_lane_first(struct ras_events *ras, struct ras_lane_page *lp,
+		   struct kbuffer *kbuf, void *data)
+{
+	if (!ras_event_urgent(ras, data))
+		return 0;
+
+	if (lp->nr_urgent < RAS_LANE_PAGE_URGENT)
+		lp->urgent[lp->nr_urgent++] = kbuffer_curr_offset(kbuf);
+	else
+		lp->overflow = 1;
+
+	return 1;
+}
+
+int ras_lane_handled(struct ras_events *ras, struct ras_lane_page *lp,
+		     struct kbuffer *kbuf, void *data)
+{
+	if (lp->next < lp->nr_urgent) {
+		if (kbuffer_curr_offset(kbuf) != lp->urgent[lp->next])
+			return 0;
+		lp->next++;
+		return 1;
+	}
+
+	/* Past the recorded ones, only those that didn't fit are left */
+	return lp->overflow && ras_event_urgent(ras, data);
+}
+
 static void parse_ras_data(struct pthread_data *pdata, struct kbuffer *kbuf,
 			   void *data, unsigned long long time_stamp)
 {
@@ -311,45 +697,133 @@ static void parse_ras_data(struct pthread_data *pdata, struct kbuffer *kbuf,
 	record.missed_events = kbuffer_missed_events(kbuf);
 	record.record_size = kbuffer_curr_size(kbuf);
 
+	RAS_PROBE2(event, record.cpu, record.ts);
+
 	/* TODO - logging */
 	trace_seq_init(&s);
 	pevent_print_event(pdata->ras->pevent, &s, &record);
 	trace_seq_do_printf(&s);
 	printf("\n");
 	fflush(stdout);
+	trace_seq_destroy(&s);
+}
+
+/*
+ * Handles the events of a page by lanes. First the urgent ones, each
+ * committed as soon as it is stored, in a single sync with the events
+ * batched from the previous pages. They get ahead of the other events of
+ * the page, which are then stored and printed after them, in order,
+ * within the batched transaction when @batch.
+ */
+static void parse_ras_page(struct pthread_data *pdata, struct kbuffer *kbuf,
+			   void *page, int batch)
+{
+	struct ras_events *ras = pdata->ras;
+	struct ras_lane_page lp = { .nr_urgent = 0 };
+	unsigned long long time_stamp;
+	int urgent = 0, others = 0;
+	void *data;
+
+	kbuffer_load_subbuffer(kbuf, page);
+	ras_metrics_missed(pdata->cpu, kbuffer_missed_events(kbuf));
+
+	while ((data = kbuffer_read_event(kbuf, &time_stamp))) {
+		if (ras_lane_first(ras, &lp, kbuf, data)) {
+			urgent++;
+			ras_lane_urgent = 1;
+			parse_ras_data(pdata, kbuf, data, time_stamp);
+			ras_lane_urgent = 0;
+			ras_db_commit(ras);
+		} else {
+			others++;
+		}
+
+		/* increment to read next event */
+		kbuffer_next_event(kbuf, NULL);
+	}
+	if (urgent)
+		ras_metrics_add(RAS_METRIC_LANE_URGENT, urgent);
+	if (!others)
+		return;
+
+	/* Back to the first event */
+	kbuffer_load_subbuffer(kbuf, page);
+	while ((data = kbuffer_read_event(kbuf, &time_stamp))) {
+		if (!ras_lane_handled(ras, &lp, kbuf, data)) {
+			if (batch)
+				ras_db_batch(ras);
+			parse_ras_data(pdata, kbuf, data, time_stamp);
+		}
+
+		kbuffer_next_event(kbuf, NULL);
+	}
+	ras_metrics_add(RAS_METRIC_LANE_BATCHED, others);
+
+	if (batch)
+		ras_db_flush(ras, 0);
 }
 
 static int get_num_cpus(struct ras_events *ras)
 {
-	return sysconf(_SC_NPROCESSORS_CONF);
-#if 0
-	char fname[MAX_PATH + 1];
+	char fname[MAX_PATH + sizeof("/per_cpu")];
 	int num_cpus = 0;
 	DIR		*dir;
 	struct dirent	*entry;
 
-	strcpy(fname, ras->debugfs);
-	strcat(fname, "/tracing/per_cpu/");
+	/* A stand-in instance may have any number of cpus */
+	if (!ras_tracefs_root)
+		return sysconf(_SC_NPROCESSORS_CONF);
+
+	snprintf(fname, sizeof(fname), "%s/per_cpu", ras->tracing);
 	dir = opendir(fname);
 	if (!dir)
-		return -1;
+		return sysconf(_SC_NPROCESSORS_CONF);
 
 	for (entry = readdir(dir); entry; entry = readdir(dir)) {
-		if (strstr(entry->d_name, "cpu"))
+		if (!strncmp(entry->d_name, "cpu", 3))
 			num_cpus++;
 	}
 	closedir(dir);
 
 	return num_cpus;
+}
+
+static inline int min_timeout(int a, int b)
+{
+	if (a < 0)
+		return b;
+	if (b < 0)
+		return a;
+	return a < b ? a : b;
+}
+
+/*
+ * Runs the time based work of the handlers, like emitting pending MCE
+ * storm summaries. Returns the poll() timeout until it is needed again.
+ */
+static int ras_periodic(struct ras_events *ras, int force)
+{
+	int timeout = -1;
+
+#ifdef HAVE_MCE
+	timeout = min_timeout(timeout, mce_storm_flush(ras, force));
+#endif
+#ifdef HAVE_AER
+	timeout = min_timeout(timeout, aer_rate_flush(ras, force));
+#endif
+#ifdef HAVE_DISKERROR
+	timeout = min_timeout(timeout, disk_regions_flush(ras, force));
 #endif
+	/* Last, as the ones above may store summaries */
+	timeout = min_timeout(timeout, ras_db_flush(ras, force));
+
+	return timeout;
 }
 
 static int read_ras_event_all_cpus(struct pthread_data *pdata,
 				   unsigned n_cpus)
 {
 	unsigned size;
-	unsigned long long time_stamp;
-	void *data;
 	int ready, i, count_nready;
 	struct kbuffer *kbuf;
 	void *page;
@@ -416,11 +890,15 @@ static int read_ras_event_all_cpus(struct pthread_data *pdata,
 	}
 
 	do {
-		ready = poll(fds, (n_cpus + 1), -1);
+		ready = poll(fds, (n_cpus + 1), ras_periodic(pdata[0].ras, 0));
 		if (ready < 0) {
 			log(TERM, LOG_WARNING, "poll\n");
 		}
 
+		/* timeout: only periodic work to do */
+		if (!ready)
+			continue;
+
 		/* check for the signal */
 		if (fds[n_cpus].revents & POLLIN) {
 			size = read(fds[n_cpus].fd, &fdsiginfo,
@@ -463,15 +941,8 @@ static int read_ras_event_all_cpus(struct pthread_data *pdata,
 				log(TERM, LOG_WARNING, "read\n");
 				goto cleanup;
 			} else if (size > 0) {
-				kbuffer_load_subbuffer(kbuf, page);
-
-				while ((data = kbuffer_read_event(kbuf, &time_stamp))) {
-					parse_ras_data(&pdata[i],
-						       kbuf, data, time_stamp);
-
-					/* increment to read next event */
-					kbuffer_next_event(kbuf, NULL);
-				}
+				RAS_PROBE2(page_read, pdata[i].cpu, size);
+				parse_ras_page(&pdata[i], kbuf, page, 1);
 			} else {
 				count_nready++;
 			}
@@ -497,6 +968,8 @@ static int read_ras_event_all_cpus(struct pthread_data *pdata,
 	    "Old kernel detected. Stop listening and fall back to pthread way.\n");
 
 cleanup:
+	ras_periodic(pdata[0].ras, 1);
+
 	if (pdata[0].ras->record_events)
 		ras_mc_event_closedb(pdata[0].cpu, pdata[0].ras);
 
@@ -521,9 +994,9 @@ static int read_ras_event(int fd,
 			  struct kbuffer *kbuf,
 			  void *page)
 {
-	int size;
-	unsigned long long time_stamp;
-	void *data;
+	int size, timeout = -1;
+	/* The periodic work is shared: the thread of the first cpu does it */
+	int periodic = !pdata->cpu;
 
 	/*
 	 * read() never blocks. We can't call poll() here, as it is
@@ -534,18 +1007,24 @@ static int read_ras_event(int fd,
 		size = read(fd, page, pdata->ras->page_size);
 		if (size < 0) {
 			log(TERM, LOG_WARNING, "read\n");
+			if (periodic)
+				ras_periodic(pdata->ras, 1);
 			return -1;
 		} else if (size > 0) {
-			kbuffer_load_subbuffer(kbuf, page);
+			RAS_PROBE2(page_read, pdata->cpu, size);
+			/* The threads share the database: no batching */
+			parse_ras_page(pdata, kbuf, page, 0);
+		}
 
-			while ((data = kbuffer_read_event(kbuf, &time_stamp))) {
-				parse_ras_data(pdata, kbuf, data, time_stamp);
+		if (periodic)
+			timeout = ras_periodic(pdata->ras, 0);
 
-				/* increment to read next event */
-				kbuffer_next_event(kbuf, NULL);
-			}
-		} else {
-			sleep(POLLING_TIME);
+		if (!size) {
+			/* Wakes up early if the periodic work is due before */
+			if (timeout >= 0 && timeout < POLLING_TIME * 1000)
+				usleep(timeout * 1000);
+			else
+				sleep(POLLING_TIME);
 		}
 	} while (1);
 }
@@ -673,6 +1152,31 @@ static int select_tracing_timestamp(struct ras_events *ras)
 	return 0;
 }
 
+/* A handler and its event type, for the metrics */
+struct ras_event_handler {
+	struct ras_event_handler	*next;
+	struct ras_events		*ras;
+	pevent_event_handler_func	func;
+	int				type;
+	struct ras_trace_event		ev;
+	unsigned			ready: 1;	/* to be enabled */
+};
+
+static int ras_event_handler(struct trace_seq *s, struct pevent_record *record,
+			     struct event_format *event, void *context)
+{
+	struct ras_event_handler *h = context;
+	uint64_t start = ras_metrics_now();
+	int rc;
+
+	RAS_PROBE2(handler_entry, h->type, record->cpu);
+	rc = h->func(s, record, event, h->ras);
+	RAS_PROBE3(handler_exit, h->type, record->cpu, rc);
+	ras_metrics_event(h->type, record->cpu, rc, start);
+
+	return rc;
+}
+
 static int add_event_handler(struct ras_events *ras, struct pevent *pevent,
 			     unsigned page_size, char *group, char *event,
 			     pevent_event_handler_func func, char *filter_str, int id)
@@ -680,6 +1184,7 @@ static int add_event_handler(struct ras_events *ras, struct pevent *pevent,
 	int fd, size, rc;
 	char *page, fname[MAX_PATH + 1];
 	struct event_filter * filter = NULL;
+	struct ras_event_handler *h;
 
 	snprintf(fname, sizeof(fname), "events/%s/%s/format", group, event);
 
@@ -708,8 +1213,24 @@ static int add_event_handler(struct ras_events *ras, struct pevent *pevent,
 		return size;
 	}
 
+	h = calloc(1, sizeof(*h));
+	if (!h) {
+		log(TERM, LOG_ERR, "Can't allocate handler for %s:%s\n",
+		    group, event);
+		free(page);
+		return ENOMEM;
+	}
+	h->ras = ras;
+	h->func = func;
+	h->type = id;
+	h->ev.group = group;
+	h->ev.event = event;
+	h->next = ras->handlers;
+	ras->handlers = h;
+
 	/* Registers the special event handlers */
-	rc = pevent_register_event_handler(pevent, -1, group, event, func, ras);
+	rc = pevent_register_event_handler(pevent, -1, group, event,
+					   ras_event_handler, h);
 	if (rc == PEVENT_ERRNO__MEM_ALLOC_FAILED) {
 		log(TERM, LOG_ERR, "Can't register event handler for %s:%s\n",
 		    group, event);
@@ -717,7 +1238,7 @@ static int add_event_handler(struct ras_events *ras, struct pevent *pevent,
 		return EINVAL;
 	}
 
-	rc = pevent_parse_event(pevent, page, size, group);
+	rc = ras_format_cache_parse(pevent, group, event, page, size);
 	if (rc) {
 		log(TERM, LOG_ERR, "Can't parse event %s:%s\n", group, event);
 		free(page);
@@ -745,20 +1266,98 @@ static int add_event_handler(struct ras_events *ras, struct pevent *pevent,
 	}
 
 	ras->filters[id] = filter;
-
-	/* Enable RAS events */
-	rc = __toggle_ras_mc_event(ras, group, event, 1);
+	ras_lane_init(ras, id, pevent_find_event_by_name(pevent, group, event));
 	free(page);
-	if (rc < 0) {
-		log(TERM, LOG_ERR, "Can't enable %s:%s tracing\n",
-		    group, event);
 
-		return EINVAL;
+	/* Enabled along with the others, by enable_ras_events() */
+	h->ready = 1;
+
+	return 0;
+}
+
+/* The events of the handlers added, in the order they were added */
+static struct ras_trace_event *ready_events(struct ras_events *ras, int *n)
+{
+	struct ras_trace_event *ev;
+	struct ras_event_handler *h;
+	int i;
+
+	*n = 0;
+	for (h = ras->handlers; h; h = h->next)
+		*n += h->ready;
+
+	ev = calloc(*n ? *n : 1, sizeof(*ev));
+	if (!ev)
+		return NULL;
+
+	/* The list has the last one added first */
+	i = *n;
+	for (h = ras->handlers; h; h = h->next) {
+		if (h->ready)
+			ev[--i] = h->ev;
 	}
 
-	log(ALL, LOG_INFO, "Enabled event %s:%s\n", group, event);
+	return ev;
+}
+
+/* Enables the events of all the handlers added, or none of them */
+static int enable_ras_events(struct ras_events *ras)
+{
+	struct ras_trace_event *ev;
+	int n, rc;
 
-	return 0;
+	ev = ready_events(ras, &n);
+	if (!ev)
+		return ENOMEM;
+
+	rc = toggle_events(ras, ev, n, 1);
+	free(ev);
+	if (!rc)
+		ras->events_enabled = 1;
+
+	return rc;
+}
+
+static void disable_ras_events(struct ras_events *ras)
+{
+	struct ras_trace_event *ev;
+	int fd, n;
+
+	/*
+	 * On an instance of our own, truncating set_event disables all of
+	 * them at once. On the top level, other tracers' events are left
+	 * alone.
+	 */
+	if (ras->instance) {
+		fd = open_trace(ras, "set_event", O_WRONLY | O_TRUNC);
+		if (fd >= 0) {
+			close(fd);
+			log(ALL, LOG_INFO, "Disabled the RAS events\n");
+			return;
+		}
+	}
+
+	ev = ready_events(ras, &n);
+	if (!ev)
+		return;
+	toggle_events(ras, ev, n, 0);
+	free(ev);
+}
+
+/*
+ * Once daemonized, stdout goes to /dev/null: there is no point on
+ * rendering text nobody will read.
+ */
+static int has_text_output(void)
+{
+	struct stat out, null;
+
+	if (fstat(STDOUT_FILENO, &out) < 0)
+		return 0;
+	if (!S_ISCHR(out.st_mode) || stat("/dev/null", &null) < 0)
+		return 1;
+
+	return out.st_rdev != null.st_rdev;
 }
 
 int handle_ras_events(int record_events)
@@ -769,7 +1368,7 @@ int handle_ras_events(int record_events)
 	struct pevent *pevent = NULL;
 	struct pthread_data *data = NULL;
 	struct ras_events *ras = NULL;
-#ifdef HAVE_DEVLINK
+#if defined(HAVE_DEVLINK) || defined(HAVE_DISKERROR)
 	char *filter_str = NULL;
 #endif
 
@@ -781,10 +1380,13 @@ int handle_ras_events(int record_events)
 
 	rc = get_tracing_dir(ras);
 	if (rc < 0) {
-		log(TERM, LOG_ERR, "Can't locate a mounted debugfs\n");
+		log(TERM, LOG_ERR, "Can't locate a mounted tracefs\n");
 		goto err;
 	}
 
+	if (ras->old_instance)
+		reset_tracing_instance(ras);
+
 	rc = select_tracing_timestamp(ras);
 	if (rc < 0) {
 		log(TERM, LOG_ERR, "Can't select a timestamp for tracing\n");
@@ -803,12 +1405,21 @@ int handle_ras_events(int record_events)
 	ras->pevent = pevent;
 	ras->page_size = page_size;
 	ras->record_events = record_events;
+	ras->text_output = has_text_output();
+
+	cpus = get_num_cpus(ras);
+
+	/* Not fatal: events are still logged and stored */
+	ras_metrics_init(cpus);
+	ras_stream_init(ras);
 
 #ifdef HAVE_MEMORY_CE_PFA
 	/* FIXME: enable memory isolation unconditionally */
 	ras_page_account_init();
 #endif
 
+	ras_format_cache_load();
+
 	rc = add_event_handler(ras, pevent, page_size, "ras", "mc_event",
 			       ras_mc_event_handler, NULL, MC_EVENT);
 	if (!rc)
@@ -818,6 +1429,7 @@ int handle_ras_events(int record_events)
 		    "ras", "mc_event");
 
 #ifdef HAVE_AER
+	ras->aer_rate = aer_rate_init();
 	rc = add_event_handler(ras, pevent, page_size, "ras", "aer_event",
 			       ras_aer_event_handler, NULL, AER_EVENT);
 	if (!rc)
@@ -847,8 +1459,6 @@ int handle_ras_events(int record_events)
 		    "ras", "arm_event");
 #endif
 
-	cpus = get_num_cpus(ras);
-
 #ifdef HAVE_MCE
 	rc = register_mce_handler(ras, cpus);
 	if (rc)
@@ -881,8 +1491,12 @@ int handle_ras_events(int record_events)
 	rc = add_event_handler(ras, pevent, page_size, "net",
 			       "net_dev_xmit_timeout",
 			       ras_net_xmit_timeout_handler, NULL, DEVLINK_EVENT);
+	/* Otherwise, TX timeouts are only reported by devlink */
 	if (!rc)
-		filter_str = "devlink/devlink_health_report:msg=~\'TX timeout*\'";
+		set_event_filter(ras, "devlink", "devlink_health_report",
+				 &filter_str);
+	else
+		filter_ras_mc_event(ras, "devlink", "devlink_health_report", "0");
 
 	rc = add_event_handler(ras, pevent, page_size, "devlink",
 			       "devlink_health_report",
@@ -895,11 +1509,13 @@ int handle_ras_events(int record_events)
 #endif
 
 #ifdef HAVE_DISKERROR
-	rc = filter_ras_mc_event(ras, "block", "block_rq_complete", "error != 0");
+	rc = set_event_filter(ras, "block", "block_rq_complete", &filter_str);
 	if (!rc) {
+		ras->disk_regions = disk_regions_init();
+		ras->blkdev = blkdev_cache_init();
 		rc = add_event_handler(ras, pevent, page_size, "block",
 				       "block_rq_complete", ras_diskerror_event_handler,
-					NULL, DISKERROR_EVENT);
+					filter_str, DISKERROR_EVENT);
 		if (!rc)
 			num_events++;
 		else
@@ -908,6 +1524,14 @@ int handle_ras_events(int record_events)
 	}
 #endif
 
+	ras_format_cache_save();
+
+	/* All parsed: they can be enabled at once */
+	if (num_events && enable_ras_events(ras)) {
+		log(ALL, LOG_ERR, "Can't enable the RAS events\n");
+		num_events = 0;
+	}
+
 	if (!num_events) {
 		log(ALL, LOG_INFO,
 		    "Failed to trace all supported RAS events. Aborting.\n");
@@ -952,6 +1576,9 @@ int handle_ras_events(int record_events)
 	log(SYSLOG, LOG_INFO, "Huh! something got wrong. Aborting.\n");
 
 err:
+	if (ras && ras->events_enabled)
+		disable_ras_events(ras);
+
 	if (data)
 		free(data);
 
@@ -963,6 +1590,25 @@ err:
 			if (ras->filters[i])
 				pevent_filter_free(ras->filters[i]);
 		}
+		ras_report_exit();
+		ras_stream_exit(ras);
+		ras_metrics_exit();
+		while (ras->handlers) {
+			struct ras_event_handler *h = ras->handlers;
+
+			ras->handlers = h->next;
+			free(h);
+		}
+#ifdef HAVE_MCE
+		unregister_mce_handler(ras);
+#endif
+#ifdef HAVE_AER
+		aer_rate_free(ras->aer_rate);
+#endif
+#ifdef HAVE_DISKERROR
+		disk_regions_free(ras->disk_regions);
+		blkdev_cache_free(ras->blkdev);
+#endif
 		free(ras);
 	}
 
@@ -28,6 +28,9 @@
 #define STR(x) #x
 
 struct mce_priv;
+struct event_format;
+struct format_field;
+struct kbuffer;
 
 enum {
 	MC_EVENT,
@@ -42,7 +45,6 @@ enum {
 };
 
 struct ras_events {
-	char debugfs[MAX_PATH + 1];
 	char tracing[MAX_PATH + 1];
 	struct pevent	*pevent;
 	int		page_size;
@@ -50,6 +52,10 @@ struct ras_events {
 	/* Booleans */
 	unsigned	use_uptime: 1;
 	unsigned        record_events: 1;
+	unsigned	text_output: 1;		/* stdout is not /dev/null */
+	unsigned	instance: 1;		/* ours, not the top level */
+	unsigned	old_instance: 1;	/* left by a previous run */
+	unsigned	events_enabled: 1;
 
 	/* For timestamp */
 	time_t		uptime_diff;
@@ -60,10 +66,29 @@ struct ras_events {
 	/* For the mce handler */
 	struct mce_priv	*mce_priv;
 
+	/* For the aer handler */
+	struct aer_rate	*aer_rate;
+
+	/* For the diskerror handler */
+	struct disk_regions *disk_regions;
+	struct blkdev_cache *blkdev;
+
+	/* Handlers registered on pevent, see add_event_handler() */
+	struct ras_event_handler *handlers;
+
+	/* For the event stream socket */
+	struct ras_stream *stream;
+
 	/* For ABRT socket*/
 	int socketfd;
 
 	struct event_filter *filters[NR_EVENTS];
+
+	/* The field telling if an event is urgent, see ras_event_urgent() */
+	struct {
+		int			id;
+		struct format_field	*field;
+	} lanes[NR_EVENTS];
 };
 
 struct pthread_data {
@@ -98,7 +123,39 @@ enum ghes_severity {
 };
 
 /* Function prototypes */
+/* Short names of the event types, for the stream and the metrics */
+extern const char *ras_event_names[NR_EVENTS];
+
+/* Tracing instance to use instead of looking for one, e. g. a fake one */
+extern const char *ras_tracefs_root;
+
 int toggle_ras_mc_event(int enable);
+
+/* Lanes: uncorrected and fatal errors bypass the batching of the others */
+void ras_lane_init(struct ras_events *ras, int type, struct event_format *event);
+int ras_event_urgent(struct ras_events *ras, void *data);
+
+/* Set while this thread handles an urgent event, for its report */
+extern __thread int ras_lane_urgent;
+
+/*
+ * The urgent events of a page, by offset, so that the second pass over
+ * the page doesn't classify its events again
+ */
+#define RAS_LANE_PAGE_URGENT	32
+
+struct ras_lane_page {
+	int		urgent[RAS_LANE_PAGE_URGENT];
+	int		nr_urgent, next;
+	unsigned	overflow:1;	/* some urgent events weren't recorded */
+};
+
+/* First pass: whether the event at @kbuf is urgent, recording it if so */
+int ras_lane_first(struct ras_events *ras, struct ras_lane_page *lp,
+		   struct kbuffer *kbuf, void *data);
+/* Second pass: whether the event at @kbuf was handled by the first one */
+int ras_lane_handled(struct ras_events *ras, struct ras_lane_page *lp,
+		     struct kbuffer *kbuf, void *data);
 int handle_ras_events(int record_events);
 
 #endif
@@ -27,6 +27,8 @@
 #include "ras-record.h"
 #include "ras-logger.h"
 #include "ras-report.h"
+#include "ras-stream.h"
+#include "ras-format.h"
 
 static char *err_type(int etype)
 {
@@ -102,85 +104,72 @@ struct cper_mem_err_compact {
 	unsigned short		mem_dev_handle;
 };
 
-static char *err_cper_data(const char *c)
+static char *err_cper_data(const char *c, char *buf, size_t size)
 {
 	const struct cper_mem_err_compact *cpd = (struct cper_mem_err_compact *)c;
-	static char buf[256];
-	char *p = buf;
+	char *p = buf, *end = buf + size;
 
+#define CPER_PRINTF(fmt, ...)						\
+	do {								\
+		if (p < end)						\
+			p += snprintf(p, end - p, fmt, __VA_ARGS__);	\
+	} while (0)
+
+	*buf = '\0';
 	if (cpd->validation_bits == 0)
-		return "";
-	p += sprintf(p, " (");
+		return buf;
+	CPER_PRINTF("%s", " (");
 	if (cpd->validation_bits & CPER_MEM_VALID_NODE)
-		p += sprintf(p, "node: %d ", cpd->node);
+		CPER_PRINTF("node: %d ", cpd->node);
 	if (cpd->validation_bits & CPER_MEM_VALID_CARD)
-		p += sprintf(p, "card: %d ", cpd->card);
+		CPER_PRINTF("card: %d ", cpd->card);
 	if (cpd->validation_bits & CPER_MEM_VALID_MODULE)
-		p += sprintf(p, "module: %d ", cpd->module);
+		CPER_PRINTF("module: %d ", cpd->module);
 	if (cpd->validation_bits & CPER_MEM_VALID_BANK)
-		p += sprintf(p, "bank: %d ", cpd->bank);
+		CPER_PRINTF("bank: %d ", cpd->bank);
 	if (cpd->validation_bits & CPER_MEM_VALID_DEVICE)
-		p += sprintf(p, "device: %d ", cpd->device);
+		CPER_PRINTF("device: %d ", cpd->device);
 	if (cpd->validation_bits & CPER_MEM_VALID_ROW)
-		p += sprintf(p, "row: %d ", cpd->row);
+		CPER_PRINTF("row: %d ", cpd->row);
 	if (cpd->validation_bits & CPER_MEM_VALID_COLUMN)
-		p += sprintf(p, "column: %d ", cpd->column);
+		CPER_PRINTF("column: %d ", cpd->column);
 	if (cpd->validation_bits & CPER_MEM_VALID_BIT_POSITION)
-		p += sprintf(p, "bit_pos: %d ", cpd->bit_pos);
+		CPER_PRINTF("bit_pos: %d ", cpd->bit_pos);
 	if (cpd->validation_bits & CPER_MEM_VALID_REQUESTOR_ID)
-		p += sprintf(p, "req_id: 0x%llx ", cpd->requestor_id);
+		CPER_PRINTF("req_id: 0x%llx ", cpd->requestor_id);
 	if (cpd->validation_bits & CPER_MEM_VALID_RESPONDER_ID)
-		p += sprintf(p, "resp_id: 0x%llx ", cpd->responder_id);
+		CPER_PRINTF("resp_id: 0x%llx ", cpd->responder_id);
 	if (cpd->validation_bits & CPER_MEM_VALID_TARGET_ID)
-		p += sprintf(p, "tgt_id: 0x%llx ", cpd->target_id);
+		CPER_PRINTF("tgt_id: 0x%llx ", cpd->target_id);
 	if (cpd->validation_bits & CPER_MEM_VALID_RANK_NUMBER)
-		p += sprintf(p, "rank: %d ", cpd->rank);
+		CPER_PRINTF("rank: %d ", cpd->rank);
 	if (cpd->validation_bits & CPER_MEM_VALID_CARD_HANDLE)
-		p += sprintf(p, "card_handle: %d ", cpd->mem_array_handle);
+		CPER_PRINTF("card_handle: %d ", cpd->mem_array_handle);
 	if (cpd->validation_bits & CPER_MEM_VALID_MODULE_HANDLE)
-		p += sprintf(p, "module_handle: %d ", cpd->mem_dev_handle);
-	p += sprintf(p-1, ")");
-
-	return buf;
-}
+		CPER_PRINTF("module_handle: %d ", cpd->mem_dev_handle);
+#undef CPER_PRINTF
 
-static char *uuid_le(const char *uu)
-{
-	static char uuid[sizeof("xxxxxxxx-xxxx-xxxx-xxxx-xxxxxxxxxxxx")];
-	char *p = uuid;
-	int i;
-	static const unsigned char le[16] = {3,2,1,0,5,4,7,6,8,9,10,11,12,13,14,15};
-
-	for (i = 0; i < 16; i++) {
-		p += sprintf(p, "%.2x", uu[le[i]]);
-		switch (i) {
-		case 3:
-		case 5:
-		case 7:
-		case 9:
-			*p++ = '-';
-			break;
-		}
-	}
+	/* Replaces the trailing space */
+	if (p < end)
+		snprintf(p - 1, end - p + 1, ")");
 
-	*p = 0;
-
-	return uuid;
+	return buf;
 }
 
-
 static void report_extlog_mem_event(struct ras_events *ras,
 				    struct pevent_record *record,
 				    struct trace_seq *s,
 				    struct ras_extlog_event *ev)
 {
+	char cper[256], uuid[RAS_UUID_STR_LEN];
+
 	trace_seq_printf(s, "%d %s error: %s physical addr: 0x%llx mask: 0x%llx%s %s %s",
 		ev->error_seq, err_severity(ev->severity),
 		err_type(ev->etype), ev->address,
 		err_mask(ev->pa_mask_lsb),
-		err_cper_data(ev->cper_data),
+		err_cper_data(ev->cper_data, cper, sizeof(cper)),
 		ev->fru_text,
-		uuid_le(ev->fru_id));
+		ras_uuid_le((const uint8_t *)ev->fru_id, uuid));
 }
 
 int ras_extlog_mem_event_handler(struct trace_seq *s,
@@ -242,5 +231,7 @@ int ras_extlog_mem_event_handler(struct trace_seq *s,
 
 	ras_store_extlog_mem_record(ras, &ev);
 
+	ras_stream_extlog_event(ras, &ev);
+
 	return 0;
 }
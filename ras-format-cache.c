@@ -0,0 +1,526 @@
+/*
+ * Copyright (c) Huawei Technologies Co., Ltd. 2026. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#include <elf.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/utsname.h>
+#include "config.h"
+#include "ras-format-cache.h"
+#include "ras-logger.h"
+
+#define FORMAT_CACHE		RASSTATEDIR "/formats.cache"
+#define FORMAT_CACHE_MAGIC	"rasdaemon-formats 1\n"
+#define FORMAT_CACHE_LINE	1024
+
+struct fmt_field {
+	char		*type;
+	char		*name;
+	int		offset;
+	int		size;
+	unsigned int	arraylen;
+	unsigned int	elementsize;
+	unsigned long	flags;
+};
+
+struct fmt_entry {
+	struct fmt_entry	*next;
+	char			*system;
+	char			*name;
+	uint64_t		hash;		/* of the format text */
+	unsigned long		size;
+	int			id;
+	int			flags;
+	int			nr_common;
+	int			nr_fields;
+	struct fmt_field	*fields;	/* common ones first */
+	int			used;
+};
+
+static struct fmt_entry *entries;
+static char kernel_key[FORMAT_CACHE_LINE];
+static const char *cache_file;
+static int dirty;
+
+static uint64_t fnv1a(const char *buf, unsigned long size)
+{
+	uint64_t h = 0xcbf29ce484222325ULL;
+
+	while (size--) {
+		h ^= (unsigned char)*buf++;
+		h *= 0x100000001b3ULL;
+	}
+
+	return h;
+}
+
+/* GNU build ID of the running kernel, from its ELF notes */
+static void kernel_build_id(char *id, size_t len)
+{
+	unsigned char notes[4096];
+	Elf64_Nhdr nh;
+	size_t off = 0, name, desc, end, i;
+	ssize_t n;
+	int fd;
+
+	snprintf(id, len, "-");
+
+	fd = open("/sys/kernel/notes", O_RDONLY);
+	if (fd < 0)
+		return;
+	n = read(fd, notes, sizeof(notes));
+	close(fd);
+	if (n <= 0)
+		return;
+
+	while (off + sizeof(nh) <= (size_t)n) {
+		memcpy(&nh, notes + off, sizeof(nh));
+		name = off + sizeof(nh);
+		desc = name + ((nh.n_namesz + 3) & ~3);
+		end = desc + ((nh.n_descsz + 3) & ~3);
+		if (end > (size_t)n)
+			return;
+
+		if (nh.n_type == NT_GNU_BUILD_ID && nh.n_namesz == 4 &&
+		    !memcmp(notes + name, "GNU", 4)) {
+			for (i = 0; i < nh.n_descsz && 2 * i + 3 <= len; i++)
+				sprintf(id + 2 * i, "%02x", notes[desc + i]);
+			return;
+		}
+		off = end;
+	}
+}
+
+static void free_entry(struct fmt_entry *e)
+{
+	int i;
+
+	for (i = 0; e->fields && i < e->nr_common + e->nr_fields; i++) {
+		free(e->fields[i].type);
+		free(e->fields[i].name);
+	}
+	free(e->fields);
+	free(e->system);
+	free(e->name);
+	free(e);
+}
+
+static void free_entries(void)
+{
+	struct fmt_entry *e;
+
+	while (entries) {
+		e = entries;
+		entries = e->next;
+		free_entry(e);
+	}
+}
+
+static int read_field(FILE *f, struct fmt_field *field)
+{
+	char line[FORMAT_CACHE_LINE], name[FORMAT_CACHE_LINE];
+	int type;
+
+	if (!fgets(line, sizeof(line), f) || !strchr(line, '\n'))
+		return -1;
+	*strchr(line, '\n') = '\0';
+
+	/* The type, which may have spaces, is the rest of the line */
+	if (sscanf(line, "field %d %d %u %u %lx %s %n", &field->offset,
+		   &field->size, &field->arraylen, &field->elementsize,
+		   &field->flags, name, &type) != 6 || !line[type])
+		return -1;
+
+	field->name = strdup(name);
+	field->type = strdup(line + type);
+	if (!field->name || !field->type)
+		return -1;
+
+	return 0;
+}
+
+static struct fmt_entry *read_entry(FILE *f, const char *line)
+{
+	char system[FORMAT_CACHE_LINE], name[FORMAT_CACHE_LINE];
+	struct fmt_entry *e;
+	int i;
+
+	e = calloc(1, sizeof(*e));
+	if (!e)
+		return NULL;
+
+	if (sscanf(line, "event %s %s %" SCNx64 " %lu %d %x %d %d",
+		   system, name, &e->hash, &e->size, &e->id, &e->flags,
+		   &e->nr_common, &e->nr_fields) != 8 ||
+	    e->nr_common < 0 || e->nr_fields < 0)
+		goto err;
+
+	e->system = strdup(system);
+	e->name = strdup(name);
+	e->fields = calloc(e->nr_common + e->nr_fields + 1,
+			   sizeof(*e->fields));
+	if (!e->system || !e->name || !e->fields)
+		goto err;
+
+	for (i = 0; i < e->nr_common + e->nr_fields; i++) {
+		if (read_field(f, &e->fields[i]))
+			goto err;
+	}
+
+	return e;
+
+err:
+	free_entry(e);
+	return NULL;
+}
+
+void ras_format_cache_load(void)
+{
+	char line[FORMAT_CACHE_LINE];
+	struct utsname uts;
+	struct fmt_entry *e;
+	char id[2 * 64 + 1];
+	int n = 0;
+	FILE *f;
+
+	cache_file = getenv("RAS_FORMAT_CACHE");
+	if (!cache_file)
+		cache_file = FORMAT_CACHE;
+	if (!*cache_file)
+		return;
+
+	if (uname(&uts) < 0) {
+		cache_file = "";
+		return;
+	}
+	kernel_build_id(id, sizeof(id));
+	snprintf(kernel_key, sizeof(kernel_key), "kernel %s %s %s %s\n",
+		 id, uts.machine, uts.release, uts.version);
+
+	/* Rewritten unless all of it is found valid, and used */
+	dirty = 1;
+
+	f = fopen(cache_file, "r");
+	if (!f)
+		return;
+
+	if (!fgets(line, sizeof(line), f) || strcmp(line, FORMAT_CACHE_MAGIC) ||
+	    !fgets(line, sizeof(line), f) || strcmp(line, kernel_key)) {
+		log(ALL, LOG_INFO, "Discarding the event formats cached on %s\n",
+		    cache_file);
+		fclose(f);
+		return;
+	}
+
+	while (fgets(line, sizeof(line), f)) {
+		e = read_entry(f, line);
+		if (!e) {
+			log(ALL, LOG_WARNING, "Corrupted event formats cache %s\n",
+			    cache_file);
+			free_entries();
+			fclose(f);
+			return;
+		}
+		e->next = entries;
+		entries = e;
+		n++;
+	}
+	fclose(f);
+
+	dirty = 0;
+	log(ALL, LOG_DEBUG, "%d event formats cached on %s\n", n, cache_file);
+}
+
+static struct fmt_entry *find_entry(const char *sys, const char *name)
+{
+	struct fmt_entry *e;
+
+	for (e = entries; e; e = e->next) {
+		if (!strcmp(e->system, sys) && !strcmp(e->name, name))
+			return e;
+	}
+
+	return NULL;
+}
+
+static struct format_field *new_field(struct event_format *event,
+				      const struct fmt_field *f)
+{
+	struct format_field *field;
+
+	field = calloc(1, sizeof(*field));
+	if (!field)
+		return NULL;
+
+	field->event = event;
+	field->type = strdup(f->type);
+	field->name = strdup(f->name);
+	field->offset = f->offset;
+	field->size = f->size;
+	field->arraylen = f->arraylen;
+	field->elementsize = f->elementsize;
+	field->flags = f->flags;
+	if (!field->type || !field->name) {
+		free(field->type);
+		free(field->name);
+		free(field);
+		return NULL;
+	}
+
+	return field;
+}
+
+static struct event_format *new_event(const struct fmt_entry *e)
+{
+	struct format_field **common, **fields, **next;
+	struct event_format *event;
+	int i;
+
+	event = calloc(1, sizeof(*event));
+	if (!event)
+		return NULL;
+
+	/* Nothing is printed past what the handler does */
+	event->flags = e->flags;
+	event->id = e->id;
+	event->name = strdup(e->name);
+	event->system = strdup(e->system);
+	event->print_fmt.format = strdup("");
+	if (!event->name || !event->system || !event->print_fmt.format)
+		goto err;
+
+	event->format.nr_common = e->nr_common;
+	event->format.nr_fields = e->nr_fields;
+	common = &event->format.common_fields;
+	fields = &event->format.fields;
+	for (i = 0; i < e->nr_common + e->nr_fields; i++) {
+		next = i < e->nr_common ? common : fields;
+		*next = new_field(event, &e->fields[i]);
+		if (!*next)
+			goto err;
+		if (i < e->nr_common)
+			common = &(*next)->next;
+		else
+			fields = &(*next)->next;
+	}
+
+	return event;
+
+err:
+	pevent_free_format(event);
+	return NULL;
+}
+
+/*
+ * Checks an entry against what is known of the running kernel: the fields
+ * fit on the largest record of a sub-buffer, the common ones being those
+ * of the events already parsed, so the first one never comes from here.
+ */
+static int entry_valid(struct pevent *pevent, const struct fmt_entry *e)
+{
+	const struct format_field *common;
+	const struct fmt_field *f;
+	int i, end = 0;
+
+	if (!pevent->nr_events)
+		return 0;
+	common = pevent->events[0]->format.common_fields;
+
+	for (i = 0; i < e->nr_common + e->nr_fields; i++) {
+		f = &e->fields[i];
+		if (f->offset < 0 || f->size < 0 ||
+		    f->offset + f->size > pevent->header_page_data_size)
+			return 0;
+
+		if (i >= e->nr_common) {
+			if (f->offset < end)
+				return 0;
+			continue;
+		}
+		if (!common || strcmp(common->name, f->name) ||
+		    common->offset != f->offset || common->size != f->size)
+			return 0;
+		common = common->next;
+		if (f->offset + f->size > end)
+			end = f->offset + f->size;
+	}
+
+	return !common;
+}
+
+static struct fmt_entry *new_entry(struct event_format *event, uint64_t hash,
+				   unsigned long size)
+{
+	struct format_field *list[2] = { event->format.common_fields,
+					 event->format.fields };
+	struct format_field *field;
+	struct fmt_entry *e;
+	int i = 0, j;
+
+	e = calloc(1, sizeof(*e));
+	if (!e)
+		return NULL;
+
+	e->system = strdup(event->system);
+	e->name = strdup(event->name);
+	e->hash = hash;
+	e->size = size;
+	e->id = event->id;
+	e->flags = event->flags;
+	e->nr_common = event->format.nr_common;
+	e->nr_fields = event->format.nr_fields;
+	e->fields = calloc(e->nr_common + e->nr_fields + 1, sizeof(*e->fields));
+	if (!e->system || !e->name || !e->fields)
+		goto err;
+
+	for (j = 0; j < 2; j++) {
+		for (field = list[j]; field; field = field->next) {
+			if (i == e->nr_common + e->nr_fields)
+				goto err;
+			e->fields[i].type = strdup(field->type);
+			e->fields[i].name = strdup(field->name);
+			if (!e->fields[i].type || !e->fields[i].name)
+				goto err;
+			e->fields[i].offset = field->offset;
+			e->fields[i].size = field->size;
+			e->fields[i].arraylen = field->arraylen;
+			e->fields[i].elementsize = field->elementsize;
+			e->fields[i].flags = field->flags;
+			i++;
+		}
+	}
+
+	return e;
+
+err:
+	free_entry(e);
+	return NULL;
+}
+
+int ras_format_cache_parse(struct pevent *pevent, const char *sys,
+			   const char *name, const char *buf,
+			   unsigned long size)
+{
+	struct event_format *event;
+	struct fmt_entry *e;
+	uint64_t hash;
+	int rc;
+
+	if (!cache_file || !*cache_file)
+		return pevent_parse_event(pevent, buf, size, sys);
+
+	hash = fnv1a(buf, size);
+	e = find_entry(sys, name);
+	if (e && e->hash == hash && e->size == size && entry_valid(pevent, e)) {
+		event = new_event(e);
+		if (event && !pevent_add_event(pevent, event)) {
+			e->used = 1;
+			return 0;
+		}
+		if (event)
+			pevent_free_format(event);
+	}
+
+	rc = pevent_parse_event(pevent, buf, size, sys);
+	if (rc)
+		return rc;
+
+	/* Not fatal: it will be parsed again next time */
+	event = pevent_find_event_by_name(pevent, sys, name);
+	if (!event)
+		return 0;
+
+	if (e) {
+		e->used = 0;
+		e->hash = 0;
+	}
+	e = new_entry(event, hash, size);
+	if (e) {
+		e->used = 1;
+		e->next = entries;
+		entries = e;
+	}
+	dirty = 1;
+
+	return 0;
+}
+
+void ras_format_cache_save(void)
+{
+	char tmp[FORMAT_CACHE_LINE];
+	struct fmt_field *field;
+	struct fmt_entry *e;
+	int i, fd;
+	FILE *f;
+
+	if (!cache_file || !*cache_file)
+		goto out;
+
+	/* Entries for events no longer handled are dropped */
+	for (e = entries; e; e = e->next) {
+		if (!e->used)
+			dirty = 1;
+	}
+	if (!dirty)
+		goto out;
+
+	snprintf(tmp, sizeof(tmp), "%s.XXXXXX", cache_file);
+	fd = mkstemp(tmp);
+	if (fd < 0) {
+		log(ALL, LOG_DEBUG, "Can't write the event formats cache %s\n",
+		    cache_file);
+		goto out;
+	}
+	f = fdopen(fd, "w");
+	if (!f) {
+		close(fd);
+		unlink(tmp);
+		goto out;
+	}
+
+	fputs(FORMAT_CACHE_MAGIC, f);
+	fputs(kernel_key, f);
+	for (e = entries; e; e = e->next) {
+		if (!e->used)
+			continue;
+		fprintf(f, "event %s %s %016" PRIx64 " %lu %d %x %d %d\n",
+			e->system, e->name, e->hash, e->size, e->id, e->flags,
+			e->nr_common, e->nr_fields);
+		for (i = 0; i < e->nr_common + e->nr_fields; i++) {
+			field = &e->fields[i];
+			fprintf(f, "field %d %d %u %u %lx %s %s\n",
+				field->offset, field->size, field->arraylen,
+				field->elementsize, field->flags, field->name,
+				field->type);
+		}
+	}
+
+	if (fclose(f) || rename(tmp, cache_file)) {
+		log(ALL, LOG_WARNING, "Can't write the event formats cache %s\n",
+		    cache_file);
+		unlink(tmp);
+	}
+
+out:
+	free_entries();
+	dirty = 0;
+}
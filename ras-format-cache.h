@@ -0,0 +1,42 @@
+/*
+ * Copyright (c) Huawei Technologies Co., Ltd. 2026. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#ifndef __RAS_FORMAT_CACHE_H
+#define __RAS_FORMAT_CACHE_H
+
+#include "libtrace/event-parse.h"
+
+/*
+ * Cache of the parsed event formats, on RAS_FORMAT_CACHE, so that the
+ * format files don't need to be parsed again at each start. An entry is
+ * only used if both the running kernel (uname and build ID) and the
+ * format text, by its hash, are the ones it was made from, and if its
+ * fields fit the records of the running kernel.
+ *
+ * Only the fields are kept: events added from the cache have an empty
+ * print format, which the handlers of rasdaemon don't need.
+ */
+
+void ras_format_cache_load(void);
+void ras_format_cache_save(void);
+
+int ras_format_cache_parse(struct pevent *pevent, const char *sys,
+			   const char *name, const char *buf,
+			   unsigned long size);
+
+#endif
@@ -0,0 +1,106 @@
+/*
+ * Copyright (c) Huawei Technologies Co., Ltd. 2026. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#include "ras-format.h"
+
+static const char hex_digits[16] = "0123456789abcdef";
+
+static inline char *put_hex8(char *p, uint8_t val)
+{
+	*p++ = hex_digits[val >> 4];
+	*p++ = hex_digits[val & 0xf];
+
+	return p;
+}
+
+static inline char *put_hex32(char *p, uint32_t val)
+{
+	p = put_hex8(p, val >> 24);
+	p = put_hex8(p, val >> 16);
+	p = put_hex8(p, val >> 8);
+
+	return put_hex8(p, val);
+}
+
+char *ras_uuid_le(const uint8_t *uu, char *buf)
+{
+	static const unsigned char le[16] = {3,2,1,0,5,4,7,6,8,9,10,11,12,13,14,15};
+	char *p = buf;
+	int i;
+
+	for (i = 0; i < 16; i++) {
+		p = put_hex8(p, uu[le[i]]);
+		switch (i) {
+		case 3:
+		case 5:
+		case 7:
+		case 9:
+			*p++ = '-';
+			break;
+		}
+	}
+	*p = '\0';
+
+	return buf;
+}
+
+/* "  %08x: " followed by 4 words and the separators after each one */
+#define HEX_DUMP_LINE_LEN	(2 + 8 + 2 + 4 * 9)
+#define HEX_DUMP_CHUNK		64
+
+void ras_hex_dump_le32(struct trace_seq *s, const uint8_t *buf, size_t len)
+{
+	char chunk[HEX_DUMP_CHUNK * HEX_DUMP_LINE_LEN + 1];
+	char *p = chunk;
+	size_t i, words = len / 4;
+	uint32_t word;
+
+	/* Formats whole lines on the stack, and copies them in bulk */
+	*p++ = ' ';
+	*p++ = ' ';
+	p = put_hex32(p, 0);
+	*p++ = ':';
+	*p++ = ' ';
+
+	for (i = 0; i < words; i++) {
+		word = buf[4 * i] | buf[4 * i + 1] << 8 |
+		       buf[4 * i + 2] << 16 | (uint32_t)buf[4 * i + 3] << 24;
+		p = put_hex32(p, word);
+
+		if ((i + 1) % 4) {
+			*p++ = ' ';
+			continue;
+		}
+
+		*p++ = '\n';
+		*p++ = ' ';
+		*p++ = ' ';
+		p = put_hex32(p, 4 * (i + 1));
+		*p++ = ':';
+		*p++ = ' ';
+
+		if ((size_t)(p - chunk) > sizeof(chunk) - 1 - HEX_DUMP_LINE_LEN) {
+			*p = '\0';
+			trace_seq_puts(s, chunk);
+			p = chunk;
+		}
+	}
+
+	*p = '\0';
+	trace_seq_puts(s, chunk);
+}
@@ -0,0 +1,42 @@
+/*
+ * Copyright (c) Huawei Technologies Co., Ltd. 2026. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#ifndef __RAS_FORMAT_H
+#define __RAS_FORMAT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "libtrace/event-parse.h"
+
+/*
+ * Formatting helpers shared by the event handlers. They write on buffers
+ * given by the caller, so they can be used from several threads at once.
+ */
+
+#define RAS_UUID_STR_LEN	sizeof("xxxxxxxx-xxxx-xxxx-xxxx-xxxxxxxxxxxx")
+
+/* formats a little endian UUID, as printed by the kernel's %pUl */
+char *ras_uuid_le(const uint8_t *uu, char *buf);
+
+/*
+ * Dumps @buf as little endian 32 bits words, 4 per line, each line
+ * starting with its offset. A trailing partial word is not printed.
+ */
+void ras_hex_dump_le32(struct trace_seq *s, const uint8_t *buf, size_t len);
+
+#endif
@@ -0,0 +1,332 @@
+/*
+ * Copyright (c) Huawei Technologies Co., Ltd. 2026. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+/*
+ * Log messages are formatted by the caller, then queued on a ring that a
+ * logging thread writes to syslog and stderr. A slow syslog or terminal
+ * never stalls event handling: when the ring is full, messages are dropped
+ * and counted.
+ *
+ * Until the logging thread is started, and once it is stopped, messages
+ * are written directly.
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+#include "ras-logger.h"
+#include "ras-env.h"
+#include "ras-metrics.h"
+
+#define LOG_RING_SIZE	256		/* a power of 2 */
+#define LOG_LINE_LEN	1024
+
+int ras_log_level = LOG_INFO;
+
+static unsigned long log_burst = 20, log_interval = 5;
+
+/*
+ * Bounded multi producer, single consumer queue. A slot can be written
+ * when its seq is the producer position, and read once it is one more.
+ */
+struct log_slot {
+	unsigned long	seq;
+	int		where, level;
+	char		msg[LOG_LINE_LEN];
+};
+
+static struct {
+	struct log_slot	slots[LOG_RING_SIZE];
+	unsigned long	head;		/* next slot to read */
+	unsigned long	tail;		/* next slot to write */
+	unsigned long	dropped;
+	int		sleeping;
+	int		wake_fd;
+	int		running, stop;
+	pthread_t	thread;
+} ring = {
+	.wake_fd = -1,
+};
+
+static void log_write(int where, int level, const char *msg)
+{
+	if (where & SYSLOG)
+		syslog(level, "%s", msg);
+	if (where & TERM)
+		fprintf(stderr, "%s: %s", TOOL_NAME, msg);
+}
+
+static void log_wake(void)
+{
+	uint64_t one = 1;
+
+	/* Only fails if the counter overflows: the thread is awake then */
+	if (write(ring.wake_fd, &one, sizeof(one)) < 0)
+		return;
+}
+
+static int log_push(int where, int level, const char *msg)
+{
+	unsigned long pos, seq;
+	struct log_slot *slot;
+
+	pos = __atomic_load_n(&ring.tail, __ATOMIC_RELAXED);
+	for (;;) {
+		slot = &ring.slots[pos & (LOG_RING_SIZE - 1)];
+		seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+		if (seq == pos) {
+			if (__atomic_compare_exchange_n(&ring.tail, &pos,
+							pos + 1, 1,
+							__ATOMIC_RELAXED,
+							__ATOMIC_RELAXED))
+				break;
+		} else if ((long)(seq - pos) < 0) {
+			/* Full */
+			__atomic_add_fetch(&ring.dropped, 1, __ATOMIC_RELAXED);
+			return -1;
+		} else {
+			pos = __atomic_load_n(&ring.tail, __ATOMIC_RELAXED);
+		}
+	}
+
+	slot->where = where;
+	slot->level = level;
+	strcpy(slot->msg, msg);
+	__atomic_store_n(&slot->seq, pos + 1, __ATOMIC_RELEASE);
+
+	/* Only the first message queued after the ring emptied wakes it up */
+	if (__atomic_exchange_n(&ring.sleeping, 0, __ATOMIC_SEQ_CST))
+		log_wake();
+
+	return 0;
+}
+
+/* Writes out the queued messages, returns how many */
+static int log_drain(void)
+{
+	struct log_slot *slot;
+	unsigned long dropped;
+	char msg[64];
+	int n = 0;
+
+	for (;;) {
+		slot = &ring.slots[ring.head & (LOG_RING_SIZE - 1)];
+		if (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) !=
+		    ring.head + 1)
+			break;
+
+		log_write(slot->where, slot->level, slot->msg);
+		__atomic_store_n(&slot->seq, ring.head + LOG_RING_SIZE,
+				 __ATOMIC_RELEASE);
+		ring.head++;
+		n++;
+	}
+
+	dropped = __atomic_exchange_n(&ring.dropped, 0, __ATOMIC_RELAXED);
+	if (dropped) {
+		ras_metrics_add(RAS_METRIC_LOG_DROPPED, dropped);
+		snprintf(msg, sizeof(msg), "%lu log messages dropped\n",
+			 dropped);
+		log_write(ALL, LOG_WARNING, msg);
+		n++;
+	}
+	if (n)
+		fflush(stderr);
+
+	return n;
+}
+
+static void *log_thread(void *arg)
+{
+	uint64_t val;
+	sigset_t mask;
+
+	/* Signals are handled by the main thread */
+	sigfillset(&mask);
+	pthread_sigmask(SIG_BLOCK, &mask, NULL);
+
+	for (;;) {
+		if (log_drain())
+			continue;
+
+		/* Checks again after telling producers to wake us up */
+		__atomic_store_n(&ring.sleeping, 1, __ATOMIC_SEQ_CST);
+		__atomic_thread_fence(__ATOMIC_SEQ_CST);
+		if (log_drain()) {
+			__atomic_store_n(&ring.sleeping, 0, __ATOMIC_SEQ_CST);
+			continue;
+		}
+		if (__atomic_load_n(&ring.stop, __ATOMIC_ACQUIRE))
+			break;
+		if (read(ring.wake_fd, &val, sizeof(val)) < 0 &&
+		    errno != EINTR)
+			break;
+	}
+
+	return NULL;
+}
+
+/* Returns 0 if the message is over the limit of its call site */
+static int log_ratelimit(struct ras_log_site *site, unsigned long *suppressed)
+{
+	time_t now, start;
+
+	if (!log_burst)
+		return 1;
+
+	now = time(NULL);
+	start = __atomic_load_n(&site->start, __ATOMIC_RELAXED);
+	if (now - start >= (time_t)log_interval &&
+	    __atomic_compare_exchange_n(&site->start, &start, now, 0,
+					__ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+		*suppressed = __atomic_exchange_n(&site->suppressed, 0,
+						  __ATOMIC_RELAXED);
+		__atomic_store_n(&site->count, 0, __ATOMIC_RELAXED);
+	}
+
+	if (__atomic_add_fetch(&site->count, 1, __ATOMIC_RELAXED) > log_burst) {
+		__atomic_add_fetch(&site->suppressed, 1, __ATOMIC_RELAXED);
+		return 0;
+	}
+
+	return 1;
+}
+
+static void log_emit(int where, int level, const char *msg)
+{
+	/* Messages that don't fit on the ring are counted by log_push() */
+	if (__atomic_load_n(&ring.running, __ATOMIC_ACQUIRE)) {
+		log_push(where, level, msg);
+		return;
+	}
+
+	log_write(where, level, msg);
+	if (where & TERM)
+		fflush(stderr);
+}
+
+void ras_log(int where, int level, struct ras_log_site *site,
+	     const char *fmt, ...)
+{
+	unsigned long suppressed = 0;
+	char msg[LOG_LINE_LEN];
+	va_list args;
+
+	if (!log_ratelimit(site, &suppressed))
+		return;
+
+	if (suppressed) {
+		snprintf(msg, sizeof(msg),
+			 "%lu similar messages suppressed\n", suppressed);
+		log_emit(where, level, msg);
+	}
+
+	va_start(args, fmt);
+	vsnprintf(msg, sizeof(msg), fmt, args);
+	va_end(args);
+
+	log_emit(where, level, msg);
+}
+
+static const char *log_levels[] = {
+	[LOG_EMERG]	= "emerg",
+	[LOG_ALERT]	= "alert",
+	[LOG_CRIT]	= "crit",
+	[LOG_ERR]	= "err",
+	[LOG_WARNING]	= "warning",
+	[LOG_NOTICE]	= "notice",
+	[LOG_INFO]	= "info",
+	[LOG_DEBUG]	= "debug",
+};
+
+/* Sets the log level from RAS_LOG_LEVEL, either a name or a number */
+void ras_log_set_level(void)
+{
+	char *env = getenv("RAS_LOG_LEVEL"), *end;
+	unsigned long v;
+	int i;
+
+	log_burst = ras_parse_env_ulong("RAS_LOG_BURST", 0, ULONG_MAX,
+					log_burst);
+	log_interval = ras_parse_env_ulong("RAS_LOG_INTERVAL", 0, ULONG_MAX,
+					   log_interval);
+
+	if (!env || !*env)
+		return;
+
+	for (i = 0; i < (int)(sizeof(log_levels) / sizeof(*log_levels)); i++) {
+		if (!strcasecmp(env, log_levels[i])) {
+			ras_log_level = i;
+			return;
+		}
+	}
+
+	v = strtoul(env, &end, 10);
+	if (end == env || *end || v > LOG_DEBUG) {
+		log(TERM, LOG_INFO, "Improper RAS_LOG_LEVEL, set to default %s.\n",
+		    log_levels[ras_log_level]);
+		return;
+	}
+	ras_log_level = v;
+}
+
+static void ras_log_exit(void)
+{
+	__atomic_store_n(&ring.stop, 1, __ATOMIC_RELEASE);
+	log_wake();
+	pthread_join(ring.thread, NULL);
+	__atomic_store_n(&ring.running, 0, __ATOMIC_RELEASE);
+
+	/* Messages queued while stopping */
+	log_drain();
+	close(ring.wake_fd);
+	ring.wake_fd = -1;
+}
+
+int ras_log_init(void)
+{
+	unsigned long i;
+
+	for (i = 0; i < LOG_RING_SIZE; i++)
+		ring.slots[i].seq = i;
+
+	ring.wake_fd = eventfd(0, EFD_CLOEXEC);
+	if (ring.wake_fd < 0)
+		return -1;
+
+	if (pthread_create(&ring.thread, NULL, log_thread, NULL)) {
+		close(ring.wake_fd);
+		ring.wake_fd = -1;
+		return -1;
+	}
+	__atomic_store_n(&ring.running, 1, __ATOMIC_RELEASE);
+	atexit(ras_log_exit);
+
+	return 0;
+}
@@ -19,6 +19,7 @@
 #ifndef __RAS_LOGGER_H
 
 #include <syslog.h>
+#include <time.h>
 
 /*
  * Logging macros
@@ -31,16 +32,25 @@
 #define SYSLOG	(1 << 0)
 #define TERM	(1 << 1)
 #define ALL	(SYSLOG | TERM)
-/* TODO: global logging limit mask */
+
+/* Messages less important than this are discarded, see RAS_LOG_LEVEL */
+extern int ras_log_level;
+
+/* Rate limiting state of a log() call site */
+struct ras_log_site {
+	time_t		start;		/* of the current interval */
+	unsigned long	count, suppressed;
+};
+
+void ras_log(int where, int level, struct ras_log_site *site,
+	     const char *fmt, ...) __attribute__((format(printf, 4, 5)));
+void ras_log_set_level(void);
+int ras_log_init(void);
 
 #define log(where, level, fmt, args...) do {\
-	if (where & SYSLOG)\
-		syslog(level, fmt, ##args);\
-	if (where & TERM) {\
-		fprintf(stderr, "%s: ", TOOL_NAME);\
-		fprintf(stderr, fmt, ##args);\
-		fflush(stderr);\
-	}\
+	static struct ras_log_site __log_site;\
+	if ((level) <= ras_log_level)\
+		ras_log(where, level, &__log_site, fmt, ##args);\
 } while (0)
 
 #define __RAS_LOGGER_H
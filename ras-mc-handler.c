@@ -25,6 +25,7 @@
 #include "ras-logger.h"
 #include "ras-page-isolation.h"
 #include "ras-report.h"
+#include "ras-stream.h"
 
 int ras_mc_event_handler(struct trace_seq *s,
 			 struct pevent_record *record,
@@ -195,6 +196,8 @@ int ras_mc_event_handler(struct trace_seq *s,
 	ras_report_mc_event(ras, &ev);
 #endif
 
+	ras_stream_mc_event(ras, &ev);
+
 	return 0;
 
 parse_error:
@@ -0,0 +1,431 @@
+/*
+ * Copyright (c) Huawei Technologies Co., Ltd. 2026. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+/*
+ * Offline decoding of raw MCA register dumps (e. g. collected by a BMC or
+ * by a crash kernel), using the same decoders as the live MCE handler.
+ *
+ * Each input file is a shard, handled by one worker thread at a time. Every
+ * worker has its own ras_events/mce_priv, so no decoder state is shared.
+ * Output is one JSON object per line on stdout; a worker only takes the
+ * output lock when its buffer is full, so lines are never interleaved.
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "ras-mce-decode.h"
+#include "ras-mce-handler.h"
+#include "ras-logger.h"
+
+#define DECODE_MAX_CPUS		8192
+#define DECODE_OUTBUF_SIZE	(256 * 1024)
+#define DECODE_BIN_BATCH	256
+
+struct decode_ctx {
+	struct mce_decode_opts	*opts;
+	struct mce_priv		*tmpl;
+	char			**files;
+	int			nfiles;
+	int			next_file;
+	pthread_mutex_t		out_lock;
+
+	/* Totals, updated by each worker when it finishes */
+	unsigned long long	records, skipped, bad;
+	int			failed_files;
+};
+
+struct decode_worker {
+	struct decode_ctx	*ctx;
+	struct ras_events	ras;
+	struct mce_priv		mce;
+	char			*out;
+	size_t			out_len;
+	unsigned long long	records, skipped, bad;
+	int			failed_files;
+};
+
+static void out_flush(struct decode_worker *w)
+{
+	if (!w->out_len)
+		return;
+
+	pthread_mutex_lock(&w->ctx->out_lock);
+	fwrite(w->out, 1, w->out_len, stdout);
+	pthread_mutex_unlock(&w->ctx->out_lock);
+	w->out_len = 0;
+}
+
+/* Worst case for one record: every message byte escaped as \u00XX */
+#define DECODE_MAX_LINE	(6 * sizeof(struct mce_event) + 1024)
+
+static void out_str(struct decode_worker *w, const char *key, const char *val)
+{
+	static const char hex[] = "0123456789abcdef";
+	char *p = w->out + w->out_len;
+	const unsigned char *c;
+
+	p += sprintf(p, ",\"%s\":\"", key);
+	for (c = (const unsigned char *)val; *c; c++) {
+		switch (*c) {
+		case '"':
+		case '\\':
+			*p++ = '\\';
+			*p++ = *c;
+			break;
+		case '\n':
+			*p++ = '\\';
+			*p++ = 'n';
+			break;
+		case '\t':
+			*p++ = '\\';
+			*p++ = 't';
+			break;
+		default:
+			if (*c < 0x20) {
+				p += sprintf(p, "\\u00");
+				*p++ = hex[*c >> 4];
+				*p++ = hex[*c & 0xf];
+			} else {
+				*p++ = *c;
+			}
+		}
+	}
+	*p++ = '"';
+	w->out_len = p - w->out;
+}
+
+static void out_record(struct decode_worker *w, struct mce_event *e)
+{
+	if (w->out_len + DECODE_MAX_LINE > DECODE_OUTBUF_SIZE)
+		out_flush(w);
+
+	w->out_len += sprintf(w->out + w->out_len,
+			      "{\"cpu\":%u,\"bank\":%u,\"status\":\"0x%016llx\","
+			      "\"addr\":\"0x%llx\",\"misc\":\"0x%llx\","
+			      "\"synd\":\"0x%llx\",\"ipid\":\"0x%llx\","
+			      "\"mcgstatus\":\"0x%llx\"",
+			      e->cpu, e->bank, (unsigned long long)e->status,
+			      (unsigned long long)e->addr,
+			      (unsigned long long)e->misc,
+			      (unsigned long long)e->synd,
+			      (unsigned long long)e->ipid,
+			      (unsigned long long)e->mcgstatus);
+
+	out_str(w, "cpu_type", mce_cputype_name(w->mce.cputype));
+	if (*e->bank_name)
+		out_str(w, "bank_name", e->bank_name);
+	if (*e->error_msg)
+		out_str(w, "error_msg", e->error_msg);
+	if (*e->mcgstatus_msg)
+		out_str(w, "mcgstatus_msg", e->mcgstatus_msg);
+	if (*e->mcistatus_msg)
+		out_str(w, "mcistatus_msg", e->mcistatus_msg);
+	if (*e->mcastatus_msg)
+		out_str(w, "mcastatus_msg", e->mcastatus_msg);
+	if (*e->user_action)
+		out_str(w, "user_action", e->user_action);
+	if (*e->mc_location)
+		out_str(w, "mc_location", e->mc_location);
+
+	w->out[w->out_len++] = '}';
+	w->out[w->out_len++] = '\n';
+}
+
+static void decode_one(struct decode_worker *w, struct mce_event *e)
+{
+	w->records++;
+
+	if (ras_mce_decode(&w->ras, e)) {
+		w->skipped++;
+		return;
+	}
+
+	out_record(w, e);
+}
+
+/*
+ * CSV columns: cpu,bank,status[,addr,misc,synd,ipid,mcgstatus,mcgcap,cpuid]
+ * Numbers may be decimal, octal or 0x-prefixed hex. Empty lines and lines
+ * starting with '#' are ignored.
+ */
+static int parse_csv_line(char *line, struct mce_event *e)
+{
+	uint64_t val[10] = { 0 };
+	char *p = line, *end;
+	int n = 0;
+
+	while (*p == ' ' || *p == '\t')
+		p++;
+	if (*p == '#' || *p == '\n' || *p == '\r' || !*p)
+		return 1;
+
+	while (n < 10) {
+		errno = 0;
+		val[n] = strtoull(p, &end, 0);
+		if (end == p || errno)
+			return -1;
+		n++;
+		p = end;
+		while (*p == ' ' || *p == '\t')
+			p++;
+		if (*p != ',')
+			break;
+		p++;
+	}
+	if (n < 3 || (*p && *p != '\n' && *p != '\r'))
+		return -1;
+
+	memset(e, 0, sizeof(*e));
+	e->cpu = val[0];
+	e->bank = val[1];
+	e->status = val[2];
+	e->addr = val[3];
+	e->misc = val[4];
+	e->synd = val[5];
+	e->ipid = val[6];
+	e->mcgstatus = val[7];
+	e->mcgcap = val[8];
+	e->cpuid = val[9];
+
+	return 0;
+}
+
+static void decode_csv(struct decode_worker *w, FILE *f, const char *name)
+{
+	struct mce_event e;
+	char *line = NULL;
+	size_t linelen = 0;
+	unsigned long lineno = 0;
+	int rc;
+
+	while (getline(&line, &linelen, f) > 0) {
+		lineno++;
+		rc = parse_csv_line(line, &e);
+		if (rc < 0) {
+			log(TERM, LOG_WARNING, "%s:%lu: can't parse record\n",
+			    name, lineno);
+			w->bad++;
+			continue;
+		}
+		if (rc)
+			continue;
+		decode_one(w, &e);
+	}
+	free(line);
+}
+
+static void decode_binary(struct decode_worker *w, FILE *f, const char *name)
+{
+	struct mce_raw_record raw[DECODE_BIN_BATCH];
+	struct mce_event e;
+	size_t len = 0, n, i;
+
+	for (;;) {
+		n = fread((char *)raw + len, 1, sizeof(raw) - len, f);
+		len += n;
+		if (!n && len < sizeof(raw))
+			break;
+
+		for (i = 0; i < len / sizeof(*raw); i++) {
+			memset(&e, 0, sizeof(e));
+			e.cpu = raw[i].cpu;
+			e.bank = raw[i].bank;
+			e.status = raw[i].status;
+			e.addr = raw[i].addr;
+			e.misc = raw[i].misc;
+			e.synd = raw[i].synd;
+			e.ipid = raw[i].ipid;
+			e.mcgstatus = raw[i].mcgstatus;
+			e.mcgcap = raw[i].mcgcap;
+			e.cpuid = raw[i].cpuid;
+			decode_one(w, &e);
+		}
+
+		/* Keep a trailing partial record for the next read */
+		n = len % sizeof(*raw);
+		memmove(raw, (char *)raw + len - n, n);
+		len = n;
+	}
+
+	if (ferror(f)) {
+		log(TERM, LOG_ERR, "%s: read error\n", name);
+		w->failed_files++;
+	} else if (len) {
+		log(TERM, LOG_WARNING, "%s: truncated record at end of file\n",
+		    name);
+		w->bad++;
+	}
+}
+
+static void *decode_thread(void *priv)
+{
+	struct decode_worker *w = priv;
+	struct decode_ctx *ctx = w->ctx;
+	const char *name;
+	FILE *f;
+	int i;
+
+	for (;;) {
+		i = __sync_fetch_and_add(&ctx->next_file, 1);
+		if (i >= ctx->nfiles)
+			break;
+
+		name = ctx->files[i];
+		if (!strcmp(name, "-")) {
+			f = stdin;
+		} else {
+			f = fopen(name, ctx->opts->binary ? "rb" : "r");
+			if (!f) {
+				log(TERM, LOG_ERR, "Can't open %s: %s\n",
+				    name, strerror(errno));
+				w->failed_files++;
+				continue;
+			}
+		}
+
+		if (ctx->opts->binary)
+			decode_binary(w, f, name);
+		else
+			decode_csv(w, f, name);
+
+		if (f != stdin)
+			fclose(f);
+	}
+	out_flush(w);
+
+	return NULL;
+}
+
+int ras_mce_decode_files(struct mce_decode_opts *opts, char **files, int nfiles)
+{
+	static char *stdin_file[] = { "-" };
+	struct ras_events ras;
+	struct mce_priv tmpl;
+	struct decode_ctx ctx;
+	struct decode_worker *w;
+	pthread_t *tid;
+	struct timespec start, end;
+	double secs;
+	unsigned int i, nthreads;
+	int rc;
+
+	if (!opts->vendor) {
+		log(TERM, LOG_ERR, "--decode-mce requires --cpu-vendor\n");
+		return -1;
+	}
+
+	memset(&ras, 0, sizeof(ras));
+	memset(&tmpl, 0, sizeof(tmpl));
+	ras.mce_priv = &tmpl;
+	strncpy(tmpl.vendor, opts->vendor, sizeof(tmpl.vendor) - 1);
+	tmpl.family = opts->family;
+	tmpl.model = opts->model;
+	tmpl.ncpus = DECODE_MAX_CPUS;
+
+	/* Every AMD family 17h and newer CPU implements Scalable MCA */
+	if (opts->smca || (!strcmp(tmpl.vendor, "AuthenticAMD") &&
+			   tmpl.family >= 0x17))
+		tmpl.smca = 1;
+
+	rc = mce_select_cputype(&ras);
+	if (rc) {
+		log(TERM, LOG_ERR, "Can't decode MCE for %s family %u model %u\n",
+		    tmpl.vendor, tmpl.family, tmpl.model);
+		return -1;
+	}
+
+	if (!nfiles) {
+		files = stdin_file;
+		nfiles = 1;
+	}
+
+	nthreads = opts->threads ? opts->threads : 1;
+	if (nthreads > (unsigned int)nfiles)
+		nthreads = nfiles;
+
+	memset(&ctx, 0, sizeof(ctx));
+	ctx.opts = opts;
+	ctx.tmpl = &tmpl;
+	ctx.files = files;
+	ctx.nfiles = nfiles;
+	pthread_mutex_init(&ctx.out_lock, NULL);
+
+	w = calloc(nthreads, sizeof(*w));
+	tid = calloc(nthreads, sizeof(*tid));
+	if (!w || !tid) {
+		log(TERM, LOG_ERR, "Can't allocate memory for decode threads\n");
+		free(w);
+		free(tid);
+		return -1;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	for (i = 0; i < nthreads; i++) {
+		w[i].ctx = &ctx;
+		w[i].mce = tmpl;
+		w[i].mce.smca_cache = NULL;
+		if (tmpl.cputype == CPU_AMD_SMCA)
+			amd_smca_alloc_cache(&w[i].mce);
+		w[i].ras.mce_priv = &w[i].mce;
+		w[i].out = malloc(DECODE_OUTBUF_SIZE);
+		if (!w[i].out) {
+			log(TERM, LOG_ERR, "Can't allocate output buffer\n");
+			nthreads = i;
+			break;
+		}
+		if (pthread_create(&tid[i], NULL, decode_thread, &w[i])) {
+			log(TERM, LOG_ERR, "Can't create decode thread\n");
+			free(w[i].out);
+			nthreads = i;
+			break;
+		}
+	}
+
+	for (i = 0; i < nthreads; i++) {
+		pthread_join(tid[i], NULL);
+		ctx.records += w[i].records;
+		ctx.skipped += w[i].skipped;
+		ctx.bad += w[i].bad;
+		ctx.failed_files += w[i].failed_files;
+		amd_smca_free_cache(&w[i].mce);
+		free(w[i].out);
+	}
+	fflush(stdout);
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	secs = (end.tv_sec - start.tv_sec) +
+	       (end.tv_nsec - start.tv_nsec) / 1e9;
+
+	fprintf(stderr,
+		"%s: decoded %llu records (%llu skipped, %llu unparsable) as %s in %.3f s, %.0f records/s, %u thread(s)\n",
+		TOOL_NAME, ctx.records, ctx.skipped, ctx.bad,
+		mce_cputype_name(tmpl.cputype), secs,
+		secs > 0 ? ctx.records / secs : 0, nthreads);
+
+	pthread_mutex_destroy(&ctx.out_lock);
+	free(w);
+	free(tid);
+
+	return (ctx.failed_files || !nthreads) ? -1 : 0;
+}
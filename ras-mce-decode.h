@@ -0,0 +1,59 @@
+/*
+ * Copyright (c) Huawei Technologies Co., Ltd. 2026. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#ifndef __RAS_MCE_DECODE_H
+#define __RAS_MCE_DECODE_H
+
+#include <stdint.h>
+#include "config.h"
+
+/*
+ * Binary input record for --decode-mce --binary. All fields are in host
+ * byte order; the layout has no implicit padding.
+ */
+struct mce_raw_record {
+	uint64_t	status;
+	uint64_t	addr;
+	uint64_t	misc;
+	uint64_t	synd;
+	uint64_t	ipid;
+	uint64_t	mcgstatus;
+	uint64_t	mcgcap;
+	uint32_t	cpu;
+	uint32_t	cpuid;
+	uint8_t		bank;
+	uint8_t		reserved[7];
+};
+
+struct mce_decode_opts {
+	const char	*vendor;	/* vendor_id string, as in /proc/cpuinfo */
+	unsigned int	family, model;
+	unsigned	smca:1;		/* AMD: bank registers are Scalable MCA */
+	unsigned	binary:1;	/* input is struct mce_raw_record */
+	unsigned int	threads;
+};
+
+#ifdef HAVE_MCE
+int ras_mce_decode_files(struct mce_decode_opts *opts,
+			 char **files, int nfiles);
+#else
+static inline int ras_mce_decode_files(struct mce_decode_opts *opts,
+				       char **files, int nfiles) { return -1; };
+#endif
+
+#endif
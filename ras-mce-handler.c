@@ -17,16 +17,23 @@
 */
 #include <ctype.h>
 #include <errno.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 #include <stdint.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#endif
 #include "libtrace/kbuffer.h"
 #include "ras-mce-handler.h"
+#include "ras-mce-storm.h"
+#include "ras-plugin.h"
 #include "ras-record.h"
 #include "ras-logger.h"
 #include "ras-report.h"
+#include "ras-stream.h"
 
 /*
  * The code below were adapted from Andi Kleen/Intel/SuSe mcelog code,
@@ -128,9 +135,93 @@ static enum cputype select_intel_cputype(struct ras_events *ras)
 	return mce->family == 6 ? CPU_P6OLD : CPU_GENERIC;
 }
 
-static int detect_cpu(struct ras_events *ras)
+/*
+ * Picks the decoder for the vendor/family/model (and, on AMD, the SMCA
+ * capability) already filled in at ras->mce_priv. Shared by the live
+ * handler and by the offline decoder, where those come from the command line.
+ */
+int mce_select_cputype(struct ras_events *ras)
 {
 	struct mce_priv *mce = ras->mce_priv;
+
+	/* Handle only Intel and AMD CPUs */
+	if (!strcmp(mce->vendor, "AuthenticAMD")) {
+		if (mce->family == 15)
+			mce->cputype = CPU_K8;
+		if (mce->smca) {
+			mce->cputype = CPU_AMD_SMCA;
+			return 0;
+		}
+		if (mce->family > 23) {
+			log(ALL, LOG_INFO,
+			    "Can't parse MCE for this AMD CPU yet %d\n",
+			    mce->family);
+			return EINVAL;
+		}
+		return 0;
+	} else if (!strcmp(mce->vendor,"HygonGenuine")) {
+		if (mce->family == 24) {
+			mce->cputype = CPU_DHYANA;
+		}
+		return 0;
+	} else if (!strcmp(mce->vendor,"GenuineIntel")) {
+		mce->cputype = select_intel_cputype(ras);
+		return 0;
+	}
+
+	return EINVAL;
+}
+
+const char *mce_cputype_name(enum cputype cputype)
+{
+	return cputype_name[cputype];
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+/*
+ * On x86, the running CPU tells everything needed to pick a decoder, which
+ * is much cheaper than parsing /proc/cpuinfo on hosts with many CPUs.
+ */
+static int detect_cpu_cpuid(struct mce_priv *mce)
+{
+	unsigned int eax, ebx, ecx, edx, max_ext;
+	unsigned int *vendor = (unsigned int *)mce->vendor;
+
+	if (!__get_cpuid(0, &eax, &ebx, &ecx, &edx))
+		return EINVAL;
+	vendor[0] = ebx;
+	vendor[1] = edx;
+	vendor[2] = ecx;
+	mce->vendor[12] = '\0';
+
+	if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+		return EINVAL;
+	mce->stepping = eax & 0xf;
+	mce->model = (eax >> 4) & 0xf;
+	mce->family = (eax >> 8) & 0xf;
+	if (mce->family == 0xf)
+		mce->family += (eax >> 20) & 0xff;
+	if (mce->family == 0x6 || mce->family >= 0xf)
+		mce->model += ((eax >> 16) & 0xf) << 4;
+
+	/* Scalable MCA: CPUID Fn8000_0007_EBX[3] */
+	mce->smca = 0;
+	max_ext = __get_cpuid_max(0x80000000, NULL);
+	if (max_ext >= 0x80000007 &&
+	    __get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx))
+		mce->smca = !!(ebx & (1 << 3));
+
+	return 0;
+}
+#else
+static int detect_cpu_cpuid(struct mce_priv *mce)
+{
+	return ENOTSUP;
+}
+#endif
+
+static int detect_cpu_procfs(struct mce_priv *mce)
+{
 	FILE *f;
 	int ret = 0;
 	char *line = NULL;
@@ -166,11 +257,7 @@ static int detect_cpu(struct ras_events *ras)
 		else if (sscanf(line, "cpu MHz : %lf", &mce->mhz) == 1)
 			seen |= CPU_MHZ;
 		else if (!strncmp(line, "flags", 5) && isspace(line[6])) {
-			if (mce->processor_flags)
-				free(mce->processor_flags);
-			mce->processor_flags = line;
-			line = NULL;
-			linelen = 0;
+			mce->smca = strstr(line, " smca") != NULL;
 			seen |= CPU_FLAGS;
 		}
 	}
@@ -183,46 +270,67 @@ static int detect_cpu(struct ras_events *ras)
 			(seen & CPU_MHZ)    ? "" : " [cpu MHz]",
 			(seen & CPU_FLAGS)  ? "" : " [flags]");
 		ret = EINVAL;
-		goto ret;
-	}
-
-	/* Handle only Intel and AMD CPUs */
-	ret = 0;
-
-	if (!strcmp(mce->vendor, "AuthenticAMD")) {
-		if (mce->family == 15)
-			mce->cputype = CPU_K8;
-		if (strstr(mce->processor_flags, "smca")) {
-			mce->cputype = CPU_AMD_SMCA;
-			goto ret;
-		}
-		if (mce->family > 23) {
-			log(ALL, LOG_INFO,
-			    "Can't parse MCE for this AMD CPU yet %d\n",
-			    mce->family);
-			ret = EINVAL;
-		}
-		goto ret;
-	} else if (!strcmp(mce->vendor,"HygonGenuine")) {
-		if (mce->family == 24) {
-			mce->cputype = CPU_DHYANA;
-		}
-		goto ret;
-	} else if (!strcmp(mce->vendor,"GenuineIntel")) {
-		mce->cputype = select_intel_cputype(ras);
-	} else {
-		ret = EINVAL;
 	}
 
-ret:
 	fclose(f);
 	free(line);
 
 	return ret;
 }
 
+static int detect_cpu(struct ras_events *ras)
+{
+	struct mce_priv *mce = ras->mce_priv;
+	int ret;
+
+	ret = detect_cpu_cpuid(mce);
+	if (ret)
+		ret = detect_cpu_procfs(mce);
+	if (ret)
+		return ret;
+
+	return mce_select_cputype(ras);
+}
+
+/*
+ * Socket of a CPU, from sysfs. Only read the first time a CPU reports an
+ * error, as most CPUs never do. The cache is allocated when the handler is
+ * registered, and its entries may be set by several threads at once.
+ */
+uint32_t mce_cpu_socketid(struct mce_priv *mce, unsigned int cpu)
+{
+	char fpath[80];
+	FILE *f;
+	int id;
+
+	if (cpu >= mce->ncpus)
+		return 0;
+
+	if (mce->cpu_socketid) {
+		id = __atomic_load_n(&mce->cpu_socketid[cpu], __ATOMIC_RELAXED);
+		if (id >= 0)
+			return id;
+	}
+
+	snprintf(fpath, sizeof(fpath),
+		 "/sys/devices/system/cpu/cpu%u/topology/physical_package_id",
+		 cpu);
+	id = 0;
+	f = fopen(fpath, "r");
+	if (f) {
+		if (fscanf(f, "%d", &id) != 1 || id < 0)
+			id = 0;
+		fclose(f);
+	}
+	if (mce->cpu_socketid)
+		__atomic_store_n(&mce->cpu_socketid[cpu], id, __ATOMIC_RELAXED);
+
+	return id;
+}
+
 int register_mce_handler(struct ras_events *ras, unsigned ncpus)
 {
+	unsigned int i;
 	int rc;
 	struct mce_priv *mce;
 
@@ -233,22 +341,36 @@ int register_mce_handler(struct ras_events *ras, unsigned ncpus)
 	}
 
 	mce = ras->mce_priv;
+	mce->ncpus = ncpus;
+
+	/* Caches used by the handler threads, allocated before they run */
+	mce->cpu_socketid = malloc(ncpus * sizeof(*mce->cpu_socketid));
+	if (!mce->cpu_socketid) {
+		free(ras->mce_priv);
+		ras->mce_priv = NULL;
+		return ENOMEM;
+	}
+	for (i = 0; i < ncpus; i++)
+		mce->cpu_socketid[i] = -1;
 
 	rc = detect_cpu(ras);
 	if (rc) {
-		if (mce->processor_flags)
-			free (mce->processor_flags);
+		free(mce->cpu_socketid);
 		free (ras->mce_priv);
 		ras->mce_priv = NULL;
 		return (rc);
 	}
+	if (mce->cputype == CPU_AMD_SMCA && amd_smca_alloc_cache(mce))
+		log(ALL, LOG_INFO, "Can't allocate the SMCA bank type cache\n");
+	mce->storm = mce_storm_init();
+
 	switch (mce->cputype) {
 	case CPU_SANDY_BRIDGE_EP:
 	case CPU_IVY_BRIDGE_EPEX:
 	case CPU_HASWELL_EPEX:
 	case CPU_KNIGHTS_LANDING:
 	case CPU_KNIGHTS_MILL:
-		set_intel_imc_log(mce->cputype, ncpus);
+		set_intel_imc_log(mce->cputype);
 	default:
 		break;
 	}
@@ -256,18 +378,27 @@ int register_mce_handler(struct ras_events *ras, unsigned ncpus)
 	return rc;
 }
 
+void unregister_mce_handler(struct ras_events *ras)
+{
+	struct mce_priv *mce = ras->mce_priv;
+
+	if (!mce)
+		return;
+
+	amd_smca_free_cache(mce);
+	mce_storm_free(mce->storm);
+	free(mce->cpu_socketid);
+	free(mce);
+	ras->mce_priv = NULL;
+}
+
 /*
  * End of mcelog's code
  */
 
-static void report_mce_event(struct ras_events *ras,
-			     struct pevent_record *record,
-			     struct trace_seq *s, struct mce_event *e)
+static time_t mce_event_time(struct ras_events *ras,
+			     struct pevent_record *record)
 {
-	time_t now;
-	struct tm *tm;
-	struct mce_priv *mce = ras->mce_priv;
-
 	/*
 	 * Newer kernels (3.10-rc1 or upper) provide an uptime clock.
 	 * On previous kernels, the way to properly generate an event would
@@ -278,9 +409,18 @@ static void report_mce_event(struct ras_events *ras,
 	 */
 
 	if (ras->use_uptime)
-		now = record->ts/user_hz + ras->uptime_diff;
-	else
-		now = time(NULL);
+		return record->ts/user_hz + ras->uptime_diff;
+
+	return time(NULL);
+}
+
+static void report_mce_event(struct ras_events *ras,
+			     struct pevent_record *record,
+			     struct trace_seq *s, struct mce_event *e)
+{
+	time_t now = mce_event_time(ras, record);
+	struct tm *tm;
+	struct mce_priv *mce = ras->mce_priv;
 
 	tm = localtime(&now);
 	if (tm)
@@ -371,6 +511,107 @@ static void report_mce_event(struct ras_events *ras,
 	 */
 }
 
+static pthread_mutex_t mce_dec_lock = PTHREAD_MUTEX_INITIALIZER;
+static const struct ras_mce_dec **mce_decs;
+static unsigned int mce_dec_count;
+/* First decoder of the plugin being initialized, -1 if none */
+static int mce_dec_staged = -1;
+
+int register_mce_dec(const struct ras_mce_dec *dec)
+{
+	const struct ras_mce_dec **decs;
+
+	pthread_mutex_lock(&mce_dec_lock);
+	decs = realloc(mce_decs, (mce_dec_count + 1) * sizeof(*decs));
+	if (!decs) {
+		pthread_mutex_unlock(&mce_dec_lock);
+		return -1;
+	}
+	decs[mce_dec_count++] = dec;
+	mce_decs = decs;
+	pthread_mutex_unlock(&mce_dec_lock);
+
+	return 0;
+}
+
+/* As ns_dec_tab_stage() and ns_dec_tab_commit(), for the MCE decoders */
+void mce_dec_stage(void)
+{
+	pthread_mutex_lock(&mce_dec_lock);
+	mce_dec_staged = mce_dec_count;
+	pthread_mutex_unlock(&mce_dec_lock);
+}
+
+void mce_dec_commit(int keep)
+{
+	pthread_mutex_lock(&mce_dec_lock);
+	if (!keep)
+		mce_dec_count = mce_dec_staged;
+	mce_dec_staged = -1;
+	pthread_mutex_unlock(&mce_dec_lock);
+}
+
+static const struct ras_mce_dec *find_mce_dec(struct mce_priv *mce)
+{
+	const struct ras_mce_dec *dec = NULL;
+	unsigned int i, count;
+
+	/* Gives a chance for a plugin handling this CPU to register itself */
+	ras_plugin_load_mce(mce->vendor, mce->family);
+
+	pthread_mutex_lock(&mce_dec_lock);
+	count = mce_dec_staged < 0 ? mce_dec_count : mce_dec_staged;
+	for (i = 0; i < count; i++) {
+		if (!strcmp(mce_decs[i]->vendor, mce->vendor) &&
+		    mce_decs[i]->family == mce->family) {
+			dec = mce_decs[i];
+			break;
+		}
+	}
+	pthread_mutex_unlock(&mce_dec_lock);
+
+	return dec;
+}
+
+int ras_mce_decode(struct ras_events *ras, struct mce_event *e)
+{
+	struct mce_priv *mce = ras->mce_priv;
+	int rc = 0;
+
+	if (!mce->ext_dec_checked) {
+		mce->ext_dec = find_mce_dec(mce);
+		mce->ext_dec_checked = 1;
+	}
+
+	if (mce->ext_dec) {
+		rc = mce->ext_dec->decode(ras, e);
+		goto done;
+	}
+
+	switch (mce->cputype) {
+	case CPU_GENERIC:
+		break;
+	case CPU_K8:
+		rc = parse_amd_k8_event(ras, e);
+		break;
+	case CPU_AMD_SMCA:
+	case CPU_DHYANA:
+		rc = parse_amd_smca_event(ras, e);
+		break;
+	default:			/* All other CPU types are Intel */
+		rc = parse_intel_event(ras, e);
+	}
+
+done:
+	if (rc)
+		return rc;
+
+	if (!*e->error_msg && *e->mcastatus_msg)
+		mce_snprintf(e->error_msg, "%s", e->mcastatus_msg);
+
+	return 0;
+}
+
 int ras_mce_event_handler(struct trace_seq *s,
 			  struct pevent_record *record,
 			  struct event_format *event, void *context)
@@ -414,12 +655,13 @@ int ras_mce_event_handler(struct trace_seq *s,
 	if (pevent_get_field_val(s, event, "cpuid", record, &val, 1) < 0)
 		return -1;
 	e.cpuid = val;
-	if (pevent_get_field_val(s, event, "apicid", record, &val, 1) < 0)
-		return -1;
-	e.apicid = val;
-	if (pevent_get_field_val(s, event, "socketid", record, &val, 1) < 0)
-		return -1;
-	e.socketid = val;
+	/* Older kernels don't report apicid/socketid */
+	if (pevent_get_field_val(s, event, "apicid", record, &val, 0) >= 0)
+		e.apicid = val;
+	if (pevent_get_field_val(s, event, "socketid", record, &val, 0) >= 0)
+		e.socketid = val;
+	else
+		e.socketid = mce_cpu_socketid(mce, e.cpu);
 	if (pevent_get_field_val(s, event, "cs", record, &val, 1) < 0)
 		return -1;
 	e.cs = val;
@@ -437,26 +679,18 @@ int ras_mce_event_handler(struct trace_seq *s,
 		return -1;
 	e.ipid = val;
 
-	switch (mce->cputype) {
-	case CPU_GENERIC:
-		break;
-	case CPU_K8:
-		rc = parse_amd_k8_event(ras, &e);
-		break;
-	case CPU_AMD_SMCA:
-	case CPU_DHYANA:
-		rc = parse_amd_smca_event(ras, &e);
-		break;
-	default:			/* All other CPU types are Intel */
-		rc = parse_intel_event(ras, &e);
+	if (mce_storm_check(mce->storm, &e, mce_event_time(ras, record)) ==
+	    MCE_STORM_COALESCE) {
+		trace_seq_printf(s, "cpu %u bank %u: corrected error coalesced into a storm summary",
+				 e.cpu, e.bank);
+		mce_storm_flush(ras, 0);
+		return 0;
 	}
 
+	rc = ras_mce_decode(ras, &e);
 	if (rc)
 		return rc;
 
-	if (!*e.error_msg && *e.mcastatus_msg)
-		mce_snprintf(e.error_msg, "%s", e.mcastatus_msg);
-
 	report_mce_event(ras, record, s, &e);
 
 #ifdef HAVE_SQLITE3
@@ -468,5 +702,7 @@ int ras_mce_event_handler(struct trace_seq *s,
 	ras_report_mce_event(ras, &e);
 #endif
 
+	ras_stream_mce_event(ras, &e);
+
 	return 0;
 }
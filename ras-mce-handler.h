@@ -82,14 +82,32 @@ struct mce_event {
 	char		mc_location[256];
 };
 
+struct smca_bank_cache;
+struct mce_storm;
+struct ras_mce_dec;
+
 struct mce_priv {
 	/* CPU Info */
 	char vendor[64];
-	unsigned int family, model;
+	unsigned int family, model, stepping;
 	double mhz;
 	enum cputype cputype;
 	unsigned mc_error_support:1;
-	char *processor_flags;
+	unsigned smca:1;
+	unsigned ncpus;
+
+	/* physical_package_id per CPU, read from sysfs on first use */
+	int *cpu_socketid;
+
+	/* corrected error storm detection, NULL if disabled */
+	struct mce_storm *storm;
+
+	/* registered decoder overriding the built-in ones, if any */
+	const struct ras_mce_dec *ext_dec;
+	unsigned ext_dec_checked:1;
+
+	/* SMCA bank types, looked up once per (cpu, bank) */
+	struct smca_bank_cache **smca_cache;
 };
 
 #define mce_snprintf(buf, fmt, arg...) do {			\
@@ -107,12 +125,42 @@ struct mce_priv {
 
 /* register and handling routines */
 int register_mce_handler(struct ras_events *ras, unsigned ncpus);
+void unregister_mce_handler(struct ras_events *ras);
 int ras_mce_event_handler(struct trace_seq *s,
 			  struct pevent_record *record,
 			  struct event_format *event, void *context);
 
+/* decodes the registers at @e, using the decoder picked for mce_priv */
+int ras_mce_decode(struct ras_events *ras, struct mce_event *e);
+
+/*
+ * Decoders for CPUs not handled by the built-in ones, usually registered by
+ * plugins (see ras-plugin.h). They take precedence over the built-in ones.
+ */
+struct ras_mce_dec {
+	const char	*vendor;	/* vendor_id, as on /proc/cpuinfo */
+	unsigned int	family;
+	int		(*decode)(struct ras_events *ras, struct mce_event *e);
+};
+
+int register_mce_dec(const struct ras_mce_dec *dec);
+
+/* around the init function of a plugin, see ns_dec_tab_stage() */
+#ifdef HAVE_MCE
+void mce_dec_stage(void);
+void mce_dec_commit(int keep);
+#else
+static inline void mce_dec_stage(void) { return; };
+static inline void mce_dec_commit(int keep) { return; };
+#endif
+
+/* picks the decoder for the vendor/family/model set at mce_priv */
+int mce_select_cputype(struct ras_events *ras);
+const char *mce_cputype_name(enum cputype cputype);
+uint32_t mce_cpu_socketid(struct mce_priv *mce, unsigned int cpu);
+
 /* enables intel iMC logs */
-int set_intel_imc_log(enum cputype cputype, unsigned ncpus);
+int set_intel_imc_log(enum cputype cputype);
 
 /* Per-CPU-type decoders for Intel CPUs */
 void p4_decode_model(struct mce_event *e);
@@ -166,5 +214,8 @@ int parse_intel_event(struct ras_events *ras, struct mce_event *e);
 int parse_amd_k8_event(struct ras_events *ras, struct mce_event *e);
 
 int parse_amd_smca_event(struct ras_events *ras, struct mce_event *e);
+/* The cache is allocated when the handler is registered, rows on use */
+int amd_smca_alloc_cache(struct mce_priv *mce);
+void amd_smca_free_cache(struct mce_priv *mce);
 
 #endif
@@ -0,0 +1,371 @@
+/*
+ * Copyright (c) Huawei Technologies Co., Ltd. 2026. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+/*
+ * MCE storm detection.
+ *
+ * A single bad cache line may produce thousands of identical corrected
+ * errors per minute. Each (cpu, bank, status signature) has a token bucket
+ * of MCE_STORM_THRESHOLD tokens, refilled at MCE_STORM_RATE tokens per
+ * minute. While the bucket is empty, corrected errors are only counted,
+ * and a summary record (count, first and last seen) is emitted every
+ * MCE_STORM_INTERVAL seconds instead. Uncorrected errors always pass.
+ */
+
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ras-mce-storm.h"
+#include "ras-mce-handler.h"
+#include "ras-record.h"
+#include "ras-logger.h"
+#include "ras-env.h"
+
+#define STORM_TABLE_SIZE	256	/* must be a power of 2 */
+
+/* MCA error code and model specific error code */
+#define STORM_SIG_MASK		0xffffffffULL
+
+/* Registers of the last coalesced event, decoded on the summary */
+struct storm_regs {
+	uint64_t	mcgcap, mcgstatus, status, addr, misc, ip;
+	uint64_t	synd, ipid;
+	uint32_t	cpuid, apicid, socketid;
+	uint8_t		cs, cpuvendor;
+};
+
+struct storm_entry {
+	unsigned		used:1;
+	unsigned		storming:1;
+	uint32_t		cpu;
+	uint8_t			bank;
+	uint32_t		sig;
+
+	/* token bucket, on the monotonic clock */
+	double			tokens, stamp;
+
+	/* pending summary */
+	unsigned long long	count;
+	double			due;
+	time_t			first_seen, last_seen;
+	struct storm_regs	regs;
+};
+
+struct mce_storm {
+	pthread_mutex_t		lock;
+	unsigned long		threshold, rate, interval;
+	unsigned int		pending;
+	double			next_due;
+	struct storm_entry	tab[STORM_TABLE_SIZE];
+};
+
+static double storm_clock(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+struct mce_storm *mce_storm_init(void)
+{
+	struct mce_storm *storm;
+	unsigned long threshold, rate, interval;
+
+	threshold = ras_parse_env_ulong("MCE_STORM_THRESHOLD", 0, ULONG_MAX, 10);
+	rate = ras_parse_env_ulong("MCE_STORM_RATE", 0, ULONG_MAX, 6);
+	interval = ras_parse_env_ulong("MCE_STORM_INTERVAL", 0, ULONG_MAX, 60);
+
+	if (!threshold) {
+		log(TERM, LOG_INFO, "MCE storm detection is disabled\n");
+		return NULL;
+	}
+	if (!interval)
+		interval = 1;
+
+	storm = calloc(1, sizeof(*storm));
+	if (!storm) {
+		log(TERM, LOG_ERR, "Can't allocate memory for MCE storm data\n");
+		return NULL;
+	}
+	pthread_mutex_init(&storm->lock, NULL);
+	storm->threshold = threshold;
+	storm->rate = rate;
+	storm->interval = interval;
+
+	log(TERM, LOG_INFO,
+	    "MCE storm threshold: %lu errors, refilled at %lu/min, summary every %lus\n",
+	    threshold, rate, interval);
+
+	return storm;
+}
+
+void mce_storm_free(struct mce_storm *storm)
+{
+	if (!storm)
+		return;
+
+	pthread_mutex_destroy(&storm->lock);
+	free(storm);
+}
+
+static unsigned int storm_hash(uint32_t cpu, uint8_t bank, uint32_t sig)
+{
+	uint64_t h = ((uint64_t)cpu << 40) ^ ((uint64_t)bank << 32) ^ sig;
+
+	h *= 0x9e3779b97f4a7c15ULL;
+	return (h >> 32) & (STORM_TABLE_SIZE - 1);
+}
+
+static void storm_refill(struct mce_storm *storm, struct storm_entry *ent,
+			 double now)
+{
+	ent->tokens += (now - ent->stamp) * storm->rate / 60.0;
+	if (ent->tokens > storm->threshold)
+		ent->tokens = storm->threshold;
+	ent->stamp = now;
+}
+
+static struct storm_entry *storm_lookup(struct mce_storm *storm,
+					struct mce_event *e, double now)
+{
+	uint32_t sig = e->status & STORM_SIG_MASK;
+	unsigned int i, n;
+	struct storm_entry *ent;
+
+	i = storm_hash(e->cpu, e->bank, sig);
+	for (n = 0; n < STORM_TABLE_SIZE; n++) {
+		ent = &storm->tab[i];
+		if (!ent->used) {
+			memset(ent, 0, sizeof(*ent));
+			ent->used = 1;
+			ent->cpu = e->cpu;
+			ent->bank = e->bank;
+			ent->sig = sig;
+			ent->tokens = storm->threshold;
+			ent->stamp = now;
+			return ent;
+		}
+		if (ent->cpu == e->cpu && ent->bank == e->bank &&
+		    ent->sig == sig)
+			return ent;
+		i = (i + 1) & (STORM_TABLE_SIZE - 1);
+	}
+
+	/* Table full of tracked sources: don't rate limit new ones */
+	return NULL;
+}
+
+/* Linear probing removal, without tombstones */
+static void storm_remove(struct mce_storm *storm, unsigned int i)
+{
+	unsigned int j = i, home;
+
+	for (;;) {
+		storm->tab[i].used = 0;
+		for (;;) {
+			j = (j + 1) & (STORM_TABLE_SIZE - 1);
+			if (!storm->tab[j].used)
+				return;
+			home = storm_hash(storm->tab[j].cpu, storm->tab[j].bank,
+					  storm->tab[j].sig);
+			/* Can the entry at j be moved back to i? */
+			if (i <= j ? (home <= i || home > j) :
+				     (home <= i && home > j))
+				break;
+		}
+		storm->tab[i] = storm->tab[j];
+		i = j;
+	}
+}
+
+enum mce_storm_verdict mce_storm_check(struct mce_storm *storm,
+				       struct mce_event *e, time_t when)
+{
+	struct storm_entry *ent;
+	struct storm_regs *r;
+	double now;
+
+	if (!storm || (e->status & (MCI_STATUS_UC | MCI_STATUS_PCC)))
+		return MCE_STORM_PASS;
+
+	now = storm_clock();
+
+	pthread_mutex_lock(&storm->lock);
+
+	ent = storm_lookup(storm, e, now);
+	if (!ent) {
+		pthread_mutex_unlock(&storm->lock);
+		return MCE_STORM_PASS;
+	}
+
+	storm_refill(storm, ent, now);
+	if (ent->tokens >= 1) {
+		ent->tokens -= 1;
+		if (ent->storming && !ent->count)
+			ent->storming = 0;
+		pthread_mutex_unlock(&storm->lock);
+		return MCE_STORM_PASS;
+	}
+
+	if (!ent->storming) {
+		ent->storming = 1;
+		log(ALL, LOG_WARNING,
+		    "MCE storm on cpu %u bank %u (status 0x%llx): coalescing corrected errors\n",
+		    e->cpu, e->bank, (unsigned long long)e->status);
+	}
+
+	if (!ent->count) {
+		ent->first_seen = when;
+		ent->due = now + storm->interval;
+		if (!storm->pending++ || ent->due < storm->next_due)
+			storm->next_due = ent->due;
+	}
+	ent->count++;
+	ent->last_seen = when;
+
+	r = &ent->regs;
+	r->mcgcap = e->mcgcap;
+	r->mcgstatus = e->mcgstatus;
+	r->status = e->status;
+	r->addr = e->addr;
+	r->misc = e->misc;
+	r->ip = e->ip;
+	r->synd = e->synd;
+	r->ipid = e->ipid;
+	r->cpuid = e->cpuid;
+	r->apicid = e->apicid;
+	r->socketid = e->socketid;
+	r->cs = e->cs;
+	r->cpuvendor = e->cpuvendor;
+
+	pthread_mutex_unlock(&storm->lock);
+
+	return MCE_STORM_COALESCE;
+}
+
+static void storm_emit(struct ras_events *ras, struct storm_entry *ent)
+{
+	struct ras_mce_storm_event ev;
+	struct mce_event e;
+	struct storm_regs *r = &ent->regs;
+	struct tm tm;
+
+	memset(&e, 0, sizeof(e));
+	e.cpu = ent->cpu;
+	e.bank = ent->bank;
+	e.mcgcap = r->mcgcap;
+	e.mcgstatus = r->mcgstatus;
+	e.status = r->status;
+	e.addr = r->addr;
+	e.misc = r->misc;
+	e.ip = r->ip;
+	e.synd = r->synd;
+	e.ipid = r->ipid;
+	e.cpuid = r->cpuid;
+	e.apicid = r->apicid;
+	e.socketid = r->socketid;
+	e.cs = r->cs;
+	e.cpuvendor = r->cpuvendor;
+
+	ras_mce_decode(ras, &e);
+
+	memset(&ev, 0, sizeof(ev));
+	ev.count = ent->count;
+	ev.mce = &e;
+	if (localtime_r(&ent->first_seen, &tm))
+		strftime(ev.first_seen, sizeof(ev.first_seen),
+			 "%Y-%m-%d %H:%M:%S %z", &tm);
+	if (localtime_r(&ent->last_seen, &tm))
+		strftime(ev.last_seen, sizeof(ev.last_seen),
+			 "%Y-%m-%d %H:%M:%S %z", &tm);
+
+	log(ALL, LOG_WARNING,
+	    "MCE storm on cpu %u bank %u: %llu corrected errors from %s to %s: %s%s%s\n",
+	    e.cpu, e.bank, ev.count, ev.first_seen, ev.last_seen,
+	    e.bank_name, *e.bank_name ? ", " : "", e.error_msg);
+
+#ifdef HAVE_SQLITE3
+	ras_store_mce_storm(ras, &ev);
+#endif
+}
+
+int mce_storm_flush(struct ras_events *ras, int force)
+{
+	struct mce_priv *mce = ras->mce_priv;
+	struct mce_storm *storm = mce ? mce->storm : NULL;
+	struct storm_entry *ent;
+	double now, next = 0, idle;
+	unsigned int i;
+	int timeout;
+
+	if (!storm)
+		return -1;
+
+	now = storm_clock();
+
+	pthread_mutex_lock(&storm->lock);
+
+	if (!force && (!storm->pending || now < storm->next_due))
+		goto out;
+
+	for (i = 0; i < STORM_TABLE_SIZE; i++) {
+		ent = &storm->tab[i];
+		if (!ent->used)
+			continue;
+
+		if (ent->count && (force || now >= ent->due)) {
+			storm_emit(ras, ent);
+			ent->count = 0;
+			storm->pending--;
+		}
+
+		if (ent->count) {
+			if (!next || ent->due < next)
+				next = ent->due;
+			continue;
+		}
+
+		/* Forget sources whose bucket is full again */
+		idle = (now - ent->stamp) * storm->rate / 60.0;
+		if (ent->tokens + idle >= storm->threshold &&
+		    now - ent->stamp >= storm->interval) {
+			storm_remove(storm, i);
+			/* An entry may have been moved back into this slot */
+			i--;
+		}
+	}
+	storm->next_due = next;
+
+out:
+	if (storm->pending) {
+		timeout = (storm->next_due - now) * 1000;
+		if (timeout < 0)
+			timeout = 0;
+	} else {
+		timeout = -1;
+	}
+	pthread_mutex_unlock(&storm->lock);
+
+	return timeout;
+}
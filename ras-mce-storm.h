@@ -0,0 +1,47 @@
+/*
+ * Copyright (c) Huawei Technologies Co., Ltd. 2026. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#ifndef __RAS_MCE_STORM_H
+#define __RAS_MCE_STORM_H
+
+#include <time.h>
+
+struct ras_events;
+struct mce_event;
+struct mce_storm;
+
+enum mce_storm_verdict {
+	MCE_STORM_PASS,		/* handle the event as usual */
+	MCE_STORM_COALESCE,	/* accounted on a storm summary */
+};
+
+struct mce_storm *mce_storm_init(void);
+void mce_storm_free(struct mce_storm *storm);
+
+/* @when is the wall clock time of the event */
+enum mce_storm_verdict mce_storm_check(struct mce_storm *storm,
+				       struct mce_event *e, time_t when);
+
+/*
+ * Emits the summaries that are due (or all pending ones, if @force).
+ * Returns how many milliseconds until the next one is due, or -1 if
+ * nothing is pending, so that it can be used as a poll() timeout.
+ */
+int mce_storm_flush(struct ras_events *ras, int force);
+
+#endif
@@ -0,0 +1,600 @@
+/*
+ * Copyright (c) Huawei Technologies Co., Ltd. 2026. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <limits.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include "ras-metrics.h"
+#include "ras-events.h"
+#include "ras-logger.h"
+#include "ras-env.h"
+
+/* Latency buckets: up to 1us, 2us, 4us... 1s, then +Inf */
+#define METRICS_BUCKETS		21
+
+struct metrics_hist {
+	uint64_t		buckets[METRICS_BUCKETS + 1];
+	uint64_t		sum_ns, count;
+};
+
+/* The metrics updated by a thread */
+struct metrics_block {
+	struct metrics_block	*next;
+	uint64_t		counters[NR_RAS_METRICS];
+	uint64_t		parse_errors[NR_EVENTS];
+	struct metrics_hist	decode[NR_EVENTS];
+	struct metrics_hist	db_step;
+	struct metrics_hist	db_commit;
+
+	/* received and decoded [NR_EVENTS][ncpus], then missed [ncpus] */
+	uint64_t		per_cpu[];
+};
+
+#define PER_CPU_RECEIVED(type)	((type) * ncpus)
+#define PER_CPU_DECODED(type)	((NR_EVENTS + (type)) * ncpus)
+#define PER_CPU_MISSED		(2 * NR_EVENTS * ncpus)
+
+static const struct {
+	const char	*name, *help, *labels;
+} metric_info[NR_RAS_METRICS] = {
+	[RAS_METRIC_ABRT_SENT] = {
+		"rasdaemon_abrt_reports_total",
+		"Reports to ABRT, by result", "result=\"sent\"" },
+	[RAS_METRIC_ABRT_FAILED] = {
+		"rasdaemon_abrt_reports_total", NULL, "result=\"failed\"" },
+	[RAS_METRIC_ABRT_DOWN] = {
+		"rasdaemon_abrt_reports_total", NULL, "result=\"down\"" },
+	[RAS_METRIC_ABRT_DROPPED] = {
+		"rasdaemon_abrt_reports_total", NULL, "result=\"dropped\"" },
+	[RAS_METRIC_STREAM_DROPPED] = {
+		"rasdaemon_stream_dropped_total",
+		"Events dropped for slow stream clients", NULL },
+	[RAS_METRIC_LOG_DROPPED] = {
+		"rasdaemon_log_dropped_total",
+		"Log messages dropped while the log queue was full", NULL },
+	[RAS_METRIC_PAGE_OFFLINED] = {
+		"rasdaemon_page_offline_total",
+		"Pages offlined for too many corrected errors, by result",
+		"result=\"offlined\"" },
+	[RAS_METRIC_PAGE_OFFLINE_FAILED] = {
+		"rasdaemon_page_offline_total", NULL, "result=\"failed\"" },
+	[RAS_METRIC_LANE_URGENT] = {
+		"rasdaemon_events_lane_total",
+		"Trace events handled, by lane: urgent ones bypass the batching",
+		"lane=\"urgent\"" },
+	[RAS_METRIC_LANE_BATCHED] = {
+		"rasdaemon_events_lane_total", NULL, "lane=\"batched\"" },
+};
+
+static const struct {
+	const char	*name, *help;
+} gauge_info[NR_RAS_GAUGES] = {
+	[RAS_GAUGE_ABRT_QUEUE] = {
+		"rasdaemon_abrt_queue_reports",
+		"Reports waiting to be sent to ABRT" },
+	[RAS_GAUGE_STREAM_QUEUE] = {
+		"rasdaemon_stream_queue_bytes",
+		"Bytes waiting to be sent to stream clients" },
+	[RAS_GAUGE_STREAM_CLIENTS] = {
+		"rasdaemon_stream_clients",
+		"Connected stream clients" },
+};
+
+int ras_metrics_on;
+
+static int ncpus;
+static struct metrics_block *blocks;
+static pthread_mutex_t blocks_lock = PTHREAD_MUTEX_INITIALIZER;
+static __thread struct metrics_block *self;
+static long gauges[NR_RAS_GAUGES];
+
+static struct {
+	char		*path, *file;
+	unsigned long	interval;
+	int		listen_fd, wake_fd;
+	pthread_t	thread;
+	int		stop;
+} exporter = {
+	.listen_fd = -1,
+	.wake_fd = -1,
+};
+
+static struct metrics_block *metrics_self(void)
+{
+	struct metrics_block *b = self;
+
+	if (b)
+		return b;
+
+	b = calloc(1, sizeof(*b) + (2 * NR_EVENTS + 1) * ncpus *
+		   sizeof(b->per_cpu[0]));
+	if (!b)
+		return NULL;
+
+	pthread_mutex_lock(&blocks_lock);
+	b->next = blocks;
+	__atomic_store_n(&blocks, b, __ATOMIC_RELEASE);
+	pthread_mutex_unlock(&blocks_lock);
+
+	self = b;
+	return b;
+}
+
+/* Only the owner thread writes to a block: no need for atomic adds */
+static inline void metrics_add(uint64_t *val, uint64_t n)
+{
+	__atomic_store_n(val, __atomic_load_n(val, __ATOMIC_RELAXED) + n,
+			 __ATOMIC_RELAXED);
+}
+
+static void metrics_observe(struct metrics_hist *h, uint64_t start)
+{
+	uint64_t ns = ras_metrics_now() - start, us = (ns + 999) / 1000;
+	int i;
+
+	/* Rounded up, as the buckets count the times up to their bound */
+	i = us <= 1 ? 0 : 64 - __builtin_clzll(us - 1);
+	if (i > METRICS_BUCKETS)
+		i = METRICS_BUCKETS;
+
+	metrics_add(&h->buckets[i], 1);
+	metrics_add(&h->sum_ns, ns);
+	metrics_add(&h->count, 1);
+}
+
+void ras_metrics_add(enum ras_metric m, uint64_t n)
+{
+	struct metrics_block *b;
+
+	if (!ras_metrics_on || !(b = metrics_self()))
+		return;
+
+	metrics_add(&b->counters[m], n);
+}
+
+void ras_metrics_set(enum ras_gauge g, long val)
+{
+	if (ras_metrics_on)
+		__atomic_store_n(&gauges[g], val, __ATOMIC_RELAXED);
+}
+
+void ras_metrics_event(int type, int cpu, int rc, uint64_t start)
+{
+	struct metrics_block *b;
+
+	if (!ras_metrics_on || !(b = metrics_self()))
+		return;
+
+	if (cpu >= 0 && cpu < ncpus) {
+		metrics_add(&b->per_cpu[PER_CPU_RECEIVED(type) + cpu], 1);
+		if (!rc)
+			metrics_add(&b->per_cpu[PER_CPU_DECODED(type) + cpu], 1);
+	}
+	if (rc)
+		metrics_add(&b->parse_errors[type], 1);
+
+	metrics_observe(&b->decode[type], start);
+}
+
+void ras_metrics_missed(int cpu, int missed)
+{
+	struct metrics_block *b;
+
+	if (!missed || !ras_metrics_on || cpu < 0 || cpu >= ncpus ||
+	    !(b = metrics_self()))
+		return;
+
+	/* The count is not always known: at least one was missed then */
+	metrics_add(&b->per_cpu[PER_CPU_MISSED + cpu], missed > 0 ? missed : 1);
+}
+
+void ras_metrics_db_step(uint64_t start)
+{
+	struct metrics_block *b;
+
+	if (!ras_metrics_on || !(b = metrics_self()))
+		return;
+
+	metrics_observe(&b->db_step, start);
+}
+
+void ras_metrics_db_commit(uint64_t start)
+{
+	struct metrics_block *b;
+
+	if (!ras_metrics_on || !(b = metrics_self()))
+		return;
+
+	metrics_observe(&b->db_commit, start);
+}
+
+/*
+ * Exposition
+ */
+
+/* Sum of the same metric on all threads, @off being its offset in a block */
+static uint64_t metrics_sum(size_t off)
+{
+	struct metrics_block *b;
+	uint64_t sum = 0;
+
+	for (b = __atomic_load_n(&blocks, __ATOMIC_ACQUIRE); b; b = b->next)
+		sum += __atomic_load_n((uint64_t *)((char *)b + off),
+				       __ATOMIC_RELAXED);
+
+	return sum;
+}
+
+#define METRICS_SUM(member)	metrics_sum(offsetof(struct metrics_block, member))
+
+static void metrics_print_hist(FILE *f, const char *name, const char *label,
+			       size_t off)
+{
+	const char *sep = label ? "," : "";
+	uint64_t count = 0;
+	char labels[80];
+	int i;
+
+	if (!label)
+		label = "";
+
+	for (i = 0; i < METRICS_BUCKETS; i++) {
+		count += metrics_sum(off + offsetof(struct metrics_hist,
+						    buckets[i]));
+		fprintf(f, "%s_bucket{%s%sle=\"%.9g\"} %llu\n", name, label, sep,
+			(double)(1 << i) / 1000000, (unsigned long long)count);
+	}
+	count += metrics_sum(off + offsetof(struct metrics_hist,
+					    buckets[METRICS_BUCKETS]));
+	fprintf(f, "%s_bucket{%s%sle=\"+Inf\"} %llu\n", name, label, sep,
+		(unsigned long long)count);
+
+	snprintf(labels, sizeof(labels), *label ? "{%s}" : "%s", label);
+	fprintf(f, "%s_sum%s %.9f\n", name, labels,
+		(double)metrics_sum(off + offsetof(struct metrics_hist,
+						   sum_ns)) / 1000000000);
+	fprintf(f, "%s_count%s %llu\n", name, labels,
+		(unsigned long long)metrics_sum(off +
+						offsetof(struct metrics_hist,
+							 count)));
+}
+
+static void metrics_print_per_cpu(FILE *f, const char *name, const char *help,
+				  int type, size_t first)
+{
+	uint64_t val;
+	int cpu;
+
+	if (help)
+		fprintf(f, "# HELP %s %s\n# TYPE %s counter\n", name, help, name);
+
+	/* Only the CPUs that saw something */
+	for (cpu = 0; cpu < ncpus; cpu++) {
+		val = METRICS_SUM(per_cpu[first + cpu]);
+		if (!val)
+			continue;
+		if (type < 0)
+			fprintf(f, "%s{cpu=\"%d\"} %llu\n", name, cpu,
+				(unsigned long long)val);
+		else
+			fprintf(f, "%s{type=\"%s\",cpu=\"%d\"} %llu\n", name,
+				ras_event_names[type], cpu,
+				(unsigned long long)val);
+	}
+}
+
+static void metrics_print(FILE *f)
+{
+	char labels[64];
+	int i;
+
+	for (i = 0; i < NR_EVENTS; i++)
+		metrics_print_per_cpu(f, "rasdaemon_events_received_total",
+				      i ? NULL : "Trace events received",
+				      i, PER_CPU_RECEIVED(i));
+	for (i = 0; i < NR_EVENTS; i++)
+		metrics_print_per_cpu(f, "rasdaemon_events_decoded_total",
+				      i ? NULL : "Trace events decoded",
+				      i, PER_CPU_DECODED(i));
+	metrics_print_per_cpu(f, "rasdaemon_events_missed_total",
+			      "Trace events lost by the kernel", -1,
+			      PER_CPU_MISSED);
+
+	fprintf(f, "# HELP rasdaemon_parse_errors_total Trace events that couldn't be parsed\n"
+		   "# TYPE rasdaemon_parse_errors_total counter\n");
+	for (i = 0; i < NR_EVENTS; i++)
+		fprintf(f, "rasdaemon_parse_errors_total{type=\"%s\"} %llu\n",
+			ras_event_names[i],
+			(unsigned long long)METRICS_SUM(parse_errors[i]));
+
+	fprintf(f, "# HELP rasdaemon_decode_seconds Time to handle a trace event\n"
+		   "# TYPE rasdaemon_decode_seconds histogram\n");
+	for (i = 0; i < NR_EVENTS; i++) {
+		if (!METRICS_SUM(decode[i].count))
+			continue;
+		snprintf(labels, sizeof(labels), "type=\"%s\"",
+			 ras_event_names[i]);
+		metrics_print_hist(f, "rasdaemon_decode_seconds", labels,
+				   offsetof(struct metrics_block, decode[i]));
+	}
+
+	/* Unless batched, each insert is its own transaction, with its commit */
+	fprintf(f, "# HELP rasdaemon_db_step_seconds Time to store an event on the database\n"
+		   "# TYPE rasdaemon_db_step_seconds histogram\n");
+	metrics_print_hist(f, "rasdaemon_db_step_seconds", NULL,
+			   offsetof(struct metrics_block, db_step));
+
+	fprintf(f, "# HELP rasdaemon_db_commit_seconds Time to commit a batch of events on the database\n"
+		   "# TYPE rasdaemon_db_commit_seconds histogram\n");
+	metrics_print_hist(f, "rasdaemon_db_commit_seconds", NULL,
+			   offsetof(struct metrics_block, db_commit));
+
+	for (i = 0; i < NR_RAS_METRICS; i++) {
+		if (metric_info[i].help)
+			fprintf(f, "# HELP %s %s\n# TYPE %s counter\n",
+				metric_info[i].name, metric_info[i].help,
+				metric_info[i].name);
+		if (metric_info[i].labels)
+			fprintf(f, "%s{%s} %llu\n", metric_info[i].name,
+				metric_info[i].labels,
+				(unsigned long long)METRICS_SUM(counters[i]));
+		else
+			fprintf(f, "%s %llu\n", metric_info[i].name,
+				(unsigned long long)METRICS_SUM(counters[i]));
+	}
+
+	for (i = 0; i < NR_RAS_GAUGES; i++)
+		fprintf(f, "# HELP %s %s\n# TYPE %s gauge\n%s %ld\n",
+			gauge_info[i].name, gauge_info[i].help,
+			gauge_info[i].name, gauge_info[i].name,
+			__atomic_load_n(&gauges[i], __ATOMIC_RELAXED));
+}
+
+static char *metrics_render(size_t *len)
+{
+	char *buf = NULL;
+	FILE *f;
+
+	f = open_memstream(&buf, len);
+	if (!f)
+		return NULL;
+	metrics_print(f);
+	if (fclose(f)) {
+		free(buf);
+		return NULL;
+	}
+
+	return buf;
+}
+
+/* Rewrites the metrics file, atomically for its readers */
+static void metrics_write_file(void)
+{
+	char tmp[PATH_MAX];
+	size_t len;
+	char *buf;
+	FILE *f;
+
+	buf = metrics_render(&len);
+	if (!buf)
+		return;
+
+	snprintf(tmp, sizeof(tmp), "%s.tmp", exporter.file);
+	f = fopen(tmp, "w");
+	if (f) {
+		if (fwrite(buf, 1, len, f) != len || fclose(f) ||
+		    rename(tmp, exporter.file))
+			unlink(tmp);
+	}
+	free(buf);
+}
+
+static void metrics_serve(void)
+{
+	struct timeval tv = { .tv_sec = 1 };
+	size_t len, off = 0;
+	ssize_t rc;
+	char *buf;
+	int fd;
+
+	fd = accept4(exporter.listen_fd, NULL, NULL, SOCK_CLOEXEC);
+	if (fd < 0)
+		return;
+
+	/* A stuck client must not stall the file updates */
+	setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+
+	buf = metrics_render(&len);
+	while (buf && off < len) {
+		rc = send(fd, buf + off, len - off, MSG_NOSIGNAL);
+		if (rc <= 0)
+			break;
+		off += rc;
+	}
+	free(buf);
+	close(fd);
+}
+
+static void *metrics_thread(void *arg)
+{
+	struct pollfd fds[2];
+	struct timespec now, next = { 0 };
+	int timeout;
+	sigset_t mask;
+
+	/* Signals are handled by the main thread */
+	sigfillset(&mask);
+	pthread_sigmask(SIG_BLOCK, &mask, NULL);
+
+	fds[0].fd = exporter.wake_fd;
+	fds[0].events = POLLIN;
+	fds[1].fd = exporter.listen_fd;
+	fds[1].events = POLLIN;
+
+	while (!__atomic_load_n(&exporter.stop, __ATOMIC_ACQUIRE)) {
+		timeout = -1;
+		if (exporter.file) {
+			clock_gettime(CLOCK_MONOTONIC, &now);
+			if (now.tv_sec >= next.tv_sec) {
+				metrics_write_file();
+				next.tv_sec = now.tv_sec + exporter.interval;
+			}
+			timeout = (next.tv_sec - now.tv_sec) * 1000;
+		}
+
+		if (poll(fds, exporter.listen_fd >= 0 ? 2 : 1, timeout) <= 0)
+			continue;
+		if (fds[1].revents & POLLIN)
+			metrics_serve();
+	}
+
+	return NULL;
+}
+
+static int metrics_listen(const char *path)
+{
+	struct sockaddr_un addr;
+	int fd;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if (strlen(path) >= sizeof(addr.sun_path))
+		return -1;
+	strcpy(addr.sun_path, path);
+
+	fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (fd < 0)
+		return -1;
+
+	/* Only root can read them: nobody can connect before listen() */
+	unlink(path);
+	if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+	    chmod(path, 0600) < 0 ||
+	    listen(fd, 4) < 0) {
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+int ras_metrics_init(unsigned int cpus)
+{
+	char *path = getenv("RAS_METRICS_SOCKET");
+	char *file = getenv("RAS_METRICS_FILE");
+
+	if (path && !*path)
+		path = NULL;
+	if (file && !*file)
+		file = NULL;
+	if (!path && !file)
+		return 0;
+
+	exporter.interval = ras_parse_env_ulong("RAS_METRICS_INTERVAL", 1,
+						ULONG_MAX, 15);
+
+	ncpus = cpus ? cpus : 1;
+
+	if (path) {
+		exporter.listen_fd = metrics_listen(path);
+		if (exporter.listen_fd < 0) {
+			log(ALL, LOG_ERR, "Can't listen on %s: %s\n", path,
+			    strerror(errno));
+			goto err;
+		}
+		exporter.path = strdup(path);
+	}
+	if (file)
+		exporter.file = strdup(file);
+
+	exporter.wake_fd = eventfd(0, EFD_CLOEXEC);
+	if (exporter.wake_fd < 0)
+		goto err;
+
+	ras_metrics_on = 1;
+	if (pthread_create(&exporter.thread, NULL, metrics_thread, NULL)) {
+		ras_metrics_on = 0;
+		goto err;
+	}
+
+	log(ALL, LOG_INFO, "Exporting metrics%s%s%s%s\n",
+	    path ? " on " : "", path ? path : "",
+	    file ? " to " : "", file ? file : "");
+
+	return 0;
+
+err:
+	log(ALL, LOG_ERR, "Can't set up the metrics\n");
+	if (exporter.listen_fd >= 0) {
+		close(exporter.listen_fd);
+		unlink(path);
+		exporter.listen_fd = -1;
+	}
+	if (exporter.wake_fd >= 0) {
+		close(exporter.wake_fd);
+		exporter.wake_fd = -1;
+	}
+	free(exporter.path);
+	free(exporter.file);
+	exporter.path = exporter.file = NULL;
+
+	return -1;
+}
+
+/*
+ * The blocks are kept: threads that are still running, like the ABRT
+ * reporter, may update them until exit.
+ */
+void ras_metrics_exit(void)
+{
+	uint64_t one = 1;
+
+	if (!ras_metrics_on)
+		return;
+
+	__atomic_store_n(&exporter.stop, 1, __ATOMIC_RELEASE);
+	if (write(exporter.wake_fd, &one, sizeof(one)) == sizeof(one))
+		pthread_join(exporter.thread, NULL);
+
+	/* Last snapshot */
+	if (exporter.file)
+		metrics_write_file();
+
+	if (exporter.listen_fd >= 0) {
+		close(exporter.listen_fd);
+		unlink(exporter.path);
+	}
+	close(exporter.wake_fd);
+	free(exporter.path);
+	free(exporter.file);
+	exporter.path = exporter.file = NULL;
+	exporter.listen_fd = exporter.wake_fd = -1;
+}
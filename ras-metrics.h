@@ -0,0 +1,87 @@
+/*
+ * Copyright (c) Huawei Technologies Co., Ltd. 2026. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#ifndef __RAS_METRICS_H
+#define __RAS_METRICS_H
+
+#include <stdint.h>
+#include <time.h>
+
+/*
+ * Metrics about rasdaemon itself, exposed in the Prometheus text format
+ * on the RAS_METRICS_SOCKET UNIX socket, and on the RAS_METRICS_FILE file.
+ * Nothing is collected unless either is set.
+ *
+ * Each thread updates its own copy of the metrics, without locks nor
+ * atomic read-modify-write: they are only summed up when read.
+ */
+
+enum ras_metric {
+	RAS_METRIC_ABRT_SENT,
+	RAS_METRIC_ABRT_FAILED,		/* sending the report failed */
+	RAS_METRIC_ABRT_DOWN,		/* couldn't connect to ABRT */
+	RAS_METRIC_ABRT_DROPPED,	/* rate limited, or the queue was full */
+	RAS_METRIC_STREAM_DROPPED,
+	RAS_METRIC_LOG_DROPPED,
+	RAS_METRIC_PAGE_OFFLINED,
+	RAS_METRIC_PAGE_OFFLINE_FAILED,
+	RAS_METRIC_LANE_URGENT,		/* events, by lane */
+	RAS_METRIC_LANE_BATCHED,
+	NR_RAS_METRICS
+};
+
+enum ras_gauge {
+	RAS_GAUGE_ABRT_QUEUE,		/* reports */
+	RAS_GAUGE_STREAM_QUEUE,		/* bytes, all clients */
+	RAS_GAUGE_STREAM_CLIENTS,
+	NR_RAS_GAUGES
+};
+
+extern int ras_metrics_on;
+
+int ras_metrics_init(unsigned int cpus);
+void ras_metrics_exit(void);
+
+void ras_metrics_add(enum ras_metric m, uint64_t n);
+void ras_metrics_set(enum ras_gauge g, long val);
+
+/* A trace event of @type, handled since @start, and its handler result */
+void ras_metrics_event(int type, int cpu, int rc, uint64_t start);
+void ras_metrics_missed(int cpu, int missed);
+void ras_metrics_db_step(uint64_t start);
+void ras_metrics_db_commit(uint64_t start);
+
+/* Start time for the latency metrics, in ns */
+static inline uint64_t ras_metrics_now(void)
+{
+	struct timespec ts;
+
+	if (!ras_metrics_on)
+		return 0;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static inline void ras_metrics_inc(enum ras_metric m)
+{
+	if (ras_metrics_on)
+		ras_metrics_add(m, 1);
+}
+
+#endif
@@ -0,0 +1,301 @@
+/*
+ * Copyright (c) Huawei Technologies Co., Ltd. 2026. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "ras-msr.h"
+#include "ras-logger.h"
+
+#define SYS_CPU_DIR		"/sys/devices/system/cpu"
+#define MSR_MAX_THREADS		32
+
+enum msr_stage {
+	MSR_OK,
+	MSR_OPEN,
+	MSR_READ,
+	MSR_WRITE,
+	MSR_REREAD,
+	MSR_VERIFY,
+};
+
+static const char *msr_stage_name[] = {
+	[MSR_OK]	= "ok",
+	[MSR_OPEN]	= "open",
+	[MSR_READ]	= "read",
+	[MSR_WRITE]	= "write",
+	[MSR_REREAD]	= "re-read",
+	[MSR_VERIFY]	= "verify",
+};
+
+struct msr_result {
+	int		cpu;
+	enum msr_stage	stage;
+	int		err;
+	uint64_t	old, new;
+};
+
+struct msr_job {
+	const struct msr_update	*upd;
+	struct msr_result	*res;
+	int			nres;
+	int			next;
+};
+
+/*
+ * Parses a sysfs cpu list, like "0-3,8,10-11". Returns the number of CPUs
+ * stored at *cpus, or a negative errno.
+ */
+static int read_online_cpus(int **cpus)
+{
+	FILE *f;
+	char *line = NULL, *p, *end;
+	size_t linelen = 0;
+	int *list = NULL, *tmp;
+	int n = 0, size = 0;
+	long first, last, cpu;
+
+	f = fopen(SYS_CPU_DIR "/online", "r");
+	if (!f)
+		return -errno;
+
+	if (getline(&line, &linelen, f) <= 0) {
+		fclose(f);
+		free(line);
+		return -EINVAL;
+	}
+	fclose(f);
+
+	for (p = line; *p && *p != '\n'; p = end) {
+		first = strtol(p, &end, 10);
+		if (end == p)
+			goto err;
+		last = first;
+		if (*end == '-') {
+			p = end + 1;
+			last = strtol(p, &end, 10);
+			if (end == p || last < first)
+				goto err;
+		}
+		if (*end == ',')
+			end++;
+
+		for (cpu = first; cpu <= last; cpu++) {
+			if (n == size) {
+				size = size ? size * 2 : 64;
+				tmp = realloc(list, size * sizeof(*list));
+				if (!tmp)
+					goto err;
+				list = tmp;
+			}
+			list[n++] = cpu;
+		}
+	}
+	free(line);
+
+	*cpus = list;
+	return n;
+
+err:
+	free(line);
+	free(list);
+	return -EINVAL;
+}
+
+static int read_package_id(int cpu)
+{
+	char fpath[64];
+	FILE *f;
+	int id;
+
+	snprintf(fpath, sizeof(fpath),
+		 SYS_CPU_DIR "/cpu%d/topology/physical_package_id", cpu);
+	f = fopen(fpath, "r");
+	if (!f)
+		return -1;
+	if (fscanf(f, "%d", &id) != 1)
+		id = -1;
+	fclose(f);
+
+	return id;
+}
+
+/* Keeps only the first online CPU of each package */
+static int filter_one_per_package(int *cpus, int n)
+{
+	int *pkg, i, j, id, count = 0;
+
+	pkg = calloc(n, sizeof(*pkg));
+	if (!pkg)
+		return n;
+
+	for (i = 0; i < n; i++) {
+		id = read_package_id(cpus[i]);
+		if (id >= 0) {
+			for (j = 0; j < count; j++)
+				if (pkg[j] == id)
+					break;
+			if (j < count)
+				continue;
+		}
+		/* Unknown topology: program this CPU, just in case */
+		pkg[count] = id;
+		cpus[count++] = cpus[i];
+	}
+	free(pkg);
+
+	return count;
+}
+
+/* The error of a pread() or pwrite() of an MSR: EIO if it was short */
+static int msr_xfer_err(ssize_t rc)
+{
+	return rc < 0 ? errno : EIO;
+}
+
+static void msr_update_cpu(const struct msr_update *upd, struct msr_result *r)
+{
+	char fpath[32];
+	uint64_t data, mask = upd->set | upd->clear;
+	ssize_t rc;
+	int fd;
+
+	snprintf(fpath, sizeof(fpath), "/dev/cpu/%d/msr", r->cpu);
+	fd = open(fpath, O_RDWR);
+	if (fd == -1) {
+		r->stage = MSR_OPEN;
+		r->err = errno;
+		return;
+	}
+
+	rc = pread(fd, &data, sizeof(data), upd->msr);
+	if (rc != sizeof(data)) {
+		r->stage = MSR_READ;
+		r->err = msr_xfer_err(rc);
+		goto out;
+	}
+	r->old = data;
+
+	data = (data & ~upd->clear) | upd->set;
+	if (data != r->old) {
+		rc = pwrite(fd, &data, sizeof(data), upd->msr);
+		if (rc != sizeof(data)) {
+			r->stage = MSR_WRITE;
+			r->err = msr_xfer_err(rc);
+			goto out;
+		}
+	}
+
+	rc = pread(fd, &data, sizeof(data), upd->msr);
+	if (rc != sizeof(data)) {
+		r->stage = MSR_REREAD;
+		r->err = msr_xfer_err(rc);
+		goto out;
+	}
+	r->new = data;
+
+	r->stage = (data & mask) != upd->set ? MSR_VERIFY : MSR_OK;
+	r->err = 0;
+out:
+	close(fd);
+}
+
+static void *msr_thread(void *priv)
+{
+	struct msr_job *job = priv;
+	int i;
+
+	for (;;) {
+		i = __sync_fetch_and_add(&job->next, 1);
+		if (i >= job->nres)
+			break;
+		msr_update_cpu(job->upd, &job->res[i]);
+	}
+
+	return NULL;
+}
+
+int ras_msr_update(const struct msr_update *upd)
+{
+	struct msr_job job;
+	pthread_t tid[MSR_MAX_THREADS];
+	int *cpus = NULL, n, i, nthreads, failed = 0;
+
+	n = read_online_cpus(&cpus);
+	if (n <= 0) {
+		log(ALL, LOG_ERR, "Can't read the list of online CPUs to set %s\n",
+		    upd->name);
+		return n ? n : -ENODEV;
+	}
+	if (upd->scope == MSR_SCOPE_PACKAGE)
+		n = filter_one_per_package(cpus, n);
+
+	memset(&job, 0, sizeof(job));
+	job.upd = upd;
+	job.nres = n;
+	job.res = calloc(n, sizeof(*job.res));
+	if (!job.res) {
+		free(cpus);
+		return -ENOMEM;
+	}
+	for (i = 0; i < n; i++)
+		job.res[i].cpu = cpus[i];
+	free(cpus);
+
+	/*
+	 * Each MSR access is a cross-CPU call on the kernel side, so running
+	 * them in parallel hides most of the latency on large systems.
+	 */
+	nthreads = n - 1 < MSR_MAX_THREADS ? n - 1 : MSR_MAX_THREADS;
+	for (i = 0; i < nthreads; i++) {
+		if (pthread_create(&tid[i], NULL, msr_thread, &job)) {
+			nthreads = i;
+			break;
+		}
+	}
+	/* The caller thread always helps, so this works even with no threads */
+	msr_thread(&job);
+	for (i = 0; i < nthreads; i++)
+		pthread_join(tid[i], NULL);
+
+	for (i = 0; i < n; i++) {
+		struct msr_result *r = &job.res[i];
+
+		if (r->stage == MSR_OK) {
+			log(SYSLOG, LOG_DEBUG, "%s on cpu %d: 0x%llx -> 0x%llx\n",
+			    upd->name, r->cpu, (unsigned long long)r->old,
+			    (unsigned long long)r->new);
+			continue;
+		}
+		failed++;
+		log(ALL, LOG_ERR, "Can't set %s on cpu %d: %s failed%s%s\n",
+		    upd->name, r->cpu, msr_stage_name[r->stage],
+		    r->err ? ": " : "", r->err ? strerror(r->err) : "");
+	}
+	log(ALL, LOG_INFO, "%s set on %d of %d %s\n", upd->name, n - failed, n,
+	    upd->scope == MSR_SCOPE_PACKAGE ? "packages" : "CPUs");
+
+	free(job.res);
+
+	return failed;
+}
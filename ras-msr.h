@@ -0,0 +1,49 @@
+/*
+ * Copyright (c) Huawei Technologies Co., Ltd. 2026. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#ifndef __RAS_MSR_H
+#define __RAS_MSR_H
+
+#include <stdint.h>
+
+enum msr_scope {
+	MSR_SCOPE_THREAD,	/* every online logical CPU */
+	MSR_SCOPE_PACKAGE,	/* one online CPU per physical package */
+};
+
+/*
+ * Read-modify-write of one MSR: new = (old & ~clear) | set. The value is
+ * read back afterwards, and the update only counts as done if the bits in
+ * (set | clear) hold what was asked for.
+ */
+struct msr_update {
+	const char	*name;		/* used on log messages */
+	uint32_t	msr;
+	uint64_t	set;
+	uint64_t	clear;
+	enum msr_scope	scope;
+};
+
+/*
+ * Applies the update on the online CPUs selected by upd->scope, in parallel.
+ * Failures are logged per CPU. Returns the number of CPUs where the update
+ * failed, or a negative errno if it couldn't be attempted at all.
+ */
+int ras_msr_update(const struct msr_update *upd);
+
+#endif
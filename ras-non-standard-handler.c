@@ -11,6 +11,7 @@
  * GNU General Public License for more details.
  */
 
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
@@ -21,25 +22,215 @@
 #include "ras-record.h"
 #include "ras-logger.h"
 #include "ras-report.h"
+#include "ras-stream.h"
+#include "ras-plugin.h"
+#include "ras-format.h"
 
 static p_ns_dec_tab * ns_dec_tab;
 static size_t dec_tab_count;
 
+/*
+ * Decoders by section type. The sec_type strings are parsed once into the
+ * binary layout used by the trace event, so matching an event is a hash
+ * and a 16 bytes compare.
+ */
+struct ns_dec_hash_entry {
+	uint8_t		guid[16];
+	p_ns_dec_tab	dec;		/* NULL if the slot is free */
+};
+
+static struct ns_dec_hash_entry *ns_dec_hash;
+static size_t ns_dec_hash_size, ns_dec_hash_used;
+
+/*
+ * Plugins register their decoders when the first event of their section
+ * types shows up, from the handler threads: growing the hash frees the old
+ * table, so it is only looked up with this lock held.
+ */
+static pthread_rwlock_t ns_dec_lock = PTHREAD_RWLOCK_INITIALIZER;
+
+/* First table of the plugin being initialized, -1 if none */
+static int ns_dec_staged = -1;
+
+/* Byte order of the sec_type strings, as printed by ras_uuid_le() */
+static const unsigned char uuid_le_order[16] = {
+	3, 2, 1, 0, 5, 4, 7, 6, 8, 9, 10, 11, 12, 13, 14, 15
+};
+
+static int hex_nibble(char c)
+{
+	if (c >= '0' && c <= '9')
+		return c - '0';
+	if (c >= 'a' && c <= 'f')
+		return c - 'a' + 10;
+	if (c >= 'A' && c <= 'F')
+		return c - 'A' + 10;
+	return -1;
+}
+
+int ns_parse_sec_type(const char *sec_type, uint8_t *guid)
+{
+	int i, hi, lo;
+
+	for (i = 0; i < 16; i++) {
+		hi = hex_nibble(sec_type[2 * i]);
+		if (hi < 0)
+			return -1;
+		lo = hex_nibble(sec_type[2 * i + 1]);
+		if (lo < 0)
+			return -1;
+		guid[uuid_le_order[i]] = (hi << 4) | lo;
+	}
+
+	return sec_type[32] ? -1 : 0;
+}
+
+static size_t guid_hash(const uint8_t *guid)
+{
+	uint64_t a, b;
+
+	memcpy(&a, guid, sizeof(a));
+	memcpy(&b, guid + 8, sizeof(b));
+	a ^= (b << 29) | (b >> 35);
+	a *= 0x9e3779b97f4a7c15ULL;
+
+	return a >> 32;
+}
+
+static struct ns_dec_hash_entry *ns_dec_hash_slot(struct ns_dec_hash_entry *hash,
+						  size_t size,
+						  const uint8_t *guid)
+{
+	size_t i = guid_hash(guid) & (size - 1);
+
+	while (hash[i].dec && memcmp(hash[i].guid, guid, 16))
+		i = (i + 1) & (size - 1);
+
+	return &hash[i];
+}
+
+static int ns_dec_hash_add(const uint8_t *guid, p_ns_dec_tab dec)
+{
+	struct ns_dec_hash_entry *new, *slot;
+	size_t i, size;
+
+	/* Keep the load factor under 1/2 */
+	if (2 * (ns_dec_hash_used + 1) > ns_dec_hash_size) {
+		size = ns_dec_hash_size ? 2 * ns_dec_hash_size : 16;
+		new = calloc(size, sizeof(*new));
+		if (!new)
+			return -1;
+		for (i = 0; i < ns_dec_hash_size; i++) {
+			if (!ns_dec_hash[i].dec)
+				continue;
+			slot = ns_dec_hash_slot(new, size, ns_dec_hash[i].guid);
+			*slot = ns_dec_hash[i];
+		}
+		free(ns_dec_hash);
+		ns_dec_hash = new;
+		ns_dec_hash_size = size;
+	}
+
+	slot = ns_dec_hash_slot(ns_dec_hash, ns_dec_hash_size, guid);
+	if (slot->dec) {
+		/* First registered decoder wins, as with the old linear search */
+		return 0;
+	}
+	memcpy(slot->guid, guid, 16);
+	slot->dec = dec;
+	ns_dec_hash_used++;
+
+	return 0;
+}
+
+static p_ns_dec_tab ns_dec_lookup(const uint8_t *guid)
+{
+	p_ns_dec_tab dec = NULL;
+
+	pthread_rwlock_rdlock(&ns_dec_lock);
+	if (ns_dec_hash_used)
+		dec = ns_dec_hash_slot(ns_dec_hash, ns_dec_hash_size,
+				       guid)->dec;
+	pthread_rwlock_unlock(&ns_dec_lock);
+
+	return dec;
+}
+
+/* Called with ns_dec_lock held for writing */
+static int ns_dec_hash_add_tab(const p_ns_dec_tab tab)
+{
+	uint8_t guid[16];
+	int i;
+
+	for (i = 0; tab[i].decode; i++) {
+		if (ns_parse_sec_type(tab[i].sec_type, guid)) {
+			printf("%s invalid section type %s\n", __func__,
+			       tab[i].sec_type);
+			continue;
+		}
+		if (ns_dec_hash_add(guid, &tab[i])) {
+			printf("%s section type hash malloc failed", __func__);
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
 int register_ns_dec_tab(const p_ns_dec_tab tab)
 {
+	int rc = 0;
+
+	pthread_rwlock_wrlock(&ns_dec_lock);
 	ns_dec_tab = (p_ns_dec_tab *)realloc(ns_dec_tab,
 					    (dec_tab_count + 1) * sizeof(tab));
 	if (ns_dec_tab == NULL) {
 		printf("%s p_ns_dec_tab malloc failed", __func__);
-		return -1;
+		rc = -1;
+		goto out;
 	}
 	ns_dec_tab[dec_tab_count] = tab;
 	dec_tab_count++;
-	return 0;
+
+	if (ns_dec_staged < 0)
+		rc = ns_dec_hash_add_tab(tab);
+
+out:
+	pthread_rwlock_unlock(&ns_dec_lock);
+	return rc;
+}
+
+/*
+ * The tables a plugin registers from its init function are only looked up
+ * once it succeeds. If it fails, they are dropped, before it is unloaded.
+ */
+void ns_dec_tab_stage(void)
+{
+	pthread_rwlock_wrlock(&ns_dec_lock);
+	ns_dec_staged = dec_tab_count;
+	pthread_rwlock_unlock(&ns_dec_lock);
+}
+
+int ns_dec_tab_commit(int keep)
+{
+	int i, rc = 0;
+
+	pthread_rwlock_wrlock(&ns_dec_lock);
+	if (keep) {
+		for (i = ns_dec_staged; i < dec_tab_count && !rc; i++)
+			rc = ns_dec_hash_add_tab(ns_dec_tab[i]);
+	} else {
+		dec_tab_count = ns_dec_staged;
+	}
+	ns_dec_staged = -1;
+	pthread_rwlock_unlock(&ns_dec_lock);
+
+	return rc;
 }
 
 void unregister_ns_dec_tab(void)
 {
+	pthread_rwlock_wrlock(&ns_dec_lock);
 	if (ns_dec_tab) {
 #ifdef HAVE_SQLITE3
 		p_ns_dec_tab dec_tab;
@@ -61,62 +252,26 @@ void unregister_ns_dec_tab(void)
 		ns_dec_tab = NULL;
 		dec_tab_count = 0;
 	}
-}
-
-void print_le_hex(struct trace_seq *s, const uint8_t *buf, int index) {
-	trace_seq_printf(s, "%02x%02x%02x%02x", buf[index+3], buf[index+2], buf[index+1], buf[index]);
-}
-
-static char *uuid_le(const char *uu)
-{
-	static char uuid[sizeof("xxxxxxxx-xxxx-xxxx-xxxx-xxxxxxxxxxxx")];
-	char *p = uuid;
-	int i;
-	static const unsigned char le[16] = {3,2,1,0,5,4,7,6,8,9,10,11,12,13,14,15};
-
-	for (i = 0; i < 16; i++) {
-		p += sprintf(p, "%.2x", uu[le[i]]);
-		switch (i) {
-		case 3:
-		case 5:
-		case 7:
-		case 9:
-			*p++ = '-';
-			break;
-		}
-	}
-
-	*p = 0;
 
-	return uuid;
-}
-
-static int uuid_le_cmp(const char *sec_type, const char *uuid2)
-{
-	static char uuid1[32];
-	char *p = uuid1;
-	int i;
-	static const unsigned char le[16] = {
-			3, 2, 1, 0, 5, 4, 7, 6, 8, 9, 10, 11, 12, 13, 14, 15};
-
-	for (i = 0; i < 16; i++)
-		p += sprintf(p, "%.2x", sec_type[le[i]]);
-	*p = 0;
-	return strncmp(uuid1, uuid2, 32);
+	free(ns_dec_hash);
+	ns_dec_hash = NULL;
+	ns_dec_hash_size = 0;
+	ns_dec_hash_used = 0;
+	pthread_rwlock_unlock(&ns_dec_lock);
 }
 
 int ras_non_standard_event_handler(struct trace_seq *s,
 			 struct pevent_record *record,
 			 struct event_format *event, void *context)
 {
-	int len, i, line_count, count;
+	int len;
 	unsigned long long val;
+	char uuid[RAS_UUID_STR_LEN];
 	struct ras_events *ras = context;
 	time_t now;
 	struct tm *tm;
 	struct ras_non_standard_event ev;
 	p_ns_dec_tab dec_tab;
-	bool dec_done = false;
 
 	/*
 	 * Newer kernels (3.10-rc1 or upper) provide an uptime clock.
@@ -159,14 +314,15 @@ int ras_non_standard_event_handler(struct trace_seq *s,
 	ev.sec_type = pevent_get_field_raw(s, event, "sec_type", record, &len, 1);
 	if(!ev.sec_type)
 		return -1;
-	trace_seq_printf(s, "\n section type: %s", uuid_le(ev.sec_type));
+	trace_seq_printf(s, "\n section type: %s",
+			 ras_uuid_le((const uint8_t *)ev.sec_type, uuid));
 	ev.fru_text = pevent_get_field_raw(s, event, "fru_text",
 						record, &len, 1);
 	ev.fru_id = pevent_get_field_raw(s, event, "fru_id",
 						record, &len, 1);
 	trace_seq_printf(s, " fru text: %s fru id: %s ",
 				ev.fru_text,
-				uuid_le(ev.fru_id));
+				ras_uuid_le((const uint8_t *)ev.fru_id, uuid));
 
 	if (pevent_get_field_val(s, event, "len", record, &val, 1) < 0)
 		return -1;
@@ -177,33 +333,14 @@ int ras_non_standard_event_handler(struct trace_seq *s,
 	if(!ev.error)
 		return -1;
 
-	for (count = 0; count < dec_tab_count && !dec_done; count++) {
-		dec_tab = ns_dec_tab[count];
-		for (i = 0; dec_tab[i].decode; i++) {
-			if (uuid_le_cmp(ev.sec_type,
-					dec_tab[i].sec_type) == 0) {
-				dec_tab[i].decode(ras, &dec_tab[i], s, &ev);
-				dec_done = true;
-				break;
-			}
-		}
-	}
-
-	if (!dec_done) {
-		len = ev.length;
-		i = 0;
-		line_count = 0;
-		trace_seq_printf(s, " error:\n  %08x: ", i);
-		while (len >= 4) {
-			print_le_hex(s, ev.error, i);
-			i += 4;
-			len -= 4;
-			if (++line_count == 4) {
-				trace_seq_printf(s, "\n  %08x: ", i);
-				line_count = 0;
-			} else
-				trace_seq_printf(s, " ");
-		}
+	dec_tab = ns_dec_lookup((const uint8_t *)ev.sec_type);
+	if (!dec_tab && ras_plugin_load_ns((const uint8_t *)ev.sec_type))
+		dec_tab = ns_dec_lookup((const uint8_t *)ev.sec_type);
+	if (dec_tab) {
+		dec_tab->decode(ras, dec_tab, s, &ev);
+	} else {
+		trace_seq_printf(s, " error:\n");
+		ras_hex_dump_le32(s, ev.error, ev.length);
 	}
 
 	/* Insert data into the SGBD */
@@ -216,6 +353,8 @@ int ras_non_standard_event_handler(struct trace_seq *s,
 	ras_report_non_standard_event(ras, &ev);
 #endif
 
+	ras_stream_non_standard_event(ras, &ev);
+
 	return 0;
 }
 
@@ -34,14 +34,19 @@ int ras_non_standard_event_handler(struct trace_seq *s,
 			 struct pevent_record *record,
 			 struct event_format *event, void *context);
 
-void print_le_hex(struct trace_seq *s, const uint8_t *buf, int index);
+/* parses a sec_type string into the layout used by the trace event */
+int ns_parse_sec_type(const char *sec_type, uint8_t *guid);
 
 #ifdef HAVE_NON_STANDARD
 int register_ns_dec_tab(const p_ns_dec_tab tab);
 void unregister_ns_dec_tab(void);
+void ns_dec_tab_stage(void);
+int ns_dec_tab_commit(int keep);
 #else
 static inline int register_ns_dec_tab(const p_ns_dec_tab tab) { return 0; };
 static inline void unregister_ns_dec_tab(void) { return; };
+static inline void ns_dec_tab_stage(void) { return; };
+static inline int ns_dec_tab_commit(int keep) { return 0; };
 #endif
 
 #endif
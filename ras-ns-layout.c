@@ -0,0 +1,248 @@
+/*
+ * Copyright (c) Huawei Technologies Co., Ltd. 2026. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include "ras-ns-layout.h"
+#include "ras-logger.h"
+
+#define NS_REGS_DUMP_LEN	1024
+#define NS_REG_LEN		64
+
+static uint64_t ns_field_val(const uint8_t *p, unsigned int width)
+{
+	uint16_t v16;
+	uint32_t v32;
+	uint64_t v64;
+
+	/* Sections come straight from the trace buffer: may be unaligned */
+	switch (width) {
+	case 1:
+		return *p;
+	case 2:
+		memcpy(&v16, p, sizeof(v16));
+		return v16;
+	case 4:
+		memcpy(&v32, p, sizeof(v32));
+		return v32;
+	case 8:
+		memcpy(&v64, p, sizeof(v64));
+		return v64;
+	}
+
+	return 0;
+}
+
+/* Checks if element @i of @f is both valid and inside the section */
+static int ns_field_present(const struct ns_field *f, unsigned int i,
+			    uint64_t val_bits, uint32_t length)
+{
+	if (f->offset + (i + 1) * f->width > length)
+		return 0;
+	if (f->valid == NS_ALWAYS_VALID)
+		return 1;
+
+	return !!(val_bits & (f->valid << i));
+}
+
+#ifdef HAVE_SQLITE3
+static int ns_layout_open(struct ras_events *ras, struct ras_ns_dec_tab *dec_tab,
+			  const struct ns_layout *layout, struct trace_seq *s)
+{
+	if (!layout->tab || !ras->db_priv)
+		return 0;
+
+	if (!dec_tab->stmt_dec_record &&
+	    ras_mc_add_vendor_table(ras, &dec_tab->stmt_dec_record,
+				    layout->tab) != SQLITE_OK) {
+		trace_seq_printf(s, "create sql %s fail\n", layout->tab->name);
+		return -1;
+	}
+
+	return 1;
+}
+
+static void ns_layout_bind(struct ras_ns_dec_tab *dec_tab, int column,
+			   const char *str, uint64_t val)
+{
+	if (str)
+		sqlite3_bind_text(dec_tab->stmt_dec_record, column, str, -1,
+				  NULL);
+	else
+		sqlite3_bind_int64(dec_tab->stmt_dec_record, column, val);
+}
+
+static void ns_layout_step(struct ras_ns_dec_tab *dec_tab,
+			   const struct ns_layout *layout)
+{
+	int rc;
+
+	rc = ras_mc_step(dec_tab->stmt_dec_record);
+	if (rc != SQLITE_OK && rc != SQLITE_DONE)
+		log(TERM, LOG_ERR,
+		    "Failed to do %s step on sqlite: error = %d\n",
+		    layout->tab->name, rc);
+
+	rc = sqlite3_reset(dec_tab->stmt_dec_record);
+	if (rc != SQLITE_OK && rc != SQLITE_DONE)
+		log(TERM, LOG_ERR,
+		    "Failed to reset %s on sqlite: error = %d\n",
+		    layout->tab->name, rc);
+
+	rc = sqlite3_clear_bindings(dec_tab->stmt_dec_record);
+	if (rc != SQLITE_OK && rc != SQLITE_DONE)
+		log(TERM, LOG_ERR,
+		    "Failed to clear bindings %s on sqlite: error = %d\n",
+		    layout->tab->name, rc);
+}
+#else
+static int ns_layout_open(struct ras_events *ras, struct ras_ns_dec_tab *dec_tab,
+			  const struct ns_layout *layout, struct trace_seq *s)
+{
+	return 0;
+}
+
+static void ns_layout_bind(struct ras_ns_dec_tab *dec_tab, int column,
+			   const char *str, uint64_t val)
+{ }
+
+static void ns_layout_step(struct ras_ns_dec_tab *dec_tab,
+			   const struct ns_layout *layout)
+{ }
+#endif
+
+static void ns_decode_hdr(struct ras_ns_dec_tab *dec_tab,
+			  const struct ns_layout *layout, struct trace_seq *s,
+			  const struct ras_non_standard_event *event,
+			  uint64_t val_bits, int text, int store)
+{
+	const struct ns_field *f;
+	const char *str;
+	uint64_t val;
+
+	if (text)
+		trace_seq_printf(s, "%s%s", layout->title, layout->hdr_open);
+
+	for (f = layout->hdr; f->fmt; f++) {
+		if (!ns_field_present(f, 0, val_bits, event->length))
+			continue;
+
+		val = ns_field_val(event->error + f->offset, f->width);
+		str = f->str ? f->str(event->error, val) : NULL;
+
+		if (text) {
+			if (str)
+				trace_seq_printf(s, f->fmt, str);
+			else
+				trace_seq_printf(s, f->fmt,
+						 (unsigned long long)val);
+		}
+		if (store && f->column)
+			ns_layout_bind(dec_tab, f->column, str, val);
+	}
+
+	if (text)
+		trace_seq_printf(s, "%s\n", layout->hdr_close);
+}
+
+static void ns_decode_regs(struct ras_ns_dec_tab *dec_tab,
+			   const struct ns_layout *layout, struct trace_seq *s,
+			   const struct ras_non_standard_event *event,
+			   uint64_t val_bits, int text, int store)
+{
+	char buf[NS_REGS_DUMP_LEN], reg[NS_REG_LEN];
+	char *p = buf, *end = buf + sizeof(buf);
+	const struct ns_field *f;
+	unsigned int i, n;
+	uint64_t val;
+
+	*p = '\0';
+	if (text)
+		trace_seq_printf(s, "Reg Dump:\n");
+
+	for (f = layout->regs; f->fmt; f++) {
+		n = f->count ? f->count : 1;
+		for (i = 0; i < n; i++) {
+			if (!ns_field_present(f, i, val_bits, event->length))
+				continue;
+
+			val = ns_field_val(event->error + f->offset +
+					   i * f->width, f->width);
+			if (f->count)
+				snprintf(reg, sizeof(reg), f->fmt, i,
+					 (unsigned long long)val);
+			else
+				snprintf(reg, sizeof(reg), f->fmt,
+					 (unsigned long long)val);
+
+			if (text)
+				trace_seq_printf(s, "%s\n", reg);
+			if (store && p < end)
+				p += snprintf(p, end - p, "%s ", reg);
+		}
+	}
+
+	if (!store)
+		return;
+
+	/* Drops the trailing space */
+	if (p > buf && p < end)
+		*--p = '\0';
+	ns_layout_bind(dec_tab, layout->regs_column, buf, 0);
+	ns_layout_step(dec_tab, layout);
+}
+
+int ns_layout_decode(struct ras_events *ras, struct ras_ns_dec_tab *dec_tab,
+		     const struct ns_layout *layout, struct trace_seq *s,
+		     struct ras_non_standard_event *event)
+{
+	uint64_t val_bits;
+	int text = ras->text_output, store;
+
+	if (event->length < layout->valid_width) {
+		trace_seq_printf(s, "%s: section too short\n", layout->name);
+		return -1;
+	}
+
+	val_bits = ns_field_val(event->error, layout->valid_width);
+	if (!val_bits) {
+		trace_seq_printf(s, "%s: no valid error information\n",
+				 layout->name);
+		return -1;
+	}
+
+	store = ns_layout_open(ras, dec_tab, layout, s);
+	if (store < 0)
+		return -1;
+
+	/* Nothing to do if neither printed nor stored */
+	if (!text && !store)
+		return 0;
+
+	if (store && layout->ts_column)
+		ns_layout_bind(dec_tab, layout->ts_column, event->timestamp, 0);
+
+	ns_decode_hdr(dec_tab, layout, s, event, val_bits, text, store);
+
+	if (layout->regs)
+		ns_decode_regs(dec_tab, layout, s, event, val_bits, text, store);
+	else if (store)
+		ns_layout_step(dec_tab, layout);
+
+	return 0;
+}
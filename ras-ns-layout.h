@@ -0,0 +1,110 @@
+/*
+ * Copyright (c) Huawei Technologies Co., Ltd. 2026. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#ifndef __RAS_NS_LAYOUT_H
+#define __RAS_NS_LAYOUT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "ras-non-standard-handler.h"
+#include "ras-record.h"
+
+/*
+ * Table driven decoding of vendor error sections.
+ *
+ * A section starts with a validation bits word, followed by the fields
+ * described by a NULL-terminated array of struct ns_field. Header fields
+ * are printed on a single line and stored on their own column, while
+ * register fields are printed one per line and stored together on a
+ * register dump column.
+ *
+ * Arrays are only supported as register fields.
+ *
+ * Field text is only rendered when someone will read it: header fields
+ * only when rasdaemon output goes somewhere, register fields also when
+ * the register dump gets stored.
+ */
+
+/* the field is not covered by the validation bits */
+#define NS_ALWAYS_VALID		0
+
+struct ns_field {
+	/*
+	 * printf format of the field, taking an unsigned long long value,
+	 * or a string if ->str is set. Arrays take the element index first.
+	 */
+	const char	*fmt;
+	uint64_t	valid;		/* validation bit, of the 1st element */
+	uint16_t	offset;
+	uint8_t		width;		/* 1, 2, 4 or 8 bytes */
+	uint8_t		column;		/* on the vendor table, 0 if none */
+	uint8_t		count;		/* elements, if this is an array */
+
+	/* translates the field value, the whole section is at @sec */
+	const char	*(*str)(const uint8_t *sec, uint64_t val);
+};
+
+/* helpers for the field tables, @type being the section struct */
+#define NS_FIELD_WIDTH(type, member)	sizeof(((type *)0)->member)
+#define NS_FIELD(_fmt, type, member, _valid, _column)			\
+	{								\
+		.fmt = _fmt,						\
+		.offset = offsetof(type, member),			\
+		.width = NS_FIELD_WIDTH(type, member),			\
+		.valid = _valid,					\
+		.column = _column,					\
+	}
+#define NS_FIELD_STR(_fmt, type, member, _valid, _column, _str)		\
+	{								\
+		.fmt = _fmt,						\
+		.offset = offsetof(type, member),			\
+		.width = NS_FIELD_WIDTH(type, member),			\
+		.valid = _valid,					\
+		.column = _column,					\
+		.str = _str,						\
+	}
+#define NS_FIELD_ARRAY(_fmt, type, member, _valid)			\
+	{								\
+		.fmt = _fmt,						\
+		.offset = offsetof(type, member),			\
+		.width = NS_FIELD_WIDTH(type, member[0]),		\
+		.valid = _valid,					\
+		.count = NS_FIELD_WIDTH(type, member) /			\
+			 NS_FIELD_WIDTH(type, member[0]),		\
+	}
+
+struct ns_layout {
+	const char		*name;		/* for error messages */
+	const char		*title;		/* printed before the header */
+	const char		*hdr_open, *hdr_close;
+	uint8_t			valid_width;	/* of the validation bits */
+
+	const struct ns_field	*hdr;
+	const struct ns_field	*regs;		/* NULL if there are none */
+
+#ifdef HAVE_SQLITE3
+	const struct db_table_descriptor *tab;	/* NULL if not stored */
+#endif
+	uint8_t			ts_column, regs_column;
+};
+
+int ns_layout_decode(struct ras_events *ras, struct ras_ns_dec_tab *dec_tab,
+		     const struct ns_layout *layout, struct trace_seq *s,
+		     struct ras_non_standard_event *event);
+
+#endif
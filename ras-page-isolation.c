@@ -18,6 +18,8 @@
 #include <string.h>
 #include <unistd.h>
 #include "ras-logger.h"
+#include "ras-metrics.h"
+#include "ras-probes.h"
 #include "ras-page-isolation.h"
 
 #define PARSED_ENV_LEN 50
@@ -238,6 +240,7 @@ static void page_offline(struct page_record *pr)
 		return;
 
 	/* Time to silence this noisy page */
+	RAS_PROBE2(page_offline_entry, addr, offline);
 	if (offline == OFFLINE_SOFT_THEN_HARD) {
 		ret = do_page_offline(addr, OFFLINE_SOFT);
 		if (ret < 0)
@@ -246,7 +249,11 @@ static void page_offline(struct page_record *pr)
 		ret = do_page_offline(addr, offline);
 	}
 
+	RAS_PROBE2(page_offline_exit, addr, ret);
+
 	pr->offlined = ret < 0 ? PAGE_OFFLINE_FAILED : PAGE_OFFLINE;
+	ras_metrics_inc(ret < 0 ? RAS_METRIC_PAGE_OFFLINE_FAILED :
+				  RAS_METRIC_PAGE_OFFLINED);
 
 	log(TERM, LOG_INFO, "Result of offlining page at %#llx: %s\n",
 	    addr, page_state[pr->offlined]);
@@ -0,0 +1,302 @@
+/*
+ * Copyright (c) Huawei Technologies Co., Ltd. 2026. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#include <dirent.h>
+#include <dlfcn.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "ras-plugin.h"
+#include "ras-non-standard-handler.h"
+#include "ras-mce-handler.h"
+#include "ras-logger.h"
+
+#define PLUGIN_MANIFEST_SUFFIX	".plugin"
+
+enum plugin_state {
+	PLUGIN_NOT_LOADED,
+	PLUGIN_LOADED,
+	PLUGIN_FAILED,
+};
+
+struct plugin_mce_match {
+	char		vendor[16];
+	unsigned int	family;
+};
+
+struct plugin_manifest {
+	struct plugin_manifest	*next;
+	char			*manifest;
+	char			*module;
+	enum plugin_state	state;
+
+	uint8_t			(*ns)[16];
+	int			n_ns;
+	struct plugin_mce_match	*mce;
+	int			n_mce;
+};
+
+static pthread_mutex_t plugin_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct plugin_manifest *plugins;
+static int plugins_scanned;
+
+static const char *plugin_dir(void)
+{
+	const char *dir = getenv("RAS_PLUGIN_DIR");
+
+	return (dir && *dir) ? dir : RAS_PLUGIN_DIR;
+}
+
+static int manifest_add_ns(struct plugin_manifest *m, const char *guid)
+{
+#ifdef HAVE_NON_STANDARD
+	uint8_t (*ns)[16];
+
+	ns = realloc(m->ns, (m->n_ns + 1) * sizeof(*ns));
+	if (!ns)
+		return -1;
+	m->ns = ns;
+	if (ns_parse_sec_type(guid, m->ns[m->n_ns]))
+		return -1;
+	m->n_ns++;
+#endif
+	return 0;
+}
+
+static int manifest_add_mce(struct plugin_manifest *m, const char *vendor,
+			    unsigned int family)
+{
+	struct plugin_mce_match *mce;
+
+	mce = realloc(m->mce, (m->n_mce + 1) * sizeof(*mce));
+	if (!mce)
+		return -1;
+	m->mce = mce;
+	snprintf(m->mce[m->n_mce].vendor, sizeof(m->mce->vendor), "%s", vendor);
+	m->mce[m->n_mce].family = family;
+	m->n_mce++;
+
+	return 0;
+}
+
+static void manifest_free(struct plugin_manifest *m)
+{
+	free(m->manifest);
+	free(m->module);
+	free(m->ns);
+	free(m->mce);
+	free(m);
+}
+
+static struct plugin_manifest *manifest_parse(const char *dir, const char *name)
+{
+	struct plugin_manifest *m;
+	char path[PATH_MAX], *line = NULL, *key, *arg1, *arg2, *save;
+	size_t linelen = 0;
+	unsigned long lineno = 0;
+	FILE *f;
+	int rc = 0;
+
+	snprintf(path, sizeof(path), "%s/%s", dir, name);
+	f = fopen(path, "r");
+	if (!f)
+		return NULL;
+
+	m = calloc(1, sizeof(*m));
+	if (!m) {
+		fclose(f);
+		return NULL;
+	}
+	m->manifest = strdup(path);
+
+	while (!rc && getline(&line, &linelen, f) > 0) {
+		lineno++;
+		key = strtok_r(line, " \t\r\n", &save);
+		if (!key || *key == '#')
+			continue;
+		arg1 = strtok_r(NULL, " \t\r\n", &save);
+		arg2 = strtok_r(NULL, " \t\r\n", &save);
+
+		if (!strcmp(key, "module") && arg1) {
+			free(m->module);
+			snprintf(path, sizeof(path), "%s/%s", dir, arg1);
+			m->module = strdup(path);
+		} else if (!strcmp(key, "ns") && arg1) {
+			rc = manifest_add_ns(m, arg1);
+		} else if (!strcmp(key, "mce") && arg1 && arg2) {
+			rc = manifest_add_mce(m, arg1, strtoul(arg2, NULL, 0));
+		} else {
+			rc = -1;
+		}
+		if (rc)
+			log(ALL, LOG_WARNING, "%s:%lu: invalid plugin manifest line\n",
+			    m->manifest, lineno);
+	}
+	free(line);
+	fclose(f);
+
+	if (rc || !m->module || !m->manifest) {
+		log(ALL, LOG_WARNING, "Ignoring plugin manifest %s/%s\n",
+		    dir, name);
+		manifest_free(m);
+		return NULL;
+	}
+
+	return m;
+}
+
+/* Only the manifests are read here: plugins are loaded when needed */
+static void plugins_scan(void)
+{
+	const char *dir = plugin_dir();
+	struct plugin_manifest *m;
+	struct dirent *entry;
+	size_t len, slen = strlen(PLUGIN_MANIFEST_SUFFIX);
+	DIR *d;
+
+	plugins_scanned = 1;
+
+	d = opendir(dir);
+	if (!d)
+		return;
+
+	while ((entry = readdir(d))) {
+		len = strlen(entry->d_name);
+		if (len <= slen ||
+		    strcmp(entry->d_name + len - slen, PLUGIN_MANIFEST_SUFFIX))
+			continue;
+
+		m = manifest_parse(dir, entry->d_name);
+		if (!m)
+			continue;
+		m->next = plugins;
+		plugins = m;
+	}
+	closedir(d);
+}
+
+static int plugin_load(struct plugin_manifest *m)
+{
+	const struct ras_plugin *desc;
+	void *handle;
+	int rc;
+
+	if (m->state != PLUGIN_NOT_LOADED)
+		return m->state == PLUGIN_LOADED;
+
+	m->state = PLUGIN_FAILED;
+
+	handle = dlopen(m->module, RTLD_NOW | RTLD_LOCAL);
+	if (!handle) {
+		log(ALL, LOG_ERR, "Can't load plugin %s: %s\n", m->module,
+		    dlerror());
+		return 0;
+	}
+
+	desc = dlsym(handle, RAS_PLUGIN_DESC_SYM);
+	if (!desc) {
+		log(ALL, LOG_ERR, "%s is not a rasdaemon plugin\n", m->module);
+		goto err;
+	}
+	if (desc->abi_version != RAS_PLUGIN_ABI_VERSION) {
+		log(ALL, LOG_ERR, "Plugin %s has ABI version %u, expected %u\n",
+		    m->module, desc->abi_version, RAS_PLUGIN_ABI_VERSION);
+		goto err;
+	}
+	if (desc->init) {
+		ns_dec_tab_stage();
+		mce_dec_stage();
+		rc = desc->init();
+		mce_dec_commit(!rc);
+		if (ns_dec_tab_commit(!rc))
+			log(ALL, LOG_ERR, "Can't register all the decoders of %s\n",
+			    m->module);
+		if (rc) {
+			log(ALL, LOG_ERR, "Plugin %s failed to initialize\n",
+			    m->module);
+			goto err;
+		}
+	}
+
+	/* Plugins are never unloaded: their tables are referenced from now on */
+	m->state = PLUGIN_LOADED;
+	log(ALL, LOG_INFO, "Loaded plugin %s from %s\n", desc->name, m->module);
+
+	return 1;
+
+err:
+	dlclose(handle);
+	return 0;
+}
+
+/*
+ * Loads the plugins handling the section type @guid, returning how many
+ * got loaded, so that the caller knows if it is worth looking again.
+ */
+int ras_plugin_load_ns(const uint8_t *guid)
+{
+	struct plugin_manifest *m;
+	int i, loaded = 0;
+
+	pthread_mutex_lock(&plugin_lock);
+	if (!plugins_scanned)
+		plugins_scan();
+
+	for (m = plugins; m; m = m->next) {
+		if (m->state != PLUGIN_NOT_LOADED)
+			continue;
+		for (i = 0; i < m->n_ns; i++) {
+			if (!memcmp(m->ns[i], guid, 16)) {
+				loaded += plugin_load(m);
+				break;
+			}
+		}
+	}
+	pthread_mutex_unlock(&plugin_lock);
+
+	return loaded;
+}
+
+int ras_plugin_load_mce(const char *vendor, unsigned int family)
+{
+	struct plugin_manifest *m;
+	int i, loaded = 0;
+
+	pthread_mutex_lock(&plugin_lock);
+	if (!plugins_scanned)
+		plugins_scan();
+
+	for (m = plugins; m; m = m->next) {
+		if (m->state != PLUGIN_NOT_LOADED)
+			continue;
+		for (i = 0; i < m->n_mce; i++) {
+			if (!strcasecmp(m->mce[i].vendor, vendor) &&
+			    m->mce[i].family == family) {
+				loaded += plugin_load(m);
+				break;
+			}
+		}
+	}
+	pthread_mutex_unlock(&plugin_lock);
+
+	return loaded;
+}
@@ -0,0 +1,74 @@
+/*
+ * Copyright (c) Huawei Technologies Co., Ltd. 2026. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#ifndef __RAS_PLUGIN_H
+#define __RAS_PLUGIN_H
+
+#include <stdint.h>
+#include "config.h"
+
+/*
+ * Vendor decoders may either be linked into rasdaemon, or be built as
+ * plugins, loaded from RAS_PLUGIN_DIR the first time an event they handle
+ * is seen. Each plugin comes with a manifest, <name>.plugin, telling which
+ * events it handles, so that rasdaemon doesn't need to load it to know:
+ *
+ *	module <name>.so
+ *	ns <section type, as in struct ras_ns_dec_tab>
+ *	mce <vendor_id> <cpu family>
+ *
+ * The same decoder source is used on both cases: RAS_PLUGIN_INIT() either
+ * runs the init function at startup, or exports it on the plugin
+ * descriptor looked up by the loader.
+ */
+
+/* Bump on any incompatible change to the interfaces used by decoders */
+#define RAS_PLUGIN_ABI_VERSION	1
+
+struct ras_plugin {
+	unsigned int	abi_version;
+	const char	*name;
+	int		(*init)(void);
+};
+
+#define RAS_PLUGIN_DESC_SYM	"ras_plugin_desc"
+
+#ifdef RAS_PLUGIN
+#define RAS_PLUGIN_INIT(_name, _init)					\
+	const struct ras_plugin ras_plugin_desc = {			\
+		.abi_version = RAS_PLUGIN_ABI_VERSION,			\
+		.name = _name,						\
+		.init = _init,						\
+	}
+#else
+#define RAS_PLUGIN_INIT(_name, _init)					\
+	static void __attribute__((constructor)) _init##_ctor(void)	\
+	{								\
+		_init();						\
+	}
+#endif
+
+#ifdef HAVE_PLUGINS
+int ras_plugin_load_ns(const uint8_t *guid);
+int ras_plugin_load_mce(const char *vendor, unsigned int family);
+#else
+static inline int ras_plugin_load_ns(const uint8_t *guid) { return 0; };
+static inline int ras_plugin_load_mce(const char *vendor, unsigned int family) { return 0; };
+#endif
+
+#endif
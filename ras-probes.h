@@ -0,0 +1,53 @@
+/*
+ * Copyright (c) Huawei Technologies Co., Ltd. 2026. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#ifndef __RAS_PROBES_H
+#define __RAS_PROBES_H
+
+/*
+ * Static probes (USDT) on the rasdaemon provider, for perf and bpftrace:
+ *
+ *	page_read(cpu, size)		a trace_pipe_raw page was read
+ *	event(cpu, ts)			an event of that page is parsed
+ *	handler_entry(type, cpu)	the handler of an event type is called
+ *	handler_exit(type, cpu, rc)	and returned
+ *	db_step_entry(sql)		an event is inserted on the database
+ *	db_step_exit(sql, rc)
+ *	db_commit_entry(events)		a batch of events is committed
+ *	db_commit_exit(rc)
+ *	report_send(type, len, status)	an ABRT report was sent, see
+ *					enum report_status
+ *	page_offline_entry(addr, type)	a page is offlined
+ *	page_offline_exit(addr, rc)
+ *
+ * They are nops until used, and are not built without <sys/sdt.h>.
+ */
+
+#ifdef HAVE_SYS_SDT_H
+#include <sys/sdt.h>
+
+#define RAS_PROBE1(name, a)		DTRACE_PROBE1(rasdaemon, name, a)
+#define RAS_PROBE2(name, a, b)		DTRACE_PROBE2(rasdaemon, name, a, b)
+#define RAS_PROBE3(name, a, b, c)	DTRACE_PROBE3(rasdaemon, name, a, b, c)
+#else
+#define RAS_PROBE1(name, a)		do { } while (0)
+#define RAS_PROBE2(name, a, b)		do { } while (0)
+#define RAS_PROBE3(name, a, b, c)	do { } while (0)
+#endif
+
+#endif
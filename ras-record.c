@@ -21,20 +21,130 @@
  * BuildRequires: sqlite-devel
  */
 
+#include <errno.h>
+#include <limits.h>
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <time.h>
 #include <unistd.h>
 #include "ras-events.h"
 #include "ras-mc-handler.h"
 #include "ras-aer-handler.h"
 #include "ras-mce-handler.h"
 #include "ras-logger.h"
+#include "ras-env.h"
+#include "ras-metrics.h"
+#include "ras-probes.h"
 
 /* #define DEBUG_SQL 1 */
 
 #define SQLITE_RAS_DB RASSTATEDIR "/" RAS_DB_FNAME
 
+/* The database can be moved away with RAS_DB_FILE, e. g. for ras-bench */
+static const char *ras_db_file(void)
+{
+	char *env = getenv("RAS_DB_FILE");
+
+	return env && *env ? env : SQLITE_RAS_DB;
+}
+
+/* sqlite3_step(), accounting for its latency, with probes around it */
+int ras_mc_step(sqlite3_stmt *stmt)
+{
+	uint64_t start = ras_metrics_now();
+	int rc;
+
+	RAS_PROBE1(db_step_entry, sqlite3_sql(stmt));
+	rc = sqlite3_step(stmt);
+	RAS_PROBE2(db_step_exit, sqlite3_sql(stmt), rc);
+	ras_metrics_db_step(start);
+
+	return rc;
+}
+
+/*
+ * Batched lane: corrected errors are stored within a transaction, committed
+ * once it has RAS_DB_BATCH events, or RAS_DB_BATCH_MS after the first one,
+ * saving a sync for each of them. Urgent events commit it right after being
+ * stored, see parse_ras_page().
+ */
+#define DB_BATCH	64
+#define DB_BATCH_MS	1000
+
+static uint64_t db_now_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/* Called before handling an event of the batched lane */
+void ras_db_batch(struct ras_events *ras)
+{
+	struct sqlite3_priv *priv = ras->db_priv;
+	int rc;
+
+	if (!priv || !priv->batch_max)
+		return;
+
+	if (!priv->batch_events) {
+		rc = sqlite3_exec(priv->db, "BEGIN", NULL, NULL, NULL);
+		if (rc != SQLITE_OK) {
+			log(TERM, LOG_ERR,
+			    "Failed to begin a transaction on sqlite: error = %d\n",
+			    rc);
+			return;
+		}
+		priv->batch_start = db_now_ms();
+	}
+	priv->batch_events++;
+}
+
+void ras_db_commit(struct ras_events *ras)
+{
+	struct sqlite3_priv *priv = ras->db_priv;
+	uint64_t start;
+	int rc;
+
+	if (!priv || !priv->batch_events)
+		return;
+
+	start = ras_metrics_now();
+	RAS_PROBE1(db_commit_entry, priv->batch_events);
+	rc = sqlite3_exec(priv->db, "COMMIT", NULL, NULL, NULL);
+	RAS_PROBE1(db_commit_exit, rc);
+	ras_metrics_db_commit(start);
+
+	/* If busy, the transaction is still open: retried on next flush */
+	if (rc != SQLITE_OK)
+		log(TERM, LOG_ERR,
+		    "Failed to commit %lu events on sqlite: error = %d\n",
+		    priv->batch_events, rc);
+	if (sqlite3_get_autocommit(priv->db))
+		priv->batch_events = 0;
+}
+
+/* Commits the batch if due, returning the ms until it will be, or -1 */
+int ras_db_flush(struct ras_events *ras, int force)
+{
+	struct sqlite3_priv *priv = ras->db_priv;
+	uint64_t age;
+
+	if (!priv || !priv->batch_events)
+		return -1;
+
+	age = db_now_ms() - priv->batch_start;
+	if (force || priv->batch_events >= priv->batch_max ||
+	    age >= priv->batch_ms) {
+		ras_db_commit(ras);
+		return priv->batch_events ? priv->batch_ms : -1;
+	}
+
+	return priv->batch_ms - age;
+}
+
 /*
  * Table and functions to handle ras:mc_event
  */
@@ -69,7 +179,7 @@ int ras_store_mc_event(struct ras_events *ras, struct ras_mc_event *ev)
 
 	if (!priv || !priv->stmt_mc_event)
 		return 0;
-	log(TERM, LOG_INFO, "mc_event store: %p\n", priv->stmt_mc_event);
+	log(TERM, LOG_DEBUG, "mc_event store: %p\n", priv->stmt_mc_event);
 
 	sqlite3_bind_text(priv->stmt_mc_event,  1, ev->timestamp, -1, NULL);
 	sqlite3_bind_int (priv->stmt_mc_event,  2, ev->error_count);
@@ -84,7 +194,7 @@ int ras_store_mc_event(struct ras_events *ras, struct ras_mc_event *ev)
 	sqlite3_bind_int64 (priv->stmt_mc_event, 11, ev->grain);
 	sqlite3_bind_int64 (priv->stmt_mc_event, 12, ev->syndrome);
 	sqlite3_bind_text(priv->stmt_mc_event, 13, ev->driver_detail, -1, NULL);
-	rc = sqlite3_step(priv->stmt_mc_event);
+	rc = ras_mc_step(priv->stmt_mc_event);
 	if (rc != SQLITE_OK && rc != SQLITE_DONE)
 		log(TERM, LOG_ERR,
 		    "Failed to do mc_event step on sqlite: error = %d\n", rc);
@@ -93,7 +203,7 @@ int ras_store_mc_event(struct ras_events *ras, struct ras_mc_event *ev)
 		log(TERM, LOG_ERR,
 		    "Failed reset mc_event on sqlite: error = %d\n",
 		    rc);
-	log(TERM, LOG_INFO, "register inserted at db\n");
+	log(TERM, LOG_DEBUG, "register inserted at db\n");
 
 	return rc;
 }
@@ -109,6 +219,17 @@ static const struct db_fields aer_event_fields[] = {
 		{ .name="dev_name",		.type="TEXT" },
 		{ .name="err_type",		.type="TEXT" },
 		{ .name="err_msg",		.type="TEXT" },
+		{ .name="status",		.type="INTEGER" },
+		{ .name="tlp_dw0",		.type="INTEGER" },
+		{ .name="tlp_dw1",		.type="INTEGER" },
+		{ .name="tlp_dw2",		.type="INTEGER" },
+		{ .name="tlp_dw3",		.type="INTEGER" },
+		{ .name="tlp_fmt_type",		.type="INTEGER" },
+		{ .name="tlp_type",		.type="TEXT" },
+		{ .name="requester_id",		.type="INTEGER" },
+		{ .name="completer_id",		.type="INTEGER" },
+		{ .name="tag",			.type="INTEGER" },
+		{ .name="address",		.type="INTEGER" },
 };
 
 static const struct db_table_descriptor aer_event_tab = {
@@ -119,19 +240,38 @@ static const struct db_table_descriptor aer_event_tab = {
 
 int ras_store_aer_event(struct ras_events *ras, struct ras_aer_event *ev)
 {
-	int rc;
+	int i, rc;
 	struct sqlite3_priv *priv = ras->db_priv;
 
 	if (!priv || !priv->stmt_aer_event)
 		return 0;
-	log(TERM, LOG_INFO, "aer_event store: %p\n", priv->stmt_aer_event);
-
-	sqlite3_bind_text(priv->stmt_aer_event,  1, ev->timestamp, -1, NULL);
-	sqlite3_bind_text(priv->stmt_aer_event,  2, ev->dev_name, -1, NULL);
-	sqlite3_bind_text(priv->stmt_aer_event,  3, ev->error_type, -1, NULL);
-	sqlite3_bind_text(priv->stmt_aer_event,  4, ev->msg, -1, NULL);
+	log(TERM, LOG_DEBUG, "aer_event store: %p\n", priv->stmt_aer_event);
+
+	/* The TLP columns are left NULL when there's no header */
+	sqlite3_clear_bindings(priv->stmt_aer_event);
+
+	sqlite3_bind_text (priv->stmt_aer_event,  1, ev->timestamp, -1, NULL);
+	sqlite3_bind_text (priv->stmt_aer_event,  2, ev->dev_name, -1, NULL);
+	sqlite3_bind_text (priv->stmt_aer_event,  3, ev->error_type, -1, NULL);
+	sqlite3_bind_text (priv->stmt_aer_event,  4, ev->msg, -1, NULL);
+	sqlite3_bind_int64(priv->stmt_aer_event,  5, ev->status);
+	if (ev->tlp_header_valid) {
+		for (i = 0; i < 4; i++)
+			sqlite3_bind_int64(priv->stmt_aer_event, 6 + i,
+					   ev->tlp_header[i]);
+		sqlite3_bind_int  (priv->stmt_aer_event, 10, ev->tlp.fmt_type);
+		sqlite3_bind_text (priv->stmt_aer_event, 11, ev->tlp.type, -1, NULL);
+		sqlite3_bind_int  (priv->stmt_aer_event, 12, ev->tlp.requester_id);
+		if (ev->tlp.has_completer)
+			sqlite3_bind_int(priv->stmt_aer_event, 13,
+					 ev->tlp.completer_id);
+		sqlite3_bind_int  (priv->stmt_aer_event, 14, ev->tlp.tag);
+		if (ev->tlp.has_address)
+			sqlite3_bind_int64(priv->stmt_aer_event, 15,
+					   ev->tlp.address);
+	}
 
-	rc = sqlite3_step(priv->stmt_aer_event);
+	rc = ras_mc_step(priv->stmt_aer_event);
 	if (rc != SQLITE_OK && rc != SQLITE_DONE)
 		log(TERM, LOG_ERR,
 		    "Failed to do aer_event step on sqlite: error = %d\n", rc);
@@ -140,7 +280,56 @@ int ras_store_aer_event(struct ras_events *ras, struct ras_aer_event *ev)
 		log(TERM, LOG_ERR,
 		    "Failed reset aer_event on sqlite: error = %d\n",
 		    rc);
-	log(TERM, LOG_INFO, "register inserted at db\n");
+	log(TERM, LOG_DEBUG, "register inserted at db\n");
+
+	return rc;
+}
+
+/*
+ * Summaries of PCIe AER error bursts, see ras-aer-rate.c
+ */
+static const struct db_fields aer_summary_fields[] = {
+		{ .name="id",			.type="INTEGER PRIMARY KEY" },
+		{ .name="first_seen",		.type="TEXT" },
+		{ .name="last_seen",		.type="TEXT" },
+		{ .name="count",		.type="INTEGER" },
+		{ .name="dev_name",		.type="TEXT" },
+		{ .name="err_type",		.type="TEXT" }, // 5
+		{ .name="err_msg",		.type="TEXT" },
+};
+
+static const struct db_table_descriptor aer_summary_tab = {
+	.name = "aer_event_summary",
+	.fields = aer_summary_fields,
+	.num_fields = ARRAY_SIZE(aer_summary_fields),
+};
+
+int ras_store_aer_summary(struct ras_events *ras, struct ras_aer_summary_event *ev)
+{
+	int rc;
+	struct sqlite3_priv *priv = ras->db_priv;
+
+	if (!priv || !priv->stmt_aer_summary)
+		return 0;
+	log(TERM, LOG_DEBUG, "aer_event_summary store: %p\n", priv->stmt_aer_summary);
+
+	sqlite3_bind_text  (priv->stmt_aer_summary,  1, ev->first_seen, -1, NULL);
+	sqlite3_bind_text  (priv->stmt_aer_summary,  2, ev->last_seen, -1, NULL);
+	sqlite3_bind_int64 (priv->stmt_aer_summary,  3, ev->count);
+	sqlite3_bind_text  (priv->stmt_aer_summary,  4, ev->dev_name, -1, NULL);
+	sqlite3_bind_text  (priv->stmt_aer_summary,  5, ev->error_type, -1, NULL);
+	sqlite3_bind_text  (priv->stmt_aer_summary,  6, ev->msg, -1, NULL);
+
+	rc = ras_mc_step(priv->stmt_aer_summary);
+	if (rc != SQLITE_OK && rc != SQLITE_DONE)
+		log(TERM, LOG_ERR,
+		    "Failed to do aer_event_summary step on sqlite: error = %d\n", rc);
+	rc = sqlite3_reset(priv->stmt_aer_summary);
+	if (rc != SQLITE_OK && rc != SQLITE_DONE)
+		log(TERM, LOG_ERR,
+		    "Failed reset aer_event_summary on sqlite: error = %d\n",
+		    rc);
+	log(TERM, LOG_DEBUG, "register inserted at db\n");
 
 	return rc;
 }
@@ -174,7 +363,7 @@ int ras_store_non_standard_record(struct ras_events *ras, struct ras_non_standar
 
 	if (!priv || !priv->stmt_non_standard_record)
 		return 0;
-	log(TERM, LOG_INFO, "non_standard_event store: %p\n", priv->stmt_non_standard_record);
+	log(TERM, LOG_DEBUG, "non_standard_event store: %p\n", priv->stmt_non_standard_record);
 
 	sqlite3_bind_text (priv->stmt_non_standard_record,  1, ev->timestamp, -1, NULL);
 	sqlite3_bind_blob (priv->stmt_non_standard_record,  2, ev->sec_type, -1, NULL);
@@ -183,7 +372,7 @@ int ras_store_non_standard_record(struct ras_events *ras, struct ras_non_standar
 	sqlite3_bind_text (priv->stmt_non_standard_record,  5, ev->severity, -1, NULL);
 	sqlite3_bind_blob (priv->stmt_non_standard_record,  6, ev->error, ev->length, NULL);
 
-	rc = sqlite3_step(priv->stmt_non_standard_record);
+	rc = ras_mc_step(priv->stmt_non_standard_record);
 	if (rc != SQLITE_OK && rc != SQLITE_DONE)
 		log(TERM, LOG_ERR,
 		    "Failed to do non_standard_event step on sqlite: error = %d\n", rc);
@@ -191,7 +380,7 @@ int ras_store_non_standard_record(struct ras_events *ras, struct ras_non_standar
 	if (rc != SQLITE_OK && rc != SQLITE_DONE)
 		log(TERM, LOG_ERR,
 		    "Failed reset non_standard_event on sqlite: error = %d\n", rc);
-	log(TERM, LOG_INFO, "register inserted at db\n");
+	log(TERM, LOG_DEBUG, "register inserted at db\n");
 
 	return rc;
 }
@@ -225,7 +414,7 @@ int ras_store_arm_record(struct ras_events *ras, struct ras_arm_event *ev)
 
 	if (!priv || !priv->stmt_arm_record)
 		return 0;
-	log(TERM, LOG_INFO, "arm_event store: %p\n", priv->stmt_arm_record);
+	log(TERM, LOG_DEBUG, "arm_event store: %p\n", priv->stmt_arm_record);
 
 	sqlite3_bind_text (priv->stmt_arm_record,  1,  ev->timestamp, -1, NULL);
 	sqlite3_bind_int  (priv->stmt_arm_record,  2,  ev->error_count);
@@ -234,7 +423,7 @@ int ras_store_arm_record(struct ras_events *ras, struct ras_arm_event *ev)
 	sqlite3_bind_int  (priv->stmt_arm_record,  5,  ev->running_state);
 	sqlite3_bind_int  (priv->stmt_arm_record,  6,  ev->psci_state);
 
-	rc = sqlite3_step(priv->stmt_arm_record);
+	rc = ras_mc_step(priv->stmt_arm_record);
 	if (rc != SQLITE_OK && rc != SQLITE_DONE)
 		log(TERM, LOG_ERR,
 		    "Failed to do arm_event step on sqlite: error = %d\n", rc);
@@ -243,7 +432,7 @@ int ras_store_arm_record(struct ras_events *ras, struct ras_arm_event *ev)
 		log(TERM, LOG_ERR,
 		    "Failed reset arm_event on sqlite: error = %d\n",
 		    rc);
-	log(TERM, LOG_INFO, "register inserted at db\n");
+	log(TERM, LOG_DEBUG, "register inserted at db\n");
 
 	return rc;
 }
@@ -275,7 +464,7 @@ int ras_store_extlog_mem_record(struct ras_events *ras, struct ras_extlog_event
 
 	if (!priv || !priv->stmt_extlog_record)
 		return 0;
-	log(TERM, LOG_INFO, "extlog_record store: %p\n", priv->stmt_extlog_record);
+	log(TERM, LOG_DEBUG, "extlog_record store: %p\n", priv->stmt_extlog_record);
 
 	sqlite3_bind_text  (priv->stmt_extlog_record,  1, ev->timestamp, -1, NULL);
 	sqlite3_bind_int   (priv->stmt_extlog_record,  2, ev->etype);
@@ -286,7 +475,7 @@ int ras_store_extlog_mem_record(struct ras_events *ras, struct ras_extlog_event
 	sqlite3_bind_text  (priv->stmt_extlog_record,  7, ev->fru_text, -1, NULL);
 	sqlite3_bind_blob  (priv->stmt_extlog_record,  8, ev->cper_data, ev->cper_data_length, NULL);
 
-	rc = sqlite3_step(priv->stmt_extlog_record);
+	rc = ras_mc_step(priv->stmt_extlog_record);
 	if (rc != SQLITE_OK && rc != SQLITE_DONE)
 		log(TERM, LOG_ERR,
 		    "Failed to do extlog_mem_record step on sqlite: error = %d\n", rc);
@@ -295,7 +484,7 @@ int ras_store_extlog_mem_record(struct ras_events *ras, struct ras_extlog_event
 		log(TERM, LOG_ERR,
 		    "Failed reset extlog_mem_record on sqlite: error = %d\n",
 		    rc);
-	log(TERM, LOG_INFO, "register inserted at db\n");
+	log(TERM, LOG_DEBUG, "register inserted at db\n");
 
 	return rc;
 }
@@ -350,7 +539,7 @@ int ras_store_mce_record(struct ras_events *ras, struct mce_event *ev)
 
 	if (!priv || !priv->stmt_mce_record)
 		return 0;
-	log(TERM, LOG_INFO, "mce_record store: %p\n", priv->stmt_mce_record);
+	log(TERM, LOG_DEBUG, "mce_record store: %p\n", priv->stmt_mce_record);
 
 	sqlite3_bind_text  (priv->stmt_mce_record,  1, ev->timestamp, -1, NULL);
 	sqlite3_bind_int   (priv->stmt_mce_record,  2, ev->mcgcap);
@@ -377,7 +566,7 @@ int ras_store_mce_record(struct ras_events *ras, struct mce_event *ev)
 	sqlite3_bind_text(priv->stmt_mce_record, 22, ev->user_action, -1, NULL);
 	sqlite3_bind_text(priv->stmt_mce_record, 23, ev->mc_location, -1, NULL);
 
-	rc = sqlite3_step(priv->stmt_mce_record);
+	rc = ras_mc_step(priv->stmt_mce_record);
 	if (rc != SQLITE_OK && rc != SQLITE_DONE)
 		log(TERM, LOG_ERR,
 		    "Failed to do mce_record step on sqlite: error = %d\n", rc);
@@ -386,7 +575,71 @@ int ras_store_mce_record(struct ras_events *ras, struct mce_event *ev)
 		log(TERM, LOG_ERR,
 		    "Failed reset mce_record on sqlite: error = %d\n",
 		    rc);
-	log(TERM, LOG_INFO, "register inserted at db\n");
+	log(TERM, LOG_DEBUG, "register inserted at db\n");
+
+	return rc;
+}
+
+/*
+ * Summaries of corrected MCE storms, see ras-mce-storm.c
+ */
+static const struct db_fields mce_storm_fields[] = {
+		{ .name="id",			.type="INTEGER PRIMARY KEY" },
+		{ .name="first_seen",		.type="TEXT" },
+		{ .name="last_seen",		.type="TEXT" },
+		{ .name="count",		.type="INTEGER" },
+		{ .name="cpu",			.type="INTEGER" },
+		{ .name="bank",			.type="INTEGER" }, // 5
+		{ .name="status",		.type="INTEGER" },
+		{ .name="addr",			.type="INTEGER" },
+		{ .name="misc",			.type="INTEGER" },
+		{ .name="bank_name",		.type="TEXT" },
+		{ .name="error_msg",		.type="TEXT" }, // 10
+		{ .name="mcistatus_msg",	.type="TEXT" },
+		{ .name="mcastatus_msg",	.type="TEXT" },
+		{ .name="mc_location",		.type="TEXT" },
+};
+
+static const struct db_table_descriptor mce_storm_tab = {
+	.name = "mce_storm",
+	.fields = mce_storm_fields,
+	.num_fields = ARRAY_SIZE(mce_storm_fields),
+};
+
+int ras_store_mce_storm(struct ras_events *ras, struct ras_mce_storm_event *ev)
+{
+	int rc;
+	struct sqlite3_priv *priv = ras->db_priv;
+	struct mce_event *e = ev->mce;
+
+	if (!priv || !priv->stmt_mce_storm)
+		return 0;
+	log(TERM, LOG_DEBUG, "mce_storm store: %p\n", priv->stmt_mce_storm);
+
+	sqlite3_bind_text  (priv->stmt_mce_storm,  1, ev->first_seen, -1, NULL);
+	sqlite3_bind_text  (priv->stmt_mce_storm,  2, ev->last_seen, -1, NULL);
+	sqlite3_bind_int64 (priv->stmt_mce_storm,  3, ev->count);
+	sqlite3_bind_int   (priv->stmt_mce_storm,  4, e->cpu);
+	sqlite3_bind_int   (priv->stmt_mce_storm,  5, e->bank);
+	sqlite3_bind_int64 (priv->stmt_mce_storm,  6, e->status);
+	sqlite3_bind_int64 (priv->stmt_mce_storm,  7, e->addr);
+	sqlite3_bind_int64 (priv->stmt_mce_storm,  8, e->misc);
+	sqlite3_bind_text  (priv->stmt_mce_storm,  9, e->bank_name, -1, NULL);
+	sqlite3_bind_text  (priv->stmt_mce_storm, 10, e->error_msg, -1, NULL);
+	sqlite3_bind_text  (priv->stmt_mce_storm, 11, e->mcistatus_msg, -1, NULL);
+	sqlite3_bind_text  (priv->stmt_mce_storm, 12, e->mcastatus_msg, -1, NULL);
+	sqlite3_bind_text  (priv->stmt_mce_storm, 13, e->mc_location, -1, NULL);
+
+	rc = ras_mc_step(priv->stmt_mce_storm);
+	if (rc != SQLITE_OK && rc != SQLITE_DONE)
+		log(TERM, LOG_ERR,
+		    "Failed to do mce_storm step on sqlite: error = %d\n", rc);
+	rc = sqlite3_reset(priv->stmt_mce_storm);
+	if (rc != SQLITE_OK && rc != SQLITE_DONE)
+		log(TERM, LOG_ERR,
+		    "Failed reset mce_storm on sqlite: error = %d\n",
+		    rc);
+	log(TERM, LOG_DEBUG, "register inserted at db\n");
 
 	return rc;
 }
@@ -420,7 +673,7 @@ int ras_store_devlink_event(struct ras_events *ras, struct devlink_event *ev)
 
 	if (!priv || !priv->stmt_devlink_event)
 		return 0;
-	log(TERM, LOG_INFO, "devlink_event store: %p\n", priv->stmt_devlink_event);
+	log(TERM, LOG_DEBUG, "devlink_event store: %p\n", priv->stmt_devlink_event);
 
 	sqlite3_bind_text(priv->stmt_devlink_event,  1, ev->timestamp, -1, NULL);
 	sqlite3_bind_text(priv->stmt_devlink_event,  2, ev->bus_name, -1, NULL);
@@ -429,7 +682,7 @@ int ras_store_devlink_event(struct ras_events *ras, struct devlink_event *ev)
 	sqlite3_bind_text(priv->stmt_devlink_event,  5, ev->reporter_name, -1, NULL);
 	sqlite3_bind_text(priv->stmt_devlink_event,  6, ev->msg, -1, NULL);
 
-	rc = sqlite3_step(priv->stmt_devlink_event);
+	rc = ras_mc_step(priv->stmt_devlink_event);
 	if (rc != SQLITE_OK && rc != SQLITE_DONE)
 		log(TERM, LOG_ERR,
 		    "Failed to do devlink_event step on sqlite: error = %d\n", rc);
@@ -438,7 +691,7 @@ int ras_store_devlink_event(struct ras_events *ras, struct devlink_event *ev)
 		log(TERM, LOG_ERR,
 		    "Failed reset devlink_event on sqlite: error = %d\n",
 		    rc);
-	log(TERM, LOG_INFO, "register inserted at db\n");
+	log(TERM, LOG_DEBUG, "register inserted at db\n");
 
 	return rc;
 }
@@ -458,6 +711,10 @@ static const struct db_fields diskerror_event_fields[] = {
 		{ .name="error",		.type="TEXT" },
 		{ .name="rwbs",			.type="TEXT" },
 		{ .name="cmd",			.type="TEXT" },
+		{ .name="name",			.type="TEXT" },
+		{ .name="wwid",			.type="TEXT" },
+		{ .name="model",		.type="TEXT" },
+		{ .name="serial",		.type="TEXT" },
 };
 
 static const struct db_table_descriptor diskerror_event_tab = {
@@ -473,7 +730,7 @@ int ras_store_diskerror_event(struct ras_events *ras, struct diskerror_event *ev
 
 	if (!priv || !priv->stmt_diskerror_event)
 		return 0;
-	log(TERM, LOG_INFO, "diskerror_eventstore: %p\n", priv->stmt_diskerror_event);
+	log(TERM, LOG_DEBUG, "diskerror_eventstore: %p\n", priv->stmt_diskerror_event);
 
 	sqlite3_bind_text(priv->stmt_diskerror_event,  1, ev->timestamp, -1, NULL);
 	sqlite3_bind_text(priv->stmt_diskerror_event,  2, ev->dev, -1, NULL);
@@ -482,8 +739,12 @@ int ras_store_diskerror_event(struct ras_events *ras, struct diskerror_event *ev
 	sqlite3_bind_text(priv->stmt_diskerror_event,  5, ev->error, -1, NULL);
 	sqlite3_bind_text(priv->stmt_diskerror_event,  6, ev->rwbs, -1, NULL);
 	sqlite3_bind_text(priv->stmt_diskerror_event,  7, ev->cmd, -1, NULL);
+	sqlite3_bind_text(priv->stmt_diskerror_event,  8, ev->name, -1, NULL);
+	sqlite3_bind_text(priv->stmt_diskerror_event,  9, ev->wwid, -1, NULL);
+	sqlite3_bind_text(priv->stmt_diskerror_event, 10, ev->model, -1, NULL);
+	sqlite3_bind_text(priv->stmt_diskerror_event, 11, ev->serial, -1, NULL);
 
-	rc = sqlite3_step(priv->stmt_diskerror_event);
+	rc = ras_mc_step(priv->stmt_diskerror_event);
 	if (rc != SQLITE_OK && rc != SQLITE_DONE)
 		log(TERM, LOG_ERR,
 		    "Failed to do diskerror_event step on sqlite: error = %d\n", rc);
@@ -492,7 +753,62 @@ int ras_store_diskerror_event(struct ras_events *ras, struct diskerror_event *ev
 		log(TERM, LOG_ERR,
 		    "Failed reset diskerror_event on sqlite: error = %d\n",
 		    rc);
-	log(TERM, LOG_INFO, "register inserted at db\n");
+	log(TERM, LOG_DEBUG, "register inserted at db\n");
+
+	return rc;
+}
+
+/*
+ * Bad regions of block devices, see ras-disk-regions.c
+ */
+static const struct db_fields disk_region_fields[] = {
+		{ .name="id",			.type="INTEGER PRIMARY KEY" },
+		{ .name="timestamp",		.type="TEXT" },
+		{ .name="dev",			.type="TEXT" },
+		{ .name="sector",		.type="INTEGER" },
+		{ .name="nr_sector",		.type="INTEGER" },
+		{ .name="count",		.type="INTEGER" },
+		{ .name="first_seen",		.type="TEXT" },
+		{ .name="last_seen",		.type="TEXT" },
+		{ .name="error",		.type="TEXT" },
+		{ .name="errors_per_min",	.type="REAL" },
+};
+
+static const struct db_table_descriptor disk_region_tab = {
+	.name = "disk_error_regions",
+	.fields = disk_region_fields,
+	.num_fields = ARRAY_SIZE(disk_region_fields),
+};
+
+int ras_store_disk_region(struct ras_events *ras, struct ras_disk_region_event *ev)
+{
+	int rc;
+	struct sqlite3_priv *priv = ras->db_priv;
+
+	if (!priv || !priv->stmt_disk_region)
+		return 0;
+	log(TERM, LOG_DEBUG, "disk_error_regions store: %p\n", priv->stmt_disk_region);
+
+	sqlite3_bind_text  (priv->stmt_disk_region,  1, ev->timestamp, -1, NULL);
+	sqlite3_bind_text  (priv->stmt_disk_region,  2, ev->dev, -1, NULL);
+	sqlite3_bind_int64 (priv->stmt_disk_region,  3, ev->sector);
+	sqlite3_bind_int64 (priv->stmt_disk_region,  4, ev->nr_sector);
+	sqlite3_bind_int64 (priv->stmt_disk_region,  5, ev->count);
+	sqlite3_bind_text  (priv->stmt_disk_region,  6, ev->first_seen, -1, NULL);
+	sqlite3_bind_text  (priv->stmt_disk_region,  7, ev->last_seen, -1, NULL);
+	sqlite3_bind_text  (priv->stmt_disk_region,  8, ev->error, -1, NULL);
+	sqlite3_bind_double(priv->stmt_disk_region,  9, ev->rate);
+
+	rc = ras_mc_step(priv->stmt_disk_region);
+	if (rc != SQLITE_OK && rc != SQLITE_DONE)
+		log(TERM, LOG_ERR,
+		    "Failed to do disk_error_regions step on sqlite: error = %d\n", rc);
+	rc = sqlite3_reset(priv->stmt_disk_region);
+	if (rc != SQLITE_OK && rc != SQLITE_DONE)
+		log(TERM, LOG_ERR,
+		    "Failed reset disk_error_regions on sqlite: error = %d\n",
+		    rc);
+	log(TERM, LOG_DEBUG, "register inserted at db\n");
 
 	return rc;
 }
@@ -538,7 +854,7 @@ static int __ras_mc_prepare_stmt(struct sqlite3_priv *priv,
 	if (rc != SQLITE_OK) {
 		log(TERM, LOG_ERR,
 		    "Failed to prepare insert db at table %s (db %s): error = %s\n",
-		    db_tab->name, SQLITE_RAS_DB, sqlite3_errmsg(priv->db));
+		    db_tab->name, ras_db_file(), sqlite3_errmsg(priv->db));
 		stmt = NULL;
 	} else {
 		log(TERM, LOG_INFO, "Recording %s events\n", db_tab->name);
@@ -574,7 +890,7 @@ static int ras_mc_create_table(struct sqlite3_priv *priv,
 	if (rc != SQLITE_OK) {
 		log(TERM, LOG_ERR,
 		    "Failed to create table %s on %s: error = %d\n",
-		    db_tab->name, SQLITE_RAS_DB, rc);
+		    db_tab->name, ras_db_file(), rc);
 	}
 	return rc;
 }
@@ -593,7 +909,7 @@ static int ras_mc_alter_table(struct sqlite3_priv *priv,
 	if (rc != SQLITE_OK) {
 		log(TERM, LOG_ERR,
 		    "Failed to query fields from the table %s on %s: error = %d\n",
-		    db_tab->name, SQLITE_RAS_DB, rc);
+		    db_tab->name, ras_db_file(), rc);
 		return rc;
 	}
 
@@ -623,7 +939,7 @@ static int ras_mc_alter_table(struct sqlite3_priv *priv,
 				log(TERM, LOG_ERR,
 				    "Failed to add new field %s to the table %s on %s: error = %d\n",
 				    field->name, db_tab->name,
-				    SQLITE_RAS_DB, rc);
+				    ras_db_file(), rc);
 				return rc;
 			}
 			p = sql;
@@ -644,16 +960,16 @@ static int ras_mc_prepare_stmt(struct sqlite3_priv *priv,
 	if (rc != SQLITE_OK) {
 		log(TERM, LOG_ERR,
 		    "Failed to prepare insert db at table %s (db %s): error = %s\n",
-		    db_tab->name, SQLITE_RAS_DB, sqlite3_errmsg(priv->db));
+		    db_tab->name, ras_db_file(), sqlite3_errmsg(priv->db));
 
 		log(TERM, LOG_INFO, "Trying to alter db at table %s (db %s)\n",
-		    db_tab->name, SQLITE_RAS_DB);
+		    db_tab->name, ras_db_file());
 
 		rc = ras_mc_alter_table(priv, stmt, db_tab);
 		if (rc != SQLITE_OK && rc != SQLITE_DONE) {
 			log(TERM, LOG_ERR,
 			    "Failed to alter db at table %s (db %s): error = %s\n",
-			    db_tab->name, SQLITE_RAS_DB,
+			    db_tab->name, ras_db_file(),
 			    sqlite3_errmsg(priv->db));
 			stmt = NULL;
 			return rc;
@@ -717,7 +1033,7 @@ int ras_mc_event_opendb(unsigned cpu, struct ras_events *ras)
 	}
 
 	do {
-		rc = sqlite3_open_v2(SQLITE_RAS_DB, &db,
+		rc = sqlite3_open_v2(ras_db_file(), &db,
 				     SQLITE_OPEN_FULLMUTEX |
 				     SQLITE_OPEN_READWRITE |
 				     SQLITE_OPEN_CREATE, NULL);
@@ -728,11 +1044,16 @@ int ras_mc_event_opendb(unsigned cpu, struct ras_events *ras)
 	if (rc != SQLITE_OK) {
 		log(TERM, LOG_ERR,
 		    "cpu %u: Failed to connect to %s: error = %d\n",
-		    cpu, SQLITE_RAS_DB, rc);
+		    cpu, ras_db_file(), rc);
 		goto error;
 	}
 	priv->db = db;
 
+	priv->batch_max = ras_parse_env_ulong("RAS_DB_BATCH", 0, ULONG_MAX,
+					      DB_BATCH);
+	priv->batch_ms = ras_parse_env_ulong("RAS_DB_BATCH_MS", 0, ULONG_MAX,
+					     DB_BATCH_MS);
+
 	rc = ras_mc_create_table(priv, &mc_event_tab);
 	if (rc == SQLITE_OK) {
 		rc = ras_mc_prepare_stmt(priv, &priv->stmt_mc_event,
@@ -749,6 +1070,14 @@ int ras_mc_event_opendb(unsigned cpu, struct ras_events *ras)
 		if (rc != SQLITE_OK)
 			goto error;
 	}
+
+	rc = ras_mc_create_table(priv, &aer_summary_tab);
+	if (rc == SQLITE_OK) {
+		rc = ras_mc_prepare_stmt(priv, &priv->stmt_aer_summary,
+					 &aer_summary_tab);
+		if (rc != SQLITE_OK)
+			goto error;
+	}
 #endif
 
 #ifdef HAVE_EXTLOG
@@ -769,6 +1098,14 @@ int ras_mc_event_opendb(unsigned cpu, struct ras_events *ras)
 		if (rc != SQLITE_OK)
 			goto error;
 	}
+
+	rc = ras_mc_create_table(priv, &mce_storm_tab);
+	if (rc == SQLITE_OK) {
+		rc = ras_mc_prepare_stmt(priv, &priv->stmt_mce_storm,
+					 &mce_storm_tab);
+		if (rc != SQLITE_OK)
+			goto error;
+	}
 #endif
 
 #ifdef HAVE_NON_STANDARD
@@ -808,6 +1145,14 @@ int ras_mc_event_opendb(unsigned cpu, struct ras_events *ras)
 		if (rc != SQLITE_OK)
 			goto error;
 	}
+
+	rc = ras_mc_create_table(priv, &disk_region_tab);
+	if (rc == SQLITE_OK) {
+		rc = ras_mc_prepare_stmt(priv, &priv->stmt_disk_region,
+					 &disk_region_tab);
+		if (rc != SQLITE_OK)
+			goto error;
+	}
 #endif
 
 	ras->db_priv = priv;
@@ -833,6 +1178,8 @@ int ras_mc_event_closedb(unsigned int cpu, struct ras_events *ras)
 	if (!db)
 		return -1;
 
+	ras_db_commit(ras);
+
 	if (priv->stmt_mc_event) {
 		rc = sqlite3_finalize(priv->stmt_mc_event);
 		if (rc != SQLITE_OK)
@@ -849,6 +1196,14 @@ int ras_mc_event_closedb(unsigned int cpu, struct ras_events *ras)
 			    "cpu %u: Failed to finalize aer_event sqlite: error = %d\n",
 			    cpu, rc);
 	}
+
+	if (priv->stmt_aer_summary) {
+		rc = sqlite3_finalize(priv->stmt_aer_summary);
+		if (rc != SQLITE_OK)
+			log(TERM, LOG_ERR,
+			    "cpu %u: Failed to finalize aer_event_summary sqlite: error = %d\n",
+			    cpu, rc);
+	}
 #endif
 
 #ifdef HAVE_EXTLOG
@@ -870,6 +1225,14 @@ int ras_mc_event_closedb(unsigned int cpu, struct ras_events *ras)
 			    "cpu %u: Failed to finalize mce_record sqlite: error = %d\n",
 			    cpu, rc);
 	}
+
+	if (priv->stmt_mce_storm) {
+		rc = sqlite3_finalize(priv->stmt_mce_storm);
+		if (rc != SQLITE_OK)
+			log(TERM, LOG_ERR,
+			    "cpu %u: Failed to finalize mce_storm sqlite: error = %d\n",
+			    cpu, rc);
+	}
 #endif
 
 #ifdef HAVE_NON_STANDARD
@@ -910,6 +1273,14 @@ int ras_mc_event_closedb(unsigned int cpu, struct ras_events *ras)
 			    "cpu %u: Failed to finalize diskerror_event sqlite: error = %d\n",
 			    cpu, rc);
 	}
+
+	if (priv->stmt_disk_region) {
+		rc = sqlite3_finalize(priv->stmt_disk_region);
+		if (rc != SQLITE_OK)
+			log(TERM, LOG_ERR,
+			    "cpu %u: Failed to finalize disk_error_regions sqlite: error = %d\n",
+			    cpu, rc);
+	}
 #endif
 
 	rc = sqlite3_close_v2(db);
@@ -39,12 +39,34 @@ struct ras_mc_event {
 	const char *driver_detail;
 };
 
+/* PCIe TLP header fields, as decoded by ras-aer-handler.c */
+struct ras_aer_tlp {
+	uint8_t fmt_type;		/* DW0[31:24] */
+	const char *type;		/* "MRd", "CplD"... */
+	uint16_t requester_id;
+	uint16_t completer_id;		/* completions and config requests */
+	uint8_t tag;
+	unsigned long long address;	/* memory, IO and atomic requests */
+	unsigned has_completer:1;
+	unsigned has_address:1;
+};
+
 struct ras_aer_event {
 	char timestamp[64];
 	const char *error_type;
 	const char *dev_name;
+	uint32_t status;
 	uint8_t tlp_header_valid;
-	uint32_t *tlp_header;
+	uint32_t tlp_header[4];
+	struct ras_aer_tlp tlp;		/* if tlp_header_valid */
+	const char *msg;
+};
+
+struct ras_aer_summary_event {
+	char first_seen[64], last_seen[64];
+	unsigned long long count;
+	const char *dev_name;
+	const char *error_type;
 	const char *msg;
 };
 
@@ -91,6 +113,7 @@ struct devlink_event {
 struct diskerror_event {
 	char timestamp[64];
 	char *dev;
+	const char *name, *wwid, *model, *serial;
 	unsigned long long sector;
 	unsigned int nr_sector;
 	const char *error;
@@ -98,8 +121,26 @@ struct diskerror_event {
 	const char *cmd;
 };
 
+struct ras_disk_region_event {
+	const char *timestamp;
+	const char *dev;
+	unsigned long long sector, nr_sector;
+	unsigned long long count;
+	char first_seen[64], last_seen[64];
+	const char *error;
+	double rate;			/* errors per minute of the device */
+};
+
+struct ras_mce_storm_event {
+	char first_seen[64], last_seen[64];
+	unsigned long long count;
+	struct mce_event *mce;		/* last coalesced event, decoded */
+};
+
 struct ras_mc_event;
+struct ras_disk_region_event;
 struct ras_aer_event;
+struct ras_aer_summary_event;
 struct ras_extlog_event;
 struct ras_non_standard_event;
 struct ras_arm_event;
@@ -113,12 +154,21 @@ struct diskerror_event;
 
 struct sqlite3_priv {
 	sqlite3		*db;
+
+	/* Transaction of the batched lane, see ras_db_batch() */
+	unsigned long	batch_max;	/* events, 0 if not batching */
+	unsigned long	batch_ms;
+	unsigned long	batch_events;
+	uint64_t	batch_start;	/* ms, CLOCK_MONOTONIC */
+
 	sqlite3_stmt	*stmt_mc_event;
 #ifdef HAVE_AER
 	sqlite3_stmt	*stmt_aer_event;
+	sqlite3_stmt	*stmt_aer_summary;
 #endif
 #ifdef HAVE_MCE
 	sqlite3_stmt	*stmt_mce_record;
+	sqlite3_stmt	*stmt_mce_storm;
 #endif
 #ifdef HAVE_EXTLOG
 	sqlite3_stmt	*stmt_extlog_record;
@@ -134,6 +184,7 @@ struct sqlite3_priv {
 #endif
 #ifdef HAVE_DISKERROR
 	sqlite3_stmt	*stmt_diskerror_event;
+	sqlite3_stmt	*stmt_disk_region;
 #endif
 };
 
@@ -153,26 +204,39 @@ int ras_mc_event_closedb(unsigned int cpu, struct ras_events *ras);
 int ras_mc_add_vendor_table(struct ras_events *ras, sqlite3_stmt **stmt,
 			    const struct db_table_descriptor *db_tab);
 int ras_mc_finalize_vendor_table(sqlite3_stmt *stmt);
+int ras_mc_step(sqlite3_stmt *stmt);
+void ras_db_batch(struct ras_events *ras);
+void ras_db_commit(struct ras_events *ras);
+int ras_db_flush(struct ras_events *ras, int force);
 int ras_store_mc_event(struct ras_events *ras, struct ras_mc_event *ev);
 int ras_store_aer_event(struct ras_events *ras, struct ras_aer_event *ev);
+int ras_store_aer_summary(struct ras_events *ras, struct ras_aer_summary_event *ev);
 int ras_store_mce_record(struct ras_events *ras, struct mce_event *ev);
+int ras_store_mce_storm(struct ras_events *ras, struct ras_mce_storm_event *ev);
 int ras_store_extlog_mem_record(struct ras_events *ras, struct ras_extlog_event *ev);
 int ras_store_non_standard_record(struct ras_events *ras, struct ras_non_standard_event *ev);
 int ras_store_arm_record(struct ras_events *ras, struct ras_arm_event *ev);
 int ras_store_devlink_event(struct ras_events *ras, struct devlink_event *ev);
 int ras_store_diskerror_event(struct ras_events *ras, struct diskerror_event *ev);
+int ras_store_disk_region(struct ras_events *ras, struct ras_disk_region_event *ev);
 
 #else
 static inline int ras_mc_event_opendb(unsigned cpu, struct ras_events *ras) { return 0; };
 static inline int ras_mc_event_closedb(unsigned int cpu, struct ras_events *ras) { return 0; };
+static inline void ras_db_batch(struct ras_events *ras) { };
+static inline void ras_db_commit(struct ras_events *ras) { };
+static inline int ras_db_flush(struct ras_events *ras, int force) { return -1; };
 static inline int ras_store_mc_event(struct ras_events *ras, struct ras_mc_event *ev) { return 0; };
 static inline int ras_store_aer_event(struct ras_events *ras, struct ras_aer_event *ev) { return 0; };
+static inline int ras_store_aer_summary(struct ras_events *ras, struct ras_aer_summary_event *ev) { return 0; };
 static inline int ras_store_mce_record(struct ras_events *ras, struct mce_event *ev) { return 0; };
+static inline int ras_store_mce_storm(struct ras_events *ras, struct ras_mce_storm_event *ev) { return 0; };
 static inline int ras_store_extlog_mem_record(struct ras_events *ras, struct ras_extlog_event *ev) { return 0; };
 static inline int ras_store_non_standard_record(struct ras_events *ras, struct ras_non_standard_event *ev) { return 0; };
 static inline int ras_store_arm_record(struct ras_events *ras, struct ras_arm_event *ev) { return 0; };
 static inline int ras_store_devlink_event(struct ras_events *ras, struct devlink_event *ev) { return 0; };
 static inline int ras_store_diskerror_event(struct ras_events *ras, struct diskerror_event *ev) { return 0; };
+static inline int ras_store_disk_region(struct ras_events *ras, struct ras_disk_region_event *ev) { return 0; };
 
 #endif
 
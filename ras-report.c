@@ -11,33 +11,130 @@
  * GNU General Public License for more details.
  */
 
+/*
+ * ABRT reporting.
+ *
+ * Reports are formatted on the event path and queued, to be sent by a
+ * reporter thread. ABRT takes one report per connection: the reporter
+ * sends each one with a single sendmsg() of the common header, the
+ * backtrace and the event type specific items.
+ *
+ * At most ABRT_RATE_LIMIT reports per minute of each event type are
+ * queued, and the queue holds ABRT_QUEUE_SIZE reports, the others being
+ * dropped. While ABRT is down, the queued reports are kept and the
+ * connection is retried with an exponential backoff.
+ *
+ * On exit, the reports still queued are sent, for at most
+ * REPORT_EXIT_TIMEOUT seconds, unless ABRT is down.
+ */
+
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdarg.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/utsname.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <sys/un.h>
 
 #include "ras-report.h"
+#include "ras-logger.h"
+#include "ras-env.h"
+#include "ras-metrics.h"
+#include "ras-probes.h"
+
+#define REPORT_RATE_WINDOW	60	/* seconds */
+#define REPORT_MAX_BACKOFF	64	/* seconds */
+#define REPORT_EXIT_TIMEOUT	5	/* seconds */
+
+struct ras_report {
+	struct ras_report	*next;
+	int			type;
+	unsigned		urgent:1;	/* see ras_lane_urgent */
+	size_t			len;		/* of bt, with its NUL */
+	char			bt[];		/* BACKTRACE=... */
+};
+
+#define REPORT_TRAILER(analyzer, reason)				\
+	{ "ANALYZER=" analyzer "\0REASON=" reason,			\
+	  sizeof("ANALYZER=" analyzer "\0REASON=" reason) }
+
+static const struct {
+	const char	*items;
+	size_t		len;
+} report_trailers[NR_EVENTS] = {
+	[MC_EVENT]		= REPORT_TRAILER("rasdaemon-mc",
+						 "EDAC driver report problem"),
+	[AER_EVENT]		= REPORT_TRAILER("rasdaemon-aer",
+						 "PCIe AER driver report problem"),
+	[MCE_EVENT]		= REPORT_TRAILER("rasdaemon-mce",
+						 "Machine Check driver report problem"),
+	[NON_STANDARD_EVENT]	= REPORT_TRAILER("rasdaemon-non-standard",
+						 "Unknown CPER section problem"),
+	[ARM_EVENT]		= REPORT_TRAILER("rasdaemon-arm",
+						 "ARM CPU report problem"),
+	[DEVLINK_EVENT]		= REPORT_TRAILER("rasdaemon-devlink",
+						 "devlink health report problem"),
+	[DISKERROR_EVENT]	= REPORT_TRAILER("rasdaemon-diskerror",
+						 "disk I/O error"),
+};
+
+static struct {
+	pthread_once_t		once;
+	pthread_mutex_t		lock;
+	pthread_cond_t		cond;
+	pthread_t		thread;
+	int			running;
+	int			stop;		/* drain the queue, then exit */
+
+	/* PUT request, PID, EXECUTABLE and TYPE */
+	char			header[256];
+	size_t			header_len;
+
+	unsigned long		queue_size, rate_limit;
+
+	/* Urgent reports are queued first, up to urgent_tail */
+	struct ras_report	*head, *tail, *urgent_tail;
+	unsigned long		queued, queued_urgent;
+
+	struct {
+		time_t		window;
+		unsigned long	sent, dropped;
+	} rate[NR_EVENTS];
+} reporter = {
+	.once = PTHREAD_ONCE_INIT,
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.cond = PTHREAD_COND_INITIALIZER,
+};
+
+static const char *report_type_name(int type)
+{
+	/* skips "ANALYZER=rasdaemon-" */
+	return report_trailers[type].items + 19;
+}
 
-static int setup_report_socket(void){
-	int sockfd = -1;
-	int rc = -1;
+static int setup_report_socket(void)
+{
 	struct sockaddr_un addr;
+	int sockfd;
 
-	sockfd = socket(AF_UNIX, SOCK_STREAM, 0);
-	if (sockfd < 0){
+	sockfd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (sockfd < 0)
 		return -1;
-	}
 
 	memset(&addr, 0, sizeof(struct sockaddr_un));
 	addr.sun_family = AF_UNIX;
 	strncpy(addr.sun_path, ABRT_SOCKET, sizeof(addr.sun_path));
 	addr.sun_path[sizeof(addr.sun_path) - 1] = '\0';
 
-	rc = connect(sockfd, (struct sockaddr *)&addr, sizeof(struct sockaddr_un));
-	if (rc < 0) {
+	if (connect(sockfd, (struct sockaddr *)&addr, sizeof(struct sockaddr_un)) < 0) {
 		close(sockfd);
 		return -1;
 	}
@@ -45,666 +142,524 @@ static int setup_report_socket(void){
 	return sockfd;
 }
 
-static int commit_report_basic(int sockfd){
-	char buf[INPUT_BUFFER_SIZE];
-	struct utsname un;
-	int rc = -1;
-
-	if(sockfd < 0){
-		return rc;
-	}
+enum report_status {
+	REPORT_SENT,
+	REPORT_FAILED,		/* dropped */
+	REPORT_DOWN,		/* ABRT is not listening, retry later */
+};
 
-	memset(buf, 0, INPUT_BUFFER_SIZE);
-	memset(&un, 0, sizeof(struct utsname));
+static enum report_status report_send(struct ras_report *rep)
+{
+	struct iovec iov[3], *v = iov;
+	struct msghdr msg;
+	size_t left;
+	ssize_t rc;
+	int sockfd;
 
-	rc = uname(&un);
-	if(rc < 0){
-		return rc;
-	}
-
-	/*
-	 * ABRT server protocol
-	 */
-	sprintf(buf, "PUT / HTTP/1.1\r\n\r\n");
-	rc = write(sockfd, buf, strlen(buf));
-	if(rc < strlen(buf)){
-		return -1;
-	}
-
-	sprintf(buf, "PID=%d", (int)getpid());
-	rc = write(sockfd, buf, strlen(buf) + 1);
-	if(rc < strlen(buf) + 1){
-		return -1;
-	}
-
-	sprintf(buf, "EXECUTABLE=/boot/vmlinuz-%s", un.release);
-	rc = write(sockfd, buf, strlen(buf) + 1);
-	if(rc < strlen(buf) + 1){
-		return -1;
-	}
+	sockfd = setup_report_socket();
+	if (sockfd < 0)
+		return REPORT_DOWN;
+
+	iov[0].iov_base = reporter.header;
+	iov[0].iov_len = reporter.header_len;
+	iov[1].iov_base = rep->bt;
+	iov[1].iov_len = rep->len;
+	iov[2].iov_base = (void *)report_trailers[rep->type].items;
+	iov[2].iov_len = report_trailers[rep->type].len;
+	left = iov[0].iov_len + iov[1].iov_len + iov[2].iov_len;
+
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = iov;
+	msg.msg_iovlen = ARRAY_SIZE(iov);
+
+	while (left) {
+		rc = sendmsg(sockfd, &msg, MSG_NOSIGNAL);
+		if (rc < 0) {
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+		left -= rc;
 
-	sprintf(buf, "TYPE=%s", "ras");
-	rc = write(sockfd, buf, strlen(buf) + 1);
-	if(rc < strlen(buf) + 1){
-		return -1;
+		/* Short write: skip what was sent */
+		while (left && (size_t)rc >= v->iov_len) {
+			rc -= v->iov_len;
+			v++;
+			msg.msg_iovlen--;
+		}
+		v->iov_base = (char *)v->iov_base + rc;
+		v->iov_len -= rc;
+		msg.msg_iov = v;
 	}
+	close(sockfd);
 
-	return 0;
+	return left ? REPORT_FAILED : REPORT_SENT;
 }
 
-static int set_mc_event_backtrace(char *buf, struct ras_mc_event *ev){
-	char bt_buf[MAX_BACKTRACE_SIZE];
-
-	if(!buf || !ev)
-		return -1;
-
-	sprintf(bt_buf, "BACKTRACE="	\
-						"timestamp=%s\n"	\
-						"error_count=%d\n"	\
-						"error_type=%s\n"	\
-						"msg=%s\n"	\
-						"label=%s\n"	\
-						"mc_index=%c\n"	\
-						"top_layer=%c\n"	\
-						"middle_layer=%c\n"	\
-						"lower_layer=%c\n"	\
-						"address=%llu\n"	\
-						"grain=%llu\n"	\
-						"syndrome=%llu\n"	\
-						"driver_detail=%s\n",	\
-						ev->timestamp,	\
-						ev->error_count,	\
-						ev->error_type,	\
-						ev->msg,	\
-						ev->label,	\
-						ev->mc_index,	\
-						ev->top_layer,	\
-						ev->middle_layer,	\
-						ev->lower_layer,	\
-						ev->address,	\
-						ev->grain,	\
-						ev->syndrome,	\
-						ev->driver_detail);
-
-	strcat(buf, bt_buf);
-
-	return 0;
-}
-
-static int set_mce_event_backtrace(char *buf, struct mce_event *ev){
-	char bt_buf[MAX_BACKTRACE_SIZE];
-
-	if(!buf || !ev)
-		return -1;
-
-	sprintf(bt_buf, "BACKTRACE="	\
-						"timestamp=%s\n"	\
-						"bank_name=%s\n"	\
-						"error_msg=%s\n"	\
-						"mcgstatus_msg=%s\n"	\
-						"mcistatus_msg=%s\n"	\
-						"mcastatus_msg=%s\n"	\
-						"user_action=%s\n"	\
-						"mc_location=%s\n"	\
-						"mcgcap=%lu\n"	\
-						"mcgstatus=%lu\n"	\
-						"status=%lu\n"	\
-						"addr=%lu\n"	\
-						"misc=%lu\n"	\
-						"ip=%lu\n"	\
-						"tsc=%lu\n"	\
-						"walltime=%lu\n"	\
-						"cpu=%u\n"	\
-						"cpuid=%u\n"	\
-						"apicid=%u\n"	\
-						"socketid=%u\n"	\
-						"cs=%d\n"	\
-						"bank=%d\n"	\
-						"cpuvendor=%d\n",	\
-						ev->timestamp,	\
-						ev->bank_name,	\
-						ev->error_msg,	\
-						ev->mcgstatus_msg,	\
-						ev->mcistatus_msg,	\
-						ev->mcastatus_msg,	\
-						ev->user_action,	\
-						ev->mc_location,	\
-						ev->mcgcap,	\
-						ev->mcgstatus,	\
-						ev->status,	\
-						ev->addr,	\
-						ev->misc,	\
-						ev->ip,	\
-						ev->tsc,	\
-						ev->walltime,	\
-						ev->cpu,	\
-						ev->cpuid,	\
-						ev->apicid,	\
-						ev->socketid,	\
-						ev->cs,	\
-						ev->bank,	\
-						ev->cpuvendor);
-
-	strcat(buf, bt_buf);
-
-	return 0;
+/* Queues @rep after @prev, or first if NULL. Called with reporter.lock */
+static void report_insert(struct ras_report *prev, struct ras_report *rep)
+{
+	if (prev) {
+		rep->next = prev->next;
+		prev->next = rep;
+	} else {
+		rep->next = reporter.head;
+		reporter.head = rep;
+	}
+	if (!rep->next)
+		reporter.tail = rep;
+	if (rep->urgent &&
+	    (!reporter.urgent_tail || prev == reporter.urgent_tail))
+		reporter.urgent_tail = rep;
 }
 
-static int set_aer_event_backtrace(char *buf, struct ras_aer_event *ev){
-	char bt_buf[MAX_BACKTRACE_SIZE];
-
-	if(!buf || !ev)
-		return -1;
-
-	sprintf(bt_buf, "BACKTRACE="	\
-						"timestamp=%s\n"	\
-						"error_type=%s\n"	\
-						"dev_name=%s\n"	\
-						"msg=%s\n",	\
-						ev->timestamp,	\
-						ev->error_type,	\
-						ev->dev_name,	\
-						ev->msg);
+/*
+ * Takes the first report off the queue, while it is sent. It is still
+ * accounted as queued until then. Called with reporter.lock
+ */
+static struct ras_report *report_pop(void)
+{
+	struct ras_report *rep = reporter.head;
 
-	strcat(buf, bt_buf);
+	reporter.head = rep->next;
+	if (!reporter.head)
+		reporter.tail = NULL;
+	if (reporter.urgent_tail == rep)
+		reporter.urgent_tail = NULL;
 
-	return 0;
+	return rep;
 }
 
-static int set_non_standard_event_backtrace(char *buf, struct ras_non_standard_event *ev){
-	char bt_buf[MAX_BACKTRACE_SIZE];
-
-	if(!buf || !ev)
-		return -1;
+static void *report_thread(void *arg)
+{
+	struct ras_report *rep;
+	enum report_status status;
+	unsigned int backoff = 0;
+	struct timespec retry;
+	sigset_t mask;
+	int rc;
+
+	/* Signals are handled by the main thread */
+	sigfillset(&mask);
+	pthread_sigmask(SIG_BLOCK, &mask, NULL);
+
+	pthread_mutex_lock(&reporter.lock);
+	for (;;) {
+		while (!reporter.head && !reporter.stop)
+			pthread_cond_wait(&reporter.cond, &reporter.lock);
+		if (!reporter.head)
+			break;
+		rep = report_pop();
+		pthread_mutex_unlock(&reporter.lock);
+
+		status = report_send(rep);
+		RAS_PROBE3(report_send, rep->type, rep->len, status);
+
+		switch (status) {
+		case REPORT_DOWN:
+			ras_metrics_inc(RAS_METRIC_ABRT_DOWN);
+			if (!backoff)
+				log(SYSLOG, LOG_WARNING,
+				    "Can't connect to ABRT, keeping %lu reports queued\n",
+				    reporter.queued);
+			backoff = backoff ? backoff * 2 : 1;
+			if (backoff > REPORT_MAX_BACKOFF)
+				backoff = REPORT_MAX_BACKOFF;
+			pthread_mutex_lock(&reporter.lock);
+			/* Back first in its lane */
+			report_insert(rep->urgent ? NULL : reporter.urgent_tail,
+				      rep);
+
+			/* Cut short by ras_report_exit(), as ABRT is down */
+			clock_gettime(CLOCK_REALTIME, &retry);
+			retry.tv_sec += backoff;
+			rc = 0;
+			while (!reporter.stop && rc != ETIMEDOUT)
+				rc = pthread_cond_timedwait(&reporter.cond,
+							    &reporter.lock,
+							    &retry);
+			if (reporter.stop)
+				goto out;
+			continue;
+		case REPORT_FAILED:
+			ras_metrics_inc(RAS_METRIC_ABRT_FAILED);
+			log(SYSLOG, LOG_WARNING, "Failed to send %s report to ABRT\n",
+			    report_type_name(rep->type));
+			break;
+		case REPORT_SENT:
+			ras_metrics_inc(RAS_METRIC_ABRT_SENT);
+			break;
+		}
+		if (backoff) {
+			log(SYSLOG, LOG_INFO, "ABRT is reachable again\n");
+			backoff = 0;
+		}
 
-	sprintf(bt_buf, "BACKTRACE="	\
-						"timestamp=%s\n"	\
-						"severity=%s\n"	\
-						"length=%d\n",	\
-						ev->timestamp,	\
-						ev->severity,	\
-						ev->length);
+		pthread_mutex_lock(&reporter.lock);
+		reporter.queued--;
+		if (rep->urgent)
+			reporter.queued_urgent--;
+		ras_metrics_set(RAS_GAUGE_ABRT_QUEUE, reporter.queued);
+		free(rep);
+	}
 
-	strcat(buf, bt_buf);
+out:
+	reporter.running = 0;
+	pthread_cond_broadcast(&reporter.cond);
+	pthread_mutex_unlock(&reporter.lock);
 
-	return 0;
+	return NULL;
 }
 
-static int set_arm_event_backtrace(char *buf, struct ras_arm_event *ev){
-	char bt_buf[MAX_BACKTRACE_SIZE];
+static void report_init(void)
+{
+	struct utsname un;
+	int len;
 
-	if(!buf || !ev)
-		return -1;
+	reporter.queue_size = ras_parse_env_ulong("ABRT_QUEUE_SIZE", 0,
+						  ULONG_MAX, 64);
+	reporter.rate_limit = ras_parse_env_ulong("ABRT_RATE_LIMIT", 0,
+						  ULONG_MAX, 10);
 
-	sprintf(bt_buf, "BACKTRACE="    \
-						"timestamp=%s\n"	\
-						"error_count=%d\n"	\
-						"affinity=%d\n"	\
-						"mpidr=0x%lx\n"	\
-						"midr=0x%lx\n"	\
-						"running_state=%d\n"	\
-						"psci_state=%d\n",	\
-						ev->timestamp,	\
-						ev->error_count,	\
-						ev->affinity,	\
-						ev->mpidr,	\
-						ev->midr,	\
-						ev->running_state,	\
-						ev->psci_state);
-
-	strcat(buf, bt_buf);
-
-	return 0;
+	/*
+	 * ABRT server protocol: a PUT request, followed by NUL terminated
+	 * items.
+	 */
+	memset(&un, 0, sizeof(un));
+	uname(&un);
+	len = snprintf(reporter.header, sizeof(reporter.header),
+		       "PUT / HTTP/1.1\r\n\r\n"
+		       "PID=%d%c"
+		       "EXECUTABLE=/boot/vmlinuz-%s%c"
+		       "TYPE=%s%c",
+		       (int)getpid(), '\0', un.release, '\0', "ras", '\0');
+	if (len < 0 || len >= sizeof(reporter.header))
+		return;
+	reporter.header_len = len;
+
+	if (pthread_create(&reporter.thread, NULL, report_thread, NULL))
+		log(ALL, LOG_ERR, "Can't create the ABRT reporter thread\n");
+	else
+		reporter.running = 1;
 }
 
-static int set_devlink_event_backtrace(char *buf, struct devlink_event *ev){
-	char bt_buf[MAX_BACKTRACE_SIZE];
-
-	if(!buf || !ev)
-		return -1;
-
-	sprintf(bt_buf, "BACKTRACE="	\
-						"timestamp=%s\n"	\
-						"bus_name=%s\n"		\
-						"dev_name=%s\n"		\
-						"driver_name=%s\n"	\
-						"reporter_name=%s\n"	\
-						"msg=%s\n",		\
-						ev->timestamp,		\
-						ev->bus_name,		\
-						ev->dev_name,		\
-						ev->driver_name,	\
-						ev->reporter_name,	\
-						ev->msg);
-
-	strcat(buf, bt_buf);
-
-	return 0;
+void ras_report_exit(void)
+{
+	struct ras_report *rep;
+	struct timespec deadline;
+	unsigned long left;
+	int rc = 0;
+
+	pthread_mutex_lock(&reporter.lock);
+	if (!reporter.running) {
+		pthread_mutex_unlock(&reporter.lock);
+		return;
+	}
+
+	reporter.stop = 1;
+	pthread_cond_broadcast(&reporter.cond);
+
+	clock_gettime(CLOCK_REALTIME, &deadline);
+	deadline.tv_sec += REPORT_EXIT_TIMEOUT;
+	while (reporter.running && rc != ETIMEDOUT)
+		rc = pthread_cond_timedwait(&reporter.cond, &reporter.lock,
+					    &deadline);
+	left = reporter.queued;
+	pthread_mutex_unlock(&reporter.lock);
+
+	/* Stuck on ABRT: its lock is left alone from now on */
+	if (rc == ETIMEDOUT) {
+		pthread_cancel(reporter.thread);
+		pthread_join(reporter.thread, NULL);
+		log(SYSLOG, LOG_WARNING,
+		    "Timed out sending the reports to ABRT, %lu not sent\n",
+		    left);
+		return;
+	}
+	pthread_join(reporter.thread, NULL);
+
+	if (left)
+		log(SYSLOG, LOG_WARNING,
+		    "Can't connect to ABRT, %lu reports not sent\n", left);
+	while (reporter.head) {
+		rep = report_pop();
+		free(rep);
+	}
 }
 
-static int set_diskerror_event_backtrace(char *buf, struct diskerror_event *ev) {
-	char bt_buf[MAX_BACKTRACE_SIZE];
-
-	if(!buf || !ev)
-		return -1;
-
-	sprintf(bt_buf, "BACKTRACE="	\
-						"timestamp=%s\n"	\
-						"dev=%s\n"		\
-						"sector=%llu\n"		\
-						"nr_sector=%u\n"	\
-						"error=%s\n"		\
-						"rwbs=%s\n"		\
-						"cmd=%s\n",		\
-						ev->timestamp,		\
-						ev->dev,		\
-						ev->sector,		\
-						ev->nr_sector,		\
-						ev->error,		\
-						ev->rwbs,		\
-						ev->cmd);
-
-	strcat(buf, bt_buf);
-
-	return 0;
-}
+/*
+ * Whether a report of @type can be queued now. Urgent reports aren't rate
+ * limited, and have their own queue_size reports to queue
+ */
+static int report_admit(int type, int urgent)
+{
+	struct timespec now;
+	int admit = 0;
 
-static int commit_report_backtrace(int sockfd, int type, void *ev){
-	char buf[MAX_BACKTRACE_SIZE];
-	char *pbuf = buf;
-	int rc = -1;
-	int buf_len = 0;
+	pthread_once(&reporter.once, report_init);
+	if (!reporter.running)
+		return 0;
 
-	if(sockfd < 0 || !ev){
-		return -1;
-	}
+	clock_gettime(CLOCK_MONOTONIC, &now);
 
-	memset(buf, 0, MAX_BACKTRACE_SIZE);
-
-	switch(type){
-	case MC_EVENT:
-		rc = set_mc_event_backtrace(buf, (struct ras_mc_event *)ev);
-		break;
-	case AER_EVENT:
-		rc = set_aer_event_backtrace(buf, (struct ras_aer_event *)ev);
-		break;
-	case MCE_EVENT:
-		rc = set_mce_event_backtrace(buf, (struct mce_event *)ev);
-		break;
-	case NON_STANDARD_EVENT:
-		rc = set_non_standard_event_backtrace(buf, (struct ras_non_standard_event *)ev);
-		break;
-	case ARM_EVENT:
-		rc = set_arm_event_backtrace(buf, (struct ras_arm_event *)ev);
-		break;
-	case DEVLINK_EVENT:
-		rc = set_devlink_event_backtrace(buf, (struct devlink_event *)ev);
-		break;
-	case DISKERROR_EVENT:
-		rc = set_diskerror_event_backtrace(buf, (struct diskerror_event *)ev);
-		break;
-	default:
-		return -1;
-	}
+	pthread_mutex_lock(&reporter.lock);
 
-	if(rc < 0){
-		return -1;
+	if (now.tv_sec - reporter.rate[type].window >= REPORT_RATE_WINDOW) {
+		if (reporter.rate[type].dropped)
+			log(SYSLOG, LOG_WARNING,
+			    "Dropped %lu %s reports to ABRT in the last %ds\n",
+			    reporter.rate[type].dropped,
+			    report_type_name(type), REPORT_RATE_WINDOW);
+		reporter.rate[type].window = now.tv_sec;
+		reporter.rate[type].sent = 0;
+		reporter.rate[type].dropped = 0;
 	}
 
-	buf_len = strlen(buf);
-
-	for(;buf_len > INPUT_BUFFER_SIZE - 1; buf_len -= (INPUT_BUFFER_SIZE - 1)){
-		rc = write(sockfd, pbuf, INPUT_BUFFER_SIZE - 1);
-		if(rc < INPUT_BUFFER_SIZE - 1){
-			return -1;
+	if (urgent) {
+		if (reporter.queued_urgent >= reporter.queue_size) {
+			reporter.rate[type].dropped++;
+			ras_metrics_inc(RAS_METRIC_ABRT_DROPPED);
+		} else {
+			admit = 1;
 		}
-
-		pbuf = pbuf + INPUT_BUFFER_SIZE - 1;
+	} else if ((reporter.rate_limit &&
+		    reporter.rate[type].sent >= reporter.rate_limit) ||
+		   reporter.queued - reporter.queued_urgent >=
+		   reporter.queue_size) {
+		reporter.rate[type].dropped++;
+		ras_metrics_inc(RAS_METRIC_ABRT_DROPPED);
+	} else {
+		reporter.rate[type].sent++;
+		admit = 1;
 	}
 
-	rc = write(sockfd, pbuf, buf_len + 1);
-	if(rc < buf_len){
-		return -1;
-	}
+	pthread_mutex_unlock(&reporter.lock);
 
-	return 0;
+	return admit;
 }
 
-int ras_report_mc_event(struct ras_events *ras, struct ras_mc_event *ev){
-	char buf[MAX_MESSAGE_SIZE];
-	int sockfd = -1;
-	int done = 0;
-	int rc = -1;
-
-	memset(buf, 0, sizeof(buf));
-
-	sockfd = setup_report_socket();
-	if(sockfd < 0){
-		return -1;
-	}
-
-	rc = commit_report_basic(sockfd);
-	if(rc < 0){
-		goto mc_fail;
-	}
-
-	rc = commit_report_backtrace(sockfd, MC_EVENT, ev);
-	if(rc < 0){
-		goto mc_fail;
-	}
-
-	sprintf(buf, "ANALYZER=%s", "rasdaemon-mc");
-	rc = write(sockfd, buf, strlen(buf) + 1);
-	if(rc < strlen(buf) + 1){
-		goto mc_fail;
-	}
-
-	sprintf(buf, "REASON=%s", "EDAC driver report problem");
-	rc = write(sockfd, buf, strlen(buf) + 1);
-	if(rc < strlen(buf) + 1){
-		goto mc_fail;
-	}
-
-	done = 1;
-
-mc_fail:
-
-	if(sockfd > 0){
-		close(sockfd);
-	}
-
-	if(done){
-		return 0;
-	}else{
-		return -1;
-	}
+static void report_queue(struct ras_report *rep)
+{
+	pthread_mutex_lock(&reporter.lock);
+	if (rep->urgent) {
+		report_insert(reporter.urgent_tail, rep);
+		reporter.queued_urgent++;
+	} else {
+		report_insert(reporter.tail, rep);
+	}
+	reporter.queued++;
+	ras_metrics_set(RAS_GAUGE_ABRT_QUEUE, reporter.queued);
+	pthread_cond_signal(&reporter.cond);
+	pthread_mutex_unlock(&reporter.lock);
 }
 
-int ras_report_aer_event(struct ras_events *ras, struct ras_aer_event *ev){
-	char buf[MAX_MESSAGE_SIZE];
-	int sockfd = 0;
-	int done = 0;
-	int rc = -1;
-
-	memset(buf, 0, sizeof(buf));
-
-	sockfd = setup_report_socket();
-	if(sockfd < 0){
-		return -1;
-	}
-
-	rc = commit_report_basic(sockfd);
-	if(rc < 0){
-		goto aer_fail;
-	}
-
-	rc = commit_report_backtrace(sockfd, AER_EVENT, ev);
-	if(rc < 0){
-		goto aer_fail;
-	}
-
-	sprintf(buf, "ANALYZER=%s", "rasdaemon-aer");
-	rc = write(sockfd, buf, strlen(buf) + 1);
-	if(rc < strlen(buf) + 1){
-		goto aer_fail;
-	}
-
-	sprintf(buf, "REASON=%s", "PCIe AER driver report problem");
-	rc = write(sockfd, buf, strlen(buf) + 1);
-	if(rc < strlen(buf) + 1){
-		goto aer_fail;
-	}
-
-	done = 1;
-
-aer_fail:
-
-	if(sockfd > 0){
-		close(sockfd);
-	}
-
-	if(done){
-		return 0;
-	}else{
-		return -1;
-	}
+__attribute__((format(printf, 2, 3)))
+static struct ras_report *report_alloc(int type, const char *fmt, ...)
+{
+	struct ras_report *rep;
+	va_list ap;
+	int len;
+
+	va_start(ap, fmt);
+	len = vsnprintf(NULL, 0, fmt, ap);
+	va_end(ap);
+	if (len < 0)
+		return NULL;
+	if (len > MAX_BACKTRACE_SIZE - 1)
+		len = MAX_BACKTRACE_SIZE - 1;
+
+	rep = malloc(sizeof(*rep) + len + 1);
+	if (!rep)
+		return NULL;
+	rep->next = NULL;
+	rep->type = type;
+	rep->len = len + 1;
+
+	va_start(ap, fmt);
+	vsnprintf(rep->bt, len + 1, fmt, ap);
+	va_end(ap);
+
+	return rep;
 }
 
-int ras_report_non_standard_event(struct ras_events *ras, struct ras_non_standard_event *ev){
-	char buf[MAX_MESSAGE_SIZE];
-	int sockfd = 0;
-	int rc = -1;
-
-	memset(buf, 0, sizeof(buf));
-
-	sockfd = setup_report_socket();
-	if(sockfd < 0){
-		return rc;
-	}
-
-	rc = commit_report_basic(sockfd);
-	if(rc < 0){
-		goto non_standard_fail;
-	}
-
-	rc = commit_report_backtrace(sockfd, NON_STANDARD_EVENT, ev);
-	if(rc < 0){
-		goto non_standard_fail;
-	}
-
-	sprintf(buf, "ANALYZER=%s", "rasdaemon-non-standard");
-	rc = write(sockfd, buf, strlen(buf) + 1);
-	if(rc < strlen(buf) + 1){
-		goto non_standard_fail;
-	}
-
-	sprintf(buf, "REASON=%s", "Unknown CPER section problem");
-	rc = write(sockfd, buf, strlen(buf) + 1);
-	if(rc < strlen(buf) + 1){
-		goto non_standard_fail;
-	}
-
-	rc = 0;
-
-non_standard_fail:
-
-	if(sockfd > 0){
-		close(sockfd);
-	}
-
-	return rc;
+static struct ras_report *mc_event_report(struct ras_mc_event *ev)
+{
+	return report_alloc(MC_EVENT,
+			    "BACKTRACE="
+			    "timestamp=%s\n"
+			    "error_count=%d\n"
+			    "error_type=%s\n"
+			    "msg=%s\n"
+			    "label=%s\n"
+			    "mc_index=%c\n"
+			    "top_layer=%c\n"
+			    "middle_layer=%c\n"
+			    "lower_layer=%c\n"
+			    "address=%llu\n"
+			    "grain=%llu\n"
+			    "syndrome=%llu\n"
+			    "driver_detail=%s\n",
+			    ev->timestamp, ev->error_count, ev->error_type,
+			    ev->msg, ev->label, ev->mc_index, ev->top_layer,
+			    ev->middle_layer, ev->lower_layer, ev->address,
+			    ev->grain, ev->syndrome, ev->driver_detail);
 }
 
-int ras_report_arm_event(struct ras_events *ras, struct ras_arm_event *ev){
-	char buf[MAX_MESSAGE_SIZE];
-	int sockfd = 0;
-	int rc = -1;
-
-	memset(buf, 0, sizeof(buf));
-
-	sockfd = setup_report_socket();
-	if(sockfd < 0){
-		return rc;
-	}
-
-	rc = commit_report_basic(sockfd);
-	if(rc < 0){
-		goto arm_fail;
-	}
-
-	rc = commit_report_backtrace(sockfd, ARM_EVENT, ev);
-	if(rc < 0){
-		goto arm_fail;
-	}
-
-	sprintf(buf, "ANALYZER=%s", "rasdaemon-arm");
-	rc = write(sockfd, buf, strlen(buf) + 1);
-	if(rc < strlen(buf) + 1){
-		goto arm_fail;
-	}
-
-	sprintf(buf, "REASON=%s", "ARM CPU report problem");
-	rc = write(sockfd, buf, strlen(buf) + 1);
-	if(rc < strlen(buf) + 1){
-		goto arm_fail;
-	}
-
-	rc = 0;
-
-arm_fail:
-
-	if(sockfd > 0){
-		close(sockfd);
-	}
-
-	return rc;
+static struct ras_report *mce_event_report(struct mce_event *ev)
+{
+	return report_alloc(MCE_EVENT,
+			    "BACKTRACE="
+			    "timestamp=%s\n"
+			    "bank_name=%s\n"
+			    "error_msg=%s\n"
+			    "mcgstatus_msg=%s\n"
+			    "mcistatus_msg=%s\n"
+			    "mcastatus_msg=%s\n"
+			    "user_action=%s\n"
+			    "mc_location=%s\n"
+			    "mcgcap=%lu\n"
+			    "mcgstatus=%lu\n"
+			    "status=%lu\n"
+			    "addr=%lu\n"
+			    "misc=%lu\n"
+			    "ip=%lu\n"
+			    "tsc=%lu\n"
+			    "walltime=%lu\n"
+			    "cpu=%u\n"
+			    "cpuid=%u\n"
+			    "apicid=%u\n"
+			    "socketid=%u\n"
+			    "cs=%d\n"
+			    "bank=%d\n"
+			    "cpuvendor=%d\n",
+			    ev->timestamp, ev->bank_name, ev->error_msg,
+			    ev->mcgstatus_msg, ev->mcistatus_msg,
+			    ev->mcastatus_msg, ev->user_action, ev->mc_location,
+			    ev->mcgcap, ev->mcgstatus, ev->status, ev->addr,
+			    ev->misc, ev->ip, ev->tsc, ev->walltime, ev->cpu,
+			    ev->cpuid, ev->apicid, ev->socketid, ev->cs,
+			    ev->bank, ev->cpuvendor);
 }
 
-int ras_report_mce_event(struct ras_events *ras, struct mce_event *ev){
-	char buf[MAX_MESSAGE_SIZE];
-	int sockfd = 0;
-	int done = 0;
-	int rc = -1;
-
-	memset(buf, 0, sizeof(buf));
-
-	sockfd = setup_report_socket();
-	if(sockfd < 0){
-		return -1;
-	}
-
-	rc = commit_report_basic(sockfd);
-	if(rc < 0){
-		goto mce_fail;
-	}
-
-	rc = commit_report_backtrace(sockfd, MCE_EVENT, ev);
-	if(rc < 0){
-		goto mce_fail;
-	}
-
-	sprintf(buf, "ANALYZER=%s", "rasdaemon-mce");
-	rc = write(sockfd, buf, strlen(buf) + 1);
-	if(rc < strlen(buf) + 1){
-		goto mce_fail;
-	}
-
-	sprintf(buf, "REASON=%s", "Machine Check driver report problem");
-	rc = write(sockfd, buf, strlen(buf) + 1);
-	if(rc < strlen(buf) + 1){
-		goto mce_fail;
-	}
-
-	done = 1;
-
-mce_fail:
-
-	if(sockfd > 0){
-		close(sockfd);
-	}
-
-	if(done){
-		return 0;
-	}else{
-		return -1;
-	}
+static struct ras_report *aer_event_report(struct ras_aer_event *ev)
+{
+	return report_alloc(AER_EVENT,
+			    "BACKTRACE="
+			    "timestamp=%s\n"
+			    "error_type=%s\n"
+			    "dev_name=%s\n"
+			    "msg=%s\n",
+			    ev->timestamp, ev->error_type, ev->dev_name,
+			    ev->msg);
 }
 
-int ras_report_devlink_event(struct ras_events *ras, struct devlink_event *ev){
-	char buf[MAX_MESSAGE_SIZE];
-	int sockfd = 0;
-	int done = 0;
-	int rc = -1;
-
-	memset(buf, 0, sizeof(buf));
-
-	sockfd = setup_report_socket();
-	if(sockfd < 0){
-		return -1;
-	}
-
-	rc = commit_report_basic(sockfd);
-	if(rc < 0){
-		goto devlink_fail;
-	}
-
-	rc = commit_report_backtrace(sockfd, DEVLINK_EVENT, ev);
-	if(rc < 0){
-		goto devlink_fail;
-	}
-
-	sprintf(buf, "ANALYZER=%s", "rasdaemon-devlink");
-	rc = write(sockfd, buf, strlen(buf) + 1);
-	if(rc < strlen(buf) + 1){
-		goto devlink_fail;
-	}
-
-	sprintf(buf, "REASON=%s", "devlink health report problem");
-	rc = write(sockfd, buf, strlen(buf) + 1);
-	if(rc < strlen(buf) + 1){
-		goto devlink_fail;
-	}
-
-	done = 1;
-
-devlink_fail:
-
-	if(sockfd > 0){
-		close(sockfd);
-	}
-
-	if(done){
-		return 0;
-	}else{
-		return -1;
-	}
+static struct ras_report *non_standard_event_report(struct ras_non_standard_event *ev)
+{
+	return report_alloc(NON_STANDARD_EVENT,
+			    "BACKTRACE="
+			    "timestamp=%s\n"
+			    "severity=%s\n"
+			    "length=%d\n",
+			    ev->timestamp, ev->severity, ev->length);
 }
 
-int ras_report_diskerror_event(struct ras_events *ras, struct diskerror_event *ev){
-	char buf[MAX_MESSAGE_SIZE];
-	int sockfd = 0;
-	int done = 0;
-	int rc = -1;
+static struct ras_report *arm_event_report(struct ras_arm_event *ev)
+{
+	return report_alloc(ARM_EVENT,
+			    "BACKTRACE="
+			    "timestamp=%s\n"
+			    "error_count=%d\n"
+			    "affinity=%d\n"
+			    "mpidr=0x%lx\n"
+			    "midr=0x%lx\n"
+			    "running_state=%d\n"
+			    "psci_state=%d\n",
+			    ev->timestamp, ev->error_count, ev->affinity,
+			    ev->mpidr, ev->midr, ev->running_state,
+			    ev->psci_state);
+}
 
-	memset(buf, 0, sizeof(buf));
+static struct ras_report *devlink_event_report(struct devlink_event *ev)
+{
+	return report_alloc(DEVLINK_EVENT,
+			    "BACKTRACE="
+			    "timestamp=%s\n"
+			    "bus_name=%s\n"
+			    "dev_name=%s\n"
+			    "driver_name=%s\n"
+			    "reporter_name=%s\n"
+			    "msg=%s\n",
+			    ev->timestamp, ev->bus_name, ev->dev_name,
+			    ev->driver_name, ev->reporter_name, ev->msg);
+}
 
-	sockfd = setup_report_socket();
-	if(sockfd < 0){
-		return -1;
-	}
+static struct ras_report *diskerror_event_report(struct diskerror_event *ev)
+{
+	return report_alloc(DISKERROR_EVENT,
+			    "BACKTRACE="
+			    "timestamp=%s\n"
+			    "dev=%s\n"
+			    "sector=%llu\n"
+			    "nr_sector=%u\n"
+			    "error=%s\n"
+			    "rwbs=%s\n"
+			    "cmd=%s\n"
+			    "name=%s\n"
+			    "wwid=%s\n"
+			    "model=%s\n"
+			    "serial=%s\n",
+			    ev->timestamp, ev->dev, ev->sector, ev->nr_sector,
+			    ev->error, ev->rwbs, ev->cmd, ev->name, ev->wwid,
+			    ev->model, ev->serial);
+}
 
-	rc = commit_report_basic(sockfd);
-	if(rc < 0){
-		goto diskerror_fail;
-	}
+/* Formats the report of @ev as @type, if it is admitted */
+#define RAS_REPORT(type, ev, fn)					\
+	do {								\
+		struct ras_report *rep;					\
+		int urgent = ras_lane_urgent;				\
+									\
+		if (!(ev) || !report_admit(type, urgent))		\
+			return -1;					\
+		rep = fn(ev);						\
+		if (!rep)						\
+			return -1;					\
+		rep->urgent = urgent;					\
+		report_queue(rep);					\
+		return 0;						\
+	} while (0)
+
+int ras_report_mc_event(struct ras_events *ras, struct ras_mc_event *ev)
+{
+	RAS_REPORT(MC_EVENT, ev, mc_event_report);
+}
 
-	rc = commit_report_backtrace(sockfd, DISKERROR_EVENT, ev);
-	if(rc < 0){
-		goto diskerror_fail;
-	}
+int ras_report_aer_event(struct ras_events *ras, struct ras_aer_event *ev)
+{
+	RAS_REPORT(AER_EVENT, ev, aer_event_report);
+}
 
-	sprintf(buf, "ANALYZER=%s", "rasdaemon-diskerror");
-	rc = write(sockfd, buf, strlen(buf) + 1);
-	if(rc < strlen(buf) + 1){
-		goto diskerror_fail;
-	}
+int ras_report_non_standard_event(struct ras_events *ras, struct ras_non_standard_event *ev)
+{
+	RAS_REPORT(NON_STANDARD_EVENT, ev, non_standard_event_report);
+}
 
-	sprintf(buf, "REASON=%s", "disk I/O error");
-	rc = write(sockfd, buf, strlen(buf) + 1);
-	if(rc < strlen(buf) + 1){
-		goto diskerror_fail;
-	}
+int ras_report_arm_event(struct ras_events *ras, struct ras_arm_event *ev)
+{
+	RAS_REPORT(ARM_EVENT, ev, arm_event_report);
+}
 
-	done = 1;
+int ras_report_mce_event(struct ras_events *ras, struct mce_event *ev)
+{
+	RAS_REPORT(MCE_EVENT, ev, mce_event_report);
+}
 
-diskerror_fail:
-	if(sockfd > 0){
-		close(sockfd);
-	}
+int ras_report_devlink_event(struct ras_events *ras, struct devlink_event *ev)
+{
+	RAS_REPORT(DEVLINK_EVENT, ev, devlink_event_report);
+}
 
-	if(done){
-		return 0;
-	}else{
-		return -1;
-	}
+int ras_report_diskerror_event(struct ras_events *ras, struct diskerror_event *ev)
+{
+	RAS_REPORT(DISKERROR_EVENT, ev, diskerror_event_report);
 }
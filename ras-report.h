@@ -22,10 +22,6 @@
 
 /* Maximal length of backtrace. */
 #define MAX_BACKTRACE_SIZE (1024*1024)
-/* Amount of data received from one client for a message before reporting error. */
-#define MAX_MESSAGE_SIZE (4*MAX_BACKTRACE_SIZE)
-/* Maximal number of characters read from socket at once. */
-#define INPUT_BUFFER_SIZE (8*1024)
 /* ABRT socket file */
 #define ABRT_SOCKET "/var/run/abrt/abrt.socket"
 
@@ -39,6 +35,9 @@ int ras_report_arm_event(struct ras_events *ras, struct ras_arm_event *ev);
 int ras_report_devlink_event(struct ras_events *ras, struct devlink_event *ev);
 int ras_report_diskerror_event(struct ras_events *ras, struct diskerror_event *ev);
 
+/* sends the reports still queued, for a few seconds at most */
+void ras_report_exit(void);
+
 #else
 
 static inline int ras_report_mc_event(struct ras_events *ras, struct ras_mc_event *ev) { return 0; };
@@ -48,6 +47,7 @@ static inline int ras_report_non_standard_event(struct ras_events *ras, struct r
 static inline int ras_report_arm_event(struct ras_events *ras, struct ras_arm_event *ev) { return 0; };
 static inline int ras_report_devlink_event(struct ras_events *ras, struct devlink_event *ev) { return 0; };
 static inline int ras_report_diskerror_event(struct ras_events *ras, struct diskerror_event *ev) { return 0; };
+static inline void ras_report_exit(void) { return; };
 
 #endif
 
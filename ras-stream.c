@@ -0,0 +1,946 @@
+/*
+ * Copyright (c) Huawei Technologies Co., Ltd. 2026. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+/*
+ * Live event stream for external consumers, see ras-stream.h for the
+ * protocol.
+ *
+ * Events are encoded once, when published, in both formats. They are
+ * kept on a replay ring of RAS_STREAM_REPLAY events, and copied to the
+ * output buffer (RAS_STREAM_BUFFER bytes) of each subscribed client.
+ * Publishing never blocks: a stream thread does all the socket I/O.
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include "ras-stream.h"
+#include "ras-events.h"
+#include "ras-record.h"
+#include "ras-mce-handler.h"
+#include "ras-logger.h"
+#include "ras-env.h"
+#include "ras-metrics.h"
+#include "ras-format.h"
+
+#define STREAM_MAX_CLIENTS	16
+#define STREAM_LINE_LEN		256
+#define STREAM_TYPE_DROPPED	255
+
+static const char *stream_severities[NR_RAS_SEV] = {
+	[RAS_SEV_INFO]		= "info",
+	[RAS_SEV_CORRECTED]	= "corrected",
+	[RAS_SEV_RECOVERABLE]	= "recoverable",
+	[RAS_SEV_FATAL]		= "fatal",
+};
+
+struct stream_field {
+	const char		*key;
+	const char		*str;		/* NULL for integers */
+	unsigned long long	val;
+	char			kind;		/* 's', 'i' or 'u' */
+};
+
+#define SF_STR(k, v)	{ .key = k, .str = stream_str(v), .kind = 's' }
+#define SF_INT(k, v)	{ .key = k, .val = (long long)(v), .kind = 'i' }
+#define SF_UINT(k, v)	{ .key = k, .val = (v), .kind = 'u' }
+
+static inline const char *stream_str(const char *s)
+{
+	return s ? s : "";
+}
+
+/* A published event, in both formats, with their length prefix */
+struct stream_rec {
+	uint64_t		id;
+	uint8_t			type, sev;
+	char			*json, *bin;
+	size_t			json_len, bin_len;
+};
+
+struct stream_client {
+	int			fd;
+	unsigned		subscribed:1;
+	unsigned		binary:1;
+	uint32_t		types, sevs;	/* masks */
+	char			line[STREAM_LINE_LEN];
+	size_t			line_len;
+	char			*out;
+	size_t			out_len;
+	unsigned long long	dropped;
+};
+
+struct ras_stream {
+	pthread_mutex_t		lock;
+	pthread_t		thread;
+	char			*path;
+	int			listen_fd, wake_fd;
+	unsigned		wake_pending:1;
+	unsigned		stop:1;
+
+	unsigned long		buf_size, replay;
+	uint64_t		first_id, next_id;
+	struct stream_rec	*ring;		/* replay ring */
+	unsigned long		ring_head, ring_count;
+
+	struct stream_client	clients[STREAM_MAX_CLIENTS];
+};
+
+/* Growing buffer, for the encoders */
+struct sbuf {
+	char			*p;
+	size_t			len, size;
+	int			err;
+};
+
+static void sbuf_add(struct sbuf *b, const void *data, size_t len)
+{
+	size_t size;
+	char *p;
+
+	if (b->err)
+		return;
+	if (b->len + len > b->size) {
+		size = b->size ? b->size : 256;
+		while (size < b->len + len)
+			size *= 2;
+		p = realloc(b->p, size);
+		if (!p) {
+			b->err = 1;
+			return;
+		}
+		b->p = p;
+		b->size = size;
+	}
+	memcpy(b->p + b->len, data, len);
+	b->len += len;
+}
+
+static void sbuf_str(struct sbuf *b, const char *s)
+{
+	sbuf_add(b, s, strlen(s));
+}
+
+static void sbuf_json_str(struct sbuf *b, const char *s)
+{
+	char esc[8];
+
+	sbuf_add(b, "\"", 1);
+	for (; *s; s++) {
+		if (*s == '"' || *s == '\\') {
+			esc[0] = '\\';
+			esc[1] = *s;
+			sbuf_add(b, esc, 2);
+		} else if ((unsigned char)*s < 0x20) {
+			snprintf(esc, sizeof(esc), "\\u%04x", *s);
+			sbuf_add(b, esc, 6);
+		} else {
+			sbuf_add(b, s, 1);
+		}
+	}
+	sbuf_add(b, "\"", 1);
+}
+
+/* Starts a record, leaving room for its length */
+static void sbuf_rec_start(struct sbuf *b)
+{
+	uint32_t len = 0;
+
+	sbuf_add(b, &len, sizeof(len));
+}
+
+static void sbuf_rec_end(struct sbuf *b)
+{
+	uint32_t len = b->len - sizeof(len);
+
+	if (!b->err)
+		memcpy(b->p, &len, sizeof(len));
+}
+
+static void stream_encode_json(struct sbuf *b, uint64_t id, int type, int sev,
+			       const char *timestamp,
+			       const struct stream_field *f, int n)
+{
+	char num[32];
+	int i;
+
+	sbuf_rec_start(b);
+	snprintf(num, sizeof(num), "%llu", (unsigned long long)id);
+	sbuf_str(b, "{\"id\":");
+	sbuf_str(b, num);
+	sbuf_str(b, ",\"type\":");
+	sbuf_json_str(b, ras_event_names[type]);
+	sbuf_str(b, ",\"severity\":");
+	sbuf_json_str(b, stream_severities[sev]);
+	sbuf_str(b, ",\"timestamp\":");
+	sbuf_json_str(b, timestamp);
+
+	for (i = 0; i < n; i++) {
+		sbuf_str(b, ",");
+		sbuf_json_str(b, f[i].key);
+		sbuf_str(b, ":");
+		if (f[i].kind == 's') {
+			sbuf_json_str(b, f[i].str);
+			continue;
+		}
+		if (f[i].kind == 'i')
+			snprintf(num, sizeof(num), "%lld", (long long)f[i].val);
+		else
+			snprintf(num, sizeof(num), "%llu", f[i].val);
+		sbuf_str(b, num);
+	}
+	sbuf_str(b, "}");
+	sbuf_rec_end(b);
+}
+
+static void sbuf_bin_field(struct sbuf *b, const struct stream_field *f)
+{
+	uint8_t keylen = strlen(f->key);
+	uint32_t len;
+	uint64_t val;
+
+	sbuf_add(b, &keylen, sizeof(keylen));
+	sbuf_add(b, f->key, keylen);
+	sbuf_add(b, &f->kind, 1);
+	if (f->kind == 's') {
+		len = strlen(f->str);
+		sbuf_add(b, &len, sizeof(len));
+		sbuf_add(b, f->str, len);
+	} else {
+		val = f->val;
+		sbuf_add(b, &val, sizeof(val));
+	}
+}
+
+static void stream_encode_bin(struct sbuf *b, uint64_t id, int type, int sev,
+			      const char *timestamp,
+			      const struct stream_field *f, int n)
+{
+	struct stream_field ts = SF_STR("timestamp", timestamp);
+	uint8_t t = type, s = sev;
+	uint16_t nfields = n + 1;
+	int i;
+
+	sbuf_rec_start(b);
+	sbuf_add(b, &id, sizeof(id));
+	sbuf_add(b, &t, sizeof(t));
+	sbuf_add(b, &s, sizeof(s));
+	sbuf_add(b, &nfields, sizeof(nfields));
+	sbuf_bin_field(b, &ts);
+	for (i = 0; i < n; i++)
+		sbuf_bin_field(b, &f[i]);
+	sbuf_rec_end(b);
+}
+
+/* Encodes the "dropped" record, for the events @c missed */
+static void stream_encode_dropped(struct sbuf *b, struct stream_client *c)
+{
+	struct stream_field count = SF_UINT("count", c->dropped);
+	uint8_t t = STREAM_TYPE_DROPPED, s = RAS_SEV_INFO;
+	uint64_t id = 0;
+	uint16_t nfields = 1;
+	char num[32];
+
+	sbuf_rec_start(b);
+	if (c->binary) {
+		sbuf_add(b, &id, sizeof(id));
+		sbuf_add(b, &t, sizeof(t));
+		sbuf_add(b, &s, sizeof(s));
+		sbuf_add(b, &nfields, sizeof(nfields));
+		sbuf_bin_field(b, &count);
+	} else {
+		snprintf(num, sizeof(num), "%llu", c->dropped);
+		sbuf_str(b, "{\"type\":\"dropped\",\"count\":");
+		sbuf_str(b, num);
+		sbuf_str(b, "}");
+	}
+	sbuf_rec_end(b);
+}
+
+/*
+ * Appends a whole record to the buffer of @c, after telling about the
+ * dropped ones, if any. Drops it if both don't fit.
+ * With no record, only tells about the dropped ones.
+ */
+static void stream_client_add(struct ras_stream *st, struct stream_client *c,
+			      const char *rec, size_t len)
+{
+	struct sbuf b = { 0 };
+
+	if (c->dropped)
+		stream_encode_dropped(&b, c);
+
+	if (b.err || c->out_len + b.len + len > st->buf_size) {
+		if (rec) {
+			c->dropped++;
+			ras_metrics_inc(RAS_METRIC_STREAM_DROPPED);
+		}
+		free(b.p);
+		return;
+	}
+	if (b.len) {
+		memcpy(c->out + c->out_len, b.p, b.len);
+		c->out_len += b.len;
+		c->dropped = 0;
+	}
+	if (rec) {
+		memcpy(c->out + c->out_len, rec, len);
+		c->out_len += len;
+	}
+	free(b.p);
+}
+
+static void stream_client_send(struct ras_stream *st, struct stream_client *c,
+			       const struct stream_rec *rec)
+{
+	if (!(c->types & (1 << rec->type)) || !(c->sevs & (1 << rec->sev)))
+		return;
+
+	if (c->binary)
+		stream_client_add(st, c, rec->bin, rec->bin_len);
+	else
+		stream_client_add(st, c, rec->json, rec->json_len);
+}
+
+static void stream_gauges(struct ras_stream *st)
+{
+	long queued = 0, clients = 0;
+	int i;
+
+	if (!ras_metrics_on)
+		return;
+
+	for (i = 0; i < STREAM_MAX_CLIENTS; i++) {
+		if (st->clients[i].fd < 0)
+			continue;
+		queued += st->clients[i].out_len;
+		clients++;
+	}
+	ras_metrics_set(RAS_GAUGE_STREAM_QUEUE, queued);
+	ras_metrics_set(RAS_GAUGE_STREAM_CLIENTS, clients);
+}
+
+static void stream_wake(struct ras_stream *st)
+{
+	uint64_t one = 1;
+
+	if (st->wake_pending)
+		return;
+	if (write(st->wake_fd, &one, sizeof(one)) == sizeof(one))
+		st->wake_pending = 1;
+}
+
+static void stream_publish(struct ras_events *ras, int type, int sev,
+			   const char *timestamp,
+			   const struct stream_field *f, int n)
+{
+	struct ras_stream *st = ras->stream;
+	struct sbuf json = { 0 }, bin = { 0 };
+	struct stream_rec *rec;
+	int i, queued = 0;
+
+	if (!st)
+		return;
+
+	pthread_mutex_lock(&st->lock);
+
+	stream_encode_json(&json, st->next_id, type, sev, timestamp, f, n);
+	stream_encode_bin(&bin, st->next_id, type, sev, timestamp, f, n);
+	if (json.err || bin.err) {
+		pthread_mutex_unlock(&st->lock);
+		free(json.p);
+		free(bin.p);
+		return;
+	}
+
+	/* Replaces the oldest event, if the ring is full */
+	rec = &st->ring[(st->ring_head + st->ring_count) % st->replay];
+	if (st->ring_count == st->replay) {
+		free(rec->json);
+		free(rec->bin);
+		st->ring_head = (st->ring_head + 1) % st->replay;
+	} else {
+		st->ring_count++;
+	}
+	rec->id = st->next_id++;
+	rec->type = type;
+	rec->sev = sev;
+	rec->json = json.p;
+	rec->json_len = json.len;
+	rec->bin = bin.p;
+	rec->bin_len = bin.len;
+
+	for (i = 0; i < STREAM_MAX_CLIENTS; i++) {
+		if (st->clients[i].fd < 0 || !st->clients[i].subscribed)
+			continue;
+		stream_client_send(st, &st->clients[i], rec);
+		queued |= !!st->clients[i].out_len;
+	}
+	if (queued)
+		stream_wake(st);
+	stream_gauges(st);
+
+	pthread_mutex_unlock(&st->lock);
+}
+
+static uint32_t stream_parse_mask(char *list, const char **names, int n)
+{
+	char *tok, *save;
+	uint32_t mask = 0;
+	int i;
+
+	for (tok = strtok_r(list, ",", &save); tok;
+	     tok = strtok_r(NULL, ",", &save)) {
+		if (!strcmp(tok, "all"))
+			return (1 << n) - 1;
+		for (i = 0; i < n; i++)
+			if (!strcmp(tok, names[i]))
+				mask |= 1 << i;
+	}
+
+	return mask;
+}
+
+static void stream_client_replay(struct ras_stream *st,
+				 struct stream_client *c, uint64_t after)
+{
+	struct stream_rec *rec;
+	unsigned long i;
+
+	if (!st->ring_count)
+		return;
+
+	/*
+	 * Events that are no longer on the ring. Nothing is known about
+	 * those of a previous run.
+	 */
+	rec = &st->ring[st->ring_head];
+	if (after + 1 >= st->first_id && rec->id > after + 1)
+		c->dropped += rec->id - after - 1;
+
+	for (i = 0; i < st->ring_count; i++) {
+		rec = &st->ring[(st->ring_head + i) % st->replay];
+		if (rec->id > after)
+			stream_client_send(st, c, rec);
+	}
+}
+
+static void stream_client_subscribe(struct ras_stream *st,
+				    struct stream_client *c)
+{
+	char *tok, *save, *val;
+	int replay = 0;
+	uint64_t after = 0;
+
+	c->types = (1 << NR_EVENTS) - 1;
+	c->sevs = (1 << NR_RAS_SEV) - 1;
+
+	for (tok = strtok_r(c->line, " \t", &save); tok;
+	     tok = strtok_r(NULL, " \t", &save)) {
+		val = strchr(tok, '=');
+		if (!val)
+			continue;
+		*val++ = '\0';
+
+		if (!strcmp(tok, "types")) {
+			c->types = stream_parse_mask(val, ras_event_names,
+						     NR_EVENTS);
+		} else if (!strcmp(tok, "severity")) {
+			c->sevs = stream_parse_mask(val, stream_severities,
+						    NR_RAS_SEV);
+		} else if (!strcmp(tok, "format")) {
+			c->binary = !strcmp(val, "binary");
+		} else if (!strcmp(tok, "replay")) {
+			after = strtoull(val, NULL, 10);
+			replay = 1;
+		}
+	}
+	c->subscribed = 1;
+
+	if (replay)
+		stream_client_replay(st, c, after);
+}
+
+static void stream_client_close(struct stream_client *c)
+{
+	close(c->fd);
+	c->fd = -1;
+	free(c->out);
+	c->out = NULL;
+}
+
+static void stream_accept(struct ras_stream *st)
+{
+	struct stream_client *c = NULL;
+	int fd, i;
+
+	fd = accept4(st->listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+	if (fd < 0)
+		return;
+
+	for (i = 0; i < STREAM_MAX_CLIENTS; i++) {
+		if (st->clients[i].fd < 0) {
+			c = &st->clients[i];
+			break;
+		}
+	}
+	if (!c) {
+		close(fd);
+		return;
+	}
+
+	memset(c, 0, sizeof(*c));
+	c->out = malloc(st->buf_size);
+	if (!c->out) {
+		c->fd = -1;
+		close(fd);
+		return;
+	}
+	c->fd = fd;
+}
+
+/* Reads the subscription line, ignoring anything after it */
+static void stream_client_read(struct ras_stream *st, struct stream_client *c)
+{
+	char buf[STREAM_LINE_LEN], *nl;
+	ssize_t len;
+	size_t n;
+
+	len = read(c->fd, buf, sizeof(buf));
+	if (len == 0 || (len < 0 && errno != EAGAIN && errno != EINTR)) {
+		stream_client_close(c);
+		return;
+	}
+	if (len < 0 || c->subscribed)
+		return;
+
+	nl = memchr(buf, '\n', len);
+	n = nl ? nl - buf : len;
+	if (c->line_len + n >= sizeof(c->line)) {
+		stream_client_close(c);
+		return;
+	}
+	memcpy(c->line + c->line_len, buf, n);
+	c->line_len += n;
+	c->line[c->line_len] = '\0';
+
+	if (nl)
+		stream_client_subscribe(st, c);
+}
+
+static void stream_client_write(struct ras_stream *st,
+			       struct stream_client *c)
+{
+	ssize_t len;
+
+	len = send(c->fd, c->out, c->out_len, MSG_NOSIGNAL);
+	if (len < 0) {
+		if (errno != EAGAIN && errno != EINTR)
+			stream_client_close(c);
+		return;
+	}
+	memmove(c->out, c->out + len, c->out_len - len);
+	c->out_len -= len;
+
+	/* Don't wait for the next event to tell about the dropped ones */
+	if (c->dropped)
+		stream_client_add(st, c, NULL, 0);
+}
+
+static void *stream_thread(void *arg)
+{
+	struct ras_stream *st = arg;
+	struct pollfd fds[STREAM_MAX_CLIENTS + 2];
+	int idx[STREAM_MAX_CLIENTS + 2];
+	struct stream_client *c;
+	uint64_t val;
+	sigset_t mask;
+	int i, n;
+
+	/* Signals are handled by the main thread */
+	sigfillset(&mask);
+	pthread_sigmask(SIG_BLOCK, &mask, NULL);
+
+	for (;;) {
+		pthread_mutex_lock(&st->lock);
+		if (st->stop) {
+			pthread_mutex_unlock(&st->lock);
+			break;
+		}
+		fds[0].fd = st->listen_fd;
+		fds[0].events = POLLIN;
+		fds[1].fd = st->wake_fd;
+		fds[1].events = POLLIN;
+		for (i = 0, n = 2; i < STREAM_MAX_CLIENTS; i++) {
+			c = &st->clients[i];
+			if (c->fd < 0)
+				continue;
+			fds[n].fd = c->fd;
+			fds[n].events = POLLIN | (c->out_len ? POLLOUT : 0);
+			idx[n++] = i;
+		}
+		pthread_mutex_unlock(&st->lock);
+
+		if (poll(fds, n, -1) < 0)
+			continue;
+
+		pthread_mutex_lock(&st->lock);
+		if (fds[1].revents & POLLIN) {
+			if (read(st->wake_fd, &val, sizeof(val)) < 0)
+				val = 0;
+			st->wake_pending = 0;
+		}
+		if (fds[0].revents & POLLIN)
+			stream_accept(st);
+		for (i = 2; i < n; i++) {
+			c = &st->clients[idx[i]];
+			if (c->fd != fds[i].fd)
+				continue;
+			if (fds[i].revents & (POLLIN | POLLHUP | POLLERR))
+				stream_client_read(st, c);
+			if (c->fd >= 0 && (fds[i].revents & POLLOUT))
+				stream_client_write(st, c);
+		}
+		stream_gauges(st);
+		pthread_mutex_unlock(&st->lock);
+	}
+
+	return NULL;
+}
+
+static int stream_listen(const char *path)
+{
+	struct sockaddr_un addr;
+	int fd;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if (strlen(path) >= sizeof(addr.sun_path))
+		return -1;
+	strcpy(addr.sun_path, path);
+
+	fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (fd < 0)
+		return -1;
+
+	/* Only root can subscribe: nobody can connect before listen() */
+	unlink(path);
+	if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+	    chmod(path, 0600) < 0 ||
+	    listen(fd, STREAM_MAX_CLIENTS) < 0) {
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+int ras_stream_init(struct ras_events *ras)
+{
+	struct ras_stream *st;
+	struct timespec ts;
+	char *path;
+	int i;
+
+	path = getenv("RAS_EVENT_SOCKET");
+	if (!path || !*path)
+		return 0;
+
+	st = calloc(1, sizeof(*st));
+	if (!st)
+		goto err;
+	pthread_mutex_init(&st->lock, NULL);
+	for (i = 0; i < STREAM_MAX_CLIENTS; i++)
+		st->clients[i].fd = -1;
+	st->wake_fd = -1;
+
+	st->buf_size = ras_parse_env_ulong("RAS_STREAM_BUFFER", 1, ULONG_MAX,
+					   256 * 1024);
+	st->replay = ras_parse_env_ulong("RAS_STREAM_REPLAY", 1, ULONG_MAX,
+					 1024);
+
+	/* Ids keep increasing across restarts */
+	clock_gettime(CLOCK_REALTIME, &ts);
+	st->next_id = (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+	st->first_id = st->next_id;
+
+	st->path = strdup(path);
+	st->ring = calloc(st->replay, sizeof(*st->ring));
+	if (!st->path || !st->ring)
+		goto err;
+
+	st->listen_fd = stream_listen(path);
+	if (st->listen_fd < 0) {
+		log(ALL, LOG_ERR, "Can't listen on %s: %s\n", path,
+		    strerror(errno));
+		goto err;
+	}
+	st->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (st->wake_fd < 0)
+		goto err_listen;
+
+	if (pthread_create(&st->thread, NULL, stream_thread, st))
+		goto err_listen;
+
+	ras->stream = st;
+	log(ALL, LOG_INFO, "Streaming events on %s\n", path);
+
+	return 0;
+
+err_listen:
+	if (st->wake_fd >= 0)
+		close(st->wake_fd);
+	close(st->listen_fd);
+	unlink(path);
+err:
+	log(ALL, LOG_ERR, "Can't set up the event stream\n");
+	if (st) {
+		free(st->ring);
+		free(st->path);
+		free(st);
+	}
+	return -1;
+}
+
+void ras_stream_exit(struct ras_events *ras)
+{
+	struct ras_stream *st = ras->stream;
+	unsigned long i;
+
+	if (!st)
+		return;
+
+	pthread_mutex_lock(&st->lock);
+	st->stop = 1;
+	st->wake_pending = 0;
+	stream_wake(st);
+	pthread_mutex_unlock(&st->lock);
+	pthread_join(st->thread, NULL);
+
+	for (i = 0; i < STREAM_MAX_CLIENTS; i++)
+		if (st->clients[i].fd >= 0)
+			stream_client_close(&st->clients[i]);
+	for (i = 0; i < st->ring_count; i++) {
+		free(st->ring[(st->ring_head + i) % st->replay].json);
+		free(st->ring[(st->ring_head + i) % st->replay].bin);
+	}
+
+	close(st->listen_fd);
+	close(st->wake_fd);
+	unlink(st->path);
+	pthread_mutex_destroy(&st->lock);
+	free(st->ring);
+	free(st->path);
+	free(st);
+	ras->stream = NULL;
+}
+
+/*
+ * Per event type fields and severity
+ */
+
+static int stream_sev_name(const char *name)
+{
+	if (!strncmp(name, "Corrected", 9))
+		return RAS_SEV_CORRECTED;
+	if (strstr(name, "Fatal") && !strstr(name, "Non-Fatal"))
+		return RAS_SEV_FATAL;
+	if (!strncmp(name, "Uncorrected", 11) || !strcmp(name, "Recoverable"))
+		return RAS_SEV_RECOVERABLE;
+
+	return RAS_SEV_INFO;
+}
+
+void ras_stream_mc_event(struct ras_events *ras, struct ras_mc_event *ev)
+{
+	const struct stream_field f[] = {
+		SF_INT("error_count", ev->error_count),
+		SF_STR("error_type", ev->error_type),
+		SF_STR("msg", ev->msg),
+		SF_STR("label", ev->label),
+		SF_UINT("mc_index", ev->mc_index),
+		SF_INT("top_layer", ev->top_layer),
+		SF_INT("middle_layer", ev->middle_layer),
+		SF_INT("lower_layer", ev->lower_layer),
+		SF_UINT("address", ev->address),
+		SF_UINT("grain", ev->grain),
+		SF_UINT("syndrome", ev->syndrome),
+		SF_STR("driver_detail", ev->driver_detail),
+	};
+
+	stream_publish(ras, MC_EVENT, stream_sev_name(ev->error_type),
+		       ev->timestamp, f, ARRAY_SIZE(f));
+}
+
+void ras_stream_aer_event(struct ras_events *ras, struct ras_aer_event *ev)
+{
+	const struct stream_field f[] = {
+		SF_STR("dev_name", ev->dev_name),
+		SF_STR("error_type", ev->error_type),
+		SF_STR("msg", ev->msg),
+		SF_UINT("status", ev->status),
+		/* TLP header fields, if any */
+		SF_STR("tlp_type", ev->tlp.type),
+		SF_UINT("requester_id", ev->tlp.requester_id),
+		SF_UINT("tag", ev->tlp.tag),
+		SF_UINT("address", ev->tlp.address),
+	};
+
+	stream_publish(ras, AER_EVENT, stream_sev_name(ev->error_type),
+		       ev->timestamp, f,
+		       ev->tlp_header_valid ? ARRAY_SIZE(f) : 4);
+}
+
+void ras_stream_mce_event(struct ras_events *ras, struct mce_event *ev)
+{
+	const struct stream_field f[] = {
+		SF_STR("bank_name", ev->bank_name),
+		SF_STR("error_msg", ev->error_msg),
+		SF_STR("mcgstatus_msg", ev->mcgstatus_msg),
+		SF_STR("mcistatus_msg", ev->mcistatus_msg),
+		SF_STR("mcastatus_msg", ev->mcastatus_msg),
+		SF_STR("user_action", ev->user_action),
+		SF_STR("mc_location", ev->mc_location),
+		SF_UINT("mcgstatus", ev->mcgstatus),
+		SF_UINT("status", ev->status),
+		SF_UINT("addr", ev->addr),
+		SF_UINT("misc", ev->misc),
+		SF_UINT("cpu", ev->cpu),
+		SF_UINT("socketid", ev->socketid),
+		SF_UINT("bank", ev->bank),
+	};
+	int sev = RAS_SEV_CORRECTED;
+
+	if (ev->status & MCI_STATUS_PCC)
+		sev = RAS_SEV_FATAL;
+	else if (ev->status & MCI_STATUS_UC)
+		sev = RAS_SEV_RECOVERABLE;
+
+	stream_publish(ras, MCE_EVENT, sev, ev->timestamp, f, ARRAY_SIZE(f));
+}
+
+void ras_stream_non_standard_event(struct ras_events *ras,
+				   struct ras_non_standard_event *ev)
+{
+	char uuid[RAS_UUID_STR_LEN];
+	const struct stream_field f[] = {
+		SF_STR("severity", ev->severity),
+		SF_STR("sec_type",
+		       ras_uuid_le((const uint8_t *)ev->sec_type, uuid)),
+		SF_STR("fru_text", ev->fru_text),
+		SF_UINT("length", ev->length),
+	};
+
+	stream_publish(ras, NON_STANDARD_EVENT, stream_sev_name(ev->severity),
+		       ev->timestamp, f, ARRAY_SIZE(f));
+}
+
+void ras_stream_arm_event(struct ras_events *ras, struct ras_arm_event *ev)
+{
+	const struct stream_field f[] = {
+		SF_INT("error_count", ev->error_count),
+		SF_INT("affinity", ev->affinity),
+		SF_UINT("mpidr", ev->mpidr),
+		SF_UINT("midr", ev->midr),
+		SF_INT("running_state", ev->running_state),
+		SF_INT("psci_state", ev->psci_state),
+	};
+
+	/* The trace event has no severity */
+	stream_publish(ras, ARM_EVENT, RAS_SEV_INFO, ev->timestamp, f,
+		       ARRAY_SIZE(f));
+}
+
+void ras_stream_extlog_event(struct ras_events *ras,
+			     struct ras_extlog_event *ev)
+{
+	const struct stream_field f[] = {
+		SF_INT("error_seq", ev->error_seq),
+		SF_INT("etype", ev->etype),
+		SF_INT("severity", ev->severity),
+		SF_UINT("address", ev->address),
+		SF_INT("pa_mask_lsb", ev->pa_mask_lsb),
+	};
+	int sev;
+
+	/* A CPER severity, unlike the GHES one of the non standard events */
+	switch (ev->severity) {
+	case 0:
+		sev = RAS_SEV_RECOVERABLE;
+		break;
+	case 1:
+		sev = RAS_SEV_FATAL;
+		break;
+	case 2:
+		sev = RAS_SEV_CORRECTED;
+		break;
+	default:
+		sev = RAS_SEV_INFO;
+	}
+
+	stream_publish(ras, EXTLOG_EVENT, sev, ev->timestamp, f, ARRAY_SIZE(f));
+}
+
+void ras_stream_devlink_event(struct ras_events *ras, struct devlink_event *ev)
+{
+	const struct stream_field f[] = {
+		SF_STR("bus_name", ev->bus_name),
+		SF_STR("dev_name", ev->dev_name),
+		SF_STR("driver_name", ev->driver_name),
+		SF_STR("reporter_name", ev->reporter_name),
+		SF_STR("msg", ev->msg),
+	};
+
+	/* Health reporters are about errors the driver recovers from */
+	stream_publish(ras, DEVLINK_EVENT, RAS_SEV_RECOVERABLE, ev->timestamp,
+		       f, ARRAY_SIZE(f));
+}
+
+void ras_stream_diskerror_event(struct ras_events *ras,
+				struct diskerror_event *ev)
+{
+	const struct stream_field f[] = {
+		SF_STR("dev", ev->dev),
+		SF_STR("name", ev->name),
+		SF_STR("wwid", ev->wwid),
+		SF_STR("serial", ev->serial),
+		SF_UINT("sector", ev->sector),
+		SF_UINT("nr_sector", ev->nr_sector),
+		SF_STR("error", ev->error),
+		SF_STR("rwbs", ev->rwbs),
+		SF_STR("cmd", ev->cmd),
+	};
+
+	stream_publish(ras, DISKERROR_EVENT, RAS_SEV_RECOVERABLE,
+		       ev->timestamp, f, ARRAY_SIZE(f));
+}
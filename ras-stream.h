@@ -0,0 +1,85 @@
+/*
+ * Copyright (c) Huawei Technologies Co., Ltd. 2026. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#ifndef __RAS_STREAM_H
+#define __RAS_STREAM_H
+
+/*
+ * Live event stream, on the UNIX socket at RAS_EVENT_SOCKET.
+ *
+ * Clients subscribe by sending a line of space separated options:
+ *
+ *	types=<type>[,<type>...]	mc, mce, aer, non_standard, arm,
+ *					extlog, devlink, diskerror or all
+ *	severity=<sev>[,<sev>...]	info, corrected, recoverable, fatal
+ *					or all
+ *	format=json|binary
+ *	replay=<id>			first send the buffered events
+ *					after event <id>
+ *
+ * An empty line subscribes to everything, as JSON. Each record is then
+ * sent as a 32 bits length, in host byte order, followed by either a JSON
+ * object, or a binary record made of:
+ *
+ *	u64 id, u8 type, u8 severity, u16 number of fields
+ *	and for each field: u8 key length, key, u8 kind, then either
+ *	a u32 length and the string (kind 's'), or a signed (kind 'i')
+ *	or unsigned (kind 'u') 64 bits integer
+ *
+ * all in host byte order. Types are numbered in the order above, and
+ * severities too. Event ids increase, also across restarts.
+ *
+ * Events that don't fit the buffer of a client are dropped. The client
+ * is told how many with a "dropped" record (binary type 255), with a
+ * "count" field. Ids missing on a replay are reported the same way.
+ */
+
+struct ras_events;
+struct ras_mc_event;
+struct ras_aer_event;
+struct mce_event;
+struct ras_non_standard_event;
+struct ras_arm_event;
+struct ras_extlog_event;
+struct devlink_event;
+struct diskerror_event;
+
+enum ras_severity {
+	RAS_SEV_INFO,
+	RAS_SEV_CORRECTED,
+	RAS_SEV_RECOVERABLE,
+	RAS_SEV_FATAL,
+	NR_RAS_SEV
+};
+
+int ras_stream_init(struct ras_events *ras);
+void ras_stream_exit(struct ras_events *ras);
+
+void ras_stream_mc_event(struct ras_events *ras, struct ras_mc_event *ev);
+void ras_stream_aer_event(struct ras_events *ras, struct ras_aer_event *ev);
+void ras_stream_mce_event(struct ras_events *ras, struct mce_event *ev);
+void ras_stream_non_standard_event(struct ras_events *ras,
+				   struct ras_non_standard_event *ev);
+void ras_stream_arm_event(struct ras_events *ras, struct ras_arm_event *ev);
+void ras_stream_extlog_event(struct ras_events *ras,
+			     struct ras_extlog_event *ev);
+void ras_stream_devlink_event(struct ras_events *ras, struct devlink_event *ev);
+void ras_stream_diskerror_event(struct ras_events *ras,
+				struct diskerror_event *ev);
+
+#endif
@@ -17,6 +17,7 @@
 */
 
 #include <argp.h>
+#include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -25,6 +26,7 @@
 #include "ras-record.h"
 #include "ras-logger.h"
 #include "ras-events.h"
+#include "ras-mce-decode.h"
 
 /*
  * Arguments(argp) handling logic and main
@@ -32,7 +34,7 @@
 
 #define TOOL_NAME "rasdaemon"
 #define TOOL_DESCRIPTION "RAS daemon to log the RAS events."
-#define ARGS_DOC "<options>"
+#define ARGS_DOC "<options> [FILE...]"
 
 const char *argp_program_version = TOOL_NAME " " VERSION;
 const char *argp_program_bug_address = "Mauro Carvalho Chehab <mchehab@kernel.org>";
@@ -41,6 +43,22 @@ struct arguments {
 	int record_events;
 	int enable_ras;
 	int foreground;
+#ifdef HAVE_MCE
+	int decode_mce;
+	struct mce_decode_opts mce_opts;
+#endif
+};
+
+/* Long-only options */
+enum {
+	OPT_DECODE_MCE = 0x100,
+	OPT_CPU_VENDOR,
+	OPT_CPU_FAMILY,
+	OPT_CPU_MODEL,
+	OPT_SMCA,
+	OPT_BINARY,
+	OPT_THREADS,
+	OPT_TRACEFS_ROOT,
 };
 
 static error_t parse_opt(int k, char *arg, struct argp_state *state)
@@ -62,6 +80,36 @@ static error_t parse_opt(int k, char *arg, struct argp_state *state)
 	case 'f':
 		args->foreground++;
 		break;
+	case OPT_TRACEFS_ROOT:
+		/* Made absolute, as daemon() changes to the root directory */
+		ras_tracefs_root = realpath(arg, NULL);
+		if (!ras_tracefs_root)
+			argp_error(state, "Can't use %s as the tracing instance: %s",
+				   arg, strerror(errno));
+		break;
+#ifdef HAVE_MCE
+	case OPT_DECODE_MCE:
+		args->decode_mce++;
+		break;
+	case OPT_CPU_VENDOR:
+		args->mce_opts.vendor = arg;
+		break;
+	case OPT_CPU_FAMILY:
+		args->mce_opts.family = strtoul(arg, NULL, 0);
+		break;
+	case OPT_CPU_MODEL:
+		args->mce_opts.model = strtoul(arg, NULL, 0);
+		break;
+	case OPT_SMCA:
+		args->mce_opts.smca = 1;
+		break;
+	case OPT_BINARY:
+		args->mce_opts.binary = 1;
+		break;
+	case OPT_THREADS:
+		args->mce_opts.threads = strtoul(arg, NULL, 0);
+		break;
+#endif
 	default:
 		return ARGP_ERR_UNKNOWN;
 	}
@@ -81,6 +129,16 @@ int main(int argc, char *argv[])
 		{"record",  'r', 0, 0, "record events via sqlite3", 0},
 #endif
 		{"foreground", 'f', 0, 0, "run foreground, not daemonize"},
+		{"tracefs-root", OPT_TRACEFS_ROOT, "DIR", 0, "use DIR as the tracing instance, e. g. one made by ras-bench --tracefs"},
+#ifdef HAVE_MCE
+		{"decode-mce", OPT_DECODE_MCE, 0, 0, "decode raw MCE records from FILEs (or stdin) and exit", 1},
+		{"cpu-vendor", OPT_CPU_VENDOR, "VENDOR", 0, "vendor_id of the CPU that logged the records", 1},
+		{"cpu-family", OPT_CPU_FAMILY, "FAMILY", 0, "CPU family of the CPU that logged the records", 1},
+		{"cpu-model", OPT_CPU_MODEL, "MODEL", 0, "CPU model of the CPU that logged the records", 1},
+		{"smca", OPT_SMCA, 0, 0, "records use AMD Scalable MCA", 1},
+		{"binary", OPT_BINARY, 0, 0, "input is binary instead of CSV", 1},
+		{"threads", OPT_THREADS, "N", 0, "decode up to N files in parallel", 1},
+#endif
 
 		{ 0, 0, 0, 0, 0, 0 }
 	};
@@ -94,6 +152,7 @@ int main(int argc, char *argv[])
 	memset (&args, 0, sizeof(args));
 
 	user_hz = sysconf(_SC_CLK_TCK);
+	ras_log_set_level();
 
 	argp_parse(&argp, argc, argv, 0,  &idx, &args);
 
@@ -102,6 +161,12 @@ int main(int argc, char *argv[])
 		return -1;
 	}
 
+#ifdef HAVE_MCE
+	if (args.decode_mce)
+		return ras_mce_decode_files(&args.mce_opts, argv + idx,
+					    argc - idx) ? EXIT_FAILURE : 0;
+#endif
+
 	if (args.enable_ras) {
 		int enable;
 
@@ -116,6 +181,10 @@ int main(int argc, char *argv[])
 		if (daemon(0,0))
 			exit(EXIT_FAILURE);
 
+	/* After daemon(), as threads don't survive fork() */
+	if (ras_log_init())
+		log(ALL, LOG_WARNING, "Can't start the logging thread\n");
+
 	handle_ras_events(args.record_events);
 
 	return 0;
@@ -0,0 +1,44 @@
+#!/bin/sh
+#
+# Runs rasdaemon on a stand-in tracing instance of a kernel without poll()
+# on trace_pipe_raw, where it reads each cpu on its own thread, and checks
+# that the disk error regions are still reported as they come.
+
+grep -q '^#define HAVE_DISKERROR' config.h || exit 77
+
+dir=$(mktemp -d) || exit 99
+trap 'kill $bench $daemon 2>/dev/null; wait; rm -rf "$dir"' EXIT
+
+./ras-bench -F "$srcdir/bench/formats" -T "$dir/tracing" -L -c 2 \
+	    -n 64 -m diskerror > "$dir/bench.log" 2>&1 &
+bench=$!
+
+i=0
+until grep -q Waiting "$dir/bench.log"; do
+	i=$((i + 1))
+	if [ $i -gt 50 ] || ! kill -0 $bench 2>/dev/null; then
+		cat "$dir/bench.log"
+		exit 99
+	fi
+	sleep 0.1
+done
+
+DISKERROR_REGION_INTERVAL=1 RAS_DB_FILE="$dir/ras.db" \
+	./rasdaemon -f --tracefs-root="$dir/tracing" > "$dir/rasdaemon.log" 2>&1 &
+daemon=$!
+
+# The threads sleep 3 seconds between reads when there's nothing to read
+i=0
+until grep -q "bad regions" "$dir/rasdaemon.log"; do
+	i=$((i + 1))
+	if [ $i -gt 100 ] || ! kill -0 $daemon 2>/dev/null; then
+		cat "$dir/bench.log" "$dir/rasdaemon.log"
+		exit 1
+	fi
+	sleep 0.1
+done
+
+grep -q "fall back to pthread way" "$dir/rasdaemon.log" || {
+	cat "$dir/rasdaemon.log"
+	exit 1
+}
@@ -0,0 +1,137 @@
+/*
+ * Copyright (c) Huawei Technologies Co., Ltd. 2026. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+/*
+ * Publishes an extlog event of each CPER severity on the event stream, and
+ * checks the severity of the binary records a client gets on replay.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "config.h"
+#include "ras-events.h"
+#include "ras-record.h"
+#include "ras-stream.h"
+
+long user_hz;
+
+#ifdef HAVE_EXTLOG
+static const struct {
+	int		cper;
+	int		sev;
+} cases[] = {
+	{ 0, RAS_SEV_RECOVERABLE },
+	{ 1, RAS_SEV_FATAL },
+	{ 2, RAS_SEV_CORRECTED },
+	{ 3, RAS_SEV_INFO },
+};
+
+#define NR_CASES	(sizeof(cases) / sizeof(cases[0]))
+
+static int read_all(int fd, void *buf, size_t len)
+{
+	ssize_t rc;
+
+	while (len) {
+		rc = read(fd, buf, len);
+		if (rc <= 0)
+			return -1;
+		buf = (char *)buf + rc;
+		len -= rc;
+	}
+
+	return 0;
+}
+
+int main(void)
+{
+	static const char subscribe[] = "format=binary replay=0\n";
+	struct ras_extlog_event ev;
+	struct sockaddr_un addr;
+	struct ras_events ras;
+	char path[] = "/tmp/ras-stream-XXXXXX";
+	unsigned char rec[4096];
+	uint32_t len;
+	unsigned int i;
+	int fd, rc = 0;
+
+	if (!mkdtemp(path))
+		return 99;
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	snprintf(addr.sun_path, sizeof(addr.sun_path), "%s/stream", path);
+	setenv("RAS_EVENT_SOCKET", addr.sun_path, 1);
+
+	memset(&ras, 0, sizeof(ras));
+	if (ras_stream_init(&ras) || !ras.stream) {
+		rmdir(path);
+		return 99;
+	}
+
+	/* Kept on the replay ring, for the client to get them all */
+	for (i = 0; i < NR_CASES; i++) {
+		memset(&ev, 0, sizeof(ev));
+		ev.error_seq = i;
+		ev.severity = cases[i].cper;
+		ras_stream_extlog_event(&ras, &ev);
+	}
+
+	fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0 || connect(fd, (struct sockaddr *)&addr, sizeof(addr)) ||
+	    write(fd, subscribe, strlen(subscribe)) != strlen(subscribe)) {
+		rc = 99;
+		goto out;
+	}
+
+	/* u64 id, u8 type, u8 severity... */
+	for (i = 0; i < NR_CASES; i++) {
+		if (read_all(fd, &len, sizeof(len)) || len > sizeof(rec) ||
+		    len < 10 || read_all(fd, rec, len)) {
+			fprintf(stderr, "Can't read record %u\n", i);
+			rc = 1;
+			break;
+		}
+		if (rec[8] != EXTLOG_EVENT || rec[9] != cases[i].sev) {
+			fprintf(stderr,
+				"CPER severity %d: type %u severity %u, expected %d\n",
+				cases[i].cper, rec[8], rec[9], cases[i].sev);
+			rc = 1;
+		}
+	}
+
+out:
+	if (fd >= 0)
+		close(fd);
+	ras_stream_exit(&ras);
+	rmdir(path);
+
+	return rc;
+}
+#else
+int main(void)
+{
+	/* Skipped */
+	return 77;
+}
+#endif